@@ -259,6 +259,9 @@ void AbstractClient::updateLayer()
 void AbstractClient::invalidateLayer()
 {
     m_layer = UnknownLayer;
+    if (Workspace *ws = workspace()) {
+        ws->invalidateRestackHint();
+    }
 }
 
 Layer AbstractClient::belongsToLayer() const
@@ -1252,11 +1255,17 @@ void AbstractClient::addTransient(AbstractClient *cl)
     Q_ASSERT(!m_transients.contains(cl));
     Q_ASSERT(cl != this);
     m_transients.append(cl);
+    if (Workspace *ws = workspace()) {
+        ws->invalidateRestackHint();
+    }
 }
 
 void AbstractClient::removeTransient(AbstractClient *cl)
 {
     m_transients.removeAll(cl);
+    if (Workspace *ws = workspace()) {
+        ws->invalidateRestackHint();
+    }
     if (cl->transientFor() == this) {
         cl->setTransientFor(nullptr);
     }
@@ -1265,6 +1274,9 @@ void AbstractClient::removeTransient(AbstractClient *cl)
 void AbstractClient::removeTransientFromList(AbstractClient *cl)
 {
     m_transients.removeAll(cl);
+    if (Workspace *ws = workspace()) {
+        ws->invalidateRestackHint();
+    }
 }
 
 bool AbstractClient::isActiveFullScreen() const
@@ -22,7 +22,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMap>
 #include <QVector>
 
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+
+struct MockObjectProperties {
+    QVector<uint32_t> properties;
+    QVector<uint64_t> values;
+};
+
+struct MockPlane {
+    uint32_t possibleCrtcs;
+    QVector<uint32_t> formats;
+};
+
 static QMap<int, QVector<_drmModeProperty>> s_drmProperties{};
+static QMap<QPair<int, uint32_t>, MockObjectProperties> s_drmObjectProperties{};
+static QMap<QPair<int, uint32_t>, MockPlane> s_drmPlanes{};
+static MockDrm::AtomicCommitHandler s_atomicCommitHandler{};
 
 namespace MockDrm
 {
@@ -32,14 +49,129 @@ void addDrmModeProperties(int fd, const QVector<_drmModeProperty> &properties)
     s_drmProperties.insert(fd, properties);
 }
 
+void addDrmModeObjectProperties(int fd, uint32_t objectId, const QVector<uint32_t> &properties, const QVector<uint64_t> &values)
+{
+    Q_ASSERT(properties.size() == values.size());
+    s_drmObjectProperties.insert(qMakePair(fd, objectId), MockObjectProperties{properties, values});
+}
+
+void addDrmModePlane(int fd, uint32_t planeId, uint32_t possibleCrtcs, const QVector<uint32_t> &formats)
+{
+    s_drmPlanes.insert(qMakePair(fd, planeId), MockPlane{possibleCrtcs, formats});
+}
+
+void setAtomicCommitHandler(const AtomicCommitHandler &handler)
+{
+    s_atomicCommitHandler = handler;
+}
+
+}
+
+drmModeAtomicReqPtr drmModeAtomicAlloc()
+{
+    return new _drmModeAtomicReq;
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req)
+{
+    delete req;
 }
 
 int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value)
 {
-    Q_UNUSED(req)
-    Q_UNUSED(object_id)
-    Q_UNUSED(property_id)
-    Q_UNUSED(value)
+    if (!req) {
+        return -EINVAL;
+    }
+    req->items << _drmModeAtomicReq::Item{object_id, property_id, value};
+    return req->items.count();
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *user_data)
+{
+    Q_UNUSED(fd)
+    Q_UNUSED(user_data)
+    if (s_atomicCommitHandler && !s_atomicCommitHandler(req, flags)) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd, uint32_t object_id, uint32_t object_type)
+{
+    Q_UNUSED(object_type)
+    auto it = s_drmObjectProperties.constFind(qMakePair(fd, object_id));
+    if (it == s_drmObjectProperties.constEnd()) {
+        return nullptr;
+    }
+    auto *properties = new drmModeObjectProperties;
+    properties->count_props = it->properties.count();
+    properties->props = new uint32_t[it->properties.count()];
+    properties->prop_values = new uint64_t[it->values.count()];
+    std::copy(it->properties.constBegin(), it->properties.constEnd(), properties->props);
+    std::copy(it->values.constBegin(), it->values.constEnd(), properties->prop_values);
+    return properties;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    delete[] ptr->props;
+    delete[] ptr->prop_values;
+    delete ptr;
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id)
+{
+    auto it = s_drmPlanes.constFind(qMakePair(fd, plane_id));
+    if (it == s_drmPlanes.constEnd()) {
+        return nullptr;
+    }
+    auto *plane = new _drmModePlane{};
+    plane->plane_id = plane_id;
+    plane->possible_crtcs = it->possibleCrtcs;
+    plane->count_formats = it->formats.count();
+    plane->formats = new uint32_t[it->formats.count()];
+    std::copy(it->formats.constBegin(), it->formats.constEnd(), plane->formats);
+    return plane;
+}
+
+void drmModeFreePlane(drmModePlanePtr ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    delete[] ptr->formats;
+    delete ptr;
+}
+
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+    Q_UNUSED(fd)
+    Q_UNUSED(request)
+    Q_UNUSED(arg)
+    errno = ENOTSUP;
+    return -1;
+}
+
+int drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth, uint8_t bpp, uint32_t pitch, uint32_t bo_handle, uint32_t *buf_id)
+{
+    Q_UNUSED(fd)
+    Q_UNUSED(width)
+    Q_UNUSED(height)
+    Q_UNUSED(depth)
+    Q_UNUSED(bpp)
+    Q_UNUSED(pitch)
+    Q_UNUSED(bo_handle)
+    Q_UNUSED(buf_id)
+    return -ENOTSUP;
+}
+
+int drmModeRmFB(int fd, uint32_t bufferId)
+{
+    Q_UNUSED(fd)
+    Q_UNUSED(bufferId)
     return 0;
 }
 
@@ -24,9 +24,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QVector>
 
+#include <functional>
+
+/**
+ * Records the properties added to an atomic request.
+ */
+struct _drmModeAtomicReq
+{
+    struct Item {
+        uint32_t object;
+        uint32_t property;
+        uint64_t value;
+    };
+    QVector<Item> items;
+};
+
 namespace MockDrm
 {
 
 void addDrmModeProperties(int fd, const QVector<_drmModeProperty> &properties);
+void addDrmModeObjectProperties(int fd, uint32_t objectId, const QVector<uint32_t> &properties, const QVector<uint64_t> &values);
+void addDrmModePlane(int fd, uint32_t planeId, uint32_t possibleCrtcs, const QVector<uint32_t> &formats);
+
+/**
+ * Decides whether an atomic commit succeeds. Without a handler all commits succeed.
+ */
+using AtomicCommitHandler = std::function<bool(const drmModeAtomicReq *req, uint32_t flags)>;
+void setAtomicCommitHandler(const AtomicCommitHandler &handler);
 
 }
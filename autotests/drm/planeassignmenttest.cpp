@@ -0,0 +1,398 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "mock_drm.h"
+#include "../../plugins/platforms/drm/drm_buffer.h"
+#include "../../plugins/platforms/drm/drm_object_plane.h"
+#include "../../plugins/platforms/drm/drm_plane_assignment.h"
+#include <QtTest>
+
+#include <drm_fourcc.h>
+
+using namespace KWin;
+
+static const int s_fd = 30;
+static const uint32_t s_crtcId = 100;
+static const QSize s_modeSize(1920, 1080);
+
+enum MockProperty : uint32_t {
+    TypeProperty = 1,
+    SrcXProperty,
+    SrcYProperty,
+    SrcWProperty,
+    SrcHProperty,
+    CrtcXProperty,
+    CrtcYProperty,
+    CrtcWProperty,
+    CrtcHProperty,
+    FbIdProperty,
+    CrtcIdProperty
+};
+
+/**
+ * A buffer which is only known by its id, nothing gets allocated.
+ */
+class FakeBuffer : public DrmBuffer
+{
+public:
+    FakeBuffer(uint32_t id, const QSize &size)
+        : DrmBuffer(s_fd)
+    {
+        m_bufferId = id;
+        m_size = size;
+    }
+};
+
+static uint64_t propertyValue(const drmModeAtomicReq *req, uint32_t object, uint32_t property)
+{
+    for (const auto &item : req->items) {
+        if (item.object == object && item.property == property) {
+            return item.value;
+        }
+    }
+    return 0;
+}
+
+class PlaneAssignmentTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testPrimary();
+    void testPrimaryRejected_data();
+    void testPrimaryRejected();
+    void testPrimaryDisablesOverlays();
+    void testOverlays();
+    void testOverlayFormat();
+    void testOverlayCrtc();
+    void testOverlayFallback();
+    void testBandwidth_data();
+    void testBandwidth();
+
+private:
+    DrmPlane *createPlane(uint32_t id, DrmPlane::TypeIndex type, uint32_t possibleCrtcs, const QVector<uint32_t> &formats);
+
+    DrmPlane *m_primary = nullptr;
+    QVector<DrmPlane *> m_overlays;
+    QVector<_drmModeAtomicReq> m_tests;
+    uint32_t m_nextPlaneId = 10;
+};
+
+void PlaneAssignmentTest::initTestCase()
+{
+    static drm_mode_property_enum typeEnums[] = {
+        {0, "Overlay"},
+        {1, "Primary"},
+        {2, "Cursor"}
+    };
+    const QVector<QPair<uint32_t, QByteArray>> names = {
+        {SrcXProperty, QByteArrayLiteral("SRC_X")},
+        {SrcYProperty, QByteArrayLiteral("SRC_Y")},
+        {SrcWProperty, QByteArrayLiteral("SRC_W")},
+        {SrcHProperty, QByteArrayLiteral("SRC_H")},
+        {CrtcXProperty, QByteArrayLiteral("CRTC_X")},
+        {CrtcYProperty, QByteArrayLiteral("CRTC_Y")},
+        {CrtcWProperty, QByteArrayLiteral("CRTC_W")},
+        {CrtcHProperty, QByteArrayLiteral("CRTC_H")},
+        {FbIdProperty, QByteArrayLiteral("FB_ID")},
+        {CrtcIdProperty, QByteArrayLiteral("CRTC_ID")}
+    };
+    QVector<_drmModeProperty> properties;
+    _drmModeProperty type{};
+    type.prop_id = TypeProperty;
+    type.flags = DRM_MODE_PROP_ENUM;
+    qstrncpy(type.name, "type", DRM_PROP_NAME_LEN);
+    type.count_enums = 3;
+    type.enums = typeEnums;
+    properties << type;
+    for (const auto &name : names) {
+        _drmModeProperty property{};
+        property.prop_id = name.first;
+        qstrncpy(property.name, name.second.constData(), DRM_PROP_NAME_LEN);
+        properties << property;
+    }
+    MockDrm::addDrmModeProperties(s_fd, properties);
+}
+
+DrmPlane *PlaneAssignmentTest::createPlane(uint32_t id, DrmPlane::TypeIndex type, uint32_t possibleCrtcs, const QVector<uint32_t> &formats)
+{
+    MockDrm::addDrmModePlane(s_fd, id, possibleCrtcs, formats);
+    MockDrm::addDrmModeObjectProperties(s_fd, id,
+        {TypeProperty, SrcXProperty, SrcYProperty, SrcWProperty, SrcHProperty, CrtcXProperty,
+         CrtcYProperty, CrtcWProperty, CrtcHProperty, FbIdProperty, CrtcIdProperty},
+        {uint64_t(type), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    DrmPlane *plane = new DrmPlane(id, s_fd);
+    if (!plane->atomicInit()) {
+        delete plane;
+        return nullptr;
+    }
+    return plane;
+}
+
+void PlaneAssignmentTest::init()
+{
+    m_primary = createPlane(m_nextPlaneId++, DrmPlane::TypeIndex::Primary, 0x1, {DRM_FORMAT_XRGB8888, DRM_FORMAT_ARGB8888});
+    QVERIFY(m_primary);
+    QCOMPARE(m_primary->type(), DrmPlane::TypeIndex::Primary);
+    // the composited image currently shown
+    m_primary->setCurrent(new FakeBuffer(1, s_modeSize));
+
+    m_overlays << createPlane(m_nextPlaneId++, DrmPlane::TypeIndex::Overlay, 0x1, {DRM_FORMAT_XRGB8888, DRM_FORMAT_NV12})
+               << createPlane(m_nextPlaneId++, DrmPlane::TypeIndex::Overlay, 0x3, {DRM_FORMAT_XRGB8888, DRM_FORMAT_ARGB8888})
+               << createPlane(m_nextPlaneId++, DrmPlane::TypeIndex::Overlay, 0x2, {DRM_FORMAT_XRGB8888});
+    QVERIFY(!m_overlays.contains(nullptr));
+
+    MockDrm::setAtomicCommitHandler(
+        [this] (const drmModeAtomicReq *req, uint32_t flags) {
+            if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
+                m_tests << *req;
+            }
+            return true;
+        }
+    );
+}
+
+void PlaneAssignmentTest::cleanup()
+{
+    MockDrm::setAtomicCommitHandler(MockDrm::AtomicCommitHandler());
+    m_tests.clear();
+    delete m_primary;
+    m_primary = nullptr;
+    // the buffers of the overlays are owned by the tests
+    for (DrmPlane *plane : qAsConst(m_overlays)) {
+        plane->disable();
+        delete plane;
+    }
+    m_overlays.clear();
+}
+
+void PlaneAssignmentTest::testPrimary()
+{
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    DrmBuffer *buffer = new FakeBuffer(2, s_modeSize);
+    uint64_t testedFb = 0;
+    MockDrm::setAtomicCommitHandler(
+        [this, &testedFb] (const drmModeAtomicReq *req, uint32_t flags) {
+            if (flags & DRM_MODE_ATOMIC_TEST_ONLY) {
+                testedFb = propertyValue(req, m_primary->id(), FbIdProperty);
+            }
+            return true;
+        }
+    );
+    QVERIFY(assignment.assignPrimary(m_primary, {buffer, DRM_FORMAT_XRGB8888, QRect(QPoint(0, 0), s_modeSize)}, s_modeSize, m_overlays));
+    QCOMPARE(testedFb, uint64_t(2));
+    QCOMPARE(m_primary->next(), buffer);
+    m_primary->flipBufferWithDelete();
+    QCOMPARE(m_primary->current(), buffer);
+}
+
+void PlaneAssignmentTest::testPrimaryRejected_data()
+{
+    QTest::addColumn<QSize>("bufferSize");
+    QTest::addColumn<QRect>("geometry");
+    QTest::addColumn<uint32_t>("format");
+    QTest::addColumn<bool>("testPasses");
+
+    QTest::newRow("smaller buffer") << QSize(1280, 720) << QRect(QPoint(0, 0), s_modeSize) << uint32_t(DRM_FORMAT_XRGB8888) << true;
+    QTest::newRow("not fullscreen") << s_modeSize << QRect(QPoint(10, 0), s_modeSize) << uint32_t(DRM_FORMAT_XRGB8888) << true;
+    QTest::newRow("format") << s_modeSize << QRect(QPoint(0, 0), s_modeSize) << uint32_t(DRM_FORMAT_NV12) << true;
+    QTest::newRow("test commit") << s_modeSize << QRect(QPoint(0, 0), s_modeSize) << uint32_t(DRM_FORMAT_XRGB8888) << false;
+}
+
+void PlaneAssignmentTest::testPrimaryRejected()
+{
+    QFETCH(QSize, bufferSize);
+    QFETCH(QRect, geometry);
+    QFETCH(uint32_t, format);
+    QFETCH(bool, testPasses);
+    MockDrm::setAtomicCommitHandler(
+        [testPasses] (const drmModeAtomicReq *req, uint32_t flags) {
+            Q_UNUSED(req)
+            return !(flags & DRM_MODE_ATOMIC_TEST_ONLY) || testPasses;
+        }
+    );
+
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> buffer(new FakeBuffer(2, bufferSize));
+    QVERIFY(!assignment.assignPrimary(m_primary, {buffer.data(), format, geometry}, s_modeSize, m_overlays));
+    // the composited image is presented instead
+    QVERIFY(!m_primary->next());
+    QCOMPARE(m_primary->current()->bufferId(), 1u);
+}
+
+void PlaneAssignmentTest::testPrimaryDisablesOverlays()
+{
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> overlayBuffer(new FakeBuffer(3, QSize(100, 100)));
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {{overlayBuffer.data(), DRM_FORMAT_XRGB8888, QRect(10, 10, 100, 100)}});
+    QCOMPARE(planes.first(), m_overlays.first());
+
+    m_tests.clear();
+    DrmBuffer *buffer = new FakeBuffer(2, s_modeSize);
+    QVERIFY(assignment.assignPrimary(m_primary, {buffer, DRM_FORMAT_XRGB8888, QRect(QPoint(0, 0), s_modeSize)}, s_modeSize, m_overlays));
+    QVERIFY(!m_overlays.first()->next());
+    QCOMPARE(m_tests.count(), 1);
+    QCOMPARE(propertyValue(&m_tests.first(), m_overlays.first()->id(), CrtcIdProperty), uint64_t(0));
+    QCOMPARE(propertyValue(&m_tests.first(), m_overlays.first()->id(), FbIdProperty), uint64_t(0));
+}
+
+void PlaneAssignmentTest::testOverlays()
+{
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> first(new FakeBuffer(3, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> second(new FakeBuffer(4, QSize(200, 100)));
+    QVector<uint64_t> lastFbIds;
+    MockDrm::setAtomicCommitHandler(
+        [this, &lastFbIds] (const drmModeAtomicReq *req, uint32_t flags) {
+            Q_UNUSED(flags)
+            lastFbIds = {propertyValue(req, m_primary->id(), FbIdProperty),
+                         propertyValue(req, m_overlays[0]->id(), FbIdProperty),
+                         propertyValue(req, m_overlays[1]->id(), FbIdProperty)};
+            return true;
+        }
+    );
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {
+        {first.data(), DRM_FORMAT_XRGB8888, QRect(100, 100, 640, 480)},
+        {second.data(), DRM_FORMAT_ARGB8888, QRect(800, 100, 400, 200)}
+    });
+    QCOMPARE(planes, QVector<DrmPlane *>({m_overlays[0], m_overlays[1]}));
+    // the composited image is tested, but stays the pending state of the primary plane
+    QCOMPARE(lastFbIds, QVector<uint64_t>({1, 3, 4}));
+    QVERIFY(!m_primary->next());
+    QCOMPARE(m_overlays[1]->next(), second.data());
+    QVERIFY(!m_overlays[2]->next());
+
+    // the geometry is applied in device pixels, the source is the complete buffer
+    drmModeAtomicReq req;
+    QVERIFY(m_overlays[1]->atomicPopulate(&req));
+    QCOMPARE(propertyValue(&req, m_overlays[1]->id(), CrtcIdProperty), uint64_t(s_crtcId));
+    QCOMPARE(propertyValue(&req, m_overlays[1]->id(), CrtcXProperty), uint64_t(800));
+    QCOMPARE(propertyValue(&req, m_overlays[1]->id(), CrtcWProperty), uint64_t(400));
+    QCOMPARE(propertyValue(&req, m_overlays[1]->id(), SrcWProperty), uint64_t(200) << 16);
+    QCOMPARE(propertyValue(&req, m_overlays[1]->id(), SrcHProperty), uint64_t(100) << 16);
+
+    // no layers anymore, the overlays get disabled
+    QVERIFY(assignment.assignOverlays(m_primary, m_overlays, {}).isEmpty());
+    for (DrmPlane *plane : qAsConst(m_overlays)) {
+        QVERIFY(!plane->next());
+    }
+}
+
+void PlaneAssignmentTest::testOverlayFormat()
+{
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> nv12(new FakeBuffer(3, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> argb(new FakeBuffer(4, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> yuyv(new FakeBuffer(5, QSize(640, 480)));
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {
+        {argb.data(), DRM_FORMAT_ARGB8888, QRect(0, 0, 640, 480)},
+        {nv12.data(), DRM_FORMAT_NV12, QRect(700, 0, 640, 480)},
+        {yuyv.data(), DRM_FORMAT_YUYV, QRect(0, 500, 640, 480)}
+    });
+    // each layer ends up on the only plane supporting its format, without a test commit for the others
+    QCOMPARE(planes, QVector<DrmPlane *>({m_overlays[1], m_overlays[0], nullptr}));
+    QCOMPARE(m_tests.count(), 2);
+}
+
+void PlaneAssignmentTest::testOverlayCrtc()
+{
+    // the second CRTC can only use the second and the third overlay
+    DrmPlaneAssignment assignment(s_fd, s_crtcId + 1, 1);
+    QScopedPointer<DrmBuffer> first(new FakeBuffer(3, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> second(new FakeBuffer(4, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> third(new FakeBuffer(5, QSize(640, 480)));
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {
+        {first.data(), DRM_FORMAT_XRGB8888, QRect(0, 0, 640, 480)},
+        {second.data(), DRM_FORMAT_XRGB8888, QRect(700, 0, 640, 480)},
+        {third.data(), DRM_FORMAT_XRGB8888, QRect(0, 500, 640, 480)}
+    });
+    QCOMPARE(planes, QVector<DrmPlane *>({m_overlays[1], m_overlays[2], nullptr}));
+}
+
+void PlaneAssignmentTest::testOverlayFallback()
+{
+    // the first overlay can't scale, the layer has to go onto the second one
+    MockDrm::setAtomicCommitHandler(
+        [this] (const drmModeAtomicReq *req, uint32_t flags) {
+            Q_UNUSED(flags)
+            const uint32_t plane = m_overlays[0]->id();
+            if (propertyValue(req, plane, CrtcIdProperty) == 0) {
+                return true;
+            }
+            return propertyValue(req, plane, SrcWProperty) >> 16 == propertyValue(req, plane, CrtcWProperty);
+        }
+    );
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> scaled(new FakeBuffer(3, QSize(320, 240)));
+    QScopedPointer<DrmBuffer> unscaled(new FakeBuffer(4, QSize(320, 240)));
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {
+        {scaled.data(), DRM_FORMAT_XRGB8888, QRect(0, 0, 640, 480)},
+        {unscaled.data(), DRM_FORMAT_XRGB8888, QRect(700, 0, 320, 240)}
+    });
+    QCOMPARE(planes, QVector<DrmPlane *>({m_overlays[1], m_overlays[0]}));
+    QCOMPARE(m_overlays[0]->next(), unscaled.data());
+    QCOMPARE(m_overlays[1]->next(), scaled.data());
+}
+
+void PlaneAssignmentTest::testBandwidth_data()
+{
+    QTest::addColumn<int>("maxPlanes");
+
+    QTest::newRow("none") << 0;
+    QTest::newRow("one") << 1;
+    QTest::newRow("two") << 2;
+}
+
+void PlaneAssignmentTest::testBandwidth()
+{
+    // the hardware can only scan out a limited number of planes at once
+    QFETCH(int, maxPlanes);
+    MockDrm::setAtomicCommitHandler(
+        [this, maxPlanes] (const drmModeAtomicReq *req, uint32_t flags) {
+            Q_UNUSED(flags)
+            int enabled = 0;
+            for (DrmPlane *plane : qAsConst(m_overlays)) {
+                if (propertyValue(req, plane->id(), FbIdProperty) != 0) {
+                    enabled++;
+                }
+            }
+            return enabled <= maxPlanes;
+        }
+    );
+    DrmPlaneAssignment assignment(s_fd, s_crtcId, 0);
+    QScopedPointer<DrmBuffer> first(new FakeBuffer(3, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> second(new FakeBuffer(4, QSize(640, 480)));
+    QScopedPointer<DrmBuffer> third(new FakeBuffer(5, QSize(640, 480)));
+    const auto planes = assignment.assignOverlays(m_primary, m_overlays, {
+        {first.data(), DRM_FORMAT_XRGB8888, QRect(0, 0, 640, 480)},
+        {second.data(), DRM_FORMAT_XRGB8888, QRect(700, 0, 640, 480)},
+        {third.data(), DRM_FORMAT_XRGB8888, QRect(0, 500, 640, 480)}
+    });
+    QCOMPARE(planes.count(), 3);
+    QCOMPARE(planes.count(nullptr), 3 - maxPlanes);
+    // the top most layers get the planes
+    for (int i = 0; i < maxPlanes; ++i) {
+        QVERIFY(planes.at(i));
+    }
+}
+
+QTEST_GUILESS_MAIN(PlaneAssignmentTest)
+#include "planeassignmenttest.moc"
@@ -0,0 +1,429 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "abstract_output.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "framescheduler.h"
+#include "internal_client.h"
+#include "platform.h"
+#include "screens.h"
+#include "virtualdesktops.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QRasterWindow>
+
+#include <atomic>
+#include <time.h>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+/*
+ * Every heap allocation of the process is counted, so that the number of allocations per
+ * frame can be reported. The allocator of glibc is wrapped, which also catches the
+ * allocations of Qt's containers which don't go through operator new.
+ */
+static std::atomic<quint64> s_allocations(0);
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+static qint64 threadCpuTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static int environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok && value > 0 ? value : defaultValue;
+}
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_compositor_benchmark-0");
+
+class InternalWindow : public QRasterWindow
+{
+    Q_OBJECT
+public:
+    InternalWindow()
+        : QRasterWindow(nullptr)
+    {
+        setFlags(Qt::FramelessWindowHint);
+    }
+
+protected:
+    void paintEvent(QPaintEvent *event) override {
+        Q_UNUSED(event)
+        QPainter p(this);
+        p.fillRect(0, 0, width(), height(), Qt::darkCyan);
+    }
+};
+
+/**
+ * Replays typical workloads on the virtual platform and records for every painted frame
+ * the CPU time spent in the compositing pass, the paint time reported to the frame
+ * scheduler, the damaged area and the number of heap allocations.
+ *
+ * The frames are written as JSON objects, one per line, to the file named by
+ * KWIN_BENCHMARK_OUTPUT (compositor_benchmark.json in the working directory by default).
+ * KWIN_BENCHMARK_CLIENTS sets the number of clients (default 20) and
+ * KWIN_BENCHMARK_ITERATIONS how often each workload is repeated (default 5). The scene
+ * is picked through KWIN_COMPOSE, by default the QPainter scene is used, so that no GPU
+ * is needed.
+ */
+class CompositorBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+    void benchmarkWindowStorm();
+    void benchmarkInternalWindowStorm();
+    void benchmarkResize();
+    void benchmarkDesktopSwitch();
+    void benchmarkEffectAnimations();
+
+private:
+    void frameStarted();
+    void framePainted(FrameScheduler *scheduler, const QRegion &damage);
+    void createWindows(int count);
+    void destroyWindows();
+    void createInternalWindows(int count);
+    void waitForIdle();
+    void switchDesktops();
+
+    struct FrameSample {
+        qint64 cpuTime;
+        qint64 paintTime;
+        qint64 damageArea;
+        quint64 allocations;
+    };
+
+    QFile m_output;
+    QVector<FrameSample> m_samples;
+    qint64 m_frameCpuTime = 0;
+    quint64 m_frameAllocations = 0;
+    int m_clientCount = 20;
+    int m_iterations = 5;
+
+    QVector<Surface *> m_surfaces;
+    QVector<XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
+};
+
+void CompositorBenchmark::initTestCase()
+{
+    qputenv("XDG_DATA_DIRS", QCoreApplication::applicationDirPath().toUtf8());
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    qRegisterMetaType<KWin::InternalClient *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1920, 1080));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects - the effect workload loads the effects it wants itself
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    if (!qEnvironmentVariableIsSet("KWIN_COMPOSE")) {
+        qputenv("KWIN_COMPOSE", QByteArrayLiteral("Q"));
+    }
+    qputenv("KWIN_EFFECTS_FORCE_ANIMATIONS", "1");
+    m_clientCount = environmentValue("KWIN_BENCHMARK_CLIENTS", 20);
+    m_iterations = environmentValue("KWIN_BENCHMARK_ITERATIONS", 5);
+
+    QString fileName = qEnvironmentVariable("KWIN_BENCHMARK_OUTPUT");
+    if (fileName.isEmpty()) {
+        fileName = QStringLiteral("compositor_benchmark.json");
+    }
+    m_output.setFileName(fileName);
+    QVERIFY(m_output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    waylandServer()->initWorkspace();
+
+    connect(Compositor::self(), &Compositor::frameStarted, this, &CompositorBenchmark::frameStarted);
+    connect(Compositor::self(), &Compositor::framePainted, this, &CompositorBenchmark::framePainted);
+}
+
+void CompositorBenchmark::cleanupTestCase()
+{
+    m_output.close();
+}
+
+void CompositorBenchmark::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+    VirtualDesktopManager::self()->setCount(4);
+    VirtualDesktopManager::self()->setCurrent(1);
+    waitForIdle();
+    m_samples.clear();
+}
+
+void CompositorBenchmark::cleanup()
+{
+    destroyWindows();
+    Test::destroyWaylandConnection();
+
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    for (const QString &name : e->loadedEffects()) {
+        e->unloadEffect(name);
+    }
+}
+
+void CompositorBenchmark::frameStarted()
+{
+    m_frameCpuTime = threadCpuTime();
+    m_frameAllocations = s_allocations.load(std::memory_order_relaxed);
+}
+
+void CompositorBenchmark::framePainted(FrameScheduler *scheduler, const QRegion &damage)
+{
+    // taken first, so that the bookkeeping below is not accounted to the frame
+    const qint64 cpuTime = threadCpuTime() - m_frameCpuTime;
+    const quint64 allocations = s_allocations.load(std::memory_order_relaxed) - m_frameAllocations;
+
+    qint64 damageArea = 0;
+    for (const QRect &rect : damage.rects()) {
+        damageArea += qint64(rect.width()) * rect.height();
+    }
+    const FrameSample sample{cpuTime, scheduler->lastRenderTime(), damageArea, allocations};
+    m_samples << sample;
+
+    QJsonObject frame;
+    frame.insert(QStringLiteral("workload"), QString::fromLatin1(QTest::currentTestFunction()));
+    frame.insert(QStringLiteral("output"), scheduler->output() ? scheduler->output()->name() : QString());
+    frame.insert(QStringLiteral("frame"), m_samples.count());
+    frame.insert(QStringLiteral("windows"), workspace()->stackingOrder().count());
+    frame.insert(QStringLiteral("cpuTime"), sample.cpuTime);
+    frame.insert(QStringLiteral("paintTime"), sample.paintTime);
+    frame.insert(QStringLiteral("damageArea"), sample.damageArea);
+    frame.insert(QStringLiteral("allocations"), qint64(sample.allocations));
+    m_output.write(QJsonDocument(frame).toJson(QJsonDocument::Compact));
+    m_output.write("\n");
+}
+
+static bool isIdle()
+{
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    return std::none_of(schedulers.constBegin(), schedulers.constEnd(),
+        [] (FrameScheduler *s) {
+            return s->hasDamage() || s->isScheduled() || s->isSwapPending();
+        }
+    );
+}
+
+void CompositorBenchmark::waitForIdle()
+{
+    // all updates got painted and no animation is running anymore
+    QTRY_VERIFY_WITH_TIMEOUT(isIdle(), 10000);
+}
+
+void CompositorBenchmark::createWindows(int count)
+{
+    const QRect area = screens()->geometry();
+    const uint desktops = VirtualDesktopManager::self()->count();
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        const QSize size(200 + (i * 37) % 400, 150 + (i * 53) % 300);
+        AbstractClient *c = Test::renderAndWaitForShown(surface, size, QColor::fromHsv((i * 29) % 360, 200, 200));
+        QVERIFY(c);
+        c->move(QPoint(area.x() + (i * 67) % (area.width() - size.width()),
+                       area.y() + (i * 43) % (area.height() - size.height())));
+        c->setDesktop(1 + i % desktops);
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
+void CompositorBenchmark::destroyWindows()
+{
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
+}
+
+void CompositorBenchmark::createInternalWindows(int count)
+{
+    QSignalSpy clientAddedSpy(workspace(), &Workspace::internalClientAdded);
+    QVERIFY(clientAddedSpy.isValid());
+    QSignalSpy clientRemovedSpy(workspace(), &Workspace::internalClientRemoved);
+    QVERIFY(clientRemovedSpy.isValid());
+    QVector<InternalWindow *> windows;
+    for (int i = 0; i < count; ++i) {
+        InternalWindow *window = new InternalWindow;
+        window->setGeometry(40 + (i * 67) % 1200, 40 + (i * 43) % 700, 300, 200);
+        window->show();
+        windows << window;
+    }
+    QTRY_COMPARE(clientAddedSpy.count(), count);
+    waitForIdle();
+    qDeleteAll(windows);
+    QTRY_COMPARE(clientRemovedSpy.count(), count);
+}
+
+void CompositorBenchmark::switchDesktops()
+{
+    VirtualDesktopManager *vds = VirtualDesktopManager::self();
+    for (uint desktop = 1; desktop <= vds->count(); ++desktop) {
+        vds->setCurrent(desktop % vds->count() + 1);
+        waitForIdle();
+    }
+}
+
+void CompositorBenchmark::benchmarkWindowStorm()
+{
+    // many clients mapping and unmapping at once, e.g. when a session gets restored
+    for (int i = 0; i < m_iterations; ++i) {
+        VirtualDesktopManager::self()->setCount(1);
+        createWindows(m_clientCount);
+        waitForIdle();
+        destroyWindows();
+        waitForIdle();
+    }
+}
+
+void CompositorBenchmark::benchmarkInternalWindowStorm()
+{
+    // the same for windows of KWin itself, e.g. OSDs and the window switcher
+    for (int i = 0; i < m_iterations; ++i) {
+        createInternalWindows(m_clientCount);
+        waitForIdle();
+    }
+}
+
+void CompositorBenchmark::benchmarkResize()
+{
+    // every client attaches a buffer of a new size each frame, as during an interactive resize
+    VirtualDesktopManager::self()->setCount(1);
+    createWindows(m_clientCount);
+    waitForIdle();
+    for (int step = 0; step < m_iterations * 20; ++step) {
+        const int delta = (step / 10) % 2 ? -8 : 8;
+        QVector<QSize> sizes;
+        for (int i = 0; i < m_surfaces.count(); ++i) {
+            sizes << m_clients.at(i)->clientSize() + QSize(delta, delta);
+            Test::render(m_surfaces.at(i), sizes.last(), Qt::darkGreen);
+        }
+        for (int i = 0; i < m_clients.count(); ++i) {
+            QTRY_COMPARE(m_clients.at(i)->clientSize(), sizes.at(i));
+        }
+        waitForIdle();
+    }
+}
+
+void CompositorBenchmark::benchmarkDesktopSwitch()
+{
+    // the clients are spread over all virtual desktops
+    createWindows(m_clientCount);
+    waitForIdle();
+    for (int i = 0; i < m_iterations; ++i) {
+        switchDesktops();
+    }
+}
+
+void CompositorBenchmark::benchmarkEffectAnimations()
+{
+    // the animations shown when windows get mapped, closed and desktops switched
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    const QStringList animations = {
+        QStringLiteral("slide"),
+        QStringLiteral("kwin4_effect_fade"),
+        QStringLiteral("kwin4_effect_maximize"),
+        QStringLiteral("kwin4_effect_windowaperture")
+    };
+    for (const QString &name : animations) {
+        e->loadEffect(name);
+    }
+    QVERIFY(!e->loadedEffects().isEmpty());
+
+    for (int i = 0; i < m_iterations; ++i) {
+        createWindows(m_clientCount);
+        waitForIdle();
+        switchDesktops();
+        destroyWindows();
+        waitForIdle();
+    }
+}
+
+WAYLANDTEST_MAIN(CompositorBenchmark)
+#include "compositor_benchmark.moc"
@@ -0,0 +1,227 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "platform.h"
+#include "scene.h"
+#include "screens.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_benchmark_effects_paint_hooks-0");
+
+/**
+ * The effects loaded by default in a Plasma session. Effects which are not supported
+ * by the backend of the test are skipped.
+ */
+static const QStringList s_effects = {
+    QStringLiteral("blur"),
+    QStringLiteral("colorpicker"),
+    QStringLiteral("contrast"),
+    QStringLiteral("desktopgrid"),
+    QStringLiteral("highlightwindow"),
+    QStringLiteral("kscreen"),
+    QStringLiteral("presentwindows"),
+    QStringLiteral("screenedge"),
+    QStringLiteral("screenshot"),
+    QStringLiteral("slide"),
+    QStringLiteral("slidingpopups"),
+    QStringLiteral("startupfeedback"),
+    QStringLiteral("zoom"),
+    QStringLiteral("kwin4_effect_dialogparent"),
+    QStringLiteral("kwin4_effect_fade"),
+    QStringLiteral("kwin4_effect_frozenapp"),
+    QStringLiteral("kwin4_effect_login"),
+    QStringLiteral("kwin4_effect_logout"),
+    QStringLiteral("kwin4_effect_maximize"),
+    QStringLiteral("kwin4_effect_morphingpopups"),
+    QStringLiteral("kwin4_effect_sessionquit"),
+    QStringLiteral("kwin4_effect_squash"),
+    QStringLiteral("kwin4_effect_translucency"),
+    QStringLiteral("kwin4_effect_windowaperture")
+};
+
+class EffectPaintHooksBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void benchmarkFrame_data();
+    void benchmarkFrame();
+
+private:
+    void restartCompositor(const QByteArray &usePaintHooks);
+    int loadEffects();
+    void createWindows(int count);
+
+    QVector<Surface *> m_surfaces;
+    QVector<XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
+};
+
+void EffectPaintHooksBenchmark::initTestCase()
+{
+    qputenv("XDG_DATA_DIRS", QCoreApplication::applicationDirPath().toUtf8());
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    qRegisterMetaType<KWin::Effect *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects - the test loads the effects it wants itself
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    qputenv("KWIN_EFFECTS_FORCE_ANIMATIONS", "1");
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    waylandServer()->initWorkspace();
+}
+
+void EffectPaintHooksBenchmark::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void EffectPaintHooksBenchmark::cleanup()
+{
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
+    Test::destroyWaylandConnection();
+
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    for (const QString &name : e->loadedEffects()) {
+        e->unloadEffect(name);
+    }
+    QVERIFY(e->loadedEffects().isEmpty());
+}
+
+void EffectPaintHooksBenchmark::restartCompositor(const QByteArray &usePaintHooks)
+{
+    // the toggle is read when the effects handler gets created
+    qputenv("KWIN_USE_EFFECT_PAINT_HOOKS", usePaintHooks);
+    QSignalSpy sceneCreatedSpy(Compositor::self(), &Compositor::sceneCreated);
+    QVERIFY(sceneCreatedSpy.isValid());
+    Compositor::self()->reinitialize();
+    if (sceneCreatedSpy.isEmpty()) {
+        QVERIFY(sceneCreatedSpy.wait());
+    }
+    QVERIFY(effects);
+}
+
+int EffectPaintHooksBenchmark::loadEffects()
+{
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    int loaded = 0;
+    for (const QString &name : s_effects) {
+        if (e->loadEffect(name)) {
+            loaded++;
+        }
+    }
+    return loaded;
+}
+
+void EffectPaintHooksBenchmark::createWindows(int count)
+{
+    const QRect area = screens()->geometry();
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        AbstractClient *c = Test::renderAndWaitForShown(surface, QSize(64, 64), Qt::blue);
+        QVERIFY(c);
+        c->move(QPoint(area.x() + (i * 67) % (area.width() - 64),
+                       area.y() + (i * 43) % (area.height() - 64)));
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
+void EffectPaintHooksBenchmark::benchmarkFrame_data()
+{
+    QTest::addColumn<QByteArray>("usePaintHooks");
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("all effects/20") << QByteArrayLiteral("0") << 20;
+    QTest::newRow("paint hooks/20") << QByteArrayLiteral("1") << 20;
+    QTest::newRow("all effects/100") << QByteArrayLiteral("0") << 100;
+    QTest::newRow("paint hooks/100") << QByteArrayLiteral("1") << 100;
+}
+
+void EffectPaintHooksBenchmark::benchmarkFrame()
+{
+    // small windows, so that the time is spent in the effect chain rather than the GPU
+    QFETCH(QByteArray, usePaintHooks);
+    QFETCH(int, windows);
+    restartCompositor(usePaintHooks);
+    QVERIFY(loadEffects() > 0);
+    createWindows(windows);
+
+    QList<Toplevel *> toplevels;
+    for (Toplevel *t : workspace()->stackingOrder()) {
+        if (t->readyForPainting()) {
+            toplevels << t;
+        }
+    }
+    QCOMPARE(toplevels.count(), windows);
+    Scene *scene = Compositor::self()->scene();
+    const QRegion damage(screens()->geometry());
+
+    QBENCHMARK {
+        scene->paint(damage, toplevels);
+    }
+}
+
+WAYLANDTEST_MAIN(EffectPaintHooksBenchmark)
+#include "effect_paint_hooks_benchmark.moc"
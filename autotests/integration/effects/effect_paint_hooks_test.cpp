@@ -0,0 +1,264 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "platform.h"
+#include "scene.h"
+#include "screens.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QFile>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_test_effects_paint_hooks-0");
+
+/**
+ * The effects loaded by default in a Plasma session. Effects which are not supported
+ * by the backend of the test are skipped.
+ */
+static const QStringList s_effects = {
+    QStringLiteral("blur"),
+    QStringLiteral("colorpicker"),
+    QStringLiteral("contrast"),
+    QStringLiteral("desktopgrid"),
+    QStringLiteral("highlightwindow"),
+    QStringLiteral("kscreen"),
+    QStringLiteral("presentwindows"),
+    QStringLiteral("screenedge"),
+    QStringLiteral("screenshot"),
+    QStringLiteral("slide"),
+    QStringLiteral("slidingpopups"),
+    QStringLiteral("startupfeedback"),
+    QStringLiteral("zoom"),
+    QStringLiteral("kwin4_effect_dialogparent"),
+    QStringLiteral("kwin4_effect_fade"),
+    QStringLiteral("kwin4_effect_frozenapp"),
+    QStringLiteral("kwin4_effect_login"),
+    QStringLiteral("kwin4_effect_logout"),
+    QStringLiteral("kwin4_effect_maximize"),
+    QStringLiteral("kwin4_effect_morphingpopups"),
+    QStringLiteral("kwin4_effect_sessionquit"),
+    QStringLiteral("kwin4_effect_squash"),
+    QStringLiteral("kwin4_effect_translucency"),
+    QStringLiteral("kwin4_effect_windowaperture")
+};
+
+class EffectPaintHooksTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testPaintHooks();
+
+private:
+    void restartCompositor(const QByteArray &usePaintHooks);
+    int loadEffects();
+    void createWindows(int count);
+    QImage paintedImage();
+
+    QVector<Surface *> m_surfaces;
+    QVector<XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
+};
+
+void EffectPaintHooksTest::initTestCase()
+{
+    qputenv("XDG_DATA_DIRS", QCoreApplication::applicationDirPath().toUtf8());
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    qRegisterMetaType<KWin::Effect *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects - the test loads the effects it wants itself
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    qputenv("KWIN_EFFECTS_FORCE_ANIMATIONS", "1");
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    waylandServer()->initWorkspace();
+}
+
+void EffectPaintHooksTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void EffectPaintHooksTest::cleanup()
+{
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
+    Test::destroyWaylandConnection();
+
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    for (const QString &name : e->loadedEffects()) {
+        e->unloadEffect(name);
+    }
+    QVERIFY(e->loadedEffects().isEmpty());
+}
+
+void EffectPaintHooksTest::restartCompositor(const QByteArray &usePaintHooks)
+{
+    // the toggle is read when the effects handler gets created
+    qputenv("KWIN_USE_EFFECT_PAINT_HOOKS", usePaintHooks);
+    QSignalSpy sceneCreatedSpy(Compositor::self(), &Compositor::sceneCreated);
+    QVERIFY(sceneCreatedSpy.isValid());
+    Compositor::self()->reinitialize();
+    if (sceneCreatedSpy.isEmpty()) {
+        QVERIFY(sceneCreatedSpy.wait());
+    }
+    QVERIFY(effects);
+}
+
+int EffectPaintHooksTest::loadEffects()
+{
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    int loaded = 0;
+    for (const QString &name : s_effects) {
+        if (e->loadEffect(name)) {
+            loaded++;
+        }
+    }
+    return loaded;
+}
+
+void EffectPaintHooksTest::createWindows(int count)
+{
+    const QRect area = screens()->geometry();
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        AbstractClient *c = Test::renderAndWaitForShown(surface, QSize(64, 64), Qt::blue);
+        QVERIFY(c);
+        c->move(QPoint(area.x() + (i * 67) % (area.width() - 64),
+                       area.y() + (i * 43) % (area.height() - 64)));
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
+QImage EffectPaintHooksTest::paintedImage()
+{
+    // what the effect chain painted, as read back by the screenshot effect
+    QSignalSpy frameSpy(Compositor::self()->scene(), &Scene::frameRendered);
+    if (!frameSpy.isValid()) {
+        return QImage();
+    }
+    Compositor::self()->addRepaintFull();
+    if (!frameSpy.wait()) {
+        return QImage();
+    }
+    QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KWin"),
+                                                          QStringLiteral("/Screenshot"),
+                                                          QStringLiteral("org.kde.kwin.Screenshot"),
+                                                          QStringLiteral("screenshotFullscreen"));
+    message.setArguments({false});
+    QDBusPendingCallWatcher watcher(QDBusConnection::sessionBus().asyncCall(message));
+    QSignalSpy finishedSpy(&watcher, &QDBusPendingCallWatcher::finished);
+    if (!finishedSpy.isValid() || !finishedSpy.wait(10000)) {
+        return QImage();
+    }
+    QDBusPendingReply<QString> reply = watcher;
+    if (reply.isError() || reply.value().isEmpty()) {
+        return QImage();
+    }
+    const QImage image(reply.value());
+    QFile::remove(reply.value());
+    return image;
+}
+
+void EffectPaintHooksTest::testPaintHooks()
+{
+    // the windows exist before the effects get loaded, so that no effect animates them
+    createWindows(20);
+
+    restartCompositor(QByteArrayLiteral("1"));
+    QVERIFY(loadEffects() > 0);
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    const auto loaded = e->loadedEffects();
+
+    // the effects of a Plasma session don't need to take part in every stage
+    QVERIFY(loaded.contains(QStringLiteral("colorpicker")));
+    QVERIFY(loaded.contains(QStringLiteral("kwin4_effect_fade")));
+    QVERIFY(loaded.contains(QStringLiteral("screenshot")));
+    bool restricted = false;
+    for (const QString &name : loaded) {
+        Effect *effect = e->findEffect(name);
+        QVERIFY(effect);
+        if (effect->paintHooks() != Effect::AllPaintHooks) {
+            restricted = true;
+        }
+    }
+    QVERIFY(restricted);
+    const QImage withPaintHooks = paintedImage();
+    QVERIFY(!withPaintHooks.isNull());
+    QCOMPARE(withPaintHooks.size(), screens()->geometry().size());
+
+    // every effect in every chain has to paint the same frame
+    restartCompositor(QByteArrayLiteral("0"));
+    QCOMPARE(loadEffects(), loaded.count());
+    const QImage withoutPaintHooks = paintedImage();
+    QVERIFY(!withoutPaintHooks.isNull());
+    QCOMPARE(withPaintHooks, withoutPaintHooks);
+    qunsetenv("KWIN_USE_EFFECT_PAINT_HOOKS");
+}
+
+WAYLANDTEST_MAIN(EffectPaintHooksTest)
+#include "effect_paint_hooks_test.moc"
@@ -0,0 +1,253 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "composite.h"
+#include "cursor.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "framescheduler.h"
+#include "input.h"
+#include "platform.h"
+#include "scene.h"
+#include "screens.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QPainter>
+
+#include <algorithm>
+
+#include <linux/input.h>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_test_effects_screenshot-0");
+
+class ScreenShotTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testScreenshotArea();
+    void testScreenshotWindow();
+    void testCaptureStall();
+
+private:
+    QDBusPendingCall requestScreenshot(const QString &method, const QVariantList &arguments);
+    QImage waitForScreenshot(const QDBusPendingCall &call);
+    QImage takeScreenshot(const QString &method, const QVariantList &arguments);
+};
+
+void ScreenShotTest::initTestCase()
+{
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(2560, 1440));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+    // two 1440p screens next to each other, about as many pixels as a 4K screen
+    QMetaObject::invokeMethod(kwinApp()->platform(), "setVirtualOutputs", Qt::DirectConnection, Q_ARG(int, 2));
+
+    // disable all effects - the test loads the screenshot effect itself
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QCOMPARE(screens()->count(), 2);
+    QVERIFY(Compositor::self());
+    waylandServer()->initWorkspace();
+}
+
+void ScreenShotTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(e->loadEffect(QStringLiteral("screenshot")));
+}
+
+void ScreenShotTest::cleanup()
+{
+    Test::destroyWaylandConnection();
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    e->unloadEffect(QStringLiteral("screenshot"));
+    QVERIFY(!e->isEffectLoaded(QStringLiteral("screenshot")));
+}
+
+QDBusPendingCall ScreenShotTest::requestScreenshot(const QString &method, const QVariantList &arguments)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KWin"),
+                                                          QStringLiteral("/Screenshot"),
+                                                          QStringLiteral("org.kde.kwin.Screenshot"),
+                                                          method);
+    message.setArguments(arguments);
+    return QDBusConnection::sessionBus().asyncCall(message);
+}
+
+QImage ScreenShotTest::waitForScreenshot(const QDBusPendingCall &call)
+{
+    QDBusPendingCallWatcher watcher(call);
+    QSignalSpy finishedSpy(&watcher, &QDBusPendingCallWatcher::finished);
+    if (!watcher.isFinished() && (!finishedSpy.isValid() || !finishedSpy.wait(10000))) {
+        return QImage();
+    }
+    QDBusPendingReply<QString> reply = watcher;
+    if (reply.isError() || reply.value().isEmpty()) {
+        return QImage();
+    }
+    const QImage image(reply.value());
+    QFile::remove(reply.value());
+    return image;
+}
+
+QImage ScreenShotTest::takeScreenshot(const QString &method, const QVariantList &arguments)
+{
+    return waitForScreenshot(requestScreenshot(method, arguments));
+}
+
+void ScreenShotTest::testScreenshotArea()
+{
+    // a window on the second screen, the read back pixels have to be the right way up
+    Surface *surface = Test::createSurface();
+    QVERIFY(surface);
+    XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+    QVERIFY(shellSurface);
+    QImage contents(QSize(200, 100), QImage::Format_ARGB32_Premultiplied);
+    contents.fill(Qt::red);
+    QPainter(&contents).fillRect(0, 50, 200, 50, Qt::blue);
+    Test::render(surface, contents);
+    AbstractClient *c = Test::waitForWaylandWindowShown();
+    QVERIFY(c);
+    c->move(QPoint(2700, 100));
+
+    const QImage image = takeScreenshot(QStringLiteral("screenshotArea"), {2700, 100, 200, 100, false});
+    QCOMPARE(image.size(), QSize(200, 100));
+    QCOMPARE(QColor(image.pixel(10, 10)), QColor(Qt::red));
+    QCOMPARE(QColor(image.pixel(10, 90)), QColor(Qt::blue));
+
+    delete shellSurface;
+    delete surface;
+    QVERIFY(Test::waitForWindowDestroyed(c));
+}
+
+void ScreenShotTest::testScreenshotWindow()
+{
+    // the window is read back asynchronously after the frame it got rendered in, the effect
+    // has to stay active until the reply is sent
+    Surface *surface = Test::createSurface();
+    QVERIFY(surface);
+    XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+    QVERIFY(shellSurface);
+    QImage contents(QSize(200, 100), QImage::Format_ARGB32_Premultiplied);
+    contents.fill(Qt::red);
+    QPainter(&contents).fillRect(0, 50, 200, 50, Qt::blue);
+    Test::render(surface, contents);
+    AbstractClient *c = Test::waitForWaylandWindowShown();
+    QVERIFY(c);
+    c->move(QPoint(100, 100));
+    KWin::Cursor::setPos(c->frameGeometry().center());
+
+    // a second request is only accepted once the first one is done
+    quint32 timestamp = 0;
+    for (int i = 0; i < 2; ++i) {
+        const QDBusPendingCall call = requestScreenshot(QStringLiteral("interactive"), {0});
+        QTRY_VERIFY(input()->isSelectingWindow());
+        kwinApp()->platform()->pointerButtonPressed(BTN_LEFT, timestamp++);
+        kwinApp()->platform()->pointerButtonReleased(BTN_LEFT, timestamp++);
+        QVERIFY(!input()->isSelectingWindow());
+
+        const QImage image = waitForScreenshot(call);
+        QCOMPARE(image.size(), QSize(200, 100));
+        QCOMPARE(QColor(image.pixel(10, 10)), QColor(Qt::red));
+        QCOMPARE(QColor(image.pixel(10, 90)), QColor(Qt::blue));
+    }
+
+    delete shellSurface;
+    delete surface;
+    QVERIFY(Test::waitForWindowDestroyed(c));
+}
+
+void ScreenShotTest::testCaptureStall()
+{
+    // the compositor must not wait for the read back, the conversion and the encoding
+    // of the screenshots, so frames with a capture have to be about as fast as others
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    QVERIFY(!schedulers.isEmpty());
+    QVector<qint64> renderTimes;
+    for (FrameScheduler *scheduler : schedulers) {
+        connect(scheduler, &FrameScheduler::frameTimingChanged, this,
+            [scheduler, &renderTimes] {
+                renderTimes << scheduler->lastRenderTime();
+            }
+        );
+    }
+    const auto maxRenderTime = [&renderTimes] {
+        return renderTimes.isEmpty() ? 0 : *std::max_element(renderTimes.constBegin(), renderTimes.constEnd());
+    };
+
+    // frames without a screenshot
+    QSignalSpy frameRenderedSpy(Compositor::self()->scene(), &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    for (int i = 0; i < 10; ++i) {
+        Compositor::self()->addRepaintFull();
+        QVERIFY(frameRenderedSpy.wait());
+    }
+    const qint64 baseline = maxRenderTime();
+
+    renderTimes.clear();
+    const QSize expectedSize = screens()->geometry().size();
+    for (int i = 0; i < 10; ++i) {
+        const QImage image = takeScreenshot(QStringLiteral("screenshotFullscreen"), {false});
+        QCOMPARE(image.size(), expectedSize);
+    }
+    const qint64 capture = maxRenderTime();
+    for (FrameScheduler *scheduler : schedulers) {
+        disconnect(scheduler, &FrameScheduler::frameTimingChanged, this, nullptr);
+    }
+
+    QVERIFY(capture < baseline * 2 + 10 * 1000 * 1000);
+}
+
+WAYLANDTEST_MAIN(ScreenShotTest)
+#include "screenshot_test.moc"
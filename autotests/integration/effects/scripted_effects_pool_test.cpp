@@ -0,0 +1,168 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "platform.h"
+#include "scripting/scriptedeffect.h"
+#include "scripting/scriptenginepool.h"
+#include "virtualdesktops.h"
+#include "wayland_server.h"
+
+#include <KConfigGroup>
+
+#include <QScriptEngine>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_effects_scripted_pool-0");
+
+class ScriptedEffectsPoolTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+    void testEnginesShared();
+    void testIsolation();
+    void testConnectionsBroken();
+
+private:
+    void createEffects(int count);
+
+    QVector<ScriptedEffect *> m_effects;
+};
+
+void ScriptedEffectsPoolTest::initTestCase()
+{
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects, so that no effect is on the engines before the test
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("Q"));
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    QVERIFY(effects);
+    VirtualDesktopManager::self()->setCount(2);
+}
+
+void ScriptedEffectsPoolTest::cleanup()
+{
+    qDeleteAll(m_effects);
+    m_effects.clear();
+    QVERIFY(ScriptedEffect::enginePool()->statistics().isEmpty());
+    VirtualDesktopManager::self()->setCurrent(1);
+}
+
+void ScriptedEffectsPoolTest::createEffects(int count)
+{
+    const QString path = QFINDTESTDATA("./scripts/poolTest.js");
+    QVERIFY(!path.isEmpty());
+    for (int i = 0; i < count; ++i) {
+        ScriptedEffect *effect = ScriptedEffect::create(QStringLiteral("poolTest%1").arg(m_effects.count()), path, 0);
+        QVERIFY(effect);
+        m_effects << effect;
+    }
+}
+
+void ScriptedEffectsPoolTest::testEnginesShared()
+{
+    // has to run first, the engines are created while loading the first effects
+    ScriptEnginePool *pool = ScriptedEffect::enginePool();
+    QCOMPARE(pool->engineCount(), 0);
+
+    // a new engine is only created while all engines are in use
+    createEffects(1);
+    QCOMPARE(pool->engineCount(), 1);
+    createEffects(ScriptedEffect::s_maxEngines - 1);
+    QCOMPARE(pool->engineCount(), ScriptedEffect::s_maxEngines);
+
+    // more effects don't create more engines, they are spread evenly
+    createEffects(32 - ScriptedEffect::s_maxEngines);
+    QCOMPARE(pool->engineCount(), ScriptedEffect::s_maxEngines);
+    const auto statistics = pool->statistics();
+    QCOMPARE(statistics.count(), 32);
+    QVector<int> effectsPerEngine(ScriptedEffect::s_maxEngines, 0);
+    for (const ScriptEnginePool::Statistics &script : statistics) {
+        QVERIFY(script.engine >= 0 && script.engine < ScriptedEffect::s_maxEngines);
+        effectsPerEngine[script.engine]++;
+    }
+    for (int count : qAsConst(effectsPerEngine)) {
+        QCOMPARE(count, 32 / ScriptedEffect::s_maxEngines);
+    }
+}
+
+void ScriptedEffectsPoolTest::testIsolation()
+{
+    createEffects(6);
+    ScriptEnginePool *pool = ScriptedEffect::enginePool();
+    for (ScriptedEffect *effect : qAsConst(m_effects)) {
+        // none of the effects saw the variables of another effect on the same engine
+        const QScriptValue scope = pool->scope(effect);
+        QVERIFY(scope.isObject());
+        QCOMPARE(scope.property(QStringLiteral("instances")).toInt32(), 1);
+        QVERIFY(!scope.engine()->globalObject().property(QStringLiteral("instances")).isValid());
+        // not even through undeclared variables
+        QCOMPARE(scope.property(QStringLiteral("leaked")).toInt32(), 1);
+        QVERIFY(!scope.engine()->globalObject().property(QStringLiteral("leaked")).isValid());
+        // the bindings specific to an effect are in its scope
+        QCOMPARE(scope.property(QStringLiteral("effect")).toQObject(), effect);
+    }
+}
+
+void ScriptedEffectsPoolTest::testConnectionsBroken()
+{
+    createEffects(3);
+    ScriptEnginePool *pool = ScriptedEffect::enginePool();
+    QVector<QScriptValue> scopes;
+    for (ScriptedEffect *effect : qAsConst(m_effects)) {
+        scopes << pool->scope(effect);
+    }
+
+    VirtualDesktopManager::self()->setCurrent(2);
+    for (const QScriptValue &scope : qAsConst(scopes)) {
+        QTRY_COMPARE(scope.property(QStringLiteral("desktopChanges")).toInt32(), 1);
+    }
+
+    // the handler of an unloaded effect is not invoked anymore, although the engine is still used
+    delete m_effects.takeFirst();
+    VirtualDesktopManager::self()->setCurrent(1);
+    QTRY_COMPARE(scopes.at(1).property(QStringLiteral("desktopChanges")).toInt32(), 2);
+    QTRY_COMPARE(scopes.at(2).property(QStringLiteral("desktopChanges")).toInt32(), 2);
+    QCOMPARE(scopes.at(0).property(QStringLiteral("desktopChanges")).toInt32(), 1);
+}
+
+WAYLANDTEST_MAIN(ScriptedEffectsPoolTest)
+#include "scripted_effects_pool_test.moc"
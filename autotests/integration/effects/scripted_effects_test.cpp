@@ -116,7 +116,7 @@ ScriptedEffectWithDebugSpy::ScriptedEffectWithDebugSpy()
 {
     QScriptValue testHookFunc = engine()->newFunction(kwinEffectScriptTestOut);
     testHookFunc.setData(engine()->newQObject(this));
-    engine()->globalObject().setProperty(QStringLiteral("sendTestResponse"), testHookFunc);
+    scope().setProperty(QStringLiteral("sendTestResponse"), testHookFunc);
 }
 
 bool ScriptedEffectWithDebugSpy::load(const QString &name)
@@ -0,0 +1,8 @@
+// every instance of the effect runs in its own scope, so it never sees another instance
+var instances = (typeof instances === "undefined") ? 1 : instances + 1;
+// not declared, goes into the scope of the instance rather than the shared global object
+leaked = (typeof leaked === "undefined") ? 1 : leaked + 1;
+var desktopChanges = 0;
+effects['desktopChanged(int,int)'].connect(function(old, current) {
+    desktopChanges++;
+});
@@ -0,0 +1,362 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_output.h"
+#include "composite.h"
+#include "debug_console.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "framescheduler.h"
+#include "platform.h"
+#include "scene.h"
+#include "screens.h"
+#include "wayland_server.h"
+
+#include <KConfigGroup>
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingReply>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_frame_scheduler-0");
+
+class FrameSchedulerTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void testSchedulerPerOutput();
+    void testDamageIsPerOutput();
+    void testRefreshRates();
+    void testRenderTimeAdapts();
+    void testLatencyHistogram();
+    void testInputLatency();
+};
+
+void FrameSchedulerTest::initTestCase()
+{
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+    QMetaObject::invokeMethod(kwinApp()->platform(), "setVirtualOutputs",
+                              Qt::DirectConnection,
+                              Q_ARG(int, 2),
+                              Q_ARG(QVector<QRect>, QVector<QRect>({QRect(0, 0, 1280, 1024), QRect(1280, 0, 1280, 1024)})),
+                              Q_ARG(QVector<int>, QVector<int>({1, 1})),
+                              Q_ARG(QVector<int>, QVector<int>({60000, 144000})));
+
+    // disable all effects - we don't want them to add repaints
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("Q"));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QCOMPARE(screens()->count(), 2);
+    QVERIFY(Compositor::self());
+    QVERIFY(Compositor::self()->scene());
+    QCOMPARE(kwinApp()->platform()->selectedCompositor(), QPainterCompositing);
+}
+
+void FrameSchedulerTest::testSchedulerPerOutput()
+{
+    // the virtual QPainter backend renders each output on its own
+    QVERIFY(Compositor::self()->scene()->perOutputScheduling());
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    QCOMPARE(outputs.count(), 2);
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    QCOMPARE(schedulers.count(), 2);
+    for (AbstractOutput *output : outputs) {
+        FrameScheduler *scheduler = Compositor::self()->frameScheduler(output);
+        QVERIFY(scheduler);
+        QCOMPARE(scheduler->geometry(), output->geometry());
+    }
+    QVERIFY(!Compositor::self()->frameScheduler(nullptr));
+}
+
+void FrameSchedulerTest::testDamageIsPerOutput()
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    FrameScheduler *first = Compositor::self()->frameScheduler(outputs.at(0));
+    FrameScheduler *second = Compositor::self()->frameScheduler(outputs.at(1));
+    QVERIFY(first);
+    QVERIFY(second);
+
+    // wait until the compositor is idle
+    QTRY_VERIFY(!first->isScheduled() && !second->isScheduled());
+
+    QSignalSpy firstFrameSpy(first, &FrameScheduler::frameRequested);
+    QVERIFY(firstFrameSpy.isValid());
+    QSignalSpy secondFrameSpy(second, &FrameScheduler::frameRequested);
+    QVERIFY(secondFrameSpy.isValid());
+
+    // damage on the second output only repaints the second output
+    Compositor::self()->addRepaint(QRect(1300, 10, 100, 100));
+    QVERIFY(!first->hasDamage());
+    QCOMPARE(second->damage(), QRegion(1300, 10, 100, 100));
+    QVERIFY(secondFrameSpy.wait());
+    QVERIFY(!second->hasDamage());
+    QCOMPARE(firstFrameSpy.count(), 0);
+
+    // damage crossing both outputs is split up
+    firstFrameSpy.clear();
+    secondFrameSpy.clear();
+    Compositor::self()->addRepaint(QRect(1200, 0, 200, 100));
+    QCOMPARE(first->damage(), QRegion(1200, 0, 80, 100));
+    QCOMPARE(second->damage(), QRegion(1280, 0, 120, 100));
+    QTRY_VERIFY(!firstFrameSpy.isEmpty() && !secondFrameSpy.isEmpty());
+}
+
+void FrameSchedulerTest::testRefreshRates()
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    FrameScheduler *slow = Compositor::self()->frameScheduler(outputs.at(0));
+    FrameScheduler *fast = Compositor::self()->frameScheduler(outputs.at(1));
+    QCOMPARE(slow->refreshRate(), 60000);
+    QCOMPARE(fast->refreshRate(), 144000);
+    QVERIFY(slow->vBlankInterval() > fast->vBlankInterval());
+
+    QTRY_VERIFY(!slow->isScheduled());
+    QTRY_VERIFY(!fast->isScheduled());
+
+    // Drive both schedulers with a fake clock each. Every frame pretends to be busy until
+    // the vblank it got started for, so the next one has to be planned for the vblank after.
+    const qint64 second = 1000 * 1000 * 1000;
+    qint64 slowTime = 0;
+    qint64 fastTime = 0;
+    slow->setClock([&slowTime] { return slowTime; });
+    fast->setClock([&fastTime] { return fastTime; });
+
+    // keep both outputs busy for one second, each one has to paint at its own pace
+    int slowFrames = 0;
+    int fastFrames = 0;
+    auto paintFrame = [second] (FrameScheduler *scheduler, qint64 &time, int &frames) {
+        const qint64 deadline = time + scheduler->timeUntilDeadline();
+        QCOMPARE(deadline, (frames + 1) * scheduler->vBlankInterval());
+        time = deadline;
+        if (deadline > second) {
+            return;
+        }
+        frames++;
+        scheduler->addRepaintFull();
+    };
+    connect(slow, &FrameScheduler::frameRequested, this,
+        [&slowTime, &slowFrames, paintFrame] (FrameScheduler *scheduler) {
+            paintFrame(scheduler, slowTime, slowFrames);
+        }
+    );
+    connect(fast, &FrameScheduler::frameRequested, this,
+        [&fastTime, &fastFrames, paintFrame] (FrameScheduler *scheduler) {
+            paintFrame(scheduler, fastTime, fastFrames);
+        }
+    );
+    Compositor::self()->addRepaintFull();
+    QTRY_VERIFY_WITH_TIMEOUT(slowTime > second && fastTime > second, 10000);
+    disconnect(slow, &FrameScheduler::frameRequested, this, nullptr);
+    disconnect(fast, &FrameScheduler::frameRequested, this, nullptr);
+    slow->setClock(nullptr);
+    fast->setClock(nullptr);
+
+    // one frame per vblank, the fast output is not throttled to the slow one
+    QCOMPARE(slowFrames, 60);
+    QCOMPARE(fastFrames, 144);
+}
+
+void FrameSchedulerTest::testRenderTimeAdapts()
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    FrameScheduler *scheduler = Compositor::self()->frameScheduler(outputs.at(0));
+    QVERIFY(scheduler);
+    QTRY_VERIFY(!scheduler->isScheduled());
+
+    FrameTimingModel model;
+    QCOMPARE(model.rowCount(QModelIndex()), 2);
+    QCOMPARE(model.data(model.index(0, FrameTimingModel::OutputColumn, QModelIndex()), Qt::DisplayRole).toString(), outputs.at(0)->name());
+
+    // slow paints are reported to the scheduler once a frame got rendered, next to the real render time
+    bool slowPaint = false;
+    connect(Compositor::self()->scene(), &Scene::frameRendered, this,
+        [&slowPaint, scheduler] {
+            if (slowPaint) {
+                scheduler->addRenderTime(8 * 1000 * 1000);
+            }
+        }
+    );
+
+    // the time between starting a frame and the vblank it is meant for
+    int frames = 0;
+    qint64 lead = 0;
+    connect(scheduler, &FrameScheduler::frameRequested, this,
+        [&frames, &lead] (FrameScheduler *scheduler) {
+            frames++;
+            if (frames > 20) {
+                lead += scheduler->timeUntilDeadline();
+            }
+            scheduler->addRepaintFull();
+        }
+    );
+
+    QSignalSpy frameRequestedSpy(scheduler, &FrameScheduler::frameRequested);
+    QVERIFY(frameRequestedSpy.isValid());
+    scheduler->addRepaintFull();
+    while (frames < 40) {
+        QVERIFY(frameRequestedSpy.wait());
+    }
+    const qint64 fastLead = lead / (frames - 20);
+    QVERIFY(scheduler->predictedRenderTime() < scheduler->vBlankInterval());
+
+    frames = 0;
+    lead = 0;
+    slowPaint = true;
+    while (frames < 40) {
+        QVERIFY(frameRequestedSpy.wait());
+    }
+    const qint64 slowLead = lead / (frames - 20);
+    slowPaint = false;
+    disconnect(scheduler, &FrameScheduler::frameRequested, this, nullptr);
+    disconnect(Compositor::self()->scene(), &Scene::frameRendered, this, nullptr);
+
+    // the frames have to be started earlier to still make the vblank
+    QVERIFY(scheduler->predictedRenderTime() >= 8 * 1000 * 1000);
+    QVERIFY(slowLead > fastLead + 4 * 1000 * 1000);
+    QVERIFY(slowLead <= scheduler->vBlankInterval());
+}
+
+void FrameSchedulerTest::testLatencyHistogram()
+{
+    LatencyHistogram histogram;
+    QVERIFY(histogram.isEmpty());
+    QCOMPARE(histogram.percentile(50), qint64(0));
+    QCOMPARE(histogram.bucketLimit(0), qint64(250 * 1000));
+    QCOMPARE(histogram.bucketLimit(1), qint64(500 * 1000));
+
+    // 0.1 ms, 3 ms, 3 ms, 200 ms
+    histogram.add(100 * 1000);
+    histogram.add(3 * 1000 * 1000);
+    histogram.add(3 * 1000 * 1000);
+    histogram.add(200 * 1000 * 1000);
+    QCOMPARE(histogram.count(), quint64(4));
+    QCOMPARE(histogram.bucket(0), quint64(1));
+    // 2 ms to 4 ms
+    QCOMPARE(histogram.bucket(4), quint64(2));
+    QCOMPARE(histogram.bucket(LatencyHistogram::s_bucketCount - 1), quint64(1));
+    QCOMPARE(histogram.percentile(50), qint64(4 * 1000 * 1000));
+    QCOMPARE(histogram.percentile(99), qint64(200 * 1000 * 1000));
+    QCOMPARE(histogram.maximum(), qint64(200 * 1000 * 1000));
+    QCOMPARE(histogram.mean(), qint64(206100 * 1000) / 4);
+
+    histogram.clear();
+    QVERIFY(histogram.isEmpty());
+    QCOMPARE(histogram.bucket(0), quint64(0));
+}
+
+void FrameSchedulerTest::testInputLatency()
+{
+    const auto outputs = kwinApp()->platform()->enabledOutputs();
+    FrameScheduler *scheduler = Compositor::self()->frameScheduler(outputs.at(0));
+    QVERIFY(scheduler);
+    QTRY_VERIFY(!scheduler->isScheduled());
+    scheduler->clearLatencies();
+    QVERIFY(scheduler->inputLatency().isEmpty());
+    QVERIFY(scheduler->presentationLatency().isEmpty());
+
+    QSignalSpy frameSpy(scheduler, &FrameScheduler::frameRequested);
+    QVERIFY(frameSpy.isValid());
+
+    // like libinput the events carry the monotonic time in milliseconds
+    const auto now = [] {
+        return quint32(FrameScheduler::monotonicTime() / (1000 * 1000));
+    };
+    kwinApp()->platform()->pointerMotion(QPointF(100, 100), now());
+    Compositor::self()->addRepaint(QRect(0, 0, 100, 100));
+    QVERIFY(frameSpy.wait());
+    QTRY_COMPARE(scheduler->inputLatency().count(), quint64(1));
+    QVERIFY(scheduler->inputLatency().maximum() < 1000 * 1000 * 1000);
+    // the virtual platform has no buffer swaps, the frames are presented once they are rendered
+    QTRY_VERIFY(!scheduler->presentationLatency().isEmpty());
+    QVERIFY(scheduler->presentationLatency().maximum() < 1000 * 1000 * 1000);
+
+    // events from the past can't be related to a frame anymore
+    QTRY_VERIFY(!scheduler->isScheduled());
+    kwinApp()->platform()->pointerMotion(QPointF(200, 200), now() - 5000);
+    Compositor::self()->addRepaint(QRect(0, 0, 100, 100));
+    QVERIFY(frameSpy.wait());
+    QTRY_VERIFY(!scheduler->isScheduled());
+    QCOMPARE(scheduler->inputLatency().count(), quint64(1));
+
+    // the debug console shows the median and the 99th percentile
+    FrameTimingModel model;
+    QVERIFY(!model.data(model.index(0, FrameTimingModel::InputLatencyColumn, QModelIndex()), Qt::DisplayRole).toString().isEmpty());
+    QVERIFY(!model.data(model.index(0, FrameTimingModel::PresentationLatencyColumn, QModelIndex()), Qt::DisplayRole).toString().isEmpty());
+
+    // and the histograms are published on D-Bus
+    const auto createCall = [] (const QString &method) {
+        return QDBusMessage::createMethodCall(QStringLiteral("org.kde.KWin"), QStringLiteral("/Compositor"),
+                                              QStringLiteral("org.kde.kwin.Compositing"), method);
+    };
+    QDBusPendingReply<QVariantMap> reply{QDBusConnection::sessionBus().asyncCall(createCall(QStringLiteral("latencyStatistics")))};
+    reply.waitForFinished();
+    QVERIFY(reply.isValid());
+    const QVariantMap statistics = reply.value();
+    QCOMPARE(qdbus_cast<QVariantList>(statistics.value(QStringLiteral("bucketLimits"))).count(), LatencyHistogram::s_bucketCount - 1);
+    QVERIFY(statistics.contains(outputs.at(1)->name()));
+    const QVariantMap output = qdbus_cast<QVariantMap>(statistics.value(outputs.at(0)->name()));
+    const QVariantMap inputLatency = qdbus_cast<QVariantMap>(output.value(QStringLiteral("inputLatency")));
+    QCOMPARE(inputLatency.value(QStringLiteral("count")).toULongLong(), 1ull);
+    QCOMPARE(qdbus_cast<QVariantList>(inputLatency.value(QStringLiteral("buckets"))).count(), LatencyHistogram::s_bucketCount);
+    const QVariantMap presentationLatency = qdbus_cast<QVariantMap>(output.value(QStringLiteral("presentationLatency")));
+    QVERIFY(presentationLatency.value(QStringLiteral("count")).toULongLong() > 0);
+
+    QDBusPendingReply<> resetReply{QDBusConnection::sessionBus().asyncCall(createCall(QStringLiteral("resetLatencyStatistics")))};
+    resetReply.waitForFinished();
+    QVERIFY(!resetReply.isError());
+    QVERIFY(scheduler->inputLatency().isEmpty());
+
+    // an event only counts for the output under the pointer, not for frames of other outputs
+    FrameScheduler *second = Compositor::self()->frameScheduler(outputs.at(1));
+    QVERIFY(second);
+    QTRY_VERIFY(!scheduler->isScheduled() && !second->isScheduled());
+    second->clearLatencies();
+    QSignalSpy secondFrameSpy(second, &FrameScheduler::frameRequested);
+    QVERIFY(secondFrameSpy.isValid());
+    frameSpy.clear();
+    kwinApp()->platform()->pointerMotion(QPointF(1400, 100), now());
+    Compositor::self()->addRepaintFull();
+    QTRY_VERIFY(!frameSpy.isEmpty() && !secondFrameSpy.isEmpty());
+    QTRY_VERIFY(!scheduler->isScheduled() && !second->isScheduled());
+    QCOMPARE(second->inputLatency().count(), quint64(1));
+    QVERIFY(scheduler->inputLatency().isEmpty());
+}
+
+WAYLANDTEST_MAIN(FrameSchedulerTest)
+#include "frame_scheduler_test.moc"
@@ -21,14 +21,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "composite.h"
 #include "effectloader.h"
 #include "cursor.h"
+#include "effects.h"
 #include "platform.h"
 #include "scene.h"
 #include "xdgshellclient.h"
 #include "wayland_server.h"
 #include "effect_builtins.h"
 
+#include <kwinglutils.h>
+
 #include <KConfigGroup>
 
+#include <KWayland/Client/server_decoration.h>
+#include <KWayland/Client/shm_pool.h>
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QFile>
+
 using namespace KWin;
 static const QString s_socketName = QStringLiteral("wayland_test_kwin_scene_opengl-0");
 
@@ -45,6 +59,10 @@ GenericSceneOpenGLTest::~GenericSceneOpenGLTest()
 void GenericSceneOpenGLTest::cleanup()
 {
     Test::destroyWaylandConnection();
+    qunsetenv("KWIN_USE_PBO_UPLOAD");
+    if (effects) {
+        static_cast<EffectsHandlerImpl *>(effects)->unloadEffect(QStringLiteral("screenshot"));
+    }
 }
 
 void GenericSceneOpenGLTest::initTestCase()
@@ -118,3 +136,188 @@ void GenericSceneOpenGLTest::testRestart()
     // TODO: introduce frameRendered signal in SceneOpenGL
     QTest::qWait(100);
 }
+
+QImage GenericSceneOpenGLTest::grabScreen()
+{
+    // the screenshot effect reads back what got rendered, including the window textures
+    QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.kde.KWin"),
+                                                          QStringLiteral("/Screenshot"),
+                                                          QStringLiteral("org.kde.kwin.Screenshot"),
+                                                          QStringLiteral("screenshotFullscreen"));
+    message.setArguments({false});
+    QDBusPendingCallWatcher watcher(QDBusConnection::sessionBus().asyncCall(message));
+    QSignalSpy finishedSpy(&watcher, &QDBusPendingCallWatcher::finished);
+    if (!finishedSpy.isValid() || !finishedSpy.wait(10000)) {
+        return QImage();
+    }
+    QDBusPendingReply<QString> reply = watcher;
+    if (reply.isError() || reply.value().isEmpty()) {
+        return QImage();
+    }
+    const QImage image(reply.value());
+    QFile::remove(reply.value());
+    return image;
+}
+
+void GenericSceneOpenGLTest::testShmDamageUpload_data()
+{
+    QTest::addColumn<QByteArray>("usePixelBuffers");
+
+    QTest::newRow("pixel buffers") << QByteArrayLiteral("1");
+    QTest::newRow("direct") << QByteArrayLiteral("0");
+}
+
+void GenericSceneOpenGLTest::testShmDamageUpload()
+{
+    // only the damaged parts of a shm buffer are uploaded into the window texture,
+    // no matter whether they are streamed through pixel buffers or not
+    QFETCH(QByteArray, usePixelBuffers);
+    qputenv("KWIN_USE_PBO_UPLOAD", usePixelBuffers);
+    QSignalSpy sceneCreatedSpy(KWin::Compositor::self(), &Compositor::sceneCreated);
+    QVERIFY(sceneCreatedSpy.isValid());
+    KWin::Compositor::self()->reinitialize();
+    if (sceneCreatedSpy.isEmpty()) {
+        QVERIFY(sceneCreatedSpy.wait());
+    }
+    if (usePixelBuffers == "1" &&
+            (!Compositor::self()->scene()->makeOpenGLContextCurrent() || !PixelBufferRing::isSupported())) {
+        QSKIP("The driver does not support pixel buffer objects");
+    }
+    EffectsHandlerImpl *e = static_cast<EffectsHandlerImpl *>(effects);
+    QVERIFY(e->loadEffect(QStringLiteral("screenshot")));
+
+    using namespace KWayland::Client;
+    QVERIFY(Test::setupWaylandConnection());
+    QScopedPointer<Surface> surface(Test::createSurface());
+    QVERIFY(!surface.isNull());
+    QScopedPointer<XdgShellSurface> shellSurface(Test::createXdgShellStableSurface(surface.data()));
+    QVERIFY(!shellSurface.isNull());
+
+    auto scene = KWin::Compositor::self()->scene();
+    const qint64 bufferBytes = 1000 * 800 * 4;
+    const qint64 initialBytes = scene->textureUploadBytes();
+    XdgShellClient *client = Test::renderAndWaitForShown(surface.data(), QSize(1000, 800), Qt::blue);
+    QVERIFY(client);
+    // the first buffer is uploaded completely
+    QTRY_VERIFY(scene->textureUploadBytes() - initialBytes >= bufferBytes);
+    const QPoint origin = client->frameGeometry().topLeft();
+    QImage screen = grabScreen();
+    QVERIFY(!screen.isNull());
+    QCOMPARE(screen.pixelColor(origin + QPoint(1, 1)), QColor(Qt::blue));
+    QCOMPARE(screen.pixelColor(origin + QPoint(998, 798)), QColor(Qt::blue));
+
+    QSignalSpy damagedSpy(client, &Toplevel::damaged);
+    QVERIFY(damagedSpy.isValid());
+    QSignalSpy frameRenderedSpy(scene, &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+
+    // a small damage only uploads the damaged rect
+    QImage image(QSize(1000, 800), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::red);
+    qint64 bytes = scene->textureUploadBytes();
+    const qint64 streamedBytes = scene->streamedTextureUploadBytes();
+    surface->attachBuffer(Test::waylandShmPool()->createBuffer(image));
+    surface->damage(QRect(10, 20, 8, 16));
+    surface->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QTRY_COMPARE(scene->textureUploadBytes() - bytes, qint64(8 * 16 * 4));
+    QCOMPARE(scene->streamedTextureUploadBytes() - streamedBytes, usePixelBuffers == "1" ? qint64(8 * 16 * 4) : 0);
+    // the client buffer is red everywhere, but the texture only got the damaged rect
+    screen = grabScreen();
+    QVERIFY(!screen.isNull());
+    QCOMPARE(screen.pixelColor(origin + QPoint(10, 20)), QColor(Qt::red));
+    QCOMPARE(screen.pixelColor(origin + QPoint(17, 35)), QColor(Qt::red));
+    QCOMPARE(screen.pixelColor(origin + QPoint(9, 20)), QColor(Qt::blue));
+    QCOMPARE(screen.pixelColor(origin + QPoint(18, 36)), QColor(Qt::blue));
+    QCOMPARE(screen.pixelColor(origin + QPoint(500, 400)), QColor(Qt::blue));
+
+    // fragmented damage is merged into a few rects, which still don't cover the whole buffer
+    image.fill(Qt::green);
+    bytes = scene->textureUploadBytes();
+    surface->attachBuffer(Test::waylandShmPool()->createBuffer(image));
+    for (int i = 0; i < 200; ++i) {
+        surface->damage(QRect(i * 5, i * 4, 1, 1));
+    }
+    surface->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+    QTRY_VERIFY(scene->textureUploadBytes() - bytes >= 200 * 4);
+    frameRenderedSpy.clear();
+    QVERIFY(frameRenderedSpy.wait());
+    QVERIFY(scene->textureUploadBytes() - bytes < bufferBytes / 2);
+    screen = grabScreen();
+    QVERIFY(!screen.isNull());
+    for (int i = 0; i < 200; i += 50) {
+        QCOMPARE(screen.pixelColor(origin + QPoint(i * 5, i * 4)), QColor(Qt::green));
+    }
+
+    shellSurface.reset();
+    QVERIFY(Test::waitForWindowDestroyed(client));
+}
+
+void GenericSceneOpenGLTest::testDecorationAtlas()
+{
+    // the decorations of all windows are sub-allocated from one shared texture
+    using namespace KWayland::Client;
+    QVERIFY(Test::setupWaylandConnection(Test::AdditionalWaylandInterface::Decoration));
+    auto scene = KWin::Compositor::self()->scene();
+    QTRY_COMPARE(scene->decorationAtlasOccupancy(), 0.0);
+
+    const int count = 5;
+    QVector<Surface *> surfaces;
+    QVector<XdgShellSurface *> shellSurfaces;
+    QVector<AbstractClient *> clients;
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface(Test::waylandCompositor());
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        ServerSideDecoration *deco = Test::waylandServerSideDecoration()->create(surface, surface);
+        QSignalSpy decoSpy(deco, &ServerSideDecoration::modeChanged);
+        QVERIFY(decoSpy.isValid());
+        QVERIFY(decoSpy.wait());
+        deco->requestMode(ServerSideDecoration::Mode::Server);
+        QVERIFY(decoSpy.wait());
+        AbstractClient *client = Test::renderAndWaitForShown(surface, QSize(200 + i * 50, 100 + i * 20), Qt::blue);
+        QVERIFY(client);
+        QVERIFY(client->isDecorated());
+        client->move(QPoint(i * 150, i * 100));
+        surfaces << surface;
+        shellSurfaces << shellSurface;
+        clients << client;
+    }
+
+    // the atlas stays bound on its texture unit while the windows are painted
+    QSignalSpy frameRenderedSpy(scene, &Scene::frameRendered);
+    QVERIFY(frameRenderedSpy.isValid());
+    KWin::Compositor::self()->addRepaintFull();
+    QVERIFY(frameRenderedSpy.wait());
+    QVERIFY(scene->decorationTextureBinds() <= 1);
+
+    // the side borders are stored transposed, so all parts fit into the initial 1024x256 texture
+    qint64 decorationArea = 0;
+    for (AbstractClient *client : qAsConst(clients)) {
+        QRect rects[4];
+        client->layoutDecorationRects(rects[0], rects[1], rects[2], rects[3]);
+        for (const QRect &rect : rects) {
+            if (!rect.isEmpty()) {
+                // one row and column of padding
+                decorationArea += qint64(rect.width() + 1) * (rect.height() + 1);
+            }
+        }
+    }
+    const qreal occupancy = scene->decorationAtlasOccupancy();
+    QCOMPARE(occupancy, qreal(decorationArea) / (1024 * 256));
+
+    // closing a window gives its room back once the decoration is not shown any more
+    delete shellSurfaces.takeFirst();
+    delete surfaces.takeFirst();
+    QVERIFY(Test::waitForWindowDestroyed(clients.takeFirst()));
+    QTRY_VERIFY(scene->decorationAtlasOccupancy() < occupancy);
+
+    qDeleteAll(shellSurfaces);
+    qDeleteAll(surfaces);
+    for (AbstractClient *client : qAsConst(clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(client));
+    }
+    QTRY_COMPARE(scene->decorationAtlasOccupancy(), 0.0);
+}
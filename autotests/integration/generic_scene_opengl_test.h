@@ -34,7 +34,12 @@ private Q_SLOTS:
     void cleanup();
     void testRestart_data();
     void testRestart();
+    void testShmDamageUpload_data();
+    void testShmDamageUpload();
+    void testDecorationAtlas();
 
 private:
+    QImage grabScreen();
+
     QByteArray m_envVariable;
 };
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include <QClipboard>
 #include <QGuiApplication>
+#include <QMimeData>
 #include <QPainter>
 #include <QRasterWindow>
 #include <QTimer>
@@ -27,16 +28,20 @@ class Window : public QRasterWindow
 {
     Q_OBJECT
 public:
-    explicit Window();
+    explicit Window(int size);
     ~Window() override;
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
+
+private:
+    int m_size;
 };
 
-Window::Window()
+Window::Window(int size)
     : QRasterWindow()
+    , m_size(size)
 {
 }
 
@@ -53,15 +58,28 @@ void Window::focusInEvent(QFocusEvent *event)
 {
     QRasterWindow::focusInEvent(event);
     // TODO: make it work without singleshot
-    QTimer::singleShot(100,[] {
-        qApp->clipboard()->setText(QStringLiteral("test"));
+    QTimer::singleShot(100, [this] {
+        if (m_size == 0) {
+            qApp->clipboard()->setText(QStringLiteral("test"));
+            return;
+        }
+        // a payload of the given size with a pattern the paste helper can verify
+        QByteArray data(m_size, Qt::Uninitialized);
+        for (int i = 0; i < m_size; ++i) {
+            data[i] = char(i % 251);
+        }
+        QMimeData *mimeData = new QMimeData;
+        mimeData->setData(QStringLiteral("application/octet-stream"), data);
+        qApp->clipboard()->setMimeData(mimeData);
     });
 }
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
-    QScopedPointer<Window> w(new Window);
+    // optionally the number of bytes to copy instead of a short text
+    const int size = app.arguments().value(1).toInt();
+    QScopedPointer<Window> w(new Window(size));
     w->setGeometry(QRect(0, 0, 100, 200));
     w->show();
 
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include <QClipboard>
 #include <QGuiApplication>
+#include <QMimeData>
 #include <QPainter>
 #include <QRasterWindow>
 #include <QTimer>
@@ -51,11 +52,28 @@ void Window::paintEvent(QPaintEvent *event)
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
+    // optionally the number of bytes expected instead of a short text
+    const int size = app.arguments().value(1).toInt();
     QObject::connect(app.clipboard(), &QClipboard::changed, &app,
-        [] {
-            if (qApp->clipboard()->text() == QLatin1String("test")) {
-                QTimer::singleShot(100, qApp, &QCoreApplication::quit);
+        [size] {
+            if (size == 0) {
+                if (qApp->clipboard()->text() == QLatin1String("test")) {
+                    QTimer::singleShot(100, qApp, &QCoreApplication::quit);
+                }
+                return;
             }
+            const QMimeData *mimeData = qApp->clipboard()->mimeData();
+            if (!mimeData || !mimeData->hasFormat(QStringLiteral("application/octet-stream"))) {
+                return;
+            }
+            const QByteArray data = mimeData->data(QStringLiteral("application/octet-stream"));
+            bool valid = data.size() == size;
+            for (int i = 0; valid && i < size; ++i) {
+                valid = data.at(i) == char(i % 251);
+            }
+            QTimer::singleShot(100, qApp, [valid] {
+                QCoreApplication::exit(valid ? 0 : 1);
+            });
         }
     );
     QScopedPointer<Window> w(new Window);
@@ -0,0 +1,241 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "cursor.h"
+#include "input.h"
+#include "input_event_spy.h"
+#include "platform.h"
+#include "screens.h"
+#include "wayland_server.h"
+#include "workspace.h"
+
+#include <linux/input.h>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_input_event_interest-0");
+
+class CountingSpy : public InputEventSpy
+{
+public:
+    explicit CountingSpy(InputEventTypes interests)
+        : InputEventSpy(interests)
+    {
+    }
+
+    void pointerEvent(MouseEvent *event) override {
+        Q_UNUSED(event)
+        pointerEvents++;
+    }
+    void keyEvent(KeyEvent *event) override {
+        Q_UNUSED(event)
+        keyEvents++;
+    }
+
+    using InputEventSpy::setInterests;
+
+    int pointerEvents = 0;
+    int keyEvents = 0;
+};
+
+class CountingFilter : public InputEventFilter
+{
+public:
+    explicit CountingFilter(InputEventTypes interests)
+        : InputEventFilter(interests)
+    {
+    }
+
+    bool pointerEvent(QMouseEvent *event, quint32 nativeButton) override {
+        Q_UNUSED(event)
+        Q_UNUSED(nativeButton)
+        pointerEvents++;
+        return false;
+    }
+    bool keyEvent(QKeyEvent *event) override {
+        Q_UNUSED(event)
+        keyEvents++;
+        return false;
+    }
+
+    using InputEventFilter::setInterests;
+
+    int pointerEvents = 0;
+    int keyEvents = 0;
+};
+
+class InputEventInterestTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void testSpyInterests();
+    void testFilterInterests();
+    void testChangeInterests();
+    void benchmarkPointerMotion_data();
+    void benchmarkPointerMotion();
+};
+
+void InputEventInterestTest::initTestCase()
+{
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    kwinApp()->setConfig(KSharedConfig::openConfig(QString(), KConfig::SimpleConfig));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    waylandServer()->initWorkspace();
+}
+
+void InputEventInterestTest::init()
+{
+    Cursor::setPos(QPoint(640, 512));
+}
+
+void InputEventInterestTest::testSpyInterests()
+{
+    CountingSpy all(InputEventType::All);
+    CountingSpy keyboard(InputEventType::Keyboard);
+    CountingSpy motion(InputEventType::PointerMotion);
+    input()->installInputEventSpy(&all);
+    input()->installInputEventSpy(&keyboard);
+    input()->installInputEventSpy(&motion);
+
+    quint32 timestamp = 1;
+    kwinApp()->platform()->pointerMotion(QPointF(100, 100), timestamp++);
+    kwinApp()->platform()->pointerMotion(QPointF(200, 100), timestamp++);
+    kwinApp()->platform()->pointerButtonPressed(BTN_LEFT, timestamp++);
+    kwinApp()->platform()->pointerButtonReleased(BTN_LEFT, timestamp++);
+    kwinApp()->platform()->keyboardKeyPressed(KEY_A, timestamp++);
+    kwinApp()->platform()->keyboardKeyReleased(KEY_A, timestamp++);
+
+    QCOMPARE(all.pointerEvents, 4);
+    QCOMPARE(all.keyEvents, 2);
+    QCOMPARE(keyboard.pointerEvents, 0);
+    QCOMPARE(keyboard.keyEvents, 2);
+    // the button events are not pointer motions
+    QCOMPARE(motion.pointerEvents, 2);
+    QCOMPARE(motion.keyEvents, 0);
+
+    input()->uninstallInputEventSpy(&all);
+    input()->uninstallInputEventSpy(&keyboard);
+    input()->uninstallInputEventSpy(&motion);
+}
+
+void InputEventInterestTest::testFilterInterests()
+{
+    CountingFilter keyboard(InputEventType::Keyboard);
+    CountingFilter buttons(InputEventType::PointerButton);
+    input()->prependInputEventFilter(&keyboard);
+    input()->prependInputEventFilter(&buttons);
+
+    quint32 timestamp = 1;
+    kwinApp()->platform()->pointerMotion(QPointF(100, 100), timestamp++);
+    kwinApp()->platform()->pointerButtonPressed(BTN_LEFT, timestamp++);
+    kwinApp()->platform()->pointerButtonReleased(BTN_LEFT, timestamp++);
+    kwinApp()->platform()->keyboardKeyPressed(KEY_A, timestamp++);
+    kwinApp()->platform()->keyboardKeyReleased(KEY_A, timestamp++);
+
+    QCOMPARE(keyboard.pointerEvents, 0);
+    QCOMPARE(keyboard.keyEvents, 2);
+    QCOMPARE(buttons.pointerEvents, 2);
+    QCOMPARE(buttons.keyEvents, 0);
+
+    input()->uninstallInputEventFilter(&keyboard);
+    input()->uninstallInputEventFilter(&buttons);
+}
+
+void InputEventInterestTest::testChangeInterests()
+{
+    CountingSpy spy(InputEventType::Keyboard);
+    CountingFilter filter(InputEventType::Keyboard);
+    input()->installInputEventSpy(&spy);
+    input()->prependInputEventFilter(&filter);
+
+    quint32 timestamp = 1;
+    kwinApp()->platform()->pointerMotion(QPointF(100, 100), timestamp++);
+    QCOMPARE(spy.pointerEvents, 0);
+    QCOMPARE(filter.pointerEvents, 0);
+
+    spy.setInterests(InputEventType::Keyboard | InputEventType::PointerMotion);
+    filter.setInterests(InputEventType::Keyboard | InputEventType::PointerMotion);
+    kwinApp()->platform()->pointerMotion(QPointF(200, 100), timestamp++);
+    QCOMPARE(spy.pointerEvents, 1);
+    QCOMPARE(filter.pointerEvents, 1);
+
+    spy.setInterests(InputEventType::Keyboard);
+    filter.setInterests(InputEventType::Keyboard);
+    kwinApp()->platform()->pointerMotion(QPointF(300, 100), timestamp++);
+    QCOMPARE(spy.pointerEvents, 1);
+    QCOMPARE(filter.pointerEvents, 1);
+
+    input()->uninstallInputEventSpy(&spy);
+    input()->uninstallInputEventFilter(&filter);
+}
+
+void InputEventInterestTest::benchmarkPointerMotion_data()
+{
+    QTest::addColumn<int>("uninterested");
+
+    QTest::newRow("0") << 0;
+    QTest::newRow("20") << 20;
+}
+
+void InputEventInterestTest::benchmarkPointerMotion()
+{
+    // filters and spies which only care about keys, as most of the installed ones do
+    QFETCH(int, uninterested);
+    QVector<CountingSpy *> spies;
+    QVector<CountingFilter *> filters;
+    for (int i = 0; i < uninterested; ++i) {
+        spies << new CountingSpy(InputEventType::Keyboard);
+        input()->installInputEventSpy(spies.last());
+        filters << new CountingFilter(InputEventType::Keyboard);
+        input()->prependInputEventFilter(filters.last());
+    }
+
+    const QRect area = screens()->geometry();
+    const int steps = 1000;
+    quint32 timestamp = 1;
+
+    QBENCHMARK {
+        for (int i = 0; i < steps; ++i) {
+            const QPointF pos(area.x() + area.width() * i / steps,
+                              area.y() + area.height() * ((i * 7) % steps) / steps);
+            kwinApp()->platform()->pointerMotion(pos, timestamp++);
+        }
+    }
+
+    for (CountingSpy *spy : spies) {
+        QCOMPARE(spy->pointerEvents, 0);
+    }
+    for (CountingFilter *filter : filters) {
+        QCOMPARE(filter->pointerEvents, 0);
+    }
+    qDeleteAll(spies);
+    qDeleteAll(filters);
+}
+
+WAYLANDTEST_MAIN(InputEventInterestTest)
+#include "input_event_interest_test.moc"
@@ -0,0 +1,291 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "cursor.h"
+#include "input.h"
+#include "input_hit_index.h"
+#include "platform.h"
+#include "screens.h"
+#include "virtualdesktops.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QRandomGenerator>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_input_hit_index-0");
+
+class InputHitIndexTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testMatchesStackingOrder();
+    void testFollowsChanges();
+    void testOtherDesktop();
+    void benchmarkPointerMotion_data();
+    void benchmarkPointerMotion();
+
+private:
+    void createWindows(int count, uint desktops);
+    void verifyAllPositions();
+
+    QVector<Surface *> m_surfaces;
+    QVector<XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
+};
+
+/**
+ * The lookup without the spatial index: the complete stacking order is walked from the top.
+ */
+static Toplevel *referenceToplevelAt(const QPoint &pos)
+{
+    const QList<Toplevel *> &stacking = workspace()->stackingOrder();
+    for (auto it = stacking.crbegin(); it != stacking.crend(); ++it) {
+        Toplevel *t = *it;
+        if (t->isDeleted()) {
+            continue;
+        }
+        if (AbstractClient *c = qobject_cast<AbstractClient *>(t)) {
+            if (!c->isOnCurrentActivity() || !c->isOnCurrentDesktop() || c->isMinimized() || c->isHiddenInternal()) {
+                continue;
+            }
+        }
+        if (!t->readyForPainting()) {
+            continue;
+        }
+        if (!t->inputGeometry().contains(pos)) {
+            continue;
+        }
+        const QRegion input = t->inputShape();
+        if (input.isEmpty() || input.translated(t->pos()).contains(pos)) {
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+void InputHitIndexTest::initTestCase()
+{
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+    QMetaObject::invokeMethod(kwinApp()->platform(), "setVirtualOutputs", Qt::DirectConnection, Q_ARG(int, 2));
+
+    kwinApp()->setConfig(KSharedConfig::openConfig(QString(), KConfig::SimpleConfig));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QCOMPARE(screens()->count(), 2);
+    waylandServer()->initWorkspace();
+}
+
+void InputHitIndexTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+    VirtualDesktopManager::self()->setCount(4);
+    VirtualDesktopManager::self()->setCurrent(1);
+    Cursor::setPos(QPoint(640, 512));
+}
+
+void InputHitIndexTest::cleanup()
+{
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
+    Test::destroyWaylandConnection();
+}
+
+void InputHitIndexTest::createWindows(int count, uint desktops)
+{
+    // the same layout for each run, so the benchmark results are comparable
+    QRandomGenerator random(42);
+    const QRect area = screens()->geometry();
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        const QSize size(random.bounded(50, 800), random.bounded(50, 600));
+        AbstractClient *c = Test::renderAndWaitForShown(surface, size, Qt::blue);
+        QVERIFY(c);
+        c->move(QPoint(random.bounded(area.x() - 100, area.right() - 100),
+                       random.bounded(area.y() - 100, area.bottom() - 100)));
+        c->setDesktop(1 + i % desktops);
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
+void InputHitIndexTest::verifyAllPositions()
+{
+    const QRect area = screens()->geometry();
+    for (int y = area.y(); y <= area.bottom(); y += 13) {
+        for (int x = area.x(); x <= area.right(); x += 13) {
+            const QPoint pos(x, y);
+            QCOMPARE(input()->findManagedToplevel(pos), referenceToplevelAt(pos));
+        }
+    }
+}
+
+void InputHitIndexTest::testMatchesStackingOrder()
+{
+    createWindows(40, 2);
+    QVERIFY(input()->hitIndex());
+    // half of the windows are on the other desktop
+    QVERIFY(input()->hitIndex()->indexedCount() <= 20);
+    verifyAllPositions();
+
+    VirtualDesktopManager::self()->setCurrent(2);
+    verifyAllPositions();
+
+    // the grid of the first desktop is kept, changes while it isn't shown are picked up
+    // when switching back
+    for (int i = 0; i < m_clients.count(); i += 4) {
+        m_clients[i]->move(m_clients[i]->pos() + QPoint(100, 50));
+        workspace()->raiseClient(m_clients[i]);
+    }
+    m_clients[2]->setDesktop(2);
+    m_clients[3]->setDesktop(1);
+    verifyAllPositions();
+    VirtualDesktopManager::self()->setCurrent(1);
+    verifyAllPositions();
+}
+
+void InputHitIndexTest::testFollowsChanges()
+{
+    createWindows(20, 1);
+    verifyAllPositions();
+
+    // move and resize some windows
+    for (int i = 0; i < m_clients.count(); i += 3) {
+        m_clients[i]->move(m_clients[i]->pos() + QPoint(150, 75));
+    }
+    verifyAllPositions();
+
+    // change the stacking order
+    for (int i = 0; i < m_clients.count(); i += 2) {
+        workspace()->raiseClient(m_clients[i]);
+    }
+    verifyAllPositions();
+    workspace()->lowerClient(m_clients.last());
+    verifyAllPositions();
+
+    // minimized windows are still indexed, but don't get input
+    m_clients[1]->minimize();
+    m_clients[5]->minimize();
+    verifyAllPositions();
+    m_clients[1]->unminimize();
+    verifyAllPositions();
+
+    // windows sent to another desktop leave the index, windows on all desktops stay
+    m_clients[2]->setDesktop(3);
+    m_clients[4]->setOnAllDesktops(true);
+    verifyAllPositions();
+    VirtualDesktopManager::self()->setCurrent(3);
+    verifyAllPositions();
+    VirtualDesktopManager::self()->setCurrent(1);
+
+    // closed windows get removed
+    AbstractClient *closed = m_clients.takeAt(6);
+    delete m_shellSurfaces.takeAt(6);
+    delete m_surfaces.takeAt(6);
+    QVERIFY(Test::waitForWindowDestroyed(closed));
+    verifyAllPositions();
+}
+
+void InputHitIndexTest::testOtherDesktop()
+{
+    // a window on another desktop never is the window under the pointer, neither on the
+    // screens nor outside of them where the index isn't used
+    Surface *surface = Test::createSurface();
+    QVERIFY(surface);
+    XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+    QVERIFY(shellSurface);
+    AbstractClient *c = Test::renderAndWaitForShown(surface, QSize(200, 100), Qt::blue);
+    QVERIFY(c);
+    m_surfaces << surface;
+    m_shellSurfaces << shellSurface;
+    m_clients << c;
+    c->move(QPoint(-100, 100));
+    const QPoint onScreen(50, 150);
+    const QPoint offScreen(-50, 150);
+    QVERIFY(!screens()->geometry().contains(offScreen));
+    QCOMPARE(input()->findManagedToplevel(onScreen), c);
+    QCOMPARE(input()->findManagedToplevel(offScreen), c);
+
+    c->setDesktop(2);
+    QCOMPARE(input()->findManagedToplevel(onScreen), nullptr);
+    QCOMPARE(input()->findManagedToplevel(offScreen), nullptr);
+
+    VirtualDesktopManager::self()->setCurrent(2);
+    QCOMPARE(input()->findManagedToplevel(onScreen), c);
+    QCOMPARE(input()->findManagedToplevel(offScreen), c);
+    VirtualDesktopManager::self()->setCurrent(1);
+    QCOMPARE(input()->findManagedToplevel(offScreen), nullptr);
+}
+
+void InputHitIndexTest::benchmarkPointerMotion_data()
+{
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("50") << 50;
+    QTest::newRow("200") << 200;
+    QTest::newRow("400") << 400;
+}
+
+void InputHitIndexTest::benchmarkPointerMotion()
+{
+    // the pointer moves over the workspace like a 1000 Hz mouse would do it
+    QFETCH(int, windows);
+    createWindows(windows, 4);
+    const QRect area = screens()->geometry();
+    const int steps = 1000;
+    quint32 timestamp = 1;
+
+    QBENCHMARK {
+        for (int i = 0; i < steps; ++i) {
+            const QPointF pos(area.x() + area.width() * i / steps,
+                              area.y() + area.height() * ((i * 7) % steps) / steps);
+            kwinApp()->platform()->pointerMotion(pos, timestamp++);
+        }
+    }
+}
+
+WAYLANDTEST_MAIN(InputHitIndexTest)
+#include "input_hit_index_test.moc"
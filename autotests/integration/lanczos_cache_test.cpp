@@ -0,0 +1,207 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effects.h"
+#include "effect_builtins.h"
+#include "options.h"
+#include "platform.h"
+#include "scene.h"
+#include "xdgshellclient.h"
+#include "wayland_server.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/shm_pool.h>
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_lanczos_cache-0");
+
+class LanczosCacheTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testCacheHit();
+    void testPartialRefilter();
+    void testEviction();
+
+private:
+    bool toggleThumbnail();
+    bool renderFrame();
+};
+
+void LanczosCacheTest::initTestCase()
+{
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient*>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects, the thumbnails get loaded by the tests
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    // thumbnails of 800x600 windows are 600x450, a bit more than 1 MiB each
+    config->group("Effect-ThumbnailAside").writeEntry("MaxWidth", 600);
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    // the filter is disabled on software emulation
+    qputenv("KWIN_FORCE_LANCZOS", QByteArrayLiteral("1"));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    QCOMPARE(Compositor::self()->scene()->compositingType(), KWin::OpenGL2Compositing);
+}
+
+void LanczosCacheTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+    options->setGlScaleCacheSize(Options::defaultGlScaleCacheSize());
+    QVERIFY(static_cast<EffectsHandlerImpl *>(effects)->loadEffect(QStringLiteral("thumbnailaside")));
+}
+
+void LanczosCacheTest::cleanup()
+{
+    static_cast<EffectsHandlerImpl *>(effects)->unloadEffect(QStringLiteral("thumbnailaside"));
+    Test::destroyWaylandConnection();
+}
+
+bool LanczosCacheTest::toggleThumbnail()
+{
+    Effect *thumbnails = static_cast<EffectsHandlerImpl *>(effects)->findEffect(QStringLiteral("thumbnailaside"));
+    return thumbnails && QMetaObject::invokeMethod(thumbnails, "toggleCurrentThumbnail");
+}
+
+bool LanczosCacheTest::renderFrame()
+{
+    QSignalSpy frameRenderedSpy(Compositor::self()->scene(), &Scene::frameRendered);
+    if (!frameRenderedSpy.isValid()) {
+        return false;
+    }
+    Compositor::self()->addRepaintFull();
+    return frameRenderedSpy.wait();
+}
+
+void LanczosCacheTest::testCacheHit()
+{
+    // an unchanged window is painted from the cache
+    QScopedPointer<Surface> surface(Test::createSurface());
+    QScopedPointer<XdgShellSurface> shellSurface(Test::createXdgShellStableSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(800, 600), Qt::blue);
+    QVERIFY(client);
+    QVERIFY(client->isActive());
+
+    Scene *scene = Compositor::self()->scene();
+    QVERIFY(toggleThumbnail());
+    QVERIFY(renderFrame());
+    const qint64 filtered = scene->scaleFilteredPixels();
+    QVERIFY(filtered > 0);
+
+    const int hits = scene->scaleCacheHits();
+    QVERIFY(renderFrame());
+    QVERIFY(renderFrame());
+    QVERIFY(scene->scaleCacheHits() >= hits + 2);
+    QCOMPARE(scene->scaleFilteredPixels(), filtered);
+}
+
+void LanczosCacheTest::testPartialRefilter()
+{
+    // after a small damage only the scaled pixels depending on it are filtered again
+    QScopedPointer<Surface> surface(Test::createSurface());
+    QScopedPointer<XdgShellSurface> shellSurface(Test::createXdgShellStableSurface(surface.data()));
+    AbstractClient *client = Test::renderAndWaitForShown(surface.data(), QSize(800, 600), Qt::blue);
+    QVERIFY(client);
+    QVERIFY(client->isActive());
+
+    Scene *scene = Compositor::self()->scene();
+    const qint64 initial = scene->scaleFilteredPixels();
+    QVERIFY(toggleThumbnail());
+    QVERIFY(renderFrame());
+    const qint64 full = scene->scaleFilteredPixels() - initial;
+    QVERIFY(full > 0);
+
+    QSignalSpy damagedSpy(client, &Toplevel::damaged);
+    QVERIFY(damagedSpy.isValid());
+    QImage image(QSize(800, 600), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::blue);
+    image.setPixel(400, 300, qRgb(255, 0, 0));
+    surface->attachBuffer(Test::waylandShmPool()->createBuffer(image));
+    surface->damage(QRect(400, 300, 1, 1));
+    surface->commit(Surface::CommitFlag::None);
+    QVERIFY(damagedSpy.wait());
+
+    const qint64 beforeDamage = scene->scaleFilteredPixels();
+    QTRY_VERIFY(scene->scaleFilteredPixels() > beforeDamage);
+    const qint64 partial = scene->scaleFilteredPixels() - beforeDamage;
+    QVERIFY2(partial * 10 < full, qPrintable(QStringLiteral("full: %1, partial: %2").arg(full).arg(partial)));
+}
+
+void LanczosCacheTest::testEviction()
+{
+    // two thumbnails don't fit into 2 MiB, the least recently used one gets dropped
+    QScopedPointer<Surface> surface1(Test::createSurface());
+    QScopedPointer<XdgShellSurface> shellSurface1(Test::createXdgShellStableSurface(surface1.data()));
+    AbstractClient *client1 = Test::renderAndWaitForShown(surface1.data(), QSize(800, 600), Qt::blue);
+    QVERIFY(client1);
+    QVERIFY(client1->isActive());
+    QVERIFY(toggleThumbnail());
+
+    options->setGlScaleCacheSize(2);
+    Scene *scene = Compositor::self()->scene();
+    QVERIFY(renderFrame());
+    const int evictions = scene->scaleCacheEvictions();
+
+    QScopedPointer<Surface> surface2(Test::createSurface());
+    QScopedPointer<XdgShellSurface> shellSurface2(Test::createXdgShellStableSurface(surface2.data()));
+    AbstractClient *client2 = Test::renderAndWaitForShown(surface2.data(), QSize(800, 600), Qt::red);
+    QVERIFY(client2);
+    QVERIFY(client2->isActive());
+    QVERIFY(toggleThumbnail());
+    QVERIFY(renderFrame());
+    QVERIFY(scene->scaleCacheEvictions() > evictions);
+
+    // with enough room both stay cached
+    options->setGlScaleCacheSize(Options::defaultGlScaleCacheSize());
+    QVERIFY(renderFrame());
+    const int settled = scene->scaleCacheEvictions();
+    QVERIFY(renderFrame());
+    QVERIFY(renderFrame());
+    QCOMPARE(scene->scaleCacheEvictions(), settled);
+}
+
+WAYLANDTEST_MAIN(LanczosCacheTest)
+#include "lanczos_cache_test.moc"
@@ -30,6 +30,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "workspace.h"
 #include "xdgshellclient.h"
 #include "deleted.h"
+#include "options.h"
 
 #include <KWayland/Client/connection_thread.h>
 #include <KWayland/Client/compositor.h>
@@ -40,6 +41,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <KWayland/Client/surface.h>
 #include <KWayland/Client/xdgshell.h>
 
+#include <QRandomGenerator>
+
 #include <linux/input.h>
 #include <xcb/xcb_icccm.h>
 
@@ -84,8 +87,16 @@ private Q_SLOTS:
     void testDestroyResizeClient();
     void testUnmapMoveClient();
     void testUnmapResizeClient();
+    void testSnapAmongManyWindows();
+    void benchmarkMoveAmongManyWindows_data();
+    void benchmarkMoveAmongManyWindows();
 
 private:
+    void createWindows(int count);
+
+    QVector<KWayland::Client::Surface *> m_surfaces;
+    QVector<KWayland::Client::XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
     KWayland::Client::ConnectionThread *m_connection = nullptr;
     KWayland::Client::Compositor *m_compositor = nullptr;
 };
@@ -118,9 +129,38 @@ void MoveResizeWindowTest::init()
 
 void MoveResizeWindowTest::cleanup()
 {
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
     Test::destroyWaylandConnection();
 }
 
+void MoveResizeWindowTest::createWindows(int count)
+{
+    using namespace KWayland::Client;
+
+    // the same layout for each run, so the benchmark results are comparable
+    QRandomGenerator random(42);
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        const QSize size(random.bounded(50, 600), random.bounded(50, 400));
+        AbstractClient *c = Test::renderAndWaitForShown(surface, size, Qt::blue);
+        QVERIFY(c);
+        c->move(QPoint(random.bounded(0, 1280 - size.width()), random.bounded(0, 1024 - size.height())));
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
 void MoveResizeWindowTest::testMove()
 {
     using namespace KWayland::Client;
@@ -1210,6 +1250,75 @@ void MoveResizeWindowTest::testUnmapResizeClient()
     QCOMPARE(clientFinishUserMovedResizedSpy.count(), 0);
 }
 
+void MoveResizeWindowTest::testSnapAmongManyWindows()
+{
+    // while a window is moved only the windows close to it are considered for snapping,
+    // which has to give the same result as looking at all windows
+    createWindows(60);
+    AbstractClient *c = m_clients.last();
+    QVERIFY(options->windowSnapZone() > 0);
+
+    QVector<QPoint> positions;
+    QVector<QPoint> expected;
+    for (int y = -20; y < 1024; y += 7) {
+        for (int x = -20; x < 1280; x += 11) {
+            positions << QPoint(x, y);
+            expected << workspace()->adjustClientPosition(c, QPoint(x, y), false);
+        }
+    }
+    // some of the positions have to snap, otherwise the test is pointless
+    QVERIFY(positions != expected);
+
+    workspace()->slotWindowMove();
+    QCOMPARE(workspace()->moveResizeClient(), c);
+    for (int i = 0; i < positions.count(); ++i) {
+        QCOMPARE(workspace()->adjustClientPosition(c, positions.at(i), false), expected.at(i));
+    }
+
+    // windows changing their geometry during the move are still snapped to
+    for (int i = 0; i < 10; ++i) {
+        m_clients[i]->move(m_clients[i]->pos() + QPoint(37, -23));
+    }
+    QVector<QPoint> adjusted;
+    for (const QPoint &pos : qAsConst(positions)) {
+        adjusted << workspace()->adjustClientPosition(c, pos, false);
+    }
+
+    c->keyPressEvent(Qt::Key_Enter);
+    QVERIFY(workspace()->moveResizeClient() == nullptr);
+    for (int i = 0; i < positions.count(); ++i) {
+        QCOMPARE(adjusted.at(i), workspace()->adjustClientPosition(c, positions.at(i), false));
+    }
+}
+
+void MoveResizeWindowTest::benchmarkMoveAmongManyWindows_data()
+{
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("50") << 50;
+    QTest::newRow("200") << 200;
+}
+
+void MoveResizeWindowTest::benchmarkMoveAmongManyWindows()
+{
+    // drags a window diagonally across the screen, each step has to look for snap targets
+    QFETCH(int, windows);
+    createWindows(windows);
+    AbstractClient *c = m_clients.last();
+    workspace()->slotWindowMove();
+    QCOMPARE(workspace()->moveResizeClient(), c);
+
+    const int steps = 1000;
+    QBENCHMARK {
+        for (int i = 0; i < steps; ++i) {
+            workspace()->adjustClientPosition(c, QPoint(1280 * i / steps, 1024 * i / steps), false);
+        }
+    }
+
+    c->keyPressEvent(Qt::Key_Enter);
+    QVERIFY(workspace()->moveResizeClient() == nullptr);
+}
+
 }
 
 WAYLANDTEST_MAIN(KWin::MoveResizeWindowTest)
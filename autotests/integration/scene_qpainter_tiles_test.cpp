@@ -0,0 +1,215 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "abstract_client.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effect_builtins.h"
+#include "platform.h"
+#include "scene.h"
+#include "screens.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "xdgshellclient.h"
+
+#include <KConfigGroup>
+
+#include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+using namespace KWin;
+using namespace KWayland::Client;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_scene_qpainter_tiles-0");
+
+class SceneQPainterTilesTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testMatchesSingleThreaded_data();
+    void testMatchesSingleThreaded();
+    void benchmarkFrame_data();
+    void benchmarkFrame();
+
+private:
+    void restartCompositor(int threads);
+    void createWindows(int count);
+    QImage renderFrame();
+
+    QVector<Surface *> m_surfaces;
+    QVector<XdgShellSurface *> m_shellSurfaces;
+    QVector<AbstractClient *> m_clients;
+};
+
+void SceneQPainterTilesTest::initTestCase()
+{
+    qRegisterMetaType<KWin::XdgShellClient *>();
+    qRegisterMetaType<KWin::AbstractClient *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(2560, 1440));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects - we don't want to have it interact with the rendering
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("Q"));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    QCOMPARE(kwinApp()->platform()->selectedCompositor(), QPainterCompositing);
+    waylandServer()->initWorkspace();
+}
+
+void SceneQPainterTilesTest::init()
+{
+    QVERIFY(Test::setupWaylandConnection());
+}
+
+void SceneQPainterTilesTest::cleanup()
+{
+    qDeleteAll(m_shellSurfaces);
+    m_shellSurfaces.clear();
+    qDeleteAll(m_surfaces);
+    m_surfaces.clear();
+    for (AbstractClient *c : qAsConst(m_clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(c));
+    }
+    m_clients.clear();
+    Test::destroyWaylandConnection();
+}
+
+void SceneQPainterTilesTest::restartCompositor(int threads)
+{
+    // the number of threads is read when the scene gets created
+    qputenv("KWIN_QPAINTER_THREADS", QByteArray::number(threads));
+    QSignalSpy sceneCreatedSpy(Compositor::self(), &Compositor::sceneCreated);
+    QVERIFY(sceneCreatedSpy.isValid());
+    Compositor::self()->reinitialize();
+    if (sceneCreatedSpy.isEmpty()) {
+        QVERIFY(sceneCreatedSpy.wait());
+    }
+    QVERIFY(Compositor::self()->scene());
+}
+
+void SceneQPainterTilesTest::createWindows(int count)
+{
+    // overlapping windows of all sizes, some of them reaching out of the screen
+    const QRect area = screens()->geometry();
+    const QColor colors[] = {Qt::red, Qt::green, Qt::blue, Qt::yellow, Qt::cyan, Qt::magenta};
+    for (int i = 0; i < count; ++i) {
+        Surface *surface = Test::createSurface();
+        QVERIFY(surface);
+        XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        const QSize size(300 + (i * 397) % 1500, 200 + (i * 211) % 900);
+        AbstractClient *c = Test::renderAndWaitForShown(surface, size, colors[i % 6]);
+        QVERIFY(c);
+        c->move(QPoint(area.x() - 100 + (i * 331) % area.width(),
+                       area.y() - 100 + (i * 173) % area.height()));
+        if (i % 3 == 2) {
+            c->setOpacity(0.5);
+        }
+        m_surfaces << surface;
+        m_shellSurfaces << shellSurface;
+        m_clients << c;
+    }
+}
+
+QImage SceneQPainterTilesTest::renderFrame()
+{
+    QList<Toplevel *> toplevels;
+    for (Toplevel *t : workspace()->stackingOrder()) {
+        if (t->readyForPainting()) {
+            toplevels << t;
+        }
+    }
+    Scene *scene = Compositor::self()->scene();
+    scene->paint(QRegion(screens()->geometry()), toplevels);
+    return scene->qpainterRenderBuffer()->copy();
+}
+
+void SceneQPainterTilesTest::testMatchesSingleThreaded_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("7") << 7;
+}
+
+void SceneQPainterTilesTest::testMatchesSingleThreaded()
+{
+    // the tiles must add up to exactly what the main thread renders on its own
+    QFETCH(int, threads);
+    createWindows(12);
+
+    restartCompositor(1);
+    const QImage reference = renderFrame();
+    restartCompositor(threads);
+    const QImage tiled = renderFrame();
+    QCOMPARE(tiled, reference);
+}
+
+void SceneQPainterTilesTest::benchmarkFrame_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("8") << 8;
+}
+
+void SceneQPainterTilesTest::benchmarkFrame()
+{
+    // full repaints of a 2560x1440 screen with a dozen large windows
+    QFETCH(int, threads);
+    createWindows(12);
+    restartCompositor(threads);
+
+    QList<Toplevel *> toplevels;
+    for (Toplevel *t : workspace()->stackingOrder()) {
+        if (t->readyForPainting()) {
+            toplevels << t;
+        }
+    }
+    Scene *scene = Compositor::self()->scene();
+    const QRegion damage(screens()->geometry());
+
+    QBENCHMARK {
+        scene->paint(damage, toplevels);
+    }
+}
+
+WAYLANDTEST_MAIN(SceneQPainterTilesTest)
+#include "scene_qpainter_tiles_test.moc"
@@ -0,0 +1,216 @@
+/********************************************************************
+KWin - the KDE window manager
+This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "composite.h"
+#include "effectloader.h"
+#include "effect_builtins.h"
+#include "platform.h"
+#include "scene.h"
+#include "wayland_server.h"
+
+#include <kwinglutils.h>
+
+#include <KConfigGroup>
+
+#include <QDir>
+#include <QStandardPaths>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_shader_cache-0");
+
+class ShaderCacheTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void testCacheHits();
+    void testRejectedBinary();
+    void testPruneOtherDriver();
+
+private:
+    bool generateVariants();
+    bool restartCompositor();
+    QDir cacheDirectory() const;
+};
+
+static QVector<ShaderTraits> allVariants()
+{
+    QVector<ShaderTraits> variants;
+    for (int i = 1; i < 16; ++i) {
+        const ShaderTraits traits(i);
+        if ((traits & ShaderTrait::MapTexture) && (traits & ShaderTrait::UniformColor)) {
+            continue;
+        }
+        variants << traits;
+    }
+    return variants;
+}
+
+void ShaderCacheTest::initTestCase()
+{
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+
+    // disable all effects - only the shaders of the scene should be cached
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    KConfigGroup plugins(config, QStringLiteral("Plugins"));
+    ScriptedEffectLoader loader;
+    const auto builtinNames = BuiltInEffects::availableEffectNames() << loader.listOfKnownEffects();
+    for (QString name : builtinNames) {
+        plugins.writeEntry(name + QStringLiteral("Enabled"), false);
+    }
+    config->sync();
+    kwinApp()->setConfig(config);
+
+    // start with an empty cache
+    QVERIFY(cacheDirectory().removeRecursively());
+
+    qputenv("KWIN_COMPOSE", QByteArrayLiteral("O2"));
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    QVERIFY(Compositor::self());
+    QVERIFY(Compositor::self()->scene());
+    QCOMPARE(Compositor::self()->scene()->compositingType(), OpenGL2Compositing);
+}
+
+QDir ShaderCacheTest::cacheDirectory() const
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kwin/glprograms"));
+}
+
+bool ShaderCacheTest::generateVariants()
+{
+    // what an effect does when it gets used the first time
+    Scene *scene = Compositor::self()->scene();
+    if (!scene->makeOpenGLContextCurrent()) {
+        return false;
+    }
+    QVector<GLShader *> shaders;
+    const auto variants = allVariants();
+    for (ShaderTraits traits : variants) {
+        shaders << ShaderManager::instance()->generateCustomShader(traits);
+    }
+
+    const bool valid = std::all_of(shaders.constBegin(), shaders.constEnd(),
+        [] (GLShader *shader) {
+            return shader->isValid();
+        }
+    );
+    qDeleteAll(shaders);
+    return valid;
+}
+
+bool ShaderCacheTest::restartCompositor()
+{
+    QSignalSpy sceneCreatedSpy(Compositor::self(), &Compositor::sceneCreated);
+    if (!sceneCreatedSpy.isValid()) {
+        return false;
+    }
+    Compositor::self()->reinitialize();
+    if (sceneCreatedSpy.isEmpty() && !sceneCreatedSpy.wait()) {
+        return false;
+    }
+    return Compositor::self()->scene()->makeOpenGLContextCurrent();
+}
+
+void ShaderCacheTest::testCacheHits()
+{
+    if (!Compositor::self()->scene()->makeOpenGLContextCurrent() || !ShaderManager::instance()->isProgramCacheEnabled()) {
+        QSKIP("The driver does not support program binaries");
+    }
+    // the scene prepares its shaders after starting
+    QTRY_VERIFY(!cacheDirectory().entryList(QDir::Files).isEmpty());
+
+    QVERIFY(cacheDirectory().removeRecursively());
+    QVERIFY(restartCompositor());
+    QVERIFY(generateVariants());
+    ShaderManager *shaderManager = ShaderManager::instance();
+    QVERIFY(shaderManager->programCacheMisses() >= allVariants().count());
+    QVERIFY(cacheDirectory().entryList(QDir::Files).count() >= allVariants().count());
+
+    // nothing has to be compiled again, neither for the scene nor for the effects
+    QVERIFY(restartCompositor());
+    QVERIFY(generateVariants());
+    shaderManager = ShaderManager::instance();
+    QCOMPARE(shaderManager->programCacheMisses(), 0);
+    QVERIFY(shaderManager->programCacheHits() >= allVariants().count());
+}
+
+void ShaderCacheTest::testRejectedBinary()
+{
+    if (!Compositor::self()->scene()->makeOpenGLContextCurrent() || !ShaderManager::instance()->isProgramCacheEnabled()) {
+        QSKIP("The driver does not support program binaries");
+    }
+    QVERIFY(generateVariants());
+
+    // e.g. the driver got updated without changing its version
+    const QByteArray garbage(256, 'x');
+    const QStringList files = cacheDirectory().entryList(QDir::Files);
+    QVERIFY(!files.isEmpty());
+    for (const QString &fileName : files) {
+        QFile file(cacheDirectory().filePath(fileName));
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QCOMPARE(file.write(garbage), garbage.size());
+    }
+
+    // the shaders get compiled again and replace the rejected binaries, with all effects
+    // disabled the scene only uses shaders which are among the variants
+    const int misses = ShaderManager::instance()->programCacheMisses();
+    QVERIFY(generateVariants());
+    QCOMPARE(ShaderManager::instance()->programCacheMisses(), misses + allVariants().count());
+    for (const QString &fileName : files) {
+        QFile file(cacheDirectory().filePath(fileName));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY(file.readAll() != garbage);
+    }
+}
+
+void ShaderCacheTest::testPruneOtherDriver()
+{
+    if (!Compositor::self()->scene()->makeOpenGLContextCurrent() || !ShaderManager::instance()->isProgramCacheEnabled()) {
+        QSKIP("The driver does not support program binaries");
+    }
+    QVERIFY(generateVariants());
+    const QStringList files = cacheDirectory().entryList(QDir::Files);
+    QVERIFY(!files.isEmpty());
+
+    // binaries stored before a driver update
+    const QString otherDriver = QStringLiteral("0123456789abcdef-0123456789abcdef0123456789abcdef01234567");
+    const QString unprefixed = QStringLiteral("0123456789abcdef0123456789abcdef01234567");
+    for (const QString &fileName : {otherDriver, unprefixed}) {
+        QFile file(cacheDirectory().filePath(fileName));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write(QByteArray(256, 'x')) > 0);
+    }
+
+    QVERIFY(restartCompositor());
+    QVERIFY(ShaderManager::instance()->isProgramCacheEnabled());
+    QVERIFY(!cacheDirectory().exists(otherDriver));
+    QVERIFY(!cacheDirectory().exists(unprefixed));
+    for (const QString &fileName : files) {
+        QVERIFY(cacheDirectory().exists(fileName));
+    }
+}
+
+WAYLANDTEST_MAIN(ShaderCacheTest)
+#include "shader_cache_test.moc"
@@ -22,8 +22,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "abstract_client.h"
 #include "atoms.h"
+#include "composite.h"
 #include "x11client.h"
 #include "deleted.h"
+#include "framescheduler.h"
 #include "main.h"
 #include "platform.h"
 #include "xdgshellclient.h"
@@ -32,6 +34,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <KWayland/Client/compositor.h>
 #include <KWayland/Client/surface.h>
+#include <KWayland/Client/xdgshell.h>
+
+#include <QRandomGenerator>
 
 #include <xcb/xcb.h>
 #include <xcb/xcb_icccm.h>
@@ -61,6 +66,9 @@ private Q_SLOTS:
     void testKeepAbove();
     void testKeepBelow();
 
+    void testRestackRepaints();
+    void testRaiseStorm_data();
+    void testRaiseStorm();
 };
 
 void StackingOrderTest::initTestCase()
@@ -906,5 +914,159 @@ void StackingOrderTest::testKeepBelow()
     QCOMPARE(workspace()->stackingOrder(), (QList<Toplevel *>{clientB, clientA}));
 }
 
+static QRegion pendingRepaints()
+{
+    QRegion damage;
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    for (FrameScheduler *scheduler : schedulers) {
+        damage += scheduler->damage();
+    }
+    return damage;
+}
+
+static bool isCompositorIdle()
+{
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    return std::none_of(schedulers.begin(), schedulers.end(),
+        [] (FrameScheduler *scheduler) {
+            return scheduler->isScheduled() || scheduler->hasDamage();
+        }
+    );
+}
+
+void StackingOrderTest::testRestackRepaints()
+{
+    // This test verifies that raising or lowering a window only repaints the area
+    // where it overlaps the windows it moved past.
+
+    QVector<KWayland::Client::Surface *> surfaces;
+    QVector<KWayland::Client::XdgShellSurface *> shellSurfaces;
+    QVector<XdgShellClient *> clients;
+    const QVector<QRect> geometries{QRect(0, 0, 200, 200), QRect(100, 100, 200, 200), QRect(800, 600, 100, 100)};
+    for (const QRect &geometry : geometries) {
+        KWayland::Client::Surface *surface = Test::createSurface(Test::waylandCompositor());
+        QVERIFY(surface);
+        KWayland::Client::XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        XdgShellClient *client = Test::renderAndWaitForShown(surface, geometry.size(), Qt::green);
+        QVERIFY(client);
+        client->move(geometry.topLeft());
+        QCOMPARE(client->visibleRect(), geometry);
+        surfaces << surface;
+        shellSurfaces << shellSurface;
+        clients << client;
+    }
+    QCOMPARE(workspace()->stackingOrder(), (QList<Toplevel *>{clients[0], clients[1], clients[2]}));
+    QTRY_VERIFY(isCompositorIdle());
+
+    // The first window goes above the second one, only their intersection changes.
+    workspace()->raiseClient(clients[0]);
+    QCOMPARE(workspace()->stackingOrder(), (QList<Toplevel *>{clients[1], clients[2], clients[0]}));
+    QCOMPARE(pendingRepaints(), QRegion(100, 100, 100, 100));
+    QTRY_VERIFY(isCompositorIdle());
+
+    // Moving past a window which doesn't overlap repaints nothing.
+    workspace()->lowerClient(clients[2]);
+    QCOMPARE(workspace()->stackingOrder(), (QList<Toplevel *>{clients[2], clients[1], clients[0]}));
+    QVERIFY(pendingRepaints().isEmpty());
+
+    // Raising the top most window is a no-op.
+    workspace()->raiseClient(clients[0]);
+    QCOMPARE(workspace()->stackingOrder(), (QList<Toplevel *>{clients[2], clients[1], clients[0]}));
+    QVERIFY(pendingRepaints().isEmpty());
+
+    qDeleteAll(shellSurfaces);
+    qDeleteAll(surfaces);
+    for (XdgShellClient *client : qAsConst(clients)) {
+        QVERIFY(Test::waitForWindowDestroyed(client));
+    }
+}
+
+void StackingOrderTest::testRaiseStorm_data()
+{
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("50") << 50;
+    QTest::newRow("200") << 200;
+}
+
+void StackingOrderTest::testRaiseStorm()
+{
+    // This test raises and lowers random windows as fast as possible, e.g. like a
+    // user clicking through the windows or a task switcher does. The result has to be
+    // the same as rebuilding the whole stacking order.
+    QFETCH(int, windows);
+
+    QVector<KWayland::Client::Surface *> surfaces;
+    QVector<KWayland::Client::XdgShellSurface *> shellSurfaces;
+    QVector<XdgShellClient *> clients;
+    QVector<XdgShellClient *> mainWindows;
+    QRandomGenerator random(42);
+    for (int i = 0; i < windows; ++i) {
+        KWayland::Client::Surface *surface = Test::createSurface(Test::waylandCompositor());
+        QVERIFY(surface);
+        KWayland::Client::XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface);
+        QVERIFY(shellSurface);
+        // every fifth window has a dialog
+        const bool dialog = i % 5 == 1;
+        if (dialog) {
+            shellSurface->setTransientFor(shellSurfaces.last());
+        }
+        XdgShellClient *client = Test::renderAndWaitForShown(surface, QSize(random.bounded(50, 400), random.bounded(50, 300)), Qt::blue);
+        QVERIFY(client);
+        QCOMPARE(client->isTransient(), dialog);
+        client->move(QPoint(random.bounded(0, 1000), random.bounded(0, 800)));
+        surfaces << surface;
+        shellSurfaces << shellSurface;
+        clients << client;
+        if (!dialog) {
+            mainWindows << client;
+        }
+    }
+
+    // every single incremental restack has to give the same order as rebuilding it
+    for (int i = 0; i < 200; ++i) {
+        XdgShellClient *client = mainWindows.at(random.bounded(mainWindows.count()));
+        if (random.bounded(4) == 0) {
+            workspace()->lowerClient(client);
+        } else {
+            workspace()->raiseClient(client);
+        }
+        const QList<Toplevel *> incremental = workspace()->stackingOrder();
+        workspace()->forceRestacking();
+        QCOMPARE(workspace()->stackingOrder(), incremental);
+    }
+
+    const int restacks = 1000;
+    QBENCHMARK {
+        for (int i = 0; i < restacks; ++i) {
+            XdgShellClient *client = mainWindows.at(random.bounded(mainWindows.count()));
+            if (random.bounded(4) == 0) {
+                workspace()->lowerClient(client);
+            } else {
+                workspace()->raiseClient(client);
+            }
+        }
+    }
+
+    // the transients are still above their main windows
+    const QList<Toplevel *> stacking = workspace()->stackingOrder();
+    for (XdgShellClient *client : qAsConst(clients)) {
+        if (client->isTransient()) {
+            QVERIFY(stacking.indexOf(client) > stacking.indexOf(client->transientFor()));
+        }
+    }
+    // and rebuilding the stacking order doesn't change anything
+    workspace()->forceRestacking();
+    QCOMPARE(workspace()->stackingOrder(), stacking);
+
+    // transients are closed before their main windows
+    for (int i = clients.count() - 1; i >= 0; --i) {
+        delete shellSurfaces[i];
+        delete surfaces[i];
+        QVERIFY(Test::waitForWindowDestroyed(clients[i]));
+    }
+}
+
 WAYLANDTEST_MAIN(StackingOrderTest)
 #include "stacking_order_test.moc"
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "deleted.h"
 #include "screenedge.h"
 #include "screens.h"
+#include "virtualdesktops.h"
 #include "wayland_server.h"
 #include "workspace.h"
 #include "xdgshellclient.h"
@@ -59,8 +60,12 @@ private Q_SLOTS:
     void test363804();
     void testLeftScreenSmallerBottomAligned();
     void testWindowMoveWithPanelBetweenScreens();
+    void testPanelOnSingleDesktop();
+    void benchmarkUpdateClientArea_data();
+    void benchmarkUpdateClientArea();
 
 private:
+    XdgShellClient *createPanel(const QRect &geometry, QObject *parent);
     KWayland::Client::Compositor *m_compositor = nullptr;
     KWayland::Client::PlasmaShell *m_plasmaShell = nullptr;
 };
@@ -963,5 +968,110 @@ void StrutsTest::testWindowMoveWithPanelBetweenScreens()
 
 }
 
+XdgShellClient *StrutsTest::createPanel(const QRect &geometry, QObject *parent)
+{
+    using namespace KWayland::Client;
+    Surface *surface = Test::createSurface(parent);
+    XdgShellSurface *shellSurface = Test::createXdgShellStableSurface(surface, surface, Test::CreationSetup::CreateOnly);
+    PlasmaShellSurface *plasmaSurface = m_plasmaShell->createSurface(surface, surface);
+    plasmaSurface->setPosition(geometry.topLeft());
+    plasmaSurface->setRole(PlasmaShellSurface::Role::Panel);
+    Test::initXdgShellSurface(surface, shellSurface);
+    return Test::renderAndWaitForShown(surface, geometry.size(), Qt::red, QImage::Format_RGB32);
+}
+
+void StrutsTest::testPanelOnSingleDesktop()
+{
+    // this test verifies that a panel only restricts the areas of the desktops it is on
+    VirtualDesktopManager::self()->setCount(4);
+    QObject surfaces;
+    XdgShellClient *panel = createPanel(QRect(0, 992, 1280, 32), &surfaces);
+    QVERIFY(panel);
+    QVERIFY(panel->hasStrut());
+    panel->setDesktop(2);
+    workspace()->updateClientArea();
+
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 1), QRect(0, 0, 1280, 1024));
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 2), QRect(0, 0, 1280, 992));
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 3), QRect(0, 0, 1280, 1024));
+    QCOMPARE(workspace()->clientArea(WorkArea, 0, 2), QRect(0, 0, 2560, 992));
+    QCOMPARE(workspace()->clientArea(WorkArea, 0, 3), QRect(0, 0, 2560, 1024));
+
+    // the areas of the old desktop have to be restored
+    panel->setDesktop(3);
+    workspace()->updateClientArea();
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 2), QRect(0, 0, 1280, 1024));
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 3), QRect(0, 0, 1280, 992));
+    QCOMPARE(workspace()->restrictedMoveArea(2), QRegion());
+    QCOMPARE(workspace()->restrictedMoveArea(3), QRegion(0, 992, 1280, 32));
+
+    panel->setOnAllDesktops(true);
+    workspace()->updateClientArea();
+    for (uint desktop = 1; desktop <= VirtualDesktopManager::self()->count(); ++desktop) {
+        QCOMPARE(workspace()->clientArea(PlacementArea, 0, desktop), QRect(0, 0, 1280, 992));
+        QCOMPARE(workspace()->clientArea(PlacementArea, 1, desktop), QRect(1280, 0, 1280, 1024));
+    }
+
+    // the areas are computed again when the desktops change
+    VirtualDesktopManager::self()->setCount(6);
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 6), QRect(0, 0, 1280, 992));
+
+    QSignalSpy destroyedSpy(panel, &QObject::destroyed);
+    QVERIFY(destroyedSpy.isValid());
+    qDeleteAll(surfaces.children());
+    QVERIFY(destroyedSpy.wait());
+    QCOMPARE(workspace()->clientArea(PlacementArea, 0, 6), QRect(0, 0, 1280, 1024));
+    VirtualDesktopManager::self()->setCount(1);
+}
+
+void StrutsTest::benchmarkUpdateClientArea_data()
+{
+    QTest::addColumn<bool>("toggle");
+
+    QTest::newRow("unchanged") << false;
+    QTest::newRow("panel toggled") << true;
+}
+
+void StrutsTest::benchmarkUpdateClientArea()
+{
+    // many desktops with a panel on each of them, and a few panels on all desktops
+    const uint desktops = 20;
+    VirtualDesktopManager::self()->setCount(desktops);
+    QObject surfaces;
+    const QVector<QRect> sharedPanels = {
+        QRect(0, 0, 1280, 24),
+        QRect(1280, 0, 1280, 24),
+        QRect(1280, 992, 1280, 32),
+    };
+    for (const QRect &geometry : sharedPanels) {
+        XdgShellClient *panel = createPanel(geometry, &surfaces);
+        QVERIFY(panel);
+        panel->setOnAllDesktops(true);
+    }
+    XdgShellClient *togglingPanel = nullptr;
+    for (uint desktop = 1; desktop <= desktops; ++desktop) {
+        XdgShellClient *panel = createPanel(QRect(0, 992, 1280, 32), &surfaces);
+        QVERIFY(panel);
+        panel->setDesktop(desktop);
+        if (desktop == desktops / 2) {
+            togglingPanel = panel;
+        }
+    }
+    workspace()->updateClientArea();
+
+    // an auto hiding panel on one of the desktops shows and hides again
+    QFETCH(bool, toggle);
+    QBENCHMARK {
+        if (toggle) {
+            togglingPanel->setDesktop(togglingPanel->desktop() == 1 ? desktops / 2 : 1);
+        }
+        workspace()->updateClientArea();
+    }
+
+    qDeleteAll(surfaces.children());
+    QTRY_VERIFY(waylandServer()->clients().isEmpty());
+    VirtualDesktopManager::self()->setCount(1);
+}
+
 WAYLANDTEST_MAIN(KWin::StrutsTest)
 #include "struts_test.moc"
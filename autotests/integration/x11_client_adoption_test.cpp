@@ -0,0 +1,271 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwin_wayland_test.h"
+#include "atoms.h"
+#include "main.h"
+#include "platform.h"
+#include "unmanaged.h"
+#include "wayland_server.h"
+#include "workspace.h"
+#include "x11client.h"
+#include "xcbutils.h"
+
+#include <netwm.h>
+#include <xcb/xcb_icccm.h>
+
+using namespace KWin;
+
+static const QString s_socketName = QStringLiteral("wayland_test_kwin_x11_client_adoption-0");
+
+struct XcbConnectionDeleter
+{
+    static inline void cleanup(xcb_connection_t *pointer)
+    {
+        xcb_disconnect(pointer);
+    }
+};
+
+/**
+ * Creates X11 windows which are mapped but not managed, like the windows which exist when KWin
+ * starts, and lets the Workspace adopt them.
+ */
+class X11ClientAdoptionTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void testAdoption();
+    void testCrashRestartOffset();
+    void testPropertyChangesSelected();
+    void benchmarkAdoption_data();
+    void benchmarkAdoption();
+
+private:
+    QVector<xcb_window_t> createExistingWindows(const QVector<QRect> &geometries);
+    void sync();
+
+    QScopedPointer<xcb_connection_t, XcbConnectionDeleter> m_connection;
+    QVector<xcb_window_t> m_windows;
+};
+
+void X11ClientAdoptionTest::initTestCase()
+{
+    qRegisterMetaType<KWin::AbstractClient *>();
+    qRegisterMetaType<KWin::Unmanaged *>();
+    QSignalSpy workspaceCreatedSpy(kwinApp(), &Application::workspaceCreated);
+    QVERIFY(workspaceCreatedSpy.isValid());
+    kwinApp()->platform()->setInitialWindowSize(QSize(1280, 1024));
+    QVERIFY(waylandServer()->init(s_socketName.toLocal8Bit()));
+    kwinApp()->setConfig(KSharedConfig::openConfig(QString(), KConfig::SimpleConfig));
+
+    kwinApp()->start();
+    QVERIFY(workspaceCreatedSpy.wait());
+    waylandServer()->initWorkspace();
+}
+
+void X11ClientAdoptionTest::init()
+{
+    m_connection.reset(xcb_connect(nullptr, nullptr));
+    QVERIFY(!xcb_connection_has_error(m_connection.data()));
+}
+
+void X11ClientAdoptionTest::cleanup()
+{
+    for (xcb_window_t window : qAsConst(m_windows)) {
+        xcb_destroy_window(m_connection.data(), window);
+    }
+    xcb_flush(m_connection.data());
+    const QVector<xcb_window_t> windows = m_windows;
+    QTRY_VERIFY(std::none_of(windows.constBegin(), windows.constEnd(), [](xcb_window_t window) {
+        return workspace()->findClient(Predicate::WindowMatch, window);
+    }));
+    m_windows.clear();
+    m_connection.reset();
+    Application::setCrashCount(0);
+}
+
+void X11ClientAdoptionTest::sync()
+{
+    free(xcb_get_input_focus_reply(m_connection.data(), xcb_get_input_focus(m_connection.data()), nullptr));
+}
+
+QVector<xcb_window_t> X11ClientAdoptionTest::createExistingWindows(const QVector<QRect> &geometries)
+{
+    // The windows are mapped as override redirect windows, so that KWin doesn't manage them,
+    // and are turned into normal windows afterwards. Releasing the Unmanaged leaves them behind
+    // like a previous window manager would do it.
+    xcb_connection_t *c = m_connection.data();
+    QVector<xcb_window_t> windows;
+    const uint32_t overrideRedirect[] = { true };
+    for (const QRect &geometry : geometries) {
+        const xcb_window_t window = xcb_generate_id(c);
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, window, rootWindow(),
+                          geometry.x(), geometry.y(), geometry.width(), geometry.height(),
+                          0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT,
+                          XCB_CW_OVERRIDE_REDIRECT, overrideRedirect);
+        xcb_size_hints_t hints;
+        memset(&hints, 0, sizeof(hints));
+        xcb_icccm_size_hints_set_position(&hints, 1, geometry.x(), geometry.y());
+        xcb_icccm_size_hints_set_size(&hints, 1, geometry.width(), geometry.height());
+        xcb_icccm_set_wm_normal_hints(c, window, &hints);
+        static const char wmClass[] = "adoption-test\0adoption-test";
+        xcb_icccm_set_wm_class(c, window, sizeof(wmClass), wmClass);
+        xcb_map_window(c, window);
+        windows << window;
+        m_windows << window;
+    }
+    xcb_flush(c);
+
+    const bool known = QTest::qWaitFor([&windows] {
+        return std::all_of(windows.constBegin(), windows.constEnd(), [](xcb_window_t window) {
+            return workspace()->findUnmanaged(window);
+        });
+    }, 10000);
+    if (!known) {
+        return {};
+    }
+
+    const uint32_t noOverrideRedirect[] = { false };
+    for (xcb_window_t window : qAsConst(windows)) {
+        xcb_change_window_attributes(c, window, XCB_CW_OVERRIDE_REDIRECT, noOverrideRedirect);
+    }
+    sync();
+    for (xcb_window_t window : qAsConst(windows)) {
+        workspace()->findUnmanaged(window)->release();
+    }
+    return windows;
+}
+
+void X11ClientAdoptionTest::testAdoption()
+{
+    const QVector<xcb_window_t> windows = createExistingWindows({QRect(100, 100, 300, 200), QRect(150, 150, 200, 100)});
+    QCOMPARE(windows.count(), 2);
+    xcb_connection_t *c = m_connection.data();
+    NETWinInfo leaderInfo(c, windows[0], rootWindow(), NET::Properties(), NET::Properties2());
+    leaderInfo.setName("Leader");
+    NETWinInfo dialogInfo(c, windows[1], rootWindow(), NET::Properties(), NET::Properties2());
+    dialogInfo.setName("Dialog");
+    xcb_icccm_set_wm_transient_for(c, windows[1], windows[0]);
+    static const QByteArray serviceName = QByteArrayLiteral("org.kde.test");
+    xcb_change_property(c, XCB_PROP_MODE_REPLACE, windows[1], atoms->kde_net_wm_appmenu_service_name,
+                        XCB_ATOM_STRING, 8, serviceName.length(), serviceName.constData());
+    sync();
+
+    workspace()->manageExistingX11Windows();
+
+    X11Client *leader = workspace()->findClient(Predicate::WindowMatch, windows[0]);
+    QVERIFY(leader);
+    X11Client *dialog = workspace()->findClient(Predicate::WindowMatch, windows[1]);
+    QVERIFY(dialog);
+    QCOMPARE(leader->resourceClass(), QByteArrayLiteral("adoption-test"));
+    QCOMPARE(leader->caption(), QStringLiteral("Leader"));
+    QCOMPARE(leader->clientSize(), QSize(300, 200));
+    QCOMPARE(dialog->caption(), QStringLiteral("Dialog"));
+    QCOMPARE(dialog->clientSize(), QSize(200, 100));
+    QCOMPARE(dialog->transientFor(), leader);
+    QCOMPARE(dialog->applicationMenuServiceName(), QString::fromLatin1(serviceName));
+    QVERIFY(leader->isShown(true));
+    QVERIFY(dialog->isShown(true));
+
+    // adopting again doesn't manage the windows twice
+    workspace()->manageExistingX11Windows();
+    QCOMPARE(workspace()->findClient(Predicate::WindowMatch, windows[0]), leader);
+
+    // the property changes after the adoption are noticed
+    QSignalSpy captionChangedSpy(leader, &AbstractClient::captionChanged);
+    QVERIFY(captionChangedSpy.isValid());
+    leaderInfo.setName("Renamed");
+    xcb_flush(c);
+    QVERIFY(captionChangedSpy.wait());
+    QCOMPARE(leader->caption(), QStringLiteral("Renamed"));
+}
+
+void X11ClientAdoptionTest::testCrashRestartOffset()
+{
+    // After a crash the windows are still at the position of the frame, fixPositionAfterCrash()
+    // moves them back by the frame extents. The moved window has to end up exactly where the
+    // window created at the fixed position does.
+    const QVector<xcb_window_t> windows = createExistingWindows({QRect(300, 400, 200, 100), QRect(290, 380, 200, 100)});
+    QCOMPARE(windows.count(), 2);
+    const uint32_t extents[] = { 10, 10, 20, 5 };
+    xcb_change_property(m_connection.data(), XCB_PROP_MODE_REPLACE, windows[0], atoms->net_frame_extents,
+                        XCB_ATOM_CARDINAL, 32, 4, extents);
+    sync();
+
+    Application::setCrashCount(1);
+    workspace()->manageExistingX11Windows();
+    Application::setCrashCount(0);
+
+    X11Client *moved = workspace()->findClient(Predicate::WindowMatch, windows[0]);
+    QVERIFY(moved);
+    X11Client *reference = workspace()->findClient(Predicate::WindowMatch, windows[1]);
+    QVERIFY(reference);
+    QCOMPARE(moved->frameGeometry(), reference->frameGeometry());
+    QCOMPARE(moved->bufferGeometry(), reference->bufferGeometry());
+}
+
+void X11ClientAdoptionTest::testPropertyChangesSelected()
+{
+    // the property changes are selected before the properties are requested, otherwise a change
+    // until embedClient() selects the events of the client would get lost
+    const QVector<xcb_window_t> windows = createExistingWindows({QRect(0, 0, 100, 100)});
+    QCOMPARE(windows.count(), 1);
+
+    Xcb::WindowAttributes before(windows[0]);
+    QVERIFY(!before.isNull());
+    QVERIFY(!(before->your_event_mask & XCB_EVENT_MASK_PROPERTY_CHANGE));
+
+    X11ManageRequests requests(windows[0]);
+    Xcb::WindowAttributes after(windows[0]);
+    QVERIFY(!after.isNull());
+    QVERIFY(after->your_event_mask & XCB_EVENT_MASK_PROPERTY_CHANGE);
+    QVERIFY(!requests.wmClientLeader.isNull());
+}
+
+void X11ClientAdoptionTest::benchmarkAdoption_data()
+{
+    QTest::addColumn<int>("windows");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("50") << 50;
+}
+
+void X11ClientAdoptionTest::benchmarkAdoption()
+{
+    QFETCH(int, windows);
+    QVector<QRect> geometries;
+    for (int i = 0; i < windows; ++i) {
+        geometries << QRect(i * 10, i * 10, 200 + i, 100 + i);
+    }
+    const QVector<xcb_window_t> existing = createExistingWindows(geometries);
+    QCOMPARE(existing.count(), windows);
+
+    QBENCHMARK_ONCE {
+        workspace()->manageExistingX11Windows();
+    }
+    for (xcb_window_t window : existing) {
+        QVERIFY(workspace()->findClient(Predicate::WindowMatch, window));
+    }
+}
+
+WAYLANDTEST_MAIN(X11ClientAdoptionTest)
+#include "x11_client_adoption_test.moc"
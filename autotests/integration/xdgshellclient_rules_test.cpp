@@ -220,6 +220,11 @@ private Q_SLOTS:
     void testInactiveOpacityForceTemporarily();
 
     void testMatchAfterNameChange();
+    void testLargeRuleBook();
+    void testQRegExpSyntax_data();
+    void testQRegExpSyntax();
+    void benchmarkFind_data();
+    void benchmarkFind();
 };
 
 void TestXdgShellClientRules::initTestCase()
@@ -4540,5 +4545,150 @@ void TestXdgShellClientRules::testMatchAfterNameChange()
     QCOMPARE(c->keepAbove(), true);
 }
 
+static KSharedConfig::Ptr largeRuleBook(int count)
+{
+    // a rule book as it grows over the years: mostly rules for single applications,
+    // some of them matching the window class or the title with regular expressions
+    KSharedConfig::Ptr config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    config->group("General").writeEntry("count", count);
+    for (int i = 1; i <= count; ++i) {
+        KConfigGroup group = config->group(QString::number(i));
+        group.writeEntry("wmclasscomplete", false);
+        if (i % 10 == 0) {
+            group.writeEntry("wmclass", QStringLiteral("^org\\.kde\\.tool%1(-.*)?$").arg(i));
+            group.writeEntry("wmclassmatch", int(Rules::RegExpMatch));
+        } else {
+            group.writeEntry("wmclass", QStringLiteral("org.kde.app%1").arg(i));
+            group.writeEntry("wmclassmatch", int(Rules::ExactMatch));
+        }
+        if (i % 3 == 0) {
+            group.writeEntry("title", QStringLiteral("^Document %1 - .*$").arg(i));
+            group.writeEntry("titlematch", int(Rules::RegExpMatch));
+        }
+        group.writeEntry("desktop", 2);
+        group.writeEntry("desktoprule", int(Rules::Apply));
+    }
+    return config;
+}
+
+void TestXdgShellClientRules::testLargeRuleBook()
+{
+    // rules which are skipped through the window class index must not change which rules apply
+    KSharedConfig::Ptr config = largeRuleBook(500);
+    KConfigGroup regExpRule = config->group("100");
+    regExpRule.writeEntry("wmclass", "^org\\.kde\\.app25.$");
+    regExpRule.writeEntry("skiptaskbar", true);
+    regExpRule.writeEntry("skiptaskbarrule", int(Rules::Force));
+    KConfigGroup exactRule = config->group("251");
+    exactRule.writeEntry("above", true);
+    exactRule.writeEntry("aboverule", int(Rules::Force));
+    KConfigGroup lowerPriorityRule = config->group("400");
+    lowerPriorityRule.writeEntry("wmclass", "org.kde.app251");
+    lowerPriorityRule.writeEntry("wmclassmatch", int(Rules::ExactMatch));
+    lowerPriorityRule.writeEntry("skiptaskbar", false);
+    lowerPriorityRule.writeEntry("skiptaskbarrule", int(Rules::Force));
+    config->sync();
+    RuleBook::self()->setConfig(config);
+    workspace()->slotReconfigure();
+
+    XdgShellClient *client;
+    Surface *surface;
+    XdgShellSurface *shellSurface;
+    std::tie(client, surface, shellSurface) = createWindow(Test::XdgShellSurfaceType::XdgShellStable, "org.kde.app251");
+    QVERIFY(client);
+    QVERIFY(client->keepAbove());
+    QVERIFY(client->skipTaskbar());
+
+    // a window no rule has been written for
+    XdgShellClient *otherClient;
+    Surface *otherSurface;
+    XdgShellSurface *otherShellSurface;
+    std::tie(otherClient, otherSurface, otherShellSurface) = createWindow(Test::XdgShellSurfaceType::XdgShellStable, "org.kde.unknown");
+    QVERIFY(otherClient);
+    QVERIFY(!otherClient->keepAbove());
+    QVERIFY(!otherClient->skipTaskbar());
+
+    delete otherShellSurface;
+    delete otherSurface;
+    QVERIFY(Test::waitForWindowDestroyed(otherClient));
+    delete shellSurface;
+    delete surface;
+    QVERIFY(Test::waitForWindowDestroyed(client));
+}
+
+void TestXdgShellClientRules::testQRegExpSyntax_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QByteArray>("appId");
+    QTest::addColumn<bool>("matches");
+
+    QTest::newRow("hex escape") << QStringLiteral("^org\\.kde\\.\\x0061pp$") << QByteArrayLiteral("org.kde.app") << true;
+    QTest::newRow("octal escape") << QStringLiteral("^org\\.kde\\.\\0141pp$") << QByteArrayLiteral("org.kde.app") << true;
+    QTest::newRow("unicode word") << QStringLiteral("^org\\.kde\\.\\wpp$") << QByteArrayLiteral("org.kde.\xc3\xa4pp") << true;
+    QTest::newRow("dollar in class") << QStringLiteral("^org\\.kde\\.app[$]$") << QByteArrayLiteral("org.kde.app$") << true;
+    QTest::newRow("hex escape mismatch") << QStringLiteral("^org\\.kde\\.\\x0062pp$") << QByteArrayLiteral("org.kde.app") << false;
+    QTest::newRow("invalid") << QStringLiteral("^org\\.kde\\.app(") << QByteArrayLiteral("org.kde.app") << false;
+}
+
+void TestXdgShellClientRules::testQRegExpSyntax()
+{
+    // the patterns of existing rules were written for QRegExp
+    QFETCH(QString, pattern);
+    auto config = KSharedConfig::openConfig(QString(), KConfig::SimpleConfig);
+    config->group("General").writeEntry("count", 1);
+    KConfigGroup group = config->group("1");
+    group.writeEntry("wmclass", pattern);
+    group.writeEntry("wmclassmatch", int(Rules::RegExpMatch));
+    group.writeEntry("wmclasscomplete", false);
+    group.writeEntry("above", true);
+    group.writeEntry("aboverule", int(Rules::Force));
+    group.sync();
+    RuleBook::self()->setConfig(config);
+    workspace()->slotReconfigure();
+
+    QFETCH(QByteArray, appId);
+    XdgShellClient *client;
+    Surface *surface;
+    XdgShellSurface *shellSurface;
+    std::tie(client, surface, shellSurface) = createWindow(Test::XdgShellSurfaceType::XdgShellStable, appId);
+    QVERIFY(client);
+    QTEST(client->keepAbove(), "matches");
+
+    delete shellSurface;
+    delete surface;
+    QVERIFY(Test::waitForWindowDestroyed(client));
+}
+
+void TestXdgShellClientRules::benchmarkFind_data()
+{
+    QTest::addColumn<QByteArray>("appId");
+
+    QTest::newRow("exact") << QByteArrayLiteral("org.kde.app251");
+    QTest::newRow("regexp") << QByteArrayLiteral("org.kde.tool250-viewer");
+    QTest::newRow("no rule") << QByteArrayLiteral("org.kde.unknown");
+}
+
+void TestXdgShellClientRules::benchmarkFind()
+{
+    // RuleBook::find is invoked whenever a window gets mapped or changes its title
+    RuleBook::self()->setConfig(largeRuleBook(500));
+    workspace()->slotReconfigure();
+
+    QFETCH(QByteArray, appId);
+    XdgShellClient *client;
+    Surface *surface;
+    XdgShellSurface *shellSurface;
+    std::tie(client, surface, shellSurface) = createWindow(Test::XdgShellSurfaceType::XdgShellStable, appId);
+    QVERIFY(client);
+
+    QBENCHMARK {
+        RuleBook::self()->find(client, false);
+    }
+
+    delete shellSurface;
+    delete surface;
+    QVERIFY(Test::waitForWindowDestroyed(client));
+}
+
 WAYLANDTEST_MAIN(TestXdgShellClientRules)
 #include "xdgshellclient_rules_test.moc"
@@ -43,8 +43,13 @@ private Q_SLOTS:
     void cleanup();
     void testSync_data();
     void testSync();
+    void testLargeTransfer_data();
+    void testLargeTransfer();
 
 private:
+    void copyAndPaste(const QString &copyPlatform, const QString &pastePlatform,
+                      const QStringList &arguments, int timeout);
+
     QProcess *m_copyProcess = nullptr;
     QProcess *m_pasteProcess = nullptr;
 };
@@ -106,6 +111,38 @@ void XwaylandSelectionsTest::testSync_data()
 void XwaylandSelectionsTest::testSync()
 {
     // this test verifies the syncing of X11 to Wayland clipboard
+    QFETCH(QString, copyPlatform);
+    QFETCH(QString, pastePlatform);
+    copyAndPaste(copyPlatform, pastePlatform, QStringList(), 5000);
+}
+
+void XwaylandSelectionsTest::testLargeTransfer_data()
+{
+    QTest::addColumn<QString>("copyPlatform");
+    QTest::addColumn<QString>("pastePlatform");
+
+    QTest::newRow("x11->wayland") << QStringLiteral("xcb") << QStringLiteral("wayland");
+    QTest::newRow("wayland->x11") << QStringLiteral("wayland") << QStringLiteral("xcb");
+}
+
+void XwaylandSelectionsTest::testLargeTransfer()
+{
+    // this test moves a payload through the clipboard which needs several INCR chunks of the
+    // largest size, the paste helper verifies the content. For measuring the throughput, e.g.
+    // of 200 MiB, the size in MiB can be passed in KWIN_TEST_SELECTION_SIZE.
+    QFETCH(QString, copyPlatform);
+    QFETCH(QString, pastePlatform);
+    bool ok = false;
+    int megabytes = qEnvironmentVariableIntValue("KWIN_TEST_SELECTION_SIZE", &ok);
+    if (!ok || megabytes <= 0) {
+        megabytes = 16;
+    }
+    copyAndPaste(copyPlatform, pastePlatform, QStringList{QString::number(megabytes * 1024 * 1024)}, 60000);
+}
+
+void XwaylandSelectionsTest::copyAndPaste(const QString &copyPlatform, const QString &pastePlatform,
+                                          const QStringList &arguments, int timeout)
+{
     const QString copy = QFINDTESTDATA(QStringLiteral("copy"));
     QVERIFY(!copy.isEmpty());
     const QString paste = QFINDTESTDATA(QStringLiteral("paste"));
@@ -121,13 +158,13 @@ void XwaylandSelectionsTest::testSync()
     QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
 
     // start the copy process
-    QFETCH(QString, copyPlatform);
     environment.insert(QStringLiteral("QT_QPA_PLATFORM"), copyPlatform);
     environment.insert(QStringLiteral("WAYLAND_DISPLAY"), s_socketName);
     m_copyProcess = new QProcess();
     m_copyProcess->setProcessEnvironment(environment);
     m_copyProcess->setProcessChannelMode(QProcess::ForwardedChannels);
     m_copyProcess->setProgram(copy);
+    m_copyProcess->setArguments(arguments);
     m_copyProcess->start();
     QVERIFY(m_copyProcess->waitForStarted());
 
@@ -158,11 +195,11 @@ void XwaylandSelectionsTest::testSync()
     m_pasteProcess = new QProcess();
     QSignalSpy finishedSpy(m_pasteProcess, static_cast<void(QProcess::*)(int,QProcess::ExitStatus)>(&QProcess::finished));
     QVERIFY(finishedSpy.isValid());
-    QFETCH(QString, pastePlatform);
     environment.insert(QStringLiteral("QT_QPA_PLATFORM"), pastePlatform);
     m_pasteProcess->setProcessEnvironment(environment);
     m_pasteProcess->setProcessChannelMode(QProcess::ForwardedChannels);
     m_pasteProcess->setProgram(paste);
+    m_pasteProcess->setArguments(arguments);
     m_pasteProcess->start();
     QVERIFY(m_pasteProcess->waitForStarted());
 
@@ -185,7 +222,7 @@ void XwaylandSelectionsTest::testSync()
         QVERIFY(clientActivatedSpy.wait());
     }
     QTRY_COMPARE(workspace()->activeClient(), pasteClient);
-    QVERIFY(finishedSpy.wait());
+    QVERIFY(finishedSpy.wait(timeout));
     QCOMPARE(finishedSpy.first().first().toInt(), 0);
     delete m_pasteProcess;
     m_pasteProcess = nullptr;
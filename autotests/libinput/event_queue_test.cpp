@@ -0,0 +1,368 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "mock_libinput.h"
+#include "../../libinput/device.h"
+#include "../../libinput/eventqueue.h"
+#include "../../libinput/events.h"
+
+#include <QtTest>
+
+#include <thread>
+
+using namespace KWin::LibInput;
+
+static quint32 timeOf(Event *event)
+{
+    return static_cast<PointerEvent*>(event)->time();
+}
+
+class TestLibinputEventQueue : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testCapacity_data();
+    void testCapacity();
+    void testOrder();
+    void testFull();
+    void testWrapAround();
+    void testFillStopsWhenFull();
+    void testTouchMotionCoalescing();
+    void testTouchMotionNotCoalesced();
+    void benchmarkThroughput_data();
+    void benchmarkThroughput();
+
+private:
+    Event *createMotion(quint32 time);
+    Event *createTouch(libinput_event_type type, libinput_device *device, qint32 slot, quint32 time);
+
+    libinput_device *m_nativeDevice = nullptr;
+    Device *m_device = nullptr;
+    libinput_device *m_nativeTouchDevice = nullptr;
+    Device *m_touchDevice = nullptr;
+};
+
+void TestLibinputEventQueue::init()
+{
+    m_nativeDevice = new libinput_device;
+    m_nativeDevice->pointer = true;
+    m_device = new Device(m_nativeDevice);
+    m_nativeTouchDevice = new libinput_device;
+    m_nativeTouchDevice->touch = true;
+    m_touchDevice = new Device(m_nativeTouchDevice);
+}
+
+void TestLibinputEventQueue::cleanup()
+{
+    delete m_device;
+    m_device = nullptr;
+
+    delete m_nativeDevice;
+    m_nativeDevice = nullptr;
+
+    delete m_touchDevice;
+    m_touchDevice = nullptr;
+
+    delete m_nativeTouchDevice;
+    m_nativeTouchDevice = nullptr;
+}
+
+Event *TestLibinputEventQueue::createMotion(quint32 time)
+{
+    libinput_event_pointer *pointerEvent = new libinput_event_pointer;
+    pointerEvent->type = LIBINPUT_EVENT_POINTER_MOTION;
+    pointerEvent->device = m_nativeDevice;
+    pointerEvent->time = time;
+    pointerEvent->delta = QSizeF(1, 1);
+    return Event::create(pointerEvent);
+}
+
+Event *TestLibinputEventQueue::createTouch(libinput_event_type type, libinput_device *device, qint32 slot, quint32 time)
+{
+    libinput_event_touch *touchEvent = new libinput_event_touch;
+    touchEvent->type = type;
+    touchEvent->device = device;
+    touchEvent->slot = slot;
+    touchEvent->time = time;
+    return Event::create(touchEvent);
+}
+
+void TestLibinputEventQueue::testCapacity_data()
+{
+    QTest::addColumn<int>("capacity");
+    QTest::addColumn<int>("expected");
+
+    QTest::newRow("1") << 1 << 1;
+    QTest::newRow("2") << 2 << 2;
+    QTest::newRow("100") << 100 << 128;
+    QTest::newRow("4096") << 4096 << 4096;
+}
+
+void TestLibinputEventQueue::testCapacity()
+{
+    QFETCH(int, capacity);
+    EventQueue queue(capacity);
+    QTEST(queue.capacity(), "expected");
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.isFull());
+    QCOMPARE(queue.count(), 0);
+}
+
+void TestLibinputEventQueue::testOrder()
+{
+    EventQueue queue(8);
+    QVERIFY(!queue.peek());
+    QVERIFY(!queue.pop());
+
+    for (quint32 i = 1; i <= 5; ++i) {
+        QVERIFY(queue.push(createMotion(i)));
+    }
+    QCOMPARE(queue.count(), 5);
+
+    // peeking doesn't take the events
+    QCOMPARE(timeOf(queue.peek()), 1u);
+    QCOMPARE(timeOf(queue.peek(4)), 5u);
+    QVERIFY(!queue.peek(5));
+    QCOMPARE(queue.count(), 5);
+
+    for (quint32 i = 1; i <= 5; ++i) {
+        QScopedPointer<Event> event(queue.pop());
+        QVERIFY(event);
+        QCOMPARE(timeOf(event.data()), i);
+        QCOMPARE(event->type(), LIBINPUT_EVENT_POINTER_MOTION);
+        QCOMPARE(event->device(), m_device);
+    }
+    QVERIFY(queue.isEmpty());
+    QVERIFY(!queue.pop());
+}
+
+void TestLibinputEventQueue::testFull()
+{
+    EventQueue queue(4);
+    for (quint32 i = 0; i < 4; ++i) {
+        QVERIFY(!queue.isFull());
+        QVERIFY(queue.push(createMotion(i)));
+    }
+    QVERIFY(queue.isFull());
+
+    // a rejected event stays with the caller
+    QScopedPointer<Event> rejected(createMotion(4));
+    QVERIFY(!queue.push(rejected.data()));
+    QCOMPARE(queue.count(), 4);
+
+    // taking one makes room for one again
+    delete queue.pop();
+    QVERIFY(!queue.isFull());
+    QVERIFY(queue.push(rejected.take()));
+    QVERIFY(queue.isFull());
+    QCOMPARE(timeOf(queue.peek(3)), 4u);
+    // the remaining events get deleted together with the queue
+}
+
+void TestLibinputEventQueue::testWrapAround()
+{
+    // push and pop many more events than fit, the slots get reused
+    EventQueue queue(4);
+    quint32 pushed = 0;
+    quint32 popped = 0;
+    while (popped < 1000) {
+        while (!queue.isFull()) {
+            QVERIFY(queue.push(createMotion(pushed++)));
+        }
+        for (int i = 0; i < 3; ++i) {
+            QScopedPointer<Event> event(queue.pop());
+            QCOMPARE(timeOf(event.data()), popped++);
+        }
+    }
+    QCOMPARE(queue.count(), int(pushed - popped));
+}
+
+void TestLibinputEventQueue::testFillStopsWhenFull()
+{
+    // a burst larger than the queue: reading pauses while it is full and resumes
+    // once the consumer made room, without losing or reordering events
+    EventQueue queue(4);
+    const quint32 count = 10;
+    quint32 read = 0;
+    auto next = [this, &read, count]() -> Event * {
+        if (read == count) {
+            return nullptr;
+        }
+        return createMotion(read++);
+    };
+
+    QCOMPARE(queue.fill(next), 4);
+    QVERIFY(queue.isFull());
+    // the remaining events are not taken from the source
+    QCOMPARE(read, 4u);
+    QCOMPARE(queue.fill(next), 0);
+    QCOMPARE(read, 4u);
+
+    quint32 popped = 0;
+    while (popped < count) {
+        for (int i = 0; i < 3; ++i) {
+            QScopedPointer<Event> event(queue.pop());
+            if (!event) {
+                break;
+            }
+            QCOMPARE(timeOf(event.data()), popped++);
+        }
+        queue.fill(next);
+        // refilled as far as the source has events left
+        QCOMPARE(queue.count(), qMin(queue.capacity(), int(count - popped)));
+    }
+    QCOMPARE(read, count);
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.fill(next), 0);
+    QVERIFY(!queue.isFull());
+}
+
+void TestLibinputEventQueue::testTouchMotionCoalescing()
+{
+    // a two finger gesture: each frame contains a motion of both touch points
+    EventQueue queue(32);
+    for (quint32 time = 1; time <= 3; ++time) {
+        if (time > 1) {
+            QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, time)));
+        }
+        QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 1, time)));
+        QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, m_nativeTouchDevice, -1, time)));
+    }
+    // the next frame is not complete yet
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, 4)));
+
+    std::vector<TouchEvent *> motions;
+    QCOMPARE(queue.takeTouchMotions(static_cast<TouchEvent*>(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, 1)), motions), 4);
+    QCOMPARE(int(motions.size()), 2);
+    QCOMPARE(motions[0]->type(), LIBINPUT_EVENT_TOUCH_MOTION);
+    QCOMPARE(motions[0]->id(), 0);
+    QCOMPARE(motions[0]->time(), 3u);
+    QCOMPARE(motions[0]->device(), m_touchDevice);
+    QCOMPARE(motions[1]->type(), LIBINPUT_EVENT_TOUCH_MOTION);
+    QCOMPARE(motions[1]->id(), 1);
+    QCOMPARE(motions[1]->time(), 3u);
+    qDeleteAll(motions);
+
+    // the frame closing the coalesced motions and the incomplete frame stay
+    QCOMPARE(queue.count(), 2);
+    QScopedPointer<TouchEvent> frame(static_cast<TouchEvent*>(queue.pop()));
+    QCOMPARE(frame->type(), LIBINPUT_EVENT_TOUCH_FRAME);
+    QCOMPARE(frame->time(), 3u);
+    QScopedPointer<TouchEvent> next(static_cast<TouchEvent*>(queue.pop()));
+    QCOMPARE(next->type(), LIBINPUT_EVENT_TOUCH_MOTION);
+    QCOMPARE(next->time(), 4u);
+
+    // nothing more queued, the motion is kept
+    QCOMPARE(queue.takeTouchMotions(static_cast<TouchEvent*>(next.take()), motions), 0);
+    QCOMPARE(int(motions.size()), 1);
+    QCOMPARE(motions[0]->time(), 4u);
+    qDeleteAll(motions);
+}
+
+void TestLibinputEventQueue::testTouchMotionNotCoalesced()
+{
+    libinput_device nativeOtherDevice;
+    nativeOtherDevice.touch = true;
+    Device otherDevice(&nativeOtherDevice);
+    std::vector<TouchEvent *> motions;
+
+    // the motions of a single frame are all delivered
+    EventQueue queue(32);
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 1, 1)));
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, m_nativeTouchDevice, -1, 1)));
+    QCOMPARE(queue.takeTouchMotions(static_cast<TouchEvent*>(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, 1)), motions), 0);
+    QCOMPARE(int(motions.size()), 2);
+    QCOMPARE(motions[0]->id(), 0);
+    QCOMPARE(motions[1]->id(), 1);
+    qDeleteAll(motions);
+    QCOMPARE(queue.count(), 1);
+    delete queue.pop();
+
+    // a frame with another event ends the coalescing
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, m_nativeTouchDevice, -1, 1)));
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_UP, m_nativeTouchDevice, 0, 2)));
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, m_nativeTouchDevice, -1, 2)));
+    QCOMPARE(queue.takeTouchMotions(static_cast<TouchEvent*>(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, 1)), motions), 0);
+    QCOMPARE(int(motions.size()), 1);
+    QCOMPARE(motions[0]->time(), 1u);
+    qDeleteAll(motions);
+    QCOMPARE(queue.count(), 3);
+    delete queue.pop();
+    delete queue.pop();
+    delete queue.pop();
+
+    // as do the events of another device
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, &nativeOtherDevice, -1, 3)));
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, &nativeOtherDevice, 0, 4)));
+    QVERIFY(queue.push(createTouch(LIBINPUT_EVENT_TOUCH_FRAME, &nativeOtherDevice, -1, 4)));
+    QCOMPARE(queue.takeTouchMotions(static_cast<TouchEvent*>(createTouch(LIBINPUT_EVENT_TOUCH_MOTION, m_nativeTouchDevice, 0, 2)), motions), 0);
+    QCOMPARE(int(motions.size()), 1);
+    QCOMPARE(motions[0]->device(), m_touchDevice);
+    qDeleteAll(motions);
+    QCOMPARE(queue.count(), 3);
+}
+
+void TestLibinputEventQueue::benchmarkThroughput_data()
+{
+    QTest::addColumn<int>("capacity");
+
+    QTest::newRow("64") << 64;
+    QTest::newRow("4096") << 4096;
+}
+
+void TestLibinputEventQueue::benchmarkThroughput()
+{
+    // a libinput thread reading a flood of events, e.g. from a 1000 Hz mouse, and the main
+    // thread processing them as fast as it can
+    QFETCH(int, capacity);
+    const quint32 count = 100000;
+
+    QBENCHMARK {
+        EventQueue queue(capacity);
+        std::thread producer([this, &queue, count] {
+            for (quint32 i = 0; i < count; ++i) {
+                Event *event = createMotion(i);
+                while (!queue.push(event)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        quint32 expected = 0;
+        bool ordered = true;
+        while (expected < count) {
+            Event *event = queue.pop();
+            if (!event) {
+                std::this_thread::yield();
+                continue;
+            }
+            ordered = ordered && timeOf(event) == expected;
+            expected++;
+            delete event;
+        }
+        producer.join();
+        QVERIFY(ordered);
+        QVERIFY(queue.isEmpty());
+    }
+}
+
+QTEST_GUILESS_MAIN(TestLibinputEventQueue)
+#include "event_queue_test.moc"
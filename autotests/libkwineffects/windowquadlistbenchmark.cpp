@@ -0,0 +1,181 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include <kwineffects.h>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QTest>
+
+#include <vector>
+
+#ifndef GL_TRIANGLES
+#  define GL_TRIANGLES      0x0004
+#endif
+
+/**
+ * Measures how many quads per second can be generated and uploaded by effects which
+ * deform windows, e.g. wobbly windows or magic lamp. Every frame they split the window
+ * into a grid and the scene converts the grid into a vertex array.
+ */
+class WindowQuadListBenchmark : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void benchmarkMakeGrid_data();
+    void benchmarkMakeGrid();
+    void benchmarkMakeInterleavedArrays_data();
+    void benchmarkMakeInterleavedArrays();
+    void benchmarkGridAndInterleave_data();
+    void benchmarkGridAndInterleave();
+
+private:
+    void addData();
+    KWin::WindowQuadList makeWindow(const QSize &size) const;
+};
+
+/**
+ * Runs @p work, which returns the number of quads it processed, for at least 100 ms outside
+ * of QBENCHMARK, so that the calibration runs don't distort the rate, and reports it.
+ */
+template <typename Work>
+static void reportQuadsPerSecond(Work work)
+{
+    qint64 quads = 0;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        quads += work();
+    } while (timer.nsecsElapsed() < 100 * 1000 * 1000);
+    qInfo("%.0f quads/s", quads * 1e9 / timer.nsecsElapsed());
+}
+
+KWin::WindowQuadList WindowQuadListBenchmark::makeWindow(const QSize &size) const
+{
+    // a decorated window: the contents and four decoration quads
+    const int border = 4;
+    const int title = 28;
+    const QRectF rects[] = {
+        QRectF(0, 0, size.width(), title),
+        QRectF(0, title, border, size.height() - title - border),
+        QRectF(size.width() - border, title, border, size.height() - title - border),
+        QRectF(0, size.height() - border, size.width(), border)
+    };
+    KWin::WindowQuadList quads;
+    for (const QRectF &r : rects) {
+        KWin::WindowQuad quad(KWin::WindowQuadDecoration);
+        quad[0] = KWin::WindowVertex(r.x(), r.y(), r.x(), r.y());
+        quad[1] = KWin::WindowVertex(r.right(), r.y(), r.right(), r.y());
+        quad[2] = KWin::WindowVertex(r.right(), r.bottom(), r.right(), r.bottom());
+        quad[3] = KWin::WindowVertex(r.x(), r.bottom(), r.x(), r.bottom());
+        quads.append(quad);
+    }
+    const QRectF contents(border, title, size.width() - 2 * border, size.height() - title - border);
+    KWin::WindowQuad quad(KWin::WindowQuadContents);
+    quad[0] = KWin::WindowVertex(contents.x(), contents.y(), 0, 0);
+    quad[1] = KWin::WindowVertex(contents.right(), contents.y(), contents.width(), 0);
+    quad[2] = KWin::WindowVertex(contents.right(), contents.bottom(), contents.width(), contents.height());
+    quad[3] = KWin::WindowVertex(contents.x(), contents.bottom(), 0, contents.height());
+    quads.append(quad);
+    return quads;
+}
+
+void WindowQuadListBenchmark::addData()
+{
+    QTest::addColumn<QSize>("windowSize");
+    QTest::addColumn<int>("quadSize");
+
+    // wobbly windows uses a grid of 32px
+    QTest::newRow("800x600/32") << QSize(800, 600) << 32;
+    QTest::newRow("1920x1080/32") << QSize(1920, 1080) << 32;
+    // magic lamp uses a grid of 8px
+    QTest::newRow("800x600/8") << QSize(800, 600) << 8;
+    QTest::newRow("1920x1080/8") << QSize(1920, 1080) << 8;
+}
+
+void WindowQuadListBenchmark::benchmarkMakeGrid_data()
+{
+    addData();
+}
+
+void WindowQuadListBenchmark::benchmarkMakeGrid()
+{
+    QFETCH(QSize, windowSize);
+    QFETCH(int, quadSize);
+    const KWin::WindowQuadList window = makeWindow(windowSize);
+
+    QBENCHMARK {
+        const KWin::WindowQuadList grid = window.makeGrid(quadSize);
+    }
+    reportQuadsPerSecond([&window, quadSize] {
+        return window.makeGrid(quadSize).count();
+    });
+}
+
+void WindowQuadListBenchmark::benchmarkMakeInterleavedArrays_data()
+{
+    addData();
+}
+
+void WindowQuadListBenchmark::benchmarkMakeInterleavedArrays()
+{
+    QFETCH(QSize, windowSize);
+    QFETCH(int, quadSize);
+    const KWin::WindowQuadList grid = makeWindow(windowSize).makeGrid(quadSize);
+    std::vector<KWin::GLVertex2D> vertices(grid.count() * 6);
+    QMatrix4x4 textureMatrix;
+    textureMatrix.scale(1.0 / windowSize.width(), 1.0 / windowSize.height());
+
+    QBENCHMARK {
+        grid.makeInterleavedArrays(GL_TRIANGLES, vertices.data(), textureMatrix);
+    }
+    reportQuadsPerSecond([&grid, &vertices, &textureMatrix] {
+        grid.makeInterleavedArrays(GL_TRIANGLES, vertices.data(), textureMatrix);
+        return grid.count();
+    });
+}
+
+void WindowQuadListBenchmark::benchmarkGridAndInterleave_data()
+{
+    addData();
+}
+
+void WindowQuadListBenchmark::benchmarkGridAndInterleave()
+{
+    // what happens every frame for a deformed window
+    QFETCH(QSize, windowSize);
+    QFETCH(int, quadSize);
+    const KWin::WindowQuadList window = makeWindow(windowSize);
+    std::vector<KWin::GLVertex2D> vertices(window.makeGrid(quadSize).count() * 6);
+    QMatrix4x4 textureMatrix;
+    textureMatrix.scale(1.0 / windowSize.width(), 1.0 / windowSize.height());
+
+    QBENCHMARK {
+        const KWin::WindowQuadList grid = window.makeGrid(quadSize);
+        grid.makeInterleavedArrays(GL_TRIANGLES, vertices.data(), textureMatrix);
+    }
+    reportQuadsPerSecond([&window, quadSize, &vertices, &textureMatrix] {
+        const KWin::WindowQuadList grid = window.makeGrid(quadSize);
+        grid.makeInterleavedArrays(GL_TRIANGLES, vertices.data(), textureMatrix);
+        return grid.count();
+    });
+}
+
+QTEST_MAIN(WindowQuadListBenchmark)
+
+#include "windowquadlistbenchmark.moc"
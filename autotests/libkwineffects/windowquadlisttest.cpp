@@ -18,8 +18,17 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include <kwineffects.h>
+#include <QMatrix4x4>
 #include <QTest>
 
+#ifndef GL_TRIANGLES
+#  define GL_TRIANGLES      0x0004
+#endif
+
+#ifndef GL_QUADS
+#  define GL_QUADS          0x0007
+#endif
+
 Q_DECLARE_METATYPE(KWin::WindowQuadList)
 
 class WindowQuadListTest : public QObject
@@ -30,6 +39,8 @@ private Q_SLOTS:
     void testMakeGrid();
     void testMakeRegularGrid_data();
     void testMakeRegularGrid();
+    void testMakeInterleavedArrays_data();
+    void testMakeInterleavedArrays();
 
 private:
     KWin::WindowQuad makeQuad(const QRectF &rect);
@@ -216,6 +227,55 @@ void WindowQuadListTest::testMakeRegularGrid()
     }
 }
 
+void WindowQuadListTest::testMakeInterleavedArrays_data()
+{
+    QTest::addColumn<uint>("type");
+    QTest::addColumn<int>("offset");
+    QTest::addColumn<QVector<int>>("order");
+
+    // offset in floats from a 16 byte aligned address
+    QTest::newRow("quads/aligned") << uint(GL_QUADS) << 0 << QVector<int>{0, 1, 2, 3};
+    QTest::newRow("quads/unaligned") << uint(GL_QUADS) << 1 << QVector<int>{0, 1, 2, 3};
+    QTest::newRow("triangles/aligned") << uint(GL_TRIANGLES) << 0 << QVector<int>{1, 0, 3, 3, 2, 1};
+    QTest::newRow("triangles/unaligned") << uint(GL_TRIANGLES) << 2 << QVector<int>{1, 0, 3, 3, 2, 1};
+}
+
+void WindowQuadListTest::testMakeInterleavedArrays()
+{
+    KWin::WindowQuadList quads;
+    quads.append(makeQuad(QRectF(0, 0, 100, 50)));
+    quads = quads.makeGrid(20);
+    QCOMPARE(quads.count(), 15);
+    // move the vertices, the texture coordinates stay
+    for (KWin::WindowQuad &quad : quads) {
+        for (int i = 0; i < 4; ++i) {
+            quad[i].move(quad[i].x() * 2 + 10, quad[i].y() * 0.5 + 5);
+        }
+    }
+
+    QMatrix4x4 textureMatrix;
+    textureMatrix.translate(0.25, 0.5);
+    textureMatrix.scale(1.0 / 100, -1.0 / 50);
+
+    QFETCH(uint, type);
+    QFETCH(int, offset);
+    QFETCH(QVector<int>, order);
+
+    alignas(16) float buffer[15 * 6 * 4 + 4];
+    KWin::GLVertex2D *vertices = reinterpret_cast<KWin::GLVertex2D *>(buffer + offset);
+    quads.makeInterleavedArrays(type, vertices, textureMatrix);
+
+    const KWin::GLVertex2D *vertex = vertices;
+    for (const KWin::WindowQuad &quad : qAsConst(quads)) {
+        for (int index : qAsConst(order)) {
+            const KWin::WindowVertex &expected = quad[index];
+            QCOMPARE(vertex->position, QVector2D(expected.x(), expected.y()));
+            QCOMPARE(vertex->texcoord, QVector2D(expected.u() / 100 + 0.25, -expected.v() / 50 + 0.5));
+            vertex++;
+        }
+    }
+}
+
 QTEST_MAIN(WindowQuadListTest)
 
 #include "windowquadlisttest.moc"
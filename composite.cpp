@@ -19,11 +19,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "composite.h"
 
+#include "abstract_output.h"
 #include "dbusinterface.h"
 #include "x11client.h"
 #include "decorations/decoratedclient.h"
 #include "deleted.h"
 #include "effects.h"
+#include "framescheduler.h"
 #include "internal_client.h"
 #include "overlaywindow.h"
 #include "platform.h"
@@ -116,19 +118,11 @@ private:
     bool m_owning;
 };
 
-static inline qint64 milliToNano(int milli) { return qint64(milli) * 1000 * 1000; }
-static inline qint64 nanoToMilli(int nano) { return nano / (1000*1000); }
-
 Compositor::Compositor(QObject* workspace)
     : QObject(workspace)
     , m_state(State::Off)
     , m_selectionOwner(nullptr)
-    , vBlankInterval(0)
-    , fpsInterval(0)
-    , m_timeSinceLastVBlank(0)
     , m_scene(nullptr)
-    , m_bufferSwapPending(false)
-    , m_composeAtSwapCompletion(false)
 {
     connect(options, &Options::configChanged, this, &Compositor::configChanged);
     connect(options, &Options::animationSpeedChanged, this, &Compositor::configChanged);
@@ -330,21 +324,14 @@ void Compositor::startupWithWorkspace()
     Workspace::self()->markXStackingOrderAsDirty();
     Q_ASSERT(m_scene);
 
-    connect(workspace(), &Workspace::destroyed, this, [this] { compositeTimer.stop(); });
+    connect(workspace(), &Workspace::destroyed, this, &Compositor::destroyFrameSchedulers);
     setupX11Support();
-    fpsInterval = options->maxFpsInterval();
-
-    const auto rate = currentRefreshRate();
-    Q_ASSERT(rate != 0); // There is a fallback in options.cpp, so why check at all?
-
-    // If we do vsync, set the fps to the next multiple of the vblank rate.
-    vBlankInterval = milliToNano(1000) / currentRefreshRate();
-    fpsInterval = qMax((fpsInterval / vBlankInterval) * vBlankInterval, vBlankInterval);
 
     // Sets also the 'effects' pointer.
     kwinApp()->platform()->createEffectsHandler(this, m_scene);
     connect(Workspace::self(), &Workspace::deletedRemoved, m_scene, &Scene::removeToplevel);
     connect(effects, &EffectsHandler::screenGeometryChanged, this, &Compositor::addRepaintFull);
+    connect(screens(), &Screens::changed, this, &Compositor::updateFrameSchedulers, Qt::UniqueConnection);
 
     for (X11Client *c : Workspace::self()->clientList()) {
         c->setupCompositing();
@@ -378,8 +365,84 @@ void Compositor::startupWithWorkspace()
     }
 
     // Render at least once.
+    updateFrameSchedulers();
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        performCompositing(scheduler);
+    }
+}
+
+FrameScheduler *Compositor::createFrameScheduler(AbstractOutput *output)
+{
+    FrameScheduler *scheduler = new FrameScheduler(output, this);
+    // Scenes with swap events are throttled by the buffer swaps, without
+    // them we have to guess when the next vblank happens.
+    scheduler->setThrottledBySwap(m_scene->hasSwapEvent());
+    scheduler->setRefreshRate(refreshRate() * 1000);
+    connect(scheduler, &FrameScheduler::frameRequested, this, &Compositor::performCompositing);
+    connect(scheduler, &FrameScheduler::bufferSwapCompleted, this, &Compositor::bufferSwapCompleted);
+    if (output) {
+        connect(output, &QObject::destroyed, scheduler,
+            [this, scheduler] {
+                m_frameSchedulers.removeOne(scheduler);
+                delete scheduler;
+                emit frameSchedulersChanged();
+            }
+        );
+    }
+    return scheduler;
+}
+
+void Compositor::updateFrameSchedulers()
+{
+    if (!m_scene) {
+        return;
+    }
+    QVector<FrameScheduler *> schedulers;
+    if (m_scene->perOutputScheduling()) {
+        const auto outputs = kwinApp()->platform()->enabledOutputs();
+        for (AbstractOutput *output : outputs) {
+            FrameScheduler *scheduler = frameScheduler(output);
+            if (!scheduler) {
+                scheduler = createFrameScheduler(output);
+            }
+            schedulers << scheduler;
+        }
+    }
+    if (schedulers.isEmpty()) {
+        FrameScheduler *scheduler = frameScheduler(nullptr);
+        if (!scheduler) {
+            scheduler = createFrameScheduler(nullptr);
+        }
+        schedulers << scheduler;
+    }
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        if (!schedulers.contains(scheduler)) {
+            delete scheduler;
+        }
+    }
+    m_frameSchedulers = schedulers;
+    emit frameSchedulersChanged();
     addRepaintFull();
-    performCompositing();
+}
+
+void Compositor::destroyFrameSchedulers()
+{
+    qDeleteAll(m_frameSchedulers);
+    m_frameSchedulers.clear();
+    emit frameSchedulersChanged();
+}
+
+FrameScheduler *Compositor::frameScheduler(AbstractOutput *output) const
+{
+    auto it = std::find_if(m_frameSchedulers.constBegin(), m_frameSchedulers.constEnd(),
+        [output] (FrameScheduler *scheduler) {
+            return scheduler->output() == output;
+        }
+    );
+    if (it == m_frameSchedulers.constEnd()) {
+        return nullptr;
+    }
+    return *it;
 }
 
 void Compositor::scheduleRepaint()
@@ -393,20 +456,10 @@ void Compositor::scheduleRepaint()
         return;
     }
 
-    // TODO: Make this distinction not on the question if there is a swap event but if per screen
-    //       rendering? On X we get swap events but they are aligned with the "wrong" screen if
-    //       it the primary/first one is not the one with the highest refresh rate.
-    //       But on the other side Present extension does not allow to sync with another screen
-    //       anyway.
-
-    if (m_scene->hasSwapEvent()) {
-        // TODO: If we don't call it back from the event loop we often crash on Wayland
-        //       in AnimationEffect::postPaintScreen. Why?
-        //       Theory is that effects call addRepaintFull in there and then performCompositing
-        //       is called again while still in the first paint. So queing it here makes sense!
-        QTimer::singleShot(0, this, [this]() { performCompositing(); });
-    } else {
-        setCompositeTimer();
+    // A window requested the repaint, we don't know yet on which outputs it is
+    // going to end up. The repaints are distributed once the frame starts.
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        scheduler->scheduleRepaint();
     }
 }
 
@@ -469,10 +522,9 @@ void Compositor::stop()
         }
     }
 
+    destroyFrameSchedulers();
     delete m_scene;
     m_scene = nullptr;
-    compositeTimer.stop();
-    repaints_region = QRegion();
 
     m_state = State::Off;
     emit compositingToggled(false);
@@ -555,20 +607,12 @@ void Compositor::reinitialize()
 
 void Compositor::addRepaint(int x, int y, int w, int h)
 {
-    if (m_state != State::On) {
-        return;
-    }
-    repaints_region += QRegion(x, y, w, h);
-    scheduleRepaint();
+    addRepaint(QRegion(x, y, w, h));
 }
 
 void Compositor::addRepaint(const QRect& r)
 {
-    if (m_state != State::On) {
-        return;
-    }
-    repaints_region += r;
-    scheduleRepaint();
+    addRepaint(QRegion(r));
 }
 
 void Compositor::addRepaint(const QRegion& r)
@@ -576,8 +620,9 @@ void Compositor::addRepaint(const QRegion& r)
     if (m_state != State::On) {
         return;
     }
-    repaints_region += r;
-    scheduleRepaint();
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        scheduler->addRepaint(r);
+    }
 }
 
 void Compositor::addRepaintFull()
@@ -585,56 +630,86 @@ void Compositor::addRepaintFull()
     if (m_state != State::On) {
         return;
     }
-    const QSize &s = screens()->size();
-    repaints_region = QRegion(0, 0, s.width(), s.height());
-    scheduleRepaint();
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        scheduler->addRepaintFull();
+    }
 }
 
-void Compositor::timerEvent(QTimerEvent *te)
+void Compositor::aboutToSwapBuffers()
 {
-    if (te->timerId() == compositeTimer.timerId()) {
-        performCompositing();
-    } else
-        QObject::timerEvent(te);
+    for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+        if (!scheduler->isSwapPending()) {
+            scheduler->aboutToSwapBuffers();
+        }
+    }
 }
 
-void Compositor::aboutToSwapBuffers()
+void Compositor::bufferSwapComplete()
 {
-    Q_ASSERT(!m_bufferSwapPending);
-
-    m_bufferSwapPending = true;
+    // Copy, completing the swap can trigger a repaint which may update the schedulers.
+    const auto schedulers = m_frameSchedulers;
+    for (FrameScheduler *scheduler : schedulers) {
+        if (scheduler->isSwapPending()) {
+            scheduler->bufferSwapComplete();
+        }
+    }
 }
 
-void Compositor::bufferSwapComplete()
+void Compositor::aboutToSwapBuffers(AbstractOutput *output)
 {
-    Q_ASSERT(m_bufferSwapPending);
-    m_bufferSwapPending = false;
+    FrameScheduler *scheduler = frameScheduler(output);
+    if (!scheduler) {
+        // The scene doesn't schedule per output, block the common scheduler.
+        aboutToSwapBuffers();
+        return;
+    }
+    scheduler->aboutToSwapBuffers();
+}
 
-    emit bufferSwapCompleted();
+void Compositor::bufferSwapComplete(AbstractOutput *output)
+{
+    FrameScheduler *scheduler = frameScheduler(output);
+    if (!scheduler) {
+        bufferSwapComplete();
+        return;
+    }
+    if (scheduler->isSwapPending()) {
+        scheduler->bufferSwapComplete();
+    }
+}
 
-    if (m_composeAtSwapCompletion) {
-        m_composeAtSwapCompletion = false;
-        performCompositing();
+void Compositor::collectWindowRepaints(const QList<Toplevel *> &windows)
+{
+    for (Toplevel *win : windows) {
+        const QRegion repaints = win->repaints();
+        if (repaints.isEmpty()) {
+            continue;
+        }
+        for (FrameScheduler *scheduler : qAsConst(m_frameSchedulers)) {
+            scheduler->addRepaint(repaints);
+        }
+        win->resetRepaints();
     }
 }
 
-void Compositor::performCompositing()
+void Compositor::performCompositing(FrameScheduler *scheduler)
 {
     // If a buffer swap is still pending, we return to the event loop and
     // continue processing events until the swap has completed.
-    if (m_bufferSwapPending) {
-        m_composeAtSwapCompletion = true;
-        compositeTimer.stop();
+    if (scheduler->isSwapPending()) {
+        scheduler->scheduleRepaint();
         return;
     }
 
     // If outputs are disabled, we return to the event loop and
     // continue processing events until the outputs are enabled again
     if (!kwinApp()->platform()->areOutputsEnabled()) {
-        compositeTimer.stop();
+        scheduler->stop();
         return;
     }
 
+    emit frameStarted(scheduler);
+
     // Create a list of all windows in the stacking order
     QList<Toplevel *> windows = Workspace::self()->xStackingOrder();
     QList<Toplevel *> damaged;
@@ -663,26 +738,31 @@ void Compositor::performCompositing()
 
     // Get the replies
     for (Toplevel *win : damaged) {
-        // Discard the cached lanczos texture
-        if (win->effectWindow()) {
-            const QVariant texture = win->effectWindow()->data(LanczosCacheRole);
-            if (texture.isValid()) {
-                delete static_cast<GLTexture *>(texture.value<void*>());
-                win->effectWindow()->setData(LanczosCacheRole, QVariant());
-            }
-        }
-
         win->getDamageRegionReply();
     }
 
-    if (repaints_region.isEmpty() && !windowRepaintsPending()) {
-        m_scene->idle();
-        m_timeSinceLastVBlank = fpsInterval - (options->vBlankTime() + 1); // means "start now"
+    // Each output only repaints what changed on it. Move the repaints requested by the
+    // windows to the outputs they are shown on.
+    if (scheduler->output()) {
+        collectWindowRepaints(windows);
+    }
+
+    if (!scheduler->hasDamage() && !windowRepaintsPending()) {
+        // Only consider the scene idle if no other output is about to paint, otherwise
+        // the animations on the other outputs would lose their time.
+        const bool idle = std::none_of(m_frameSchedulers.constBegin(), m_frameSchedulers.constEnd(),
+            [] (FrameScheduler *s) {
+                return s->hasDamage() || s->isScheduled() || s->isSwapPending();
+            }
+        );
+        if (idle) {
+            m_scene->idle();
+        }
         // Note: It would seem here we should undo suspended unredirect, but when scenes need
         // it for some reason, e.g. transformations or translucency, the next pass that does not
         // need this anymore and paints normally will also reset the suspended unredirect.
         // Otherwise the window would not be painted normally anyway.
-        compositeTimer.stop();
+        scheduler->stop();
         return;
     }
 
@@ -703,14 +783,31 @@ void Compositor::performCompositing()
         }
     }
 
-    QRegion repaints = repaints_region;
+    // Don't bother the scene with windows which are not on the output. Fullscreen
+    // effects are free to move windows around, so they get all of them.
+    if (scheduler->output() && !effects->hasActiveFullScreenEffect()) {
+        const QRect geometry = scheduler->geometry();
+        auto it = std::remove_if(windows.begin(), windows.end(),
+            [geometry] (Toplevel *win) {
+                return !win->visibleRect().intersects(geometry);
+            }
+        );
+        windows.erase(it, windows.end());
+    }
+
     // clear all repaints, so that post-pass can add repaints for the next repaint
-    repaints_region = QRegion();
+    const QRegion repaints = scheduler->takeDamage();
 
     if (m_framesToTestForSafety > 0 && (m_scene->compositingType() & OpenGLCompositing)) {
         kwinApp()->platform()->createOpenGLSafePoint(Platform::OpenGLSafePoint::PreFrame);
     }
-    m_timeSinceLastVBlank = m_scene->paint(repaints, windows);
+    scheduler->paintStarted();
+    if (AbstractOutput *output = scheduler->output()) {
+        const int screenId = kwinApp()->platform()->enabledOutputs().indexOf(output);
+        scheduler->addRenderTime(m_scene->paintOutput(screenId, repaints, windows));
+    } else {
+        scheduler->addRenderTime(m_scene->paint(repaints, windows));
+    }
     if (m_framesToTestForSafety > 0) {
         if (m_scene->compositingType() & OpenGLCompositing) {
             kwinApp()->platform()->createOpenGLSafePoint(Platform::OpenGLSafePoint::PostFrame);
@@ -731,19 +828,18 @@ void Compositor::performCompositing()
         }
     }
 
+    emit framePainted(scheduler, repaints);
+
     // Stop here to ensure *we* cause the next repaint schedule - not some effect
     // through m_scene->paint().
-    compositeTimer.stop();
+    scheduler->stop();
 
     // Trigger at least one more pass even if there would be nothing to paint, so that scene->idle()
     // is called the next time. If there would be nothing pending, it will not restart the timer and
     // scheduleRepaint() would restart it again somewhen later, called from functions that
-    // would again add something pending.
-    if (m_bufferSwapPending) {
-        m_composeAtSwapCompletion = true;
-    } else {
-        scheduleRepaint();
-    }
+    // would again add something pending. If a buffer swap is pending the pass happens on
+    // swap completion.
+    scheduler->scheduleRepaint();
 }
 
 template <class T>
@@ -786,17 +882,6 @@ bool Compositor::windowRepaintsPending() const
     return false;
 }
 
-void Compositor::setCompositeTimer()
-{
-    if (compositeTimer.isActive()) {
-        return;
-    }
-
-    uint waitTime = 1000 / refreshRate();
-    // Force 4fps minimum:
-    compositeTimer.start(qMin(waitTime, 250u), this);
-}
-
 bool Compositor::isActive()
 {
     return m_state == State::On;
@@ -927,13 +1012,13 @@ void X11Compositor::start()
     m_xrrRefreshRate = KWin::currentRefreshRate();
     startupWithWorkspace();
 }
-void X11Compositor::performCompositing()
+void X11Compositor::performCompositing(FrameScheduler *scheduler)
 {
     if (scene()->usesOverlayWindow() && !isOverlayWindowVisible()) {
         // Return since nothing is visible.
         return;
     }
-    Compositor::performCompositing();
+    Compositor::performCompositing(scheduler);
 }
 
 bool X11Compositor::checkForOverlayWindow(WId w) const
@@ -25,13 +25,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QElapsedTimer>
 #include <QTimer>
-#include <QBasicTimer>
 #include <QRegion>
+#include <QVector>
 
 namespace KWin
 {
+class AbstractOutput;
 class CompositorSelectionOwner;
+class FrameScheduler;
 class Scene;
+class Toplevel;
 class X11Client;
 
 class KWIN_EXPORT Compositor : public QObject
@@ -64,6 +67,9 @@ public:
      * Notifies the compositor that SwapBuffers() is about to be called.
      * Rendering of the next frame will be deferred until bufferSwapComplete()
      * is called.
+     *
+     * This blocks the rendering of all outputs. Backends which present each
+     * output on its own should use the overload taking the output.
      */
     void aboutToSwapBuffers();
 
@@ -72,6 +78,31 @@ public:
      */
     void bufferSwapComplete();
 
+    /**
+     * Notifies the compositor that a buffer is about to be presented on @p output.
+     * Rendering of the next frame for @p output will be deferred until
+     * bufferSwapComplete() is called for it, the other outputs are not affected.
+     */
+    void aboutToSwapBuffers(AbstractOutput *output);
+
+    /**
+     * Notifies the compositor that a pending buffer swap on @p output has completed.
+     */
+    void bufferSwapComplete(AbstractOutput *output);
+
+    /**
+     * The schedulers driving the repaints. If the Scene renders each output on its
+     * own there is one FrameScheduler per enabled output, otherwise a single one
+     * covering all screens.
+     */
+    QVector<FrameScheduler *> frameSchedulers() const {
+        return m_frameSchedulers;
+    }
+    /**
+     * Returns the FrameScheduler driving @p output, @c null if there is none.
+     */
+    FrameScheduler *frameScheduler(AbstractOutput *output) const;
+
     /**
      * Toggles compositing, that is if the Compositor is suspended it will be resumed
      * and if the Compositor is active it will be suspended.
@@ -115,10 +146,23 @@ Q_SIGNALS:
     void aboutToToggleCompositing();
     void sceneCreated();
     void bufferSwapCompleted();
+    /**
+     * Emitted whenever FrameSchedulers got created or destroyed.
+     */
+    void frameSchedulersChanged();
+    /**
+     * Emitted when @p scheduler starts a compositing pass. Not every pass results in a
+     * painted frame, e.g. if nothing is damaged.
+     */
+    void frameStarted(KWin::FrameScheduler *scheduler);
+    /**
+     * Emitted at the end of a compositing pass which painted @p damage on the area
+     * covered by @p scheduler.
+     */
+    void framePainted(KWin::FrameScheduler *scheduler, const QRegion &damage);
 
 protected:
     explicit Compositor(QObject *parent = nullptr);
-    void timerEvent(QTimerEvent *te) override;
 
     virtual void start() = 0;
     void stop();
@@ -132,7 +176,7 @@ protected:
      * Continues the startup after Scene And Workspace are created
      */
     void startupWithWorkspace();
-    virtual void performCompositing();
+    virtual void performCompositing(FrameScheduler *scheduler);
 
     virtual void configChanged();
 
@@ -145,7 +189,10 @@ private:
 
     void setupX11Support();
 
-    void setCompositeTimer();
+    void updateFrameSchedulers();
+    void destroyFrameSchedulers();
+    FrameScheduler *createFrameScheduler(AbstractOutput *output);
+    void collectWindowRepaints(const QList<Toplevel *> &windows);
     bool windowRepaintsPending() const;
 
     void releaseCompositorSelection();
@@ -153,20 +200,14 @@ private:
 
     State m_state;
 
-    QBasicTimer compositeTimer;
     CompositorSelectionOwner *m_selectionOwner;
     QTimer m_releaseSelectionTimer;
     QList<xcb_atom_t> m_unusedSupportProperties;
     QTimer m_unusedSupportPropertyTimer;
-    qint64 vBlankInterval, fpsInterval;
-    QRegion repaints_region;
-
-    qint64 m_timeSinceLastVBlank;
 
     Scene *m_scene;
 
-    bool m_bufferSwapPending;
-    bool m_composeAtSwapCompletion;
+    QVector<FrameScheduler *> m_frameSchedulers;
 
     int m_framesToTestForSafety = 3;
     QElapsedTimer m_monotonicClock;
@@ -262,7 +303,7 @@ public:
 
 protected:
     void start() override;
-    void performCompositing() override;
+    void performCompositing(FrameScheduler *scheduler) override;
 
 private:
     explicit X11Compositor(QObject *parent);
@@ -25,9 +25,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // kwin
 #include "abstract_client.h"
+#include "abstract_output.h"
 #include "atoms.h"
 #include "composite.h"
 #include "debug_console.h"
+#include "framescheduler.h"
 #include "main.h"
 #include "placement.h"
 #include "platform.h"
@@ -326,6 +328,48 @@ void CompositorDBusInterface::reinitialize()
     m_compositor->reinitialize();
 }
 
+static QVariantMap latencyHistogramToMap(const LatencyHistogram &histogram)
+{
+    QVariantList buckets;
+    for (int i = 0; i < LatencyHistogram::s_bucketCount; ++i) {
+        buckets << histogram.bucket(i);
+    }
+    return QVariantMap{
+        {QStringLiteral("buckets"), buckets},
+        {QStringLiteral("count"), histogram.count()},
+        {QStringLiteral("mean"), histogram.mean() / 1000},
+        {QStringLiteral("median"), histogram.percentile(50) / 1000},
+        {QStringLiteral("p99"), histogram.percentile(99) / 1000},
+        {QStringLiteral("maximum"), histogram.maximum() / 1000}
+    };
+}
+
+QVariantMap CompositorDBusInterface::latencyStatistics() const
+{
+    QVariantList limits;
+    for (int i = 0; i < LatencyHistogram::s_bucketCount - 1; ++i) {
+        limits << LatencyHistogram::bucketLimit(i) / 1000;
+    }
+    QVariantMap statistics{{QStringLiteral("bucketLimits"), limits}};
+    const auto schedulers = m_compositor->frameSchedulers();
+    for (FrameScheduler *scheduler : schedulers) {
+        const QString name = scheduler->output() ? scheduler->output()->name() : QStringLiteral("all");
+        statistics.insert(name, QVariantMap{
+            {QStringLiteral("inputLatency"), latencyHistogramToMap(scheduler->inputLatency())},
+            {QStringLiteral("presentationLatency"), latencyHistogramToMap(scheduler->presentationLatency())}
+        });
+    }
+    return statistics;
+}
+
+void CompositorDBusInterface::resetLatencyStatistics()
+{
+    const auto schedulers = m_compositor->frameSchedulers();
+    for (FrameScheduler *scheduler : schedulers) {
+        scheduler->clearLatencies();
+    }
+}
+
 QStringList CompositorDBusInterface::supportedOpenGLPlatformInterfaces() const
 {
     QStringList interfaces;
@@ -171,6 +171,28 @@ public Q_SLOTS:
      * On signal Compositor reloads settings and restarts.
      */
     void reinitialize();
+    /**
+     * @brief The input and presentation latency histograms of the outputs.
+     *
+     * The map contains the upper limits of the histogram buckets in microseconds as
+     * @c bucketLimits, the last bucket is open. For each output, keyed by its name, there
+     * is a map with the @c inputLatency, the time from an input event until the frame
+     * showing it started to be painted, and the @c presentationLatency, the time from
+     * starting to paint a frame until it got presented. Each histogram is a map with the
+     * @c buckets, the @c count of samples and the @c mean, @c median, @c p99 and @c maximum
+     * latency in microseconds.
+     *
+     * @return QVariantMap
+     * @see resetLatencyStatistics
+     */
+    QVariantMap latencyStatistics() const;
+    /**
+     * @brief Clears the latency histograms of all outputs.
+     *
+     * @return void
+     * @see latencyStatistics
+     */
+    void resetLatencyStatistics();
 
 Q_SIGNALS:
     void compositingToggled(bool active);
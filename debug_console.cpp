@@ -18,17 +18,23 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "debug_console.h"
+#include "abstract_output.h"
 #include "composite.h"
+#include "framescheduler.h"
 #include "x11client.h"
 #include "input_event.h"
 #include "internal_client.h"
 #include "main.h"
 #include "scene.h"
+#include "scripting/scriptedeffect.h"
+#include "scripting/scriptenginepool.h"
+#include "scripting/scripting.h"
 #include "xdgshellclient.h"
 #include "unmanaged.h"
 #include "wayland_server.h"
 #include "workspace.h"
 #include "keyboard_input.h"
+#include "effects.h"
 #include "libinput/connection.h"
 #include "libinput/device.h"
 #include <kwinglplatform.h>
@@ -573,6 +579,8 @@ DebugConsole::DebugConsole()
     m_ui->windowsView->setItemDelegate(new DebugConsoleDelegate(this));
     m_ui->windowsView->setModel(new DebugConsoleModel(this));
     m_ui->surfacesView->setModel(new SurfaceTreeModel(this));
+    m_ui->frameTimingView->setModel(new FrameTimingModel(this));
+    m_ui->scriptsView->setModel(new ScriptEngineModel(this));
     if (kwinApp()->usesLibinput()) {
         m_ui->inputDevicesView->setModel(new InputDeviceModel(this));
         m_ui->inputDevicesView->setItemDelegate(new DebugConsoleDelegate(this));
@@ -1593,4 +1601,261 @@ void InputDeviceModel::setupDeviceConnections(LibInput::Device *device)
     );
 }
 
+FrameTimingModel::FrameTimingModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    resetSchedulers();
+    if (Compositor *compositor = Compositor::self()) {
+        connect(compositor, &Compositor::frameSchedulersChanged, this,
+            [this] {
+                beginResetModel();
+                resetSchedulers();
+                endResetModel();
+            }
+        );
+    }
+}
+
+FrameTimingModel::~FrameTimingModel() = default;
+
+void FrameTimingModel::resetSchedulers()
+{
+    for (const auto &scheduler : qAsConst(m_schedulers)) {
+        if (scheduler) {
+            disconnect(scheduler, nullptr, this, nullptr);
+        }
+    }
+    m_schedulers.clear();
+    if (!Compositor::self()) {
+        return;
+    }
+    const auto schedulers = Compositor::self()->frameSchedulers();
+    for (FrameScheduler *scheduler : schedulers) {
+        const int row = m_schedulers.count();
+        m_schedulers << scheduler;
+        connect(scheduler, &FrameScheduler::frameTimingChanged, this,
+            [this, row] {
+                emit dataChanged(index(row, PredictedRenderTimeColumn, QModelIndex()),
+                                 index(row, PresentationLatencyColumn, QModelIndex()),
+                                 QVector<int>{Qt::DisplayRole});
+            }
+        );
+    }
+}
+
+int FrameTimingModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return ColumnCount;
+}
+
+static QString nanoToMilliString(qint64 nano)
+{
+    return i18nc("Duration in milliseconds", "%1 ms", QString::number(nano / 1000000.0, 'f', 2));
+}
+
+static QString latencyToString(const LatencyHistogram &histogram)
+{
+    if (histogram.isEmpty()) {
+        return QString();
+    }
+    return i18nc("Median and 99th percentile of a latency", "%1 / %2",
+                 nanoToMilliString(histogram.percentile(50)), nanoToMilliString(histogram.percentile(99)));
+}
+
+QVariant FrameTimingModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.parent().isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    if (index.row() >= m_schedulers.count()) {
+        return QVariant();
+    }
+    FrameScheduler *scheduler = m_schedulers.at(index.row());
+    if (!scheduler) {
+        return QVariant();
+    }
+    switch (index.column()) {
+    case OutputColumn:
+        return scheduler->output() ? scheduler->output()->name() : i18n("All Screens");
+    case RefreshRateColumn:
+        return i18nc("Refresh rate in Hertz", "%1 Hz", QString::number(scheduler->refreshRate() / 1000.0, 'f', 2));
+    case PredictedRenderTimeColumn:
+        return nanoToMilliString(scheduler->predictedRenderTime());
+    case LastRenderTimeColumn:
+        return nanoToMilliString(scheduler->lastRenderTime());
+    case DeadlineSlackColumn:
+        return nanoToMilliString(scheduler->lastDeadlineSlack());
+    case MissedDeadlinesColumn:
+        return scheduler->missedDeadlines();
+    case InputLatencyColumn:
+        return latencyToString(scheduler->inputLatency());
+    case PresentationLatencyColumn:
+        return latencyToString(scheduler->presentationLatency());
+    default:
+        return QVariant();
+    }
+}
+
+QVariant FrameTimingModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case OutputColumn:
+        return i18n("Output");
+    case RefreshRateColumn:
+        return i18n("Refresh Rate");
+    case PredictedRenderTimeColumn:
+        return i18n("Predicted Render Time");
+    case LastRenderTimeColumn:
+        return i18n("Last Render Time");
+    case DeadlineSlackColumn:
+        return i18n("Time Left at Deadline");
+    case MissedDeadlinesColumn:
+        return i18n("Missed Deadlines");
+    case InputLatencyColumn:
+        return i18n("Input to Paint (Median / 99%)");
+    case PresentationLatencyColumn:
+        return i18n("Paint to Present (Median / 99%)");
+    default:
+        return QVariant();
+    }
+}
+
+QModelIndex FrameTimingModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || column < 0 || column >= ColumnCount || row < 0 || row >= m_schedulers.count()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+int FrameTimingModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_schedulers.count();
+}
+
+QModelIndex FrameTimingModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child)
+    return QModelIndex();
+}
+
+
+ScriptEngineModel::ScriptEngineModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    if (effects) {
+        addPool(ScriptedEffect::enginePool(), i18nc("Script engine of the effects, %1 is its number", "Effects %1"));
+    }
+    if (Scripting *scripting = Scripting::self()) {
+        addPool(scripting->enginePool(), i18nc("Script engine of the KWin scripts, %1 is its number", "Scripts %1"));
+    }
+    updateRows();
+}
+
+ScriptEngineModel::~ScriptEngineModel() = default;
+
+void ScriptEngineModel::addPool(ScriptEnginePool *pool, const QString &engineName)
+{
+    m_pools << qMakePair(QPointer<ScriptEnginePool>(pool), engineName);
+    connect(pool, &ScriptEnginePool::statisticsChanged, this,
+        [this] {
+            beginResetModel();
+            updateRows();
+            endResetModel();
+        }
+    );
+}
+
+void ScriptEngineModel::updateRows()
+{
+    m_rows.clear();
+    for (const auto &pool : qAsConst(m_pools)) {
+        if (!pool.first) {
+            continue;
+        }
+        const auto statistics = pool.first->statistics();
+        for (const ScriptEnginePool::Statistics &script : statistics) {
+            m_rows << Row{script.fileName, pool.second.arg(script.engine + 1), script.loadTime, script.memory};
+        }
+    }
+}
+
+int ScriptEngineModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+    return ColumnCount;
+}
+
+QVariant ScriptEngineModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.parent().isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    if (index.row() >= m_rows.count()) {
+        return QVariant();
+    }
+    const Row &row = m_rows.at(index.row());
+    switch (index.column()) {
+    case ScriptColumn:
+        return row.script;
+    case EngineColumn:
+        return row.engine;
+    case LoadTimeColumn:
+        // still loading
+        return row.loadTime < 0 ? QVariant() : nanoToMilliString(row.loadTime);
+    case MemoryColumn:
+        return i18nc("Memory in kilobytes", "%1 KiB", row.memory / 1024);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ScriptEngineModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    switch (section) {
+    case ScriptColumn:
+        return i18n("Script");
+    case EngineColumn:
+        return i18n("Engine");
+    case LoadTimeColumn:
+        return i18n("Load Time");
+    case MemoryColumn:
+        return i18n("Memory");
+    default:
+        return QVariant();
+    }
+}
+
+QModelIndex ScriptEngineModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || column < 0 || column >= ColumnCount || row < 0 || row >= m_rows.count()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column);
+}
+
+int ScriptEngineModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_rows.count();
+}
+
+QModelIndex ScriptEngineModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child)
+    return QModelIndex();
+}
+
 }
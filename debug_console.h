@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "input_event_spy.h"
 
 #include <QAbstractItemModel>
+#include <QPointer>
 #include <QStyledItemDelegate>
 #include <QVector>
 
@@ -44,6 +45,8 @@ class InternalClient;
 class XdgShellClient;
 class Unmanaged;
 class DebugConsoleFilter;
+class FrameScheduler;
+class ScriptEnginePool;
 
 class KWIN_EXPORT DebugConsoleModel : public QAbstractItemModel
 {
@@ -186,6 +189,80 @@ private:
     QVector<LibInput::Device*> m_devices;
 };
 
+/**
+ * Shows the predicted and the measured render times of the FrameSchedulers, and the median
+ * and 99th percentile of their input and presentation latencies.
+ */
+class KWIN_EXPORT FrameTimingModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        OutputColumn,
+        RefreshRateColumn,
+        PredictedRenderTimeColumn,
+        LastRenderTimeColumn,
+        DeadlineSlackColumn,
+        MissedDeadlinesColumn,
+        InputLatencyColumn,
+        PresentationLatencyColumn,
+        ColumnCount
+    };
+
+    explicit FrameTimingModel(QObject *parent = nullptr);
+    ~FrameTimingModel() override;
+
+    int columnCount(const QModelIndex &parent) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    QModelIndex index(int row, int column, const QModelIndex & parent) const override;
+    int rowCount(const QModelIndex &parent) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+
+private:
+    void resetSchedulers();
+    QVector<QPointer<FrameScheduler>> m_schedulers;
+};
+
+/**
+ * Shows the scripts running on the shared script engines, how long they took to load
+ * and how much memory they need.
+ */
+class KWIN_EXPORT ScriptEngineModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Column {
+        ScriptColumn,
+        EngineColumn,
+        LoadTimeColumn,
+        MemoryColumn,
+        ColumnCount
+    };
+
+    explicit ScriptEngineModel(QObject *parent = nullptr);
+    ~ScriptEngineModel() override;
+
+    int columnCount(const QModelIndex &parent) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    QModelIndex index(int row, int column, const QModelIndex & parent) const override;
+    int rowCount(const QModelIndex &parent) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+
+private:
+    struct Row {
+        QString script;
+        QString engine;
+        qint64 loadTime;
+        qint64 memory;
+    };
+    void addPool(ScriptEnginePool *pool, const QString &engineName);
+    void updateRows();
+    QVector<QPair<QPointer<ScriptEnginePool>, QString>> m_pools;
+    QVector<Row> m_rows;
+};
+
 }
 
 #endif
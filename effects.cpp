@@ -61,6 +61,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "decorations/decorationbridge.h"
 #include <KDecoration2/DecorationSettings>
 
+#include <algorithm>
+
 namespace KWin
 {
 //---------------------
@@ -128,6 +130,7 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
     , m_effectLoader(new EffectLoader(this))
     , m_trackingCursorChanges(0)
 {
+    m_usePaintHooks = qgetenv("KWIN_USE_EFFECT_PAINT_HOOKS") != "0";
     qRegisterMetaType<QVector<KWin::EffectWindow*>>();
     connect(m_effectLoader, &AbstractEffectLoader::effectLoaded, this,
         [this](Effect *effect, const QString &name) {
@@ -140,9 +143,6 @@ EffectsHandlerImpl::EffectsHandlerImpl(Compositor *compositor, Scene *scene)
     new EffectsAdaptor(this);
     QDBusConnection dbus = QDBusConnection::sessionBus();
     dbus.registerObject(QStringLiteral("/Effects"), this);
-    // init is important, otherwise causes crashes when quads are build before the first painting pass start
-    m_currentBuildQuadsIterator = m_activeEffects.constEnd();
-
     Workspace *ws = Workspace::self();
     VirtualDesktopManager *vds = VirtualDesktopManager::self();
     connect(ws, &Workspace::showingDesktopChanged,
@@ -392,18 +392,20 @@ void EffectsHandlerImpl::reconfigure()
 // the idea is that effects call this function again which calls the next one
 void EffectsHandlerImpl::prePaintScreen(ScreenPrePaintData& data, int time)
 {
-    if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintScreenIterator++)->prePaintScreen(data, time);
-        --m_currentPaintScreenIterator;
+    PaintChain &chain = m_paintChains[PrePaintScreenChain];
+    if (chain.current < chain.effects.count()) {
+        chain.effects.at(chain.current++)->prePaintScreen(data, time);
+        --chain.current;
     }
     // no special final code
 }
 
 void EffectsHandlerImpl::paintScreen(int mask, const QRegion &region, ScreenPaintData& data)
 {
-    if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintScreenIterator++)->paintScreen(mask, region, data);
-        --m_currentPaintScreenIterator;
+    PaintChain &chain = m_paintChains[PaintScreenChain];
+    if (chain.current < chain.effects.count()) {
+        chain.effects.at(chain.current++)->paintScreen(mask, region, data);
+        --chain.current;
     } else
         m_scene->finalPaintScreen(mask, region, data);
 }
@@ -415,47 +417,86 @@ void EffectsHandlerImpl::paintDesktop(int desktop, int mask, QRegion region, Scr
     }
     m_currentRenderedDesktop = desktop;
     m_desktopRendering = true;
-    // save the paint screen iterator
-    EffectsIterator savedIterator = m_currentPaintScreenIterator;
-    m_currentPaintScreenIterator = m_activeEffects.constBegin();
+    // save the paint screen position
+    PaintChain &chain = m_paintChains[PaintScreenChain];
+    const int saved = chain.current;
+    chain.current = 0;
     effects->paintScreen(mask, region, data);
-    // restore the saved iterator
-    m_currentPaintScreenIterator = savedIterator;
+    // restore the saved position
+    chain.current = saved;
     m_desktopRendering = false;
 }
 
 void EffectsHandlerImpl::postPaintScreen()
 {
-    if (m_currentPaintScreenIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintScreenIterator++)->postPaintScreen();
-        --m_currentPaintScreenIterator;
+    PaintChain &chain = m_paintChains[PostPaintScreenChain];
+    if (chain.current < chain.effects.count()) {
+        chain.effects.at(chain.current++)->postPaintScreen();
+        --chain.current;
     }
     // no special final code
 }
 
+int EffectsHandlerImpl::nextEffectForWindow(const PaintChain &chain, EffectWindow *w)
+{
+    if (!m_usePaintHooks) {
+        return chain.current;
+    }
+    EffectWindowImpl *window = static_cast<EffectWindowImpl*>(w);
+    if (window->m_paintEffectsSerial != m_paintSerial) {
+        // ask the effects only once per painting pass, the windows go through several chains
+        window->m_paintEffects = 0;
+        const int count = qMin(m_activeEffects.count(), 64);
+        for (int i = 0; i < count; ++i) {
+            if (m_activeEffects.at(i)->isActiveForWindow(w)) {
+                window->m_paintEffects |= quint64(1) << i;
+            }
+        }
+        window->m_paintEffectsSerial = m_paintSerial;
+    }
+    int next = chain.current;
+    while (next < chain.effects.count()) {
+        const int position = chain.positions.at(next);
+        if (position >= 64 || (window->m_paintEffects & (quint64(1) << position))) {
+            break;
+        }
+        ++next;
+    }
+    return next;
+}
+
 void EffectsHandlerImpl::prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time)
 {
-    if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintWindowIterator++)->prePaintWindow(w, data, time);
-        --m_currentPaintWindowIterator;
+    PaintChain &chain = m_paintChains[PrePaintWindowChain];
+    const int next = nextEffectForWindow(chain, w);
+    if (next < chain.effects.count()) {
+        const int saved = chain.current;
+        chain.current = next + 1;
+        chain.effects.at(next)->prePaintWindow(w, data, time);
+        chain.current = saved;
     }
     // no special final code
 }
 
 void EffectsHandlerImpl::paintWindow(EffectWindow* w, int mask, const QRegion &region, WindowPaintData& data)
 {
-    if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintWindowIterator++)->paintWindow(w, mask, region, data);
-        --m_currentPaintWindowIterator;
+    PaintChain &chain = m_paintChains[PaintWindowChain];
+    const int next = nextEffectForWindow(chain, w);
+    if (next < chain.effects.count()) {
+        const int saved = chain.current;
+        chain.current = next + 1;
+        chain.effects.at(next)->paintWindow(w, mask, region, data);
+        chain.current = saved;
     } else
         m_scene->finalPaintWindow(static_cast<EffectWindowImpl*>(w), mask, region, data);
 }
 
 void EffectsHandlerImpl::paintEffectFrame(EffectFrame* frame, const QRegion &region, double opacity, double frameOpacity)
 {
-    if (m_currentPaintEffectFrameIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintEffectFrameIterator++)->paintEffectFrame(frame, region, opacity, frameOpacity);
-        --m_currentPaintEffectFrameIterator;
+    PaintChain &chain = m_paintChains[PaintEffectFrameChain];
+    if (chain.current < chain.effects.count()) {
+        chain.effects.at(chain.current++)->paintEffectFrame(frame, region, opacity, frameOpacity);
+        --chain.current;
     } else {
         const EffectFrameImpl* frameImpl = static_cast<const EffectFrameImpl*>(frame);
         frameImpl->finalRender(region, opacity, frameOpacity);
@@ -464,9 +505,13 @@ void EffectsHandlerImpl::paintEffectFrame(EffectFrame* frame, const QRegion &reg
 
 void EffectsHandlerImpl::postPaintWindow(EffectWindow* w)
 {
-    if (m_currentPaintWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentPaintWindowIterator++)->postPaintWindow(w);
-        --m_currentPaintWindowIterator;
+    PaintChain &chain = m_paintChains[PostPaintWindowChain];
+    const int next = nextEffectForWindow(chain, w);
+    if (next < chain.effects.count()) {
+        const int saved = chain.current;
+        chain.current = next + 1;
+        chain.effects.at(next)->postPaintWindow(w);
+        chain.current = saved;
     }
     // no special final code
 }
@@ -481,26 +526,24 @@ Effect *EffectsHandlerImpl::provides(Effect::Feature ef)
 
 void EffectsHandlerImpl::drawWindow(EffectWindow* w, int mask, const QRegion &region, WindowPaintData& data)
 {
-    if (m_currentDrawWindowIterator != m_activeEffects.constEnd()) {
-        (*m_currentDrawWindowIterator++)->drawWindow(w, mask, region, data);
-        --m_currentDrawWindowIterator;
+    PaintChain &chain = m_paintChains[DrawWindowChain];
+    const int next = nextEffectForWindow(chain, w);
+    if (next < chain.effects.count()) {
+        const int saved = chain.current;
+        chain.current = next + 1;
+        chain.effects.at(next)->drawWindow(w, mask, region, data);
+        chain.current = saved;
     } else
         m_scene->finalDrawWindow(static_cast<EffectWindowImpl*>(w), mask, region, data);
 }
 
 void EffectsHandlerImpl::buildQuads(EffectWindow* w, WindowQuadList& quadList)
 {
-    static bool initIterator = true;
-    if (initIterator) {
-        m_currentBuildQuadsIterator = m_activeEffects.constBegin();
-        initIterator = false;
+    PaintChain &chain = m_paintChains[BuildQuadsChain];
+    if (chain.current < chain.effects.count()) {
+        chain.effects.at(chain.current++)->buildQuads(w, quadList);
+        --chain.current;
     }
-    if (m_currentBuildQuadsIterator != m_activeEffects.constEnd()) {
-        (*m_currentBuildQuadsIterator++)->buildQuads(w, quadList);
-        --m_currentBuildQuadsIterator;
-    }
-    if (m_currentBuildQuadsIterator == m_activeEffects.constBegin())
-        initIterator = true;
 }
 
 bool EffectsHandlerImpl::hasDecorationShadows() const
@@ -528,10 +571,49 @@ void EffectsHandlerImpl::startPaint()
             m_activeEffects << it->second;
         }
     }
-    m_currentDrawWindowIterator = m_activeEffects.constBegin();
-    m_currentPaintWindowIterator = m_activeEffects.constBegin();
-    m_currentPaintScreenIterator = m_activeEffects.constBegin();
-    m_currentPaintEffectFrameIterator = m_activeEffects.constBegin();
+
+    // each paint method only goes through the effects reimplementing it
+    clearPaintChains();
+    for (int i = 0; i < m_activeEffects.count(); ++i) {
+        Effect *effect = m_activeEffects.at(i);
+        const Effect::PaintHooks hooks = m_usePaintHooks ? effect->paintHooks() : Effect::AllPaintHooks;
+        for (int chain = 0; chain < PaintChainCount; ++chain) {
+            if (hooks & Effect::PaintHook(1 << chain)) {
+                m_paintChains[chain].effects << effect;
+                m_paintChains[chain].positions << i;
+            }
+        }
+    }
+    // invalidates the effects cached in the windows
+    ++m_paintSerial;
+}
+
+void EffectsHandlerImpl::clearPaintChains()
+{
+    for (PaintChain &chain : m_paintChains) {
+        chain.effects.clear();
+        chain.positions.clear();
+        chain.current = 0;
+    }
+}
+
+bool EffectsHandlerImpl::blocksDirectScanout() const
+{
+    // called before startPaint, so the active effects of the last frame can't be used
+    return std::any_of(loaded_effects.constBegin(), loaded_effects.constEnd(),
+        [] (const EffectPair &pair) {
+            return pair.second->isActive() && pair.second->blocksDirectScanout();
+        }
+    );
+}
+
+bool EffectsHandlerImpl::hasActiveEffects() const
+{
+    return std::any_of(loaded_effects.constBegin(), loaded_effects.constEnd(),
+        [] (const EffectPair &pair) {
+            return pair.second->isActive();
+        }
+    );
 }
 
 void EffectsHandlerImpl::slotClientMaximized(KWin::AbstractClient *c, MaximizeMode maxMode)
@@ -1518,6 +1600,7 @@ void EffectsHandlerImpl::effectsChanged()
 {
     loaded_effects.clear();
     m_activeEffects.clear(); // it's possible to have a reconfigure and a quad rebuild between two paint cycles - bug #308201
+    clearPaintChains();
 
     loaded_effects.reserve(effect_order.count());
     std::copy(effect_order.constBegin(), effect_order.constEnd(),
@@ -1741,11 +1824,6 @@ EffectWindowImpl::EffectWindowImpl(Toplevel *toplevel)
 
 EffectWindowImpl::~EffectWindowImpl()
 {
-    QVariant cachedTextureVariant = data(LanczosCacheRole);
-    if (cachedTextureVariant.isValid()) {
-        GLTexture *cachedTexture = static_cast< GLTexture*>(cachedTextureVariant.value<void*>());
-        delete cachedTexture;
-    }
 }
 
 bool EffectWindowImpl::isPaintingEnabled()
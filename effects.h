@@ -206,6 +206,14 @@ public:
 
     // internal (used by kwin core or compositing code)
     void startPaint();
+    /**
+     * Whether an active effect prevents showing client buffers on hardware planes.
+     */
+    bool blocksDirectScanout() const;
+    /**
+     * Whether any loaded effect is active and might paint windows elsewhere than at their geometry.
+     */
+    bool hasActiveEffects() const;
     void grabbedKeyboardEvent(QKeyEvent* e);
     bool hasKeyboardGrab() const;
     void desktopResized(const QSize &size);
@@ -349,14 +357,40 @@ private:
     void registerPropertyType(long atom, bool reg);
     void destroyEffect(Effect *effect);
 
+    /**
+     * The active effects which reimplement one paint method, in the order of the
+     * Effect::PaintHook flags.
+     */
+    enum PaintChainIndex {
+        PrePaintScreenChain,
+        PaintScreenChain,
+        PostPaintScreenChain,
+        PrePaintWindowChain,
+        PaintWindowChain,
+        PostPaintWindowChain,
+        DrawWindowChain,
+        BuildQuadsChain,
+        PaintEffectFrameChain,
+        PaintChainCount
+    };
+    struct PaintChain {
+        QVector<Effect *> effects;
+        // the index of each effect in m_activeEffects
+        QVector<int> positions;
+        // the next effect to call, each call restores it when it returns
+        int current = 0;
+    };
+    void clearPaintChains();
+    /**
+     * Returns the index of the next effect in the window @p chain which wants to paint @p w.
+     */
+    int nextEffectForWindow(const PaintChain &chain, EffectWindow *w);
+
     typedef QVector< Effect*> EffectsList;
-    typedef EffectsList::const_iterator EffectsIterator;
     EffectsList m_activeEffects;
-    EffectsIterator m_currentDrawWindowIterator;
-    EffectsIterator m_currentPaintWindowIterator;
-    EffectsIterator m_currentPaintEffectFrameIterator;
-    EffectsIterator m_currentPaintScreenIterator;
-    EffectsIterator m_currentBuildQuadsIterator;
+    PaintChain m_paintChains[PaintChainCount];
+    quint32 m_paintSerial = 0;
+    bool m_usePaintHooks;
     typedef QHash< QByteArray, QList< Effect*> > PropertyEffectMap;
     PropertyEffectMap m_propertiesForEffects;
     QHash<QByteArray, qulonglong> m_managedProperties;
@@ -524,6 +558,10 @@ private:
     bool managed = false;
     bool waylandClient;
     bool x11Client;
+    // the active effects which paint the window, a bit per effect of the painting pass
+    quint64 m_paintEffects = 0;
+    quint32 m_paintEffectsSerial = 0;
+    friend class EffectsHandlerImpl;
 };
 
 class EffectWindowGroupImpl
@@ -57,6 +57,9 @@ public:
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) override;
     void paintEffectFrame(EffectFrame *frame, const QRegion &region, double opacity, double frameOpacity) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PrePaintWindowHook | DrawWindowHook | PaintEffectFrameHook;
+    }
 
     bool provides(Feature feature) override;
 
@@ -64,6 +67,11 @@ public:
         return 76;
     }
 
+    // only paints behind translucent windows, which are never put on planes
+    bool blocksDirectScanout() const override {
+        return false;
+    }
+
     bool eventFilter(QObject *watched, QEvent *event) override;
 
 public Q_SLOTS:
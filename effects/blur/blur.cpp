@@ -43,6 +43,22 @@ namespace KWin
 
 static const QByteArray s_blurAtomName = QByteArrayLiteral("_KDE_NET_WM_BLUR_BEHIND_REGION");
 
+static qint64 regionArea(const QRegion &region)
+{
+    qint64 area = 0;
+    for (const QRect &rect : region) {
+        area += qint64(rect.width()) * rect.height();
+    }
+    return area;
+}
+
+// Whether copying the bounding rect of @p region costs about as much as copying its rects
+static bool isCompact(const QRegion &region)
+{
+    const QRect bounds = region.boundingRect();
+    return qint64(bounds.width()) * bounds.height() * 2 <= regionArea(region) * 3;
+}
+
 BlurEffect::BlurEffect()
 {
     initConfig<BlurConfig>();
@@ -51,6 +67,10 @@ BlurEffect::BlurEffect()
     initBlurStrengthValues();
     reconfigure(ReconfigureAll);
 
+    // timestamp queries let us measure the GPU time without waiting for the GPU
+    m_gpuTimerSupported = !GLPlatform::instance()->isGLES() &&
+            (hasGLVersion(3, 3) || hasGLExtension(QByteArrayLiteral("GL_ARB_timer_query")));
+
     // ### Hackish way to announce support.
     //     Should be included in _NET_SUPPORTED instead.
     if (m_shader && m_shader->isValid() && m_renderTargetsValid) {
@@ -84,6 +104,9 @@ BlurEffect::BlurEffect()
 BlurEffect::~BlurEffect()
 {
     deleteFBOs();
+    if (!m_timerQueries.isEmpty()) {
+        glDeleteQueries(m_timerQueries.count(), m_timerQueries.data());
+    }
 }
 
 void BlurEffect::slotScreenGeometryChanged()
@@ -489,6 +512,16 @@ void BlurEffect::prePaintScreen(ScreenPrePaintData &data, int time)
     m_paintedArea = QRegion();
     m_currentBlur = QRegion();
 
+    m_batches.clear();
+    m_windowBatches.clear();
+    m_batchCovered = QRegion();
+    m_lastBatch = -1;
+    m_renderedBatch = -1;
+    m_renderedBatchArea = QRegion();
+    m_paintedSinceBatch = QRegion();
+
+    collectGpuTime();
+
     effects->prePaintScreen(data, time);
 }
 
@@ -543,6 +576,24 @@ void BlurEffect::prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int t
 
     m_currentBlur |= expandedBlur;
 
+    // Docks don't sample outside of their blur area, they always get blurred on their own.
+    // Everything painted after a batch started hides the background of the windows above.
+    const QRegion batchArea = w->isDock() ? QRegion() : expand(blurArea & data.paint) & screen;
+    if (!batchArea.isEmpty()) {
+        // Windows far apart get their own batch, a shared one would copy everything in between.
+        if (m_lastBatch == -1 || batchArea.intersects(m_batchCovered) ||
+                !isCompact(m_batches.at(m_lastBatch) | batchArea)) {
+            m_batches.append(QRegion());
+            m_lastBatch = m_batches.count() - 1;
+            m_batchCovered = QRegion();
+        }
+        m_batches[m_lastBatch] |= batchArea;
+        m_windowBatches.insert(w, m_lastBatch);
+    }
+    if (m_lastBatch != -1) {
+        m_batchCovered |= w->expandedGeometry();
+    }
+
     // we don't consider damaged areas which are occluded and are not
     // explicitly damaged by this window
     m_damagedArea -= data.clip;
@@ -607,12 +658,24 @@ void BlurEffect::drawWindow(EffectWindow *w, int mask, const QRegion &region, Wi
         }
 
         if (!shape.isEmpty()) {
-            doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), w->isDock(), w->geometry());
+            if (translated || scaled || !doBatchedBlur(w, shape, screen, data.opacity(), data.screenProjectionMatrix())) {
+                doBlur(shape, screen, data.opacity(), data.screenProjectionMatrix(), w->isDock(), w->geometry());
+            }
         }
     }
 
     // Draw the window over the blurred area
     effects->drawWindow(w, mask, region, data);
+
+    // the background of the following windows of the batch must not change
+    if (m_renderedBatch != -1) {
+        if ((mask & PAINT_WINDOW_TRANSFORMED) || data.xTranslation() || data.yTranslation() ||
+                data.xScale() != 1 || data.yScale() != 1) {
+            m_renderedBatch = -1;
+        } else {
+            m_paintedSinceBatch |= region & w->expandedGeometry();
+        }
+    }
 }
 
 void BlurEffect::paintEffectFrame(EffectFrame *frame, const QRegion &region, double opacity, double frameOpacity)
@@ -626,6 +689,7 @@ void BlurEffect::paintEffectFrame(EffectFrame *frame, const QRegion &region, dou
         doBlur(shape, screen, opacity * frameOpacity, frame->screenProjectionMatrix(), false, frame->geometry());
     }
     effects->paintEffectFrame(frame, region, opacity, frameOpacity);
+    m_renderedBatch = -1;
 }
 
 void BlurEffect::generateNoiseTexture()
@@ -664,7 +728,7 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
 
     const QRegion expandedBlurRegion = expand(shape) & expand(screen);
 
-    const bool useSRGB = m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8;
+    beginGpuTimer();
 
     // Upload geometry for the down and upsample iterations
     GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
@@ -673,6 +737,75 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
     uploadGeometry(vbo, expandedBlurRegion.translated(xTranslate, yTranslate), shape);
     vbo->bindArrays();
 
+    blurTextures(vbo, expandedBlurRegion, shape, screen, screenProjection, isDock);
+
+    const int blurRectCount = expandedBlurRegion.rectCount() * 6;
+    blurToScreen(vbo, blurRectCount * (m_downSampleIterations + 1), shape, opacity, screenProjection, windowRect);
+
+    vbo->unbindArrays();
+
+    endGpuTimer();
+
+    // the render targets don't contain the downsample chain of a batch anymore
+    m_renderedBatch = -1;
+    m_currentFrame.blurredWindows++;
+}
+
+bool BlurEffect::doBatchedBlur(EffectWindow *w, const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection)
+{
+    const auto it = m_windowBatches.constFind(w);
+    if (it == m_windowBatches.constEnd()) {
+        return false;
+    }
+    const int batch = *it;
+    const QRegion expandedBlurRegion = expand(shape) & expand(screen);
+
+    beginGpuTimer();
+
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    const bool reusable = m_renderedBatch == batch && m_renderedBatchScreen == screen &&
+            (expandedBlurRegion - m_renderedBatchArea).isEmpty() &&
+            !expandedBlurRegion.intersects(m_paintedSinceBatch);
+    if (!reusable) {
+        // Blur the area of all windows of the batch at once, the windows above will sample
+        // from the same textures.
+        const int xTranslate = -screen.x();
+        const int yTranslate = effects->virtualScreenSize().height() - screen.height() - screen.y();
+        const QRegion batchArea = (m_batches.at(batch) & expand(screen)) | expandedBlurRegion;
+
+        vbo->reset();
+        uploadGeometry(vbo, batchArea.translated(xTranslate, yTranslate), QRegion());
+        vbo->bindArrays();
+        blurTextures(vbo, batchArea, QRegion(), screen, screenProjection, false);
+        vbo->unbindArrays();
+
+        m_renderedBatch = batch;
+        m_renderedBatchScreen = screen;
+        m_renderedBatchArea = batchArea;
+        m_paintedSinceBatch = QRegion();
+    } else if (m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+
+    vbo->reset();
+    uploadGeometry(vbo, QRegion(), shape);
+    vbo->bindArrays();
+    blurToScreen(vbo, 0, shape, opacity, screenProjection, w->geometry());
+    vbo->unbindArrays();
+
+    endGpuTimer();
+
+    m_currentFrame.blurredWindows++;
+    return true;
+}
+
+void BlurEffect::blurTextures(GLVertexBuffer *vbo, const QRegion &expandedBlurRegion, const QRegion &shape, const QRect &screen, const QMatrix4x4 &screenProjection, bool isDock)
+{
+    const int xTranslate = -screen.x();
+    const int yTranslate = effects->virtualScreenSize().height() - screen.height() - screen.y();
+
+    const bool useSRGB = m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8;
+
     const QRect sourceRect = expandedBlurRegion.boundingRect() & screen;
     const QRect destRect = sourceRect.translated(xTranslate, yTranslate);
 
@@ -695,7 +828,14 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
 
         copyScreenSampleTexture(vbo, blurRectCount, shape.translated(xTranslate, yTranslate), screenProjection);
     } else {
-        m_renderTargets.first()->blitFromFramebuffer(sourceRect, destRect);
+        const QRegion sourceRegion = expandedBlurRegion & screen;
+        if (isCompact(sourceRegion)) {
+            m_renderTargets.first()->blitFromFramebuffer(sourceRect, destRect);
+        } else {
+            for (const QRect &rect : sourceRegion) {
+                m_renderTargets.first()->blitFromFramebuffer(rect, rect.translated(xTranslate, yTranslate));
+            }
+        }
 
         if (useSRGB) {
             glEnable(GL_FRAMEBUFFER_SRGB);
@@ -708,6 +848,13 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
     downSampleTexture(vbo, blurRectCount);
     upSampleTexture(vbo, blurRectCount);
 
+    m_currentFrame.downSampleChains++;
+}
+
+void BlurEffect::blurToScreen(GLVertexBuffer *vbo, int vboStart, const QRegion &shape, const float opacity, const QMatrix4x4 &screenProjection, QRect windowRect)
+{
+    const bool useSRGB = m_renderTextures.first().internalFormat() == GL_SRGB8_ALPHA8;
+
     // Modulate the blurred texture with the window opacity if the window isn't opaque
     if (opacity < 1.0) {
         glEnable(GL_BLEND);
@@ -722,7 +869,7 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
         glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
     }
 
-    upscaleRenderToScreen(vbo, blurRectCount * (m_downSampleIterations + 1), shape.rectCount() * 6, screenProjection, windowRect.topLeft());
+    upscaleRenderToScreen(vbo, vboStart, shape.rectCount() * 6, screenProjection, windowRect.topLeft());
 
     if (useSRGB) {
         glDisable(GL_FRAMEBUFFER_SRGB);
@@ -731,8 +878,6 @@ void BlurEffect::doBlur(const QRegion& shape, const QRect& screen, const float o
     if (opacity < 1.0) {
         glDisable(GL_BLEND);
     }
-
-    vbo->unbindArrays();
 }
 
 void BlurEffect::upscaleRenderToScreen(GLVertexBuffer *vbo, int vboStart, int blurRectCount, QMatrix4x4 screenProjection, QPoint windowPosition)
@@ -831,5 +976,63 @@ void BlurEffect::copyScreenSampleTexture(GLVertexBuffer *vbo, int blurRectCount,
     m_shader->unbind();
 }
 
+void BlurEffect::beginGpuTimer()
+{
+    if (!m_gpuTimerSupported) {
+        return;
+    }
+    if (m_usedTimerQueries + 2 > m_timerQueries.count()) {
+        const int count = m_timerQueries.count();
+        m_timerQueries.resize(count + 8);
+        glGenQueries(8, m_timerQueries.data() + count);
+    }
+    glQueryCounter(m_timerQueries[m_usedTimerQueries], GL_TIMESTAMP);
+}
+
+void BlurEffect::endGpuTimer()
+{
+    if (!m_gpuTimerSupported) {
+        return;
+    }
+    glQueryCounter(m_timerQueries[m_usedTimerQueries + 1], GL_TIMESTAMP);
+    m_usedTimerQueries += 2;
+}
+
+void BlurEffect::collectGpuTime()
+{
+    // The previous frame has been submitted already. If the GPU isn't done with it yet,
+    // we don't wait for it, the time is reported as unknown instead.
+    if (m_usedTimerQueries > 0) {
+        GLint available = 0;
+        glGetQueryObjectiv(m_timerQueries[m_usedTimerQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            m_currentFrame.gpuTime = 0;
+            for (int i = 0; i < m_usedTimerQueries; i += 2) {
+                GLuint64 start = 0;
+                GLuint64 end = 0;
+                glGetQueryObjectui64v(m_timerQueries[i], GL_QUERY_RESULT, &start);
+                glGetQueryObjectui64v(m_timerQueries[i + 1], GL_QUERY_RESULT, &end);
+                m_currentFrame.gpuTime += end - start;
+            }
+        }
+    } else if (m_gpuTimerSupported) {
+        m_currentFrame.gpuTime = 0;
+    }
+    m_usedTimerQueries = 0;
+    m_lastFrame = m_currentFrame;
+    m_currentFrame = FrameStatistics();
+}
+
+QString BlurEffect::debug(const QString &parameter) const
+{
+    Q_UNUSED(parameter)
+    const QString gpuTime = m_lastFrame.gpuTime < 0 ? QStringLiteral("unknown")
+                                                    : QStringLiteral("%1 us").arg(m_lastFrame.gpuTime / 1000);
+    return QStringLiteral("GPU time of the last frame: %1\nDownsample chains: %2\nBlurred windows: %3")
+            .arg(gpuTime)
+            .arg(m_lastFrame.downSampleChains)
+            .arg(m_lastFrame.blurredWindows);
+}
+
 } // namespace KWin
 
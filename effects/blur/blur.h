@@ -25,6 +25,7 @@
 #include <kwinglplatform.h>
 #include <kwinglutils.h>
 
+#include <QHash>
 #include <QVector>
 #include <QVector2D>
 #include <QStack>
@@ -60,6 +61,9 @@ public:
     void prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time) override;
     void drawWindow(EffectWindow *w, int mask, const QRegion &region, WindowPaintData &data) override;
     void paintEffectFrame(EffectFrame *frame, const QRegion &region, double opacity, double frameOpacity) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PrePaintWindowHook | DrawWindowHook | PaintEffectFrameHook;
+    }
 
     bool provides(Feature feature) override;
 
@@ -67,8 +71,15 @@ public:
         return 75;
     }
 
+    // only paints behind translucent windows, which are never put on planes
+    bool blocksDirectScanout() const override {
+        return false;
+    }
+
     bool eventFilter(QObject *watched, QEvent *event) override;
 
+    QString debug(const QString &parameter) const override;
+
 public Q_SLOTS:
     void slotWindowAdded(KWin::EffectWindow *w);
     void slotWindowDeleted(KWin::EffectWindow *w);
@@ -86,10 +97,17 @@ private:
     bool shouldBlur(const EffectWindow *w, int mask, const WindowPaintData &data) const;
     void updateBlurRegion(EffectWindow *w) const;
     void doBlur(const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection, bool isDock, QRect windowRect);
+    bool doBatchedBlur(EffectWindow *w, const QRegion &shape, const QRect &screen, const float opacity, const QMatrix4x4 &screenProjection);
+    void blurTextures(GLVertexBuffer *vbo, const QRegion &expandedBlurRegion, const QRegion &shape, const QRect &screen, const QMatrix4x4 &screenProjection, bool isDock);
+    void blurToScreen(GLVertexBuffer *vbo, int vboStart, const QRegion &shape, const float opacity, const QMatrix4x4 &screenProjection, QRect windowRect);
     void uploadRegion(QVector2D *&map, const QRegion &region, const int downSampleIterations);
     void uploadGeometry(GLVertexBuffer *vbo, const QRegion &blurRegion, const QRegion &windowRegion);
     void generateNoiseTexture();
 
+    void beginGpuTimer();
+    void endGpuTimer();
+    void collectGpuTime();
+
     void upscaleRenderToScreen(GLVertexBuffer *vbo, int vboStart, int blurRectCount, QMatrix4x4 screenProjection, QPoint windowPosition);
     void downSampleTexture(GLVertexBuffer *vbo, int blurRectCount);
     void upSampleTexture(GLVertexBuffer *vbo, int blurRectCount);
@@ -109,6 +127,21 @@ private:
     QRegion m_paintedArea; // actually painted area which is greater than m_damagedArea
     QRegion m_currentBlur; // keeps track of the currently blured area of the windows(from bottom to top)
 
+    /*
+     * Windows whose blurred areas are not covered by any window painted between them
+     * see the same background, so they are put into a batch which runs the downsample
+     * chain only once. The batches are formed in prePaintWindow (from bottom to top).
+     */
+    QVector<QRegion> m_batches; // the expanded blur areas of the windows in each batch
+    QHash<EffectWindow*, int> m_windowBatches;
+    QRegion m_batchCovered; // everything painted since the last batch started
+    int m_lastBatch = -1;
+    // the batch whose downsample chain is currently in the render targets
+    int m_renderedBatch = -1;
+    QRect m_renderedBatchScreen;
+    QRegion m_renderedBatchArea;
+    QRegion m_paintedSinceBatch; // painted since the downsample chain got rendered
+
     int m_downSampleIterations; // number of times the texture will be downsized to half size
     int m_offset;
     int m_expandSize;
@@ -131,6 +164,17 @@ private:
     QVector <BlurValuesStruct> blurStrengthValues;
 
     QMap <EffectWindow*, QMetaObject::Connection> windowBlurChangedConnections;
+
+    struct FrameStatistics {
+        qint64 gpuTime = -1; // in nanoseconds, -1 if not known
+        int downSampleChains = 0;
+        int blurredWindows = 0;
+    };
+    FrameStatistics m_currentFrame;
+    FrameStatistics m_lastFrame;
+    bool m_gpuTimerSupported = false;
+    QVector<GLuint> m_timerQueries;
+    int m_usedTimerQueries = 0;
     KWayland::Server::BlurManagerInterface *m_blurManager = nullptr;
 };
 
@@ -57,6 +57,9 @@ public:
     void paintScreen(int mask, const QRegion &region, ScreenPaintData &data) override;
     void postPaintScreen() override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook | PostPaintScreenHook | PaintWindowHook;
+    }
     void windowInputMouseEvent(QEvent *e) override;
     bool isActive() const override;
 
@@ -63,6 +63,9 @@ public:
     void postPaintScreen() override;
     void prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time) override;
     void paintWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
     bool borderActivated(ElectricBorder border) override;
     void grabbedKeyboardEvent(QKeyEvent* e) override;
     void windowInputMouseEvent(QEvent* e) override;
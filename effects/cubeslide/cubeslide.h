@@ -47,6 +47,9 @@ public:
     void postPaintScreen() override;
     void prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time) override;
     void paintWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
     bool isActive() const override;
 
     int requestedEffectChainPosition() const override {
@@ -74,6 +74,9 @@ public:
     void postPaintScreen() override;
     void prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time) override;
     void paintWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
     void windowInputMouseEvent(QEvent* e) override;
     void grabbedKeyboardEvent(QKeyEvent* e) override;
     bool borderActivated(ElectricBorder border) override;
@@ -199,6 +199,11 @@ bool GlideEffect::isActive() const
     return !m_animations.isEmpty();
 }
 
+bool GlideEffect::isActiveForWindow(EffectWindow *w) const
+{
+    return m_animations.contains(w);
+}
+
 bool GlideEffect::supported()
 {
     return effects->isOpenGLCompositing()
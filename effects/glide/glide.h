@@ -53,8 +53,12 @@ public:
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
     void postPaintScreen() override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
 
     bool isActive() const override;
+    bool isActiveForWindow(EffectWindow *w) const override;
     int requestedEffectChainPosition() const override;
 
     static bool supported();
@@ -37,6 +37,9 @@ public:
     void postPaintScreen() override;
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
 
     void reconfigure(ReconfigureFlags flags) override;
     bool isActive() const override;
@@ -47,6 +47,9 @@ public:
 
     void prePaintScreen(ScreenPrePaintData& data, int time) override;
     void paintScreen(int mask, const QRegion &region, ScreenPaintData &data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook;
+    }
     bool isActive() const override;
 
     static bool supported();
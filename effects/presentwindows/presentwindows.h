@@ -104,6 +104,9 @@ public:
     // Window painting
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
 
     // User interaction
     bool borderActivated(ElectricBorder border) override;
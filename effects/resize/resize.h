@@ -42,6 +42,10 @@ public:
     void prePaintScreen(ScreenPrePaintData& data, int time) override;
     void prePaintWindow(EffectWindow* w, WindowPrePaintData& data, int time) override;
     void paintWindow(EffectWindow* w, int mask, QRegion region, WindowPaintData& data) override;
+    PaintHooks paintHooks() const override {
+        // AnimationEffect also needs postPaintScreen
+        return PrePaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
     void reconfigure(ReconfigureFlags) override;
 
     int requestedEffectChainPosition() const override {
@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <kwinxrenderutils.h>
 #include <QtConcurrentRun>
 #include <QDataStream>
+#include <QFutureWatcher>
 #include <QTemporaryFile>
 #include <QDir>
 #include <QDBusConnection>
@@ -57,6 +58,26 @@ bool ScreenShotEffect::supported()
             (effects->isOpenGLCompositing() && GLRenderTarget::supported());
 }
 
+struct ScreenShotEffect::PendingReadback
+{
+    explicit PendingReadback(PixelBufferRing *ring)
+        : readback(ring)
+    {
+    }
+    GLPixelReadback readback;
+    /**
+     * Repainted until the GPU copied the pixels, so that they get picked up.
+     */
+    QRect area;
+    /**
+     * Converts the mapped pixels, only created once the GPU copied them.
+     */
+    QFutureWatcher<QImage> *watcher = nullptr;
+    std::function<void (const QImage &)> callback;
+    QImage cursor;
+    QPoint cursorPos;
+};
+
 ScreenShotEffect::ScreenShotEffect()
     : m_scheduledScreenshot(nullptr)
 {
@@ -67,6 +88,18 @@ ScreenShotEffect::ScreenShotEffect()
 ScreenShotEffect::~ScreenShotEffect()
 {
     QDBusConnection::sessionBus().unregisterObject(QStringLiteral("/Screenshot"));
+    if (m_readbackRing) {
+        effects->makeOpenGLContextCurrent();
+        for (PendingReadback *pending : qAsConst(m_pendingReadbacks)) {
+            if (pending->watcher) {
+                // the conversion still reads the mapped memory
+                pending->watcher->waitForFinished();
+                delete pending->watcher;
+            }
+            delete pending;
+        }
+        m_readbackRing.reset();
+    }
 }
 
 #ifdef KWIN_HAVE_XRENDER_COMPOSITING
@@ -165,6 +198,9 @@ void ScreenShotEffect::paintScreen(int mask, const QRegion &region, ScreenPaintD
 void ScreenShotEffect::postPaintScreen()
 {
     effects->postPaintScreen();
+    if (!m_pendingReadbacks.isEmpty()) {
+        pollReadbacks();
+    }
     if (m_scheduledScreenshot) {
         WindowPaintData d(m_scheduledScreenshot);
         double left = 0;
@@ -214,7 +250,7 @@ void ScreenShotEffect::postPaintScreen()
 
             // render window into offscreen texture
             int mask = PAINT_WINDOW_TRANSFORMED | PAINT_WINDOW_TRANSLUCENT;
-            QImage img;
+            const QPoint origin(m_scheduledScreenshot->x() + left, m_scheduledScreenshot->y() + top);
             if (effects->isOpenGLCompositing()) {
                 GLRenderTarget::pushRenderTarget(target.data());
                 glClearColor(0.0, 0.0, 0.0, 0.0);
@@ -228,51 +264,30 @@ void ScreenShotEffect::postPaintScreen()
                 effects->drawWindow(m_scheduledScreenshot, mask, infiniteRegion(), d);
 
                 // copy content from framebuffer into image
-                img = QImage(QSize(width, height), QImage::Format_ARGB32);
-                glReadnPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(), (GLvoid*)img.bits());
+                readFramebuffer(QRect(0, 0, width, height), origin, m_type & INCLUDE_CURSOR,
+                    [this] (const QImage &img) {
+                        sendWindowScreenshot(img);
+                    }
+                );
                 GLRenderTarget::popRenderTarget();
-                ScreenShotEffect::convertFromGLImage(img, width, height);
             }
 #ifdef KWIN_HAVE_XRENDER_COMPOSITING
-            xcb_image_t *xImage = nullptr;
             if (effects->compositingType() == XRenderCompositing) {
+                QImage img;
+                xcb_image_t *xImage = nullptr;
                 setXRenderOffscreen(true);
                 effects->drawWindow(m_scheduledScreenshot, mask, QRegion(0, 0, width, height), d);
                 if (xRenderOffscreenTarget()) {
                     img = xPictureToImage(xRenderOffscreenTarget(), QRect(0, 0, width, height), &xImage);
                 }
                 setXRenderOffscreen(false);
-            }
-#endif
-
-            if (m_type & INCLUDE_CURSOR) {
-                grabPointerImage(img, m_scheduledScreenshot->x() + left, m_scheduledScreenshot->y() + top);
-            }
-
-            if (m_windowMode == WindowMode::Xpixmap) {
-                const xcb_pixmap_t xpix = xpixmapFromImage(img);
-                emit screenshotCreated(xpix);
-                m_windowMode = WindowMode::NoCapture;
-            } else if (m_windowMode == WindowMode::File) {
-                sendReplyImage(img);
-            } else if (m_windowMode == WindowMode::FileDescriptor) {
-                QtConcurrent::run(
-                    [] (int fd, const QImage &img) {
-                        QFile file;
-                        if (file.open(fd, QIODevice::WriteOnly, QFileDevice::AutoCloseHandle)) {
-                            QDataStream ds(&file);
-                            ds << img;
-                            file.close();
-                        } else {
-                            close(fd);
-                        }
-                    }, m_fd, img);
-                m_windowMode = WindowMode::NoCapture;
-                m_fd = -1;
-            }
-#ifdef KWIN_HAVE_XRENDER_COMPOSITING
-            if (xImage) {
-                xcb_image_destroy(xImage);
+                if (m_type & INCLUDE_CURSOR) {
+                    grabPointerImage(img, origin.x(), origin.y());
+                }
+                sendWindowScreenshot(img);
+                if (xImage) {
+                    xcb_image_destroy(xImage);
+                }
             }
 #endif
         }
@@ -283,36 +298,68 @@ void ScreenShotEffect::postPaintScreen()
         if (!m_cachedOutputGeometry.isNull()) {
             // special handling for per-output geometry rendering
             const QRect intersection = m_scheduledGeometry.intersected(m_cachedOutputGeometry);
-            if (intersection.isEmpty()) {
-                // doesn't intersect, not going onto this screenshot
-                return;
-            }
-            const QImage img = blitScreenshot(intersection);
-            if (img.size() == m_scheduledGeometry.size()) {
-                // we are done
-                sendReplyImage(img);
+            if (intersection.isEmpty() || m_requestedGeometry.intersects(intersection)) {
+                // doesn't intersect or is already being read, not going onto this screenshot
                 return;
             }
-            if (m_multipleOutputsImage.isNull()) {
-                m_multipleOutputsImage = QImage(m_scheduledGeometry.size(), QImage::Format_ARGB32);
-                m_multipleOutputsImage.fill(Qt::transparent);
-            }
-            QPainter p;
-            p.begin(&m_multipleOutputsImage);
-            p.drawImage(intersection.topLeft() - m_scheduledGeometry.topLeft(), img);
-            p.end();
-            m_multipleOutputsRendered = m_multipleOutputsRendered.united(intersection);
-            if (m_multipleOutputsRendered.boundingRect() == m_scheduledGeometry) {
-                sendReplyImage(m_multipleOutputsImage);
-            }
-
-        } else {
-            const QImage img = blitScreenshot(m_scheduledGeometry);
-            sendReplyImage(img);
+            m_requestedGeometry += intersection;
+            blitScreenshot(intersection,
+                [this, intersection] (const QImage &img) {
+                    if (img.size() == m_scheduledGeometry.size()) {
+                        // we are done
+                        sendReplyImage(img);
+                        return;
+                    }
+                    if (m_multipleOutputsImage.isNull()) {
+                        m_multipleOutputsImage = QImage(m_scheduledGeometry.size(), QImage::Format_ARGB32);
+                        m_multipleOutputsImage.fill(Qt::transparent);
+                    }
+                    QPainter p;
+                    p.begin(&m_multipleOutputsImage);
+                    p.drawImage(intersection.topLeft() - m_scheduledGeometry.topLeft(), img);
+                    p.end();
+                    m_multipleOutputsRendered = m_multipleOutputsRendered.united(intersection);
+                    if (m_multipleOutputsRendered.boundingRect() == m_scheduledGeometry) {
+                        sendReplyImage(m_multipleOutputsImage);
+                    }
+                }
+            );
+        } else if (m_requestedGeometry.isEmpty()) {
+            m_requestedGeometry = m_scheduledGeometry;
+            blitScreenshot(m_scheduledGeometry,
+                [this] (const QImage &img) {
+                    sendReplyImage(img);
+                }
+            );
         }
     }
 }
 
+void ScreenShotEffect::sendWindowScreenshot(const QImage &img)
+{
+    if (m_windowMode == WindowMode::Xpixmap) {
+        const xcb_pixmap_t xpix = xpixmapFromImage(img);
+        emit screenshotCreated(xpix);
+        m_windowMode = WindowMode::NoCapture;
+    } else if (m_windowMode == WindowMode::File) {
+        sendReplyImage(img);
+    } else if (m_windowMode == WindowMode::FileDescriptor) {
+        QtConcurrent::run(
+            [] (int fd, const QImage &img) {
+                QFile file;
+                if (file.open(fd, QIODevice::WriteOnly, QFileDevice::AutoCloseHandle)) {
+                    QDataStream ds(&file);
+                    ds << img;
+                    file.close();
+                } else {
+                    close(fd);
+                }
+            }, m_fd, img);
+        m_windowMode = WindowMode::NoCapture;
+        m_fd = -1;
+    }
+}
+
 void ScreenShotEffect::sendReplyImage(const QImage &img)
 {
     if (m_fd != -1) {
@@ -329,9 +376,26 @@ void ScreenShotEffect::sendReplyImage(const QImage &img)
             }, m_fd, img);
         m_fd = -1;
     } else {
-        QDBusConnection::sessionBus().send(m_replyMessage.createReply(saveTempImage(img)));
+        // encoding the image takes long, the reply is sent once it is saved
+        const QDBusMessage replyMessage = m_replyMessage;
+        auto watcher = new QFutureWatcher<QString>(this);
+        connect(watcher, &QFutureWatcher<QString>::finished, this,
+            [watcher, replyMessage] {
+                watcher->deleteLater();
+                const QString fileName = watcher->result();
+                if (!fileName.isEmpty()) {
+                    KNotification::event(KNotification::Notification,
+                                        i18nc("Notification caption that a screenshot got saved to file", "Screenshot"),
+                                        i18nc("Notification with path to screenshot file", "Screenshot saved to %1", fileName),
+                                        QStringLiteral("spectacle"));
+                }
+                QDBusConnection::sessionBus().send(replyMessage.createReply(fileName));
+            }
+        );
+        watcher->setFuture(QtConcurrent::run(&ScreenShotEffect::saveTempImage, img));
     }
     m_scheduledGeometry = QRect();
+    m_requestedGeometry = QRegion();
     m_multipleOutputsImage = QImage();
     m_multipleOutputsRendered = QRegion();
     m_captureCursor = false;
@@ -350,10 +414,6 @@ QString ScreenShotEffect::saveTempImage(const QImage &img)
     }
     img.save(&temp);
     temp.close();
-    KNotification::event(KNotification::Notification,
-                        i18nc("Notification caption that a screenshot got saved to file", "Screenshot"),
-                        i18nc("Notification with path to screenshot file", "Screenshot saved to %1", temp.fileName()),
-                        QStringLiteral("spectacle"));
     return temp.fileName();
 }
 
@@ -604,26 +664,24 @@ QString ScreenShotEffect::screenshotArea(int x, int y, int width, int height, bo
     return QString();
 }
 
-QImage ScreenShotEffect::blitScreenshot(const QRect &geometry)
+void ScreenShotEffect::blitScreenshot(const QRect &geometry, std::function<void (const QImage &)> callback)
 {
-    QImage img;
-    if (effects->isOpenGLCompositing())
-    {
-        img = QImage(geometry.size(), QImage::Format_ARGB32);
+    if (effects->isOpenGLCompositing()) {
         if (GLRenderTarget::blitSupported() && !GLPlatform::instance()->isGLES()) {
             GLTexture tex(GL_RGBA8, geometry.width(), geometry.height());
             GLRenderTarget target(tex);
             target.blitFromFramebuffer(geometry);
             // copy content from framebuffer into image
-            tex.bind();
-            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)img.bits());
-            tex.unbind();
+            GLRenderTarget::pushRenderTarget(&target);
+            readFramebuffer(QRect(QPoint(0, 0), geometry.size()), geometry.topLeft(), m_captureCursor, callback);
+            GLRenderTarget::popRenderTarget();
         } else {
-            glReadPixels(0, 0, img.width(), img.height(), GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)img.bits());
+            readFramebuffer(QRect(QPoint(0, 0), geometry.size()), geometry.topLeft(), m_captureCursor, callback);
         }
-        ScreenShotEffect::convertFromGLImage(img, geometry.width(), geometry.height());
+        return;
     }
 
+    QImage img;
 #ifdef KWIN_HAVE_XRENDER_COMPOSITING
     if (effects->compositingType() == XRenderCompositing) {
     xcb_image_t *xImage = nullptr;
@@ -638,7 +696,100 @@ QImage ScreenShotEffect::blitScreenshot(const QRect &geometry)
         grabPointerImage(img, geometry.x(), geometry.y());
     }
 
-    return img;
+    callback(img);
+}
+
+void ScreenShotEffect::readFramebuffer(const QRect &rect, const QPoint &origin, bool captureCursor,
+                                       std::function<void (const QImage &)> callback)
+{
+    QImage cursor;
+    QPoint cursorPos;
+    if (captureCursor) {
+        const auto cursorImage = effects->cursorImage();
+        cursor = cursorImage.image();
+        cursorPos = effects->cursorPos() - cursorImage.hotSpot() - origin;
+    }
+
+    if (GLPixelReadback::supported()) {
+        if (!m_readbackRing) {
+            m_readbackRing.reset(new PixelBufferRing(GL_PIXEL_PACK_BUFFER));
+        }
+        // the pixels are copied while the GPU continues with the next frames, they are
+        // picked up in a later frame once the fence is signalled
+        PendingReadback *pending = new PendingReadback(m_readbackRing.data());
+        if (pending->readback.read(rect)) {
+            pending->area = QRect(origin, rect.size());
+            pending->callback = callback;
+            pending->cursor = cursor;
+            pending->cursorPos = cursorPos;
+            m_pendingReadbacks << pending;
+            effects->addRepaint(pending->area);
+            return;
+        }
+        // all buffers are still in use by other read backs
+        delete pending;
+    }
+
+    QImage img(rect.size(), QImage::Format_ARGB32);
+    glReadnPixels(rect.x(), rect.y(), rect.width(), rect.height(), GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(), (GLvoid*)img.bits());
+    ScreenShotEffect::convertFromGLImage(img, rect.width(), rect.height());
+    if (!cursor.isNull()) {
+        QPainter painter(&img);
+        painter.drawImage(cursorPos, cursor);
+    }
+    callback(img);
+}
+
+void ScreenShotEffect::pollReadbacks()
+{
+    for (PendingReadback *pending : qAsConst(m_pendingReadbacks)) {
+        if (pending->watcher) {
+            continue;
+        }
+        if (!pending->readback.isFinished()) {
+            // another frame is needed to check again
+            effects->addRepaint(pending->area);
+            continue;
+        }
+        // the conversion and the cursor are done on a worker thread, the memory stays
+        // mapped until it is finished
+        pending->watcher = new QFutureWatcher<QImage>();
+        connect(pending->watcher, &QFutureWatcher<QImage>::finished, this,
+            [this, pending] {
+                finishReadback(pending);
+            }
+        );
+        const uchar *data = pending->readback.map();
+        if (!data) {
+            pending->watcher->setFuture(QtConcurrent::run([] { return QImage(); }));
+            continue;
+        }
+        const QSize size = pending->readback.size();
+        const QImage cursor = pending->cursor;
+        const QPoint cursorPos = pending->cursorPos;
+        pending->watcher->setFuture(QtConcurrent::run(
+            [data, size, cursor, cursorPos] {
+                QImage img = GLPixelReadback::toImage(data, size);
+                if (!cursor.isNull()) {
+                    QPainter painter(&img);
+                    painter.drawImage(cursorPos, cursor);
+                }
+                return img;
+            }
+        ));
+    }
+}
+
+void ScreenShotEffect::finishReadback(PendingReadback *pending)
+{
+    m_pendingReadbacks.removeOne(pending);
+    const QImage img = pending->watcher->result();
+    const auto callback = pending->callback;
+    pending->watcher->deleteLater();
+    effects->makeOpenGLContextCurrent();
+    pending->readback.unmap();
+    delete pending;
+    callback(img);
 }
 
 void ScreenShotEffect::grabPointerImage(QImage& snapshot, int offsetx, int offsety)
@@ -684,6 +835,10 @@ void ScreenShotEffect::convertFromGLImage(QImage &img, int w, int h)
 
 bool ScreenShotEffect::isActive() const
 {
+    if (!m_pendingReadbacks.isEmpty()) {
+        // postPaintScreen() has to pick up the read back pixels
+        return true;
+    }
     return (m_scheduledScreenshot != nullptr || !m_scheduledGeometry.isNull()) && !effects->isScreenLocked();
 }
 
@@ -29,9 +29,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QImage>
 
+#include <functional>
+
 namespace KWin
 {
 
+class PixelBufferRing;
+
 class ScreenShotEffect : public Effect, protected QDBusContext
 {
     Q_OBJECT
@@ -46,6 +50,9 @@ public:
 
     void paintScreen(int mask, const QRegion &region, ScreenPaintData &data) override;
     void postPaintScreen() override;
+    PaintHooks paintHooks() const override {
+        return PaintScreenHook | PostPaintScreenHook;
+    }
     bool isActive() const override;
 
     int requestedEffectChainPosition() const override {
@@ -140,10 +147,23 @@ private Q_SLOTS:
     void windowClosed( KWin::EffectWindow* w );
 
 private:
+    struct PendingReadback;
     void grabPointerImage(QImage& snapshot, int offsetx, int offsety);
-    QImage blitScreenshot(const QRect &geometry);
-    QString saveTempImage(const QImage &img);
+    void blitScreenshot(const QRect &geometry, std::function<void (const QImage &)> callback);
+    /**
+     * Reads @p rect of the bound framebuffer and passes the image to @p callback, once the
+     * GPU copied it and it got converted on a worker thread.
+     */
+    void readFramebuffer(const QRect &rect, const QPoint &origin, bool captureCursor,
+                         std::function<void (const QImage &)> callback);
+    /**
+     * Picks up the read backs the GPU finished, called once per frame.
+     */
+    void pollReadbacks();
+    void finishReadback(PendingReadback *pending);
+    static QString saveTempImage(const QImage &img);
     void sendReplyImage(const QImage &img);
+    void sendWindowScreenshot(const QImage &img);
     enum class InfoMessageMode {
         Window,
         Screen
@@ -154,6 +174,10 @@ private:
     EffectWindow *m_scheduledScreenshot;
     ScreenShotType m_type;
     QRect m_scheduledGeometry;
+    /**
+     * The parts of the scheduled geometry which are already being read back.
+     */
+    QRegion m_requestedGeometry;
     QDBusMessage m_replyMessage;
     QRect m_cachedOutputGeometry;
     QImage m_multipleOutputsImage;
@@ -167,6 +191,8 @@ private:
     };
     WindowMode m_windowMode = WindowMode::NoCapture;
     int m_fd = -1;
+    QList<PendingReadback *> m_pendingReadbacks;
+    QScopedPointer<PixelBufferRing> m_readbackRing;
 };
 
 } // namespace
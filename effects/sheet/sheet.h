@@ -43,6 +43,9 @@ public:
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
     void postPaintWindow(EffectWindow *w) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PrePaintWindowHook | PaintWindowHook | PostPaintWindowHook;
+    }
 
     bool isActive() const override;
     int requestedEffectChainPosition() const override;
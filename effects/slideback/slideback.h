@@ -40,6 +40,9 @@ public:
 
     void prePaintScreen(ScreenPrePaintData &data, int time) override;
     void postPaintScreen() override;
+    PaintHooks paintHooks() const override {
+        return PrePaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook | PostPaintWindowHook;
+    }
     bool isActive() const override;
 
     int requestedEffectChainPosition() const override {
@@ -540,4 +540,9 @@ bool SlidingPopupsEffect::isActive() const
     return !m_animations.isEmpty();
 }
 
+bool SlidingPopupsEffect::isActiveForWindow(EffectWindow *w) const
+{
+    return m_animations.contains(w);
+}
+
 } // namespace
@@ -41,8 +41,12 @@ public:
     void prePaintWindow(EffectWindow *w, WindowPrePaintData &data, int time) override;
     void paintWindow(EffectWindow *w, int mask, QRegion region, WindowPaintData &data) override;
     void postPaintWindow(EffectWindow *w) override;
+    PaintHooks paintHooks() const override {
+        return PrePaintWindowHook | PaintWindowHook | PostPaintWindowHook;
+    }
     void reconfigure(ReconfigureFlags flags) override;
     bool isActive() const override;
+    bool isActiveForWindow(EffectWindow *w) const override;
 
     int requestedEffectChainPosition() const override {
         return 40;
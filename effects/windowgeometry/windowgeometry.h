@@ -40,6 +40,9 @@ public:
     }
     void reconfigure(ReconfigureFlags) override;
     void paintScreen(int mask, const QRegion &region, ScreenPaintData &data) override;
+    PaintHooks paintHooks() const override {
+        return PaintHooks(PaintScreenHook);
+    }
     bool isActive() const override;
 
     int requestedEffectChainPosition() const override {
@@ -0,0 +1,365 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "framescheduler.h"
+#include "abstract_output.h"
+#include "options.h"
+#include "screens.h"
+
+#include <QTimerEvent>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace KWin
+{
+
+// Headroom on top of the predicted render time to cope with the timer jitter.
+static const qint64 s_renderTimeMargin = 1000 * 1000;
+// Input events older than this don't get related to a frame anymore.
+static const qint64 s_maximumInputAge = qint64(1000) * 1000 * 1000;
+// Upper limit of the first latency bucket.
+static const qint64 s_firstBucketLimit = 250 * 1000;
+
+void RenderTimeHistory::add(qint64 renderTime)
+{
+    m_samples[m_next] = renderTime;
+    m_next = (m_next + 1) % s_size;
+    m_count = qMin(m_count + 1, s_size);
+}
+
+void RenderTimeHistory::clear()
+{
+    m_next = 0;
+    m_count = 0;
+}
+
+qint64 RenderTimeHistory::percentile(int percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    std::array<qint64, s_size> sorted;
+    std::copy(m_samples.cbegin(), m_samples.cbegin() + m_count, sorted.begin());
+    const int index = qBound(0, (m_count * percentile + 99) / 100 - 1, m_count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + m_count);
+    return sorted[index];
+}
+
+void LatencyHistogram::add(qint64 latency)
+{
+    latency = qMax<qint64>(latency, 0);
+    int index = 0;
+    while (index < s_bucketCount - 1 && latency >= bucketLimit(index)) {
+        index++;
+    }
+    m_buckets[index]++;
+    m_count++;
+    m_sum += latency;
+    m_maximum = qMax(m_maximum, latency);
+}
+
+void LatencyHistogram::clear()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum = 0;
+    m_maximum = 0;
+}
+
+qint64 LatencyHistogram::bucketLimit(int index)
+{
+    if (index >= s_bucketCount - 1) {
+        return std::numeric_limits<qint64>::max();
+    }
+    return s_firstBucketLimit << index;
+}
+
+qint64 LatencyHistogram::percentile(int percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    const quint64 wanted = qMax<quint64>((m_count * percentile + 99) / 100, 1);
+    quint64 seen = 0;
+    for (int i = 0; i < s_bucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= wanted) {
+            return qMin(bucketLimit(i), m_maximum);
+        }
+    }
+    return m_maximum;
+}
+
+qint64 LatencyHistogram::mean() const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    return m_sum / qint64(m_count);
+}
+
+FrameScheduler::FrameScheduler(AbstractOutput *output, QObject *parent)
+    : QObject(parent)
+    , m_output(output)
+{
+    m_clock.start();
+}
+
+FrameScheduler::~FrameScheduler() = default;
+
+QRect FrameScheduler::geometry() const
+{
+    if (m_output) {
+        return m_output->geometry();
+    }
+    return screens()->geometry();
+}
+
+int FrameScheduler::refreshRate() const
+{
+    if (m_output && m_output->refreshRate() > 0) {
+        return m_output->refreshRate();
+    }
+    return m_refreshRate;
+}
+
+void FrameScheduler::setRefreshRate(int refreshRate)
+{
+    m_refreshRate = refreshRate;
+}
+
+qint64 FrameScheduler::vBlankInterval() const
+{
+    return qint64(1000) * 1000 * 1000 * 1000 / qMax(refreshRate(), 1);
+}
+
+void FrameScheduler::addRepaint(const QRegion &region)
+{
+    const QRegion damage = region.intersected(geometry());
+    if (damage.isEmpty()) {
+        return;
+    }
+    m_damage += damage;
+    scheduleRepaint();
+}
+
+void FrameScheduler::addRepaintFull()
+{
+    m_damage = geometry();
+    scheduleRepaint();
+}
+
+QRegion FrameScheduler::takeDamage()
+{
+    const QRegion damage = m_damage;
+    m_damage = QRegion();
+    return damage;
+}
+
+void FrameScheduler::setThrottledBySwap(bool throttled)
+{
+    m_throttledBySwap = throttled;
+}
+
+qint64 FrameScheduler::currentTime() const
+{
+    if (m_fakeClock) {
+        return m_fakeClock();
+    }
+    return m_clock.nsecsElapsed();
+}
+
+void FrameScheduler::setClock(std::function<qint64 ()> clock)
+{
+    m_fakeClock = clock;
+    m_lastVBlank = currentTime();
+    m_deadline = 0;
+    m_plannedDeadline = 0;
+}
+
+qint64 FrameScheduler::nextVBlank(qint64 now) const
+{
+    // Without swap events the vblanks are assumed to happen in a fixed interval since
+    // the scheduler got created, otherwise each completed swap marks a vblank.
+    const qint64 interval = vBlankInterval();
+    const qint64 sinceLastVBlank = now - m_lastVBlank;
+    return now + interval - (sinceLastVBlank % interval);
+}
+
+qint64 FrameScheduler::nextVBlankIn() const
+{
+    const qint64 now = currentTime();
+    return nextVBlank(now) - now;
+}
+
+qint64 FrameScheduler::predictedRenderTime() const
+{
+    const qint64 interval = vBlankInterval();
+    if (m_renderTimes.isEmpty()) {
+        return qMin(options->vBlankTime(), interval);
+    }
+    return qMin(m_renderTimes.percentile(90) + s_renderTimeMargin, interval);
+}
+
+void FrameScheduler::addRenderTime(qint64 renderTime)
+{
+    m_lastRenderTime = renderTime;
+    m_renderTimes.add(renderTime);
+    if (m_frameStarted) {
+        // Frames which were not started by us, e.g. the initial one, have no deadline.
+        m_frameStarted = false;
+        m_lastDeadlineSlack = timeUntilDeadline();
+        if (m_lastDeadlineSlack < 0) {
+            m_missedDeadlines++;
+        }
+    }
+    if (m_presentPending && !m_swapPending) {
+        // nothing to wait for, the frame is on screen
+        framePresented();
+    }
+    emit frameTimingChanged();
+}
+
+qint64 FrameScheduler::monotonicTime()
+{
+    // the steady clock is CLOCK_MONOTONIC, the clock of the libinput timestamps
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FrameScheduler::addInputEvent(qint64 timestamp)
+{
+    const qint64 age = monotonicTime() - timestamp;
+    if (age < 0 || age > s_maximumInputAge) {
+        return;
+    }
+    if (!m_pendingInput || timestamp < m_pendingInput) {
+        m_pendingInput = timestamp;
+    }
+}
+
+void FrameScheduler::paintStarted()
+{
+    m_paintStart = monotonicTime();
+    m_presentPending = true;
+    if (m_pendingInput) {
+        if (m_paintStart - m_pendingInput <= s_maximumInputAge) {
+            m_inputLatency.add(m_paintStart - m_pendingInput);
+        }
+        m_pendingInput = 0;
+    }
+}
+
+void FrameScheduler::framePresented()
+{
+    m_presentPending = false;
+    m_presentationLatency.add(monotonicTime() - m_paintStart);
+}
+
+void FrameScheduler::clearLatencies()
+{
+    m_inputLatency.clear();
+    m_presentationLatency.clear();
+    emit frameTimingChanged();
+}
+
+qint64 FrameScheduler::timeUntilDeadline() const
+{
+    return m_deadline - currentTime();
+}
+
+void FrameScheduler::scheduleRepaint()
+{
+    if (m_swapPending) {
+        // The frame gets started once the pending buffer swap has completed.
+        m_composeAtSwapCompletion = true;
+        return;
+    }
+    if (m_timer.isActive()) {
+        return;
+    }
+    const qint64 now = currentTime();
+    const qint64 interval = vBlankInterval();
+    qint64 deadline = nextVBlank(now);
+    if (deadline - m_deadline < interval / 2) {
+        // The last frame is going to be shown at this vblank already.
+        deadline = m_deadline + interval;
+    }
+    m_plannedDeadline = deadline;
+
+    // Compose from the event loop even if we are late. Effects might add repaints
+    // while still painting, so we must not start the next frame directly.
+    const qint64 start = deadline - predictedRenderTime();
+    const int waitTime = qMax<qint64>(start - now, 0) / (1000 * 1000);
+    m_timer.start(waitTime, Qt::PreciseTimer, this);
+}
+
+void FrameScheduler::stop()
+{
+    m_timer.stop();
+    m_composeAtSwapCompletion = false;
+    // the input didn't result in a frame on this output
+    m_pendingInput = 0;
+}
+
+bool FrameScheduler::isScheduled() const
+{
+    return m_timer.isActive() || m_composeAtSwapCompletion;
+}
+
+void FrameScheduler::aboutToSwapBuffers()
+{
+    Q_ASSERT(!m_swapPending);
+    m_swapPending = true;
+}
+
+void FrameScheduler::bufferSwapComplete()
+{
+    Q_ASSERT(m_swapPending);
+    m_swapPending = false;
+    if (m_throttledBySwap) {
+        m_lastVBlank = currentTime();
+    }
+    if (m_presentPending) {
+        framePresented();
+        emit frameTimingChanged();
+    }
+
+    emit bufferSwapCompleted();
+
+    if (m_composeAtSwapCompletion) {
+        m_composeAtSwapCompletion = false;
+        scheduleRepaint();
+    }
+}
+
+void FrameScheduler::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_timer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+    m_timer.stop();
+    m_deadline = m_plannedDeadline;
+    m_frameStarted = true;
+    emit frameRequested(this);
+}
+
+}
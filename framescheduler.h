@@ -0,0 +1,337 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_FRAMESCHEDULER_H
+#define KWIN_FRAMESCHEDULER_H
+
+#include <kwinglobals.h>
+
+#include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QRegion>
+
+#include <array>
+#include <functional>
+
+namespace KWin
+{
+
+class AbstractOutput;
+
+/**
+ * @brief Rolling history of the time it took to render the last frames.
+ *
+ * Only the most recent samples are kept, so the estimate follows changes in the
+ * scene, e.g. an effect getting activated.
+ */
+class KWIN_EXPORT RenderTimeHistory
+{
+public:
+    /**
+     * Adds a render time in nanoseconds, dropping the oldest sample if the history is full.
+     */
+    void add(qint64 renderTime);
+    void clear();
+    int count() const {
+        return m_count;
+    }
+    bool isEmpty() const {
+        return m_count == 0;
+    }
+    /**
+     * The render time in nanoseconds which @p percentile percent of the recorded
+     * samples did not exceed, or @c 0 if the history is empty.
+     */
+    qint64 percentile(int percentile) const;
+
+    static const int s_size = 32;
+
+private:
+    std::array<qint64, s_size> m_samples;
+    int m_next = 0;
+    int m_count = 0;
+};
+
+/**
+ * @brief Histogram of latencies with exponentially growing buckets.
+ *
+ * The first bucket counts the samples below 0.25 ms, each further bucket covers twice
+ * the range of the previous one and the last bucket counts everything from 128 ms on.
+ */
+class KWIN_EXPORT LatencyHistogram
+{
+public:
+    /**
+     * Adds a latency in nanoseconds.
+     */
+    void add(qint64 latency);
+    void clear();
+    quint64 count() const {
+        return m_count;
+    }
+    bool isEmpty() const {
+        return m_count == 0;
+    }
+    /**
+     * The number of samples in the bucket @p index.
+     */
+    quint64 bucket(int index) const {
+        return m_buckets[index];
+    }
+    /**
+     * The exclusive upper limit of the bucket @p index in nanoseconds.
+     */
+    static qint64 bucketLimit(int index);
+    /**
+     * The upper limit of the bucket holding the given @p percentile of the samples,
+     * capped to the largest sample, or @c 0 if the histogram is empty.
+     */
+    qint64 percentile(int percentile) const;
+    qint64 mean() const;
+    qint64 maximum() const {
+        return m_maximum;
+    }
+
+    static const int s_bucketCount = 11;
+
+private:
+    std::array<quint64, s_bucketCount> m_buckets = {};
+    quint64 m_count = 0;
+    qint64 m_sum = 0;
+    qint64 m_maximum = 0;
+};
+
+/**
+ * @brief Drives the repaints of a single output.
+ *
+ * The FrameScheduler accumulates the damage of its output, tracks whether a buffer swap
+ * is pending for it and predicts when the next vblank of the output is going to happen.
+ * Once a new frame should be rendered frameRequested is emitted.
+ *
+ * Frames are started as late as possible: the scheduler remembers how long the last frames
+ * took to render and starts the next one just early enough to be done before the vblank.
+ * This keeps the latency between a client update and it being shown on screen low.
+ *
+ * If the scene cannot render the outputs independently of each other, the Compositor
+ * creates a single FrameScheduler without an output, which covers all screens.
+ *
+ * The scheduler also measures the latency between input events and the frames showing
+ * their effect. Each frame is tagged with the oldest input event since the previous
+ * frame. The time from that event to the start of painting, and the time from the start
+ * of painting until the frame got presented, are collected in histograms.
+ */
+class KWIN_EXPORT FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameScheduler(AbstractOutput *output, QObject *parent = nullptr);
+    ~FrameScheduler() override;
+
+    /**
+     * The output driven by this scheduler, @c null if the scheduler covers all screens.
+     */
+    AbstractOutput *output() const {
+        return m_output;
+    }
+    /**
+     * The area of the workspace this scheduler is responsible for.
+     */
+    QRect geometry() const;
+    /**
+     * The refresh rate of the driven output in mHz.
+     */
+    int refreshRate() const;
+    /**
+     * Sets the refresh rate in mHz used if the scheduler doesn't drive an output.
+     */
+    void setRefreshRate(int refreshRate);
+    /**
+     * The time between two vblanks in nanoseconds.
+     */
+    qint64 vBlankInterval() const;
+
+    /**
+     * Adds the part of @p region which intersects the geometry of this scheduler
+     * to the damage and schedules a repaint if needed.
+     */
+    void addRepaint(const QRegion &region);
+    void addRepaintFull();
+    QRegion damage() const {
+        return m_damage;
+    }
+    bool hasDamage() const {
+        return !m_damage.isEmpty();
+    }
+    /**
+     * Returns the accumulated damage and clears it, so that repaints added while
+     * painting are collected for the next frame.
+     */
+    QRegion takeDamage();
+
+    /**
+     * Schedules a new frame if none is scheduled yet. If a buffer swap is pending
+     * the frame is deferred until bufferSwapComplete is called.
+     */
+    void scheduleRepaint();
+    /**
+     * Cancels a scheduled frame. The accumulated damage is kept.
+     */
+    void stop();
+    /**
+     * Whether a frame is scheduled, either through the timer or for the swap completion.
+     */
+    bool isScheduled() const;
+
+    /**
+     * If @c true the completed buffer swaps mark the vblanks of the output,
+     * otherwise the vblanks are assumed to happen in a fixed interval.
+     */
+    void setThrottledBySwap(bool throttled);
+
+    bool isSwapPending() const {
+        return m_swapPending;
+    }
+    void aboutToSwapBuffers();
+    void bufferSwapComplete();
+
+    /**
+     * Time in nanoseconds until the predicted next vblank of the output.
+     */
+    qint64 nextVBlankIn() const;
+
+    /**
+     * Records how long it took to render the last frame, in nanoseconds.
+     */
+    void addRenderTime(qint64 renderTime);
+    /**
+     * The time in nanoseconds which is reserved to render a frame before the vblank.
+     * Until render times got recorded the configured vblank time is used.
+     */
+    qint64 predictedRenderTime() const;
+    /**
+     * The render time of the last frame in nanoseconds.
+     */
+    qint64 lastRenderTime() const {
+        return m_lastRenderTime;
+    }
+    /**
+     * The time in nanoseconds until the vblank the current or last frame was started for.
+     * Negative if the vblank already passed.
+     */
+    qint64 timeUntilDeadline() const;
+    /**
+     * How much time was left until the vblank when the last frame was done rendering,
+     * in nanoseconds. Negative if the frame was too late.
+     */
+    qint64 lastDeadlineSlack() const {
+        return m_lastDeadlineSlack;
+    }
+    /**
+     * The number of frames which were not done rendering before their vblank.
+     */
+    int missedDeadlines() const {
+        return m_missedDeadlines;
+    }
+
+    /**
+     * Tags the next frame with an input event which happened at @p timestamp, in
+     * nanoseconds of the monotonic clock. Events older than a second are ignored,
+     * they cannot be related to the next frame anymore.
+     */
+    void addInputEvent(qint64 timestamp);
+    /**
+     * Marks that the scene starts painting the frame.
+     */
+    void paintStarted();
+    /**
+     * The time from the oldest input event of a frame until painting it started.
+     */
+    const LatencyHistogram &inputLatency() const {
+        return m_inputLatency;
+    }
+    /**
+     * The time from the start of painting a frame until it got presented. Without
+     * buffer swaps to wait for, a frame counts as presented once it is rendered.
+     */
+    const LatencyHistogram &presentationLatency() const {
+        return m_presentationLatency;
+    }
+    void clearLatencies();
+
+    /**
+     * The current time of the monotonic clock in nanoseconds, the clock used
+     * for the timestamps of the input events.
+     */
+    static qint64 monotonicTime();
+
+    /**
+     * Replaces the clock the vblanks and deadlines are calculated with, the clock returns
+     * nanoseconds. Used by the autotests to drive the scheduler with a fake time, pass an
+     * empty function to go back to the real clock. Resets the vblank phase to the current
+     * time of the new clock.
+     */
+    void setClock(std::function<qint64 ()> clock);
+
+Q_SIGNALS:
+    /**
+     * Emitted when the output should be repainted.
+     */
+    void frameRequested(KWin::FrameScheduler *scheduler);
+    void bufferSwapCompleted();
+    /**
+     * Emitted after a render time got recorded.
+     */
+    void frameTimingChanged();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
+private:
+    qint64 currentTime() const;
+    qint64 nextVBlank(qint64 now) const;
+    void framePresented();
+
+    AbstractOutput *m_output;
+    QBasicTimer m_timer;
+    QRegion m_damage;
+    QElapsedTimer m_clock;
+    std::function<qint64 ()> m_fakeClock;
+    qint64 m_lastVBlank = 0;
+    qint64 m_plannedDeadline = 0;
+    qint64 m_deadline = 0;
+    RenderTimeHistory m_renderTimes;
+    qint64 m_lastRenderTime = 0;
+    qint64 m_lastDeadlineSlack = 0;
+    int m_missedDeadlines = 0;
+    LatencyHistogram m_inputLatency;
+    LatencyHistogram m_presentationLatency;
+    qint64 m_pendingInput = 0;
+    qint64 m_paintStart = 0;
+    bool m_presentPending = false;
+    bool m_frameStarted = false;
+    int m_refreshRate = 60000;
+    bool m_swapPending = false;
+    bool m_composeAtSwapCompletion = false;
+    bool m_throttledBySwap = true;
+};
+
+}
+
+#endif
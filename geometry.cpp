@@ -39,11 +39,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 #include "effects.h"
 #include "screenedge.h"
+#include "snap_targets.h"
 #include "internal_client.h"
 #include <QApplication>
 #include <QDebug>
 #include <QVarLengthArray>
 
+#include <algorithm>
+
 #include "outline.h"
 #include "xdgshellclient.h"
 #include "wayland_server.h"
@@ -99,6 +102,117 @@ void Workspace::saveOldScreenSizes()
         oldscreensizes.append( screens()->geometry( i ));
 }
 
+bool Workspace::StrutContribution::operator==(const StrutContribution &other) const
+{
+    return client == other.client
+        && desktop == other.desktop
+        && restrictsWorkArea == other.restrictsWorkArea
+        && workArea == other.workArea
+        && screenAreas == other.screenAreas
+        && ignoreEmptyScreenAreas == other.ignoreEmptyScreenAreas
+        && strutRects == other.strutRects;
+}
+
+Workspace::StrutContribution Workspace::strutContribution(X11Client *c, const QRect &desktopArea, const QVector<QRect> &screens) const
+{
+    StrutContribution contribution;
+    contribution.client = c;
+    contribution.desktop = c->isOnAllDesktops() ? NET::OnAllDesktops : c->desktop();
+
+    QRect r = c->adjustedClientArea(desktopArea, desktopArea);
+    // sanity check that a strut doesn't exclude a complete screen geometry
+    // this is a violation to EWMH, as KWin just ignores the strut
+    for (const QRect &screen : screens) {
+        if (!r.intersects(screen)) {
+            qCDebug(KWIN_CORE) << "Adjusted client area would exclude a complete screen, ignore";
+            r = desktopArea;
+            break;
+        }
+    }
+    // Ignore offscreen xinerama struts. These interfere with the larger monitors on the setup
+    // and should be ignored so that applications that use the work area to work out where
+    // windows can go can use the entire visible area of the larger monitors.
+    // This goes against the EWMH description of the work area but it is a toss up between
+    // having unusable sections of the screen (Which can be quite large with newer monitors)
+    // or having some content appear offscreen (Relatively rare compared to other).
+    contribution.restrictsWorkArea = !c->hasOffscreenXineramaStrut();
+    contribution.workArea = r;
+
+    contribution.strutRects = c->strutRects();
+    const QRect clientsScreenRect = KWin::screens()->geometry(c->screen());
+    for (auto strut = contribution.strutRects.begin(); strut != contribution.strutRects.end(); strut++) {
+        *strut = StrutRect((*strut).intersected(clientsScreenRect), (*strut).area());
+    }
+
+    contribution.screenAreas.reserve(screens.count());
+    for (const QRect &screen : screens) {
+        contribution.screenAreas << c->adjustedClientArea(desktopArea, screen);
+    }
+    // ignore the geometry if it results in the screen getting removed completely
+    contribution.ignoreEmptyScreenAreas = true;
+    return contribution;
+}
+
+Workspace::StrutContribution Workspace::strutContribution(XdgShellClient *c, const QRect &desktopArea, const QVector<QRect> &screens) const
+{
+    // assuming that only docks have "struts" and that all docks have a strut
+    const QRect frame = c->frameGeometry();
+    auto margins = [frame] (const QRect &geometry) {
+        QMargins margins;
+        if (!geometry.intersects(frame)) {
+            return margins;
+        }
+        // figure out which areas of the overall screen setup it borders
+        const bool left = frame.left() == geometry.left();
+        const bool right = frame.right() == geometry.right();
+        const bool top = frame.top() == geometry.top();
+        const bool bottom = frame.bottom() == geometry.bottom();
+        const bool horizontal = frame.width() >= frame.height();
+        if (left && ((!top && !bottom) || !horizontal)) {
+            margins.setLeft(frame.width());
+        }
+        if (right && ((!top && !bottom) || !horizontal)) {
+            margins.setRight(frame.width());
+        }
+        if (top && ((!left && !right) || horizontal)) {
+            margins.setTop(frame.height());
+        }
+        if (bottom && ((!left && !right) || horizontal)) {
+            margins.setBottom(frame.height());
+        }
+        return margins;
+    };
+    auto marginsToStrutArea = [] (const QMargins &margins) {
+        if (margins.left() != 0) {
+            return StrutAreaLeft;
+        }
+        if (margins.right() != 0) {
+            return StrutAreaRight;
+        }
+        if (margins.top() != 0) {
+            return StrutAreaTop;
+        }
+        if (margins.bottom() != 0) {
+            return StrutAreaBottom;
+        }
+        return StrutAreaInvalid;
+    };
+
+    StrutContribution contribution;
+    contribution.client = c;
+    contribution.desktop = c->isOnAllDesktops() ? NET::OnAllDesktops : c->desktop();
+    contribution.restrictsWorkArea = true;
+    contribution.workArea = desktopArea - margins(KWin::screens()->geometry());
+    const auto strut = margins(KWin::screens()->geometry(c->screen()));
+    contribution.strutRects = StrutRects{StrutRect(frame, marginsToStrutArea(strut))};
+    contribution.screenAreas.reserve(screens.count());
+    for (const QRect &screen : screens) {
+        contribution.screenAreas << screen - margins(screen);
+    }
+    contribution.ignoreEmptyScreenAreas = false;
+    return contribution;
+}
+
 /**
  * Updates the current client areas according to the current clients.
  *
@@ -108,6 +222,11 @@ void Workspace::saveOldScreenSizes()
  * which is not taken by windows like panels, the top-of-screen menu
  * etc).
  *
+ * How each window with a strut restricts the areas is computed once per window, no matter
+ * on how many desktops it is, and compared to the last update. Only the desktops affected
+ * by a changed strut are computed again, and only the windows on desktops whose areas
+ * really changed have to check their position.
+ *
  * @see clientArea()
  */
 void Workspace::updateClientArea(bool force)
@@ -115,216 +234,158 @@ void Workspace::updateClientArea(bool force)
     const Screens *s = Screens::self();
     int nscreens = s->count();
     const int numberOfDesktops = VirtualDesktopManager::self()->count();
-    QVector< QRect > new_wareas(numberOfDesktops + 1);
-    QVector< StrutRects > new_rmoveareas(numberOfDesktops + 1);
-    QVector< QVector< QRect > > new_sareas(numberOfDesktops + 1);
     QVector< QRect > screens(nscreens);
     QRect desktopArea;
-    for (int i = 0; i < nscreens; i++) {
-        desktopArea |= s->geometry(i);
-    }
     for (int iS = 0;
             iS < nscreens;
             iS ++) {
         screens [iS] = s->geometry(iS);
+        desktopArea |= screens[iS];
     }
-    for (int i = 1;
-            i <= numberOfDesktops;
-            ++i) {
-        new_wareas[ i ] = desktopArea;
-        new_sareas[ i ].resize(nscreens);
-        for (int iS = 0;
-                iS < nscreens;
-                iS ++)
-            new_sareas[ i ][ iS ] = screens[ iS ];
-    }
+
+    QVector<StrutContribution> contributions;
     for (auto it = clients.constBegin(); it != clients.constEnd(); ++it) {
-        if (!(*it)->hasStrut())
-            continue;
-        QRect r = (*it)->adjustedClientArea(desktopArea, desktopArea);
-        // sanity check that a strut doesn't exclude a complete screen geometry
-        // this is a violation to EWMH, as KWin just ignores the strut
-        for (int i = 0; i < Screens::self()->count(); i++) {
-            if (!r.intersects(Screens::self()->geometry(i))) {
-                qCDebug(KWIN_CORE) << "Adjusted client area would exclude a complete screen, ignore";
-                r = desktopArea;
-                break;
+        if ((*it)->hasStrut()) {
+            contributions << strutContribution(*it, desktopArea, screens);
+        }
+    }
+    if (waylandServer()) {
+        const auto clients = waylandServer()->clients();
+        for (auto c : clients) {
+            if (c->hasStrut()) {
+                contributions << strutContribution(c, desktopArea, screens);
             }
         }
-        StrutRects strutRegion = (*it)->strutRects();
-        const QRect clientsScreenRect = KWin::screens()->geometry((*it)->screen());
-        for (auto strut = strutRegion.begin(); strut != strutRegion.end(); strut++) {
-            *strut = StrutRect((*strut).intersected(clientsScreenRect), (*strut).area());
-        }
-
-        // Ignore offscreen xinerama struts. These interfere with the larger monitors on the setup
-        // and should be ignored so that applications that use the work area to work out where
-        // windows can go can use the entire visible area of the larger monitors.
-        // This goes against the EWMH description of the work area but it is a toss up between
-        // having unusable sections of the screen (Which can be quite large with newer monitors)
-        // or having some content appear offscreen (Relatively rare compared to other).
-        bool hasOffscreenXineramaStrut = (*it)->hasOffscreenXineramaStrut();
-
-        if ((*it)->isOnAllDesktops()) {
-            for (int i = 1;
-                    i <= numberOfDesktops;
-                    ++i) {
-                if (!hasOffscreenXineramaStrut)
-                    new_wareas[ i ] = new_wareas[ i ].intersected(r);
-                new_rmoveareas[ i ] += strutRegion;
-                for (int iS = 0;
-                        iS < nscreens;
-                        iS ++) {
-                    const auto geo = new_sareas[ i ][ iS ].intersected(
-                                                (*it)->adjustedClientArea(desktopArea, screens[ iS ]));
-                    // ignore the geometry if it results in the screen getting removed completely
-                    if (!geo.isEmpty()) {
-                        new_sareas[ i ][ iS ] = geo;
-                    }
-                }
+    }
+
+    // Everything has to be computed again if the screens or the desktops changed,
+    // otherwise only the desktops the changed struts are or were on.
+    const bool layoutChanged = force || screenarea.isEmpty()
+        || workarea.size() != numberOfDesktops + 1
+        || screenarea.size() != numberOfDesktops + 1
+        || m_strutScreens != screens;
+    QVector<bool> dirty(numberOfDesktops + 1, layoutChanged);
+    if (!layoutChanged) {
+        auto markDirty = [&dirty, numberOfDesktops] (const StrutContribution &contribution) {
+            if (contribution.desktop == NET::OnAllDesktops) {
+                dirty.fill(true);
+            } else if (contribution.desktop >= 1 && contribution.desktop <= numberOfDesktops) {
+                dirty[contribution.desktop] = true;
             }
-        } else {
-            if (!hasOffscreenXineramaStrut)
-                new_wareas[(*it)->desktop()] = new_wareas[(*it)->desktop()].intersected(r);
-            new_rmoveareas[(*it)->desktop()] += strutRegion;
-            for (int iS = 0;
-                    iS < nscreens;
-                    iS ++) {
-//                            qDebug() << "adjusting new_sarea: " << screens[ iS ];
-                const auto geo = new_sareas[(*it)->desktop()][ iS ].intersected(
-                      (*it)->adjustedClientArea(desktopArea, screens[ iS ]));
-                // ignore the geometry if it results in the screen getting removed completely
-                if (!geo.isEmpty()) {
-                    new_sareas[(*it)->desktop()][ iS ] = geo;
+        };
+        auto findContribution = [] (const QVector<StrutContribution> &list, const AbstractClient *client) {
+            return std::find_if(list.constBegin(), list.constEnd(),
+                [client] (const StrutContribution &contribution) {
+                    return contribution.client == client;
                 }
+            );
+        };
+        for (const StrutContribution &contribution : qAsConst(contributions)) {
+            auto old = findContribution(m_strutContributions, contribution.client);
+            if (old == m_strutContributions.constEnd()) {
+                markDirty(contribution);
+            } else if (!(*old == contribution)) {
+                markDirty(contribution);
+                markDirty(*old);
+            }
+        }
+        for (const StrutContribution &old : qAsConst(m_strutContributions)) {
+            if (findContribution(contributions, old.client) == contributions.constEnd()) {
+                markDirty(old);
             }
         }
     }
-    if (waylandServer()) {
-        auto updateStrutsForWaylandClient = [&] (XdgShellClient *c) {
-            // assuming that only docks have "struts" and that all docks have a strut
-            if (!c->hasStrut()) {
-                return;
+    m_strutContributions = contributions;
+    m_strutScreens = screens;
+
+    QVector< QRect > new_wareas = workarea;
+    QVector< StrutRects > new_rmoveareas = restrictedmovearea;
+    QVector< QVector< QRect > > new_sareas = screenarea;
+    new_wareas.resize(numberOfDesktops + 1);
+    new_rmoveareas.resize(numberOfDesktops + 1);
+    new_sareas.resize(numberOfDesktops + 1);
+    for (int i = 1;
+            i <= numberOfDesktops;
+            ++i) {
+        if (!dirty[i]) {
+            continue;
+        }
+        new_wareas[ i ] = desktopArea;
+        new_rmoveareas[ i ].clear();
+        new_sareas[ i ] = screens;
+        for (const StrutContribution &contribution : qAsConst(contributions)) {
+            if (contribution.desktop != NET::OnAllDesktops && contribution.desktop != i) {
+                continue;
             }
-            auto margins = [c] (const QRect &geometry) {
-                QMargins margins;
-                if (!geometry.intersects(c->frameGeometry())) {
-                    return margins;
-                }
-                // figure out which areas of the overall screen setup it borders
-                const bool left = c->frameGeometry().left() == geometry.left();
-                const bool right = c->frameGeometry().right() == geometry.right();
-                const bool top = c->frameGeometry().top() == geometry.top();
-                const bool bottom = c->frameGeometry().bottom() == geometry.bottom();
-                const bool horizontal = c->frameGeometry().width() >= c->frameGeometry().height();
-                if (left && ((!top && !bottom) || !horizontal)) {
-                    margins.setLeft(c->frameGeometry().width());
-                }
-                if (right && ((!top && !bottom) || !horizontal)) {
-                    margins.setRight(c->frameGeometry().width());
-                }
-                if (top && ((!left && !right) || horizontal)) {
-                    margins.setTop(c->frameGeometry().height());
-                }
-                if (bottom && ((!left && !right) || horizontal)) {
-                    margins.setBottom(c->frameGeometry().height());
-                }
-                return margins;
-            };
-            auto marginsToStrutArea = [] (const QMargins &margins) {
-                if (margins.left() != 0) {
-                    return StrutAreaLeft;
-                }
-                if (margins.right() != 0) {
-                    return StrutAreaRight;
-                }
-                if (margins.top() != 0) {
-                    return StrutAreaTop;
-                }
-                if (margins.bottom() != 0) {
-                    return StrutAreaBottom;
-                }
-                return StrutAreaInvalid;
-            };
-            const auto strut = margins(KWin::screens()->geometry(c->screen()));
-            const StrutRects strutRegion = StrutRects{StrutRect(c->frameGeometry(), marginsToStrutArea(strut))};
-            QRect r = desktopArea - margins(KWin::screens()->geometry());
-            if (c->isOnAllDesktops()) {
-                for (int i = 1; i <= numberOfDesktops; ++i) {
-                    new_wareas[ i ] = new_wareas[ i ].intersected(r);
-                    for (int iS = 0; iS < nscreens; ++iS) {
-                        new_sareas[ i ][ iS ] = new_sareas[ i ][ iS ].intersected(screens[iS] - margins(screens[iS]));
-                    }
-                    new_rmoveareas[ i ] += strutRegion;
-                }
-            } else {
-                new_wareas[c->desktop()] = new_wareas[c->desktop()].intersected(r);
-                for (int iS = 0; iS < nscreens; iS++) {
-                    new_sareas[c->desktop()][ iS ] = new_sareas[c->desktop()][ iS ].intersected(screens[iS] - margins(screens[iS]));
+            if (contribution.restrictsWorkArea) {
+                new_wareas[ i ] = new_wareas[ i ].intersected(contribution.workArea);
+            }
+            new_rmoveareas[ i ] += contribution.strutRects;
+            for (int iS = 0;
+                    iS < nscreens;
+                    iS ++) {
+                const auto geo = new_sareas[ i ][ iS ].intersected(contribution.screenAreas[ iS ]);
+                if (!contribution.ignoreEmptyScreenAreas || !geo.isEmpty()) {
+                    new_sareas[ i ][ iS ] = geo;
                 }
-                new_rmoveareas[ c->desktop() ] += strutRegion;
             }
-        };
-        const auto clients = waylandServer()->clients();
-        for (auto c : clients) {
-            updateStrutsForWaylandClient(c);
         }
     }
-#if 0
+
+    const bool changedAll = force || screenarea.isEmpty()
+        || workarea.size() != numberOfDesktops + 1
+        || screenarea.size() != numberOfDesktops + 1;
+    QVector<int> changedDesktops;
     for (int i = 1;
-            i <= numberOfDesktops();
+            i <= numberOfDesktops;
             ++i) {
-        for (int iS = 0;
-                iS < nscreens;
-                iS ++)
-            qCDebug(KWIN_CORE) << "new_sarea: " << new_sareas[ i ][ iS ];
+        if (changedAll) {
+            changedDesktops << i;
+            continue;
+        }
+        if (!dirty[i]) {
+            continue;
+        }
+        if (workarea[ i ] != new_wareas[ i ]
+                || restrictedmovearea[ i ] != new_rmoveareas[ i ]
+                || screenarea[ i ] != new_sareas[ i ]) {
+            changedDesktops << i;
+        }
     }
-#endif
-
-    bool changed = force;
 
-    if (screenarea.isEmpty())
-        changed = true;
+    if (changedDesktops.isEmpty()) {
+        return;
+    }
 
-    for (int i = 1;
-            !changed && i <= numberOfDesktops;
-            ++i) {
-        if (workarea[ i ] != new_wareas[ i ])
-            changed = true;
-        if (restrictedmovearea[ i ] != new_rmoveareas[ i ])
-            changed = true;
-        if (screenarea[ i ].size() != new_sareas[ i ].size())
-            changed = true;
-        for (int iS = 0;
-                !changed && iS < nscreens;
-                iS ++)
-            if (new_sareas[ i ][ iS ] != screenarea [ i ][ iS ])
-                changed = true;
-    }
-
-    if (changed) {
-        workarea = new_wareas;
-        oldrestrictedmovearea = restrictedmovearea;
-        restrictedmovearea = new_rmoveareas;
-        screenarea = new_sareas;
-        if (rootInfo()) {
-            NETRect r;
-            for (int i = 1; i <= numberOfDesktops; i++) {
-                r.pos.x = workarea[ i ].x();
-                r.pos.y = workarea[ i ].y();
-                r.size.width = workarea[ i ].width();
-                r.size.height = workarea[ i ].height();
-                rootInfo()->setWorkArea(i, r);
+    workarea = new_wareas;
+    oldrestrictedmovearea = restrictedmovearea;
+    restrictedmovearea = new_rmoveareas;
+    screenarea = new_sareas;
+    if (rootInfo()) {
+        NETRect r;
+        for (int i : qAsConst(changedDesktops)) {
+            r.pos.x = workarea[ i ].x();
+            r.pos.y = workarea[ i ].y();
+            r.size.width = workarea[ i ].width();
+            r.size.height = workarea[ i ].height();
+            rootInfo()->setWorkArea(i, r);
+        }
+    }
+
+    for (auto it = m_allClients.constBegin();
+            it != m_allClients.constEnd();
+            ++it) {
+        const bool affected = (*it)->isOnAllDesktops() || std::any_of(changedDesktops.constBegin(), changedDesktops.constEnd(),
+            [it] (int desktop) {
+                return (*it)->isOnDesktop(desktop);
             }
-        }
-
-        for (auto it = m_allClients.constBegin();
-                it != m_allClients.constEnd();
-                ++it)
+        );
+        if (affected) {
             (*it)->checkWorkspacePosition();
-
-        oldrestrictedmovearea.clear(); // reset, no longer valid or needed
+        }
     }
+
+    oldrestrictedmovearea.clear(); // reset, no longer valid or needed
 }
 
 void Workspace::updateClientArea()
@@ -540,7 +601,14 @@ QPoint Workspace::adjustClientPosition(AbstractClient* c, QPoint pos, bool unres
         // windows snap
         int snap = options->windowSnapZone() * snapAdjust;
         if (snap) {
-            for (auto l = m_allClients.constBegin(); l != m_allClients.constEnd(); ++l) {
+            // Only the windows with an edge close to the moved window can be snapped to.
+            QVector<AbstractClient *> candidates;
+            if (m_snapTargets && m_snapTargets->movingClient() == c) {
+                candidates = m_snapTargets->candidates(QRect(cx, cy, cw, ch), snap);
+            } else {
+                candidates = m_allClients.toVector();
+            }
+            for (auto l = candidates.constBegin(); l != candidates.constEnd(); ++l) {
                 if ((*l) == c)
                     continue;
                 if ((*l)->isMinimized())
@@ -886,23 +954,30 @@ void Workspace::setMoveResizeClient(AbstractClient *c)
         ++block_focus;
     else
         --block_focus;
+    // the other windows are collected once, not on every motion while moving
+    m_snapTargets.reset(c ? new SnapTargets(c) : nullptr);
 }
 
 // When kwin crashes, windows will not be gravitated back to their original position
 // and will remain offset by the size of the decoration. So when restarting, fix this
 // (the property with the size of the frame remains on the window after the crash).
-void Workspace::fixPositionAfterCrash(xcb_window_t w, const xcb_get_geometry_reply_t *geometry)
+/**
+ * Moves the window @p w by its frame extents, returns whether it got moved.
+ */
+bool Workspace::fixPositionAfterCrash(xcb_window_t w, const xcb_get_geometry_reply_t *geometry)
 {
     NETWinInfo i(connection(), w, rootWindow(), NET::WMFrameExtents, NET::Properties2());
     NETStrut frame = i.frameExtents();
 
-    if (frame.left != 0 || frame.top != 0) {
-        // left and top needed due to narrowing conversations restrictions in C++11
-        const uint32_t left = frame.left;
-        const uint32_t top = frame.top;
-        const uint32_t values[] = { geometry->x - left, geometry->y - top };
-        xcb_configure_window(connection(), w, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+    if (frame.left == 0 && frame.top == 0) {
+        return false;
     }
+    // left and top needed due to narrowing conversations restrictions in C++11
+    const uint32_t left = frame.left;
+    const uint32_t top = frame.top;
+    const uint32_t values[] = { geometry->x - left, geometry->y - top };
+    xcb_configure_window(connection(), w, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+    return true;
 }
 
 //********************************************
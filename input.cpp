@@ -25,6 +25,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "globalshortcuts.h"
 #include "input_event.h"
 #include "input_event_spy.h"
+#include "input_hit_index.h"
+#include "input_latency_spy.h"
 #include "keyboard_input.h"
 #include "logind.h"
 #include "main.h"
@@ -66,7 +68,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 namespace KWin
 {
 
-InputEventFilter::InputEventFilter() = default;
+InputEventFilter::InputEventFilter(InputEventTypes interests)
+    : m_interests(interests)
+{
+}
 
 InputEventFilter::~InputEventFilter()
 {
@@ -75,6 +80,11 @@ InputEventFilter::~InputEventFilter()
     }
 }
 
+void InputEventFilter::setInterests(InputEventTypes interests)
+{
+    m_interests = interests;
+}
+
 bool InputEventFilter::pointerEvent(QMouseEvent *event, quint32 nativeButton)
 {
     Q_UNUSED(event)
@@ -231,6 +241,10 @@ void InputEventFilter::passToWaylandServer(QKeyEvent *event)
 
 class VirtualTerminalFilter : public InputEventFilter {
 public:
+    VirtualTerminalFilter()
+        : InputEventFilter(InputEventType::Keyboard)
+    {
+    }
     bool keyEvent(QKeyEvent *event) override {
         // really on press and not on release? X11 switches on press.
         if (event->type() == QEvent::KeyPress && !event->isAutoRepeat()) {
@@ -246,6 +260,10 @@ public:
 
 class TerminateServerFilter : public InputEventFilter {
 public:
+    TerminateServerFilter()
+        : InputEventFilter(InputEventType::Keyboard)
+    {
+    }
     bool keyEvent(QKeyEvent *event) override {
         if (event->type() == QEvent::KeyPress && !event->isAutoRepeat()) {
             if (event->nativeVirtualKey() == XKB_KEY_Terminate_Server) {
@@ -733,6 +751,11 @@ private:
 
 class GlobalShortcutFilter : public InputEventFilter {
 public:
+    GlobalShortcutFilter()
+        : InputEventFilter(InputEventType::PointerButton | InputEventType::PointerAxis |
+                           InputEventType::Keyboard | InputEventType::Gesture)
+    {
+    }
     bool pointerEvent(QMouseEvent *event, quint32 nativeButton) override {
         Q_UNUSED(nativeButton);
         if (event->type() == QEvent::MouseButtonPress) {
@@ -1292,6 +1315,10 @@ private:
 class WindowActionInputFilter : public InputEventFilter
 {
 public:
+    WindowActionInputFilter()
+        : InputEventFilter(InputEventType::PointerButton | InputEventType::PointerAxis | InputEventType::Touch)
+    {
+    }
     bool pointerEvent(QMouseEvent *event, quint32 nativeButton) override {
         Q_UNUSED(nativeButton)
         if (event->type() != QEvent::MouseButtonPress) {
@@ -1527,6 +1554,7 @@ class FakeTabletInputFilter : public InputEventFilter
 {
 public:
     FakeTabletInputFilter()
+        : InputEventFilter(InputEventType::Tablet)
     {
     }
 
@@ -1896,6 +1924,7 @@ void InputRedirection::setupInputFilters()
     }
     if (waylandServer()) {
         installInputEventSpy(new TouchHideCursorSpy);
+        installInputEventSpy(new InputLatencySpy);
         if (hasGlobalShortcutSupport) {
             installInputEventFilter(new TerminateServerFilter);
         }
@@ -2005,8 +2034,8 @@ void InputRedirection::setupLibInput()
         connect(conn, &LibInput::Connection::touchFrame, m_touch, &TouchInputRedirection::frame);
         auto handleSwitchEvent = [this] (SwitchEvent::State state, quint32 time, quint64 timeMicroseconds, LibInput::Device *device) {
             SwitchEvent event(state, time, timeMicroseconds, device);
-            processSpies(std::bind(&InputEventSpy::switchEvent, std::placeholders::_1, &event));
-            processFilters(std::bind(&InputEventFilter::switchEvent, std::placeholders::_1, &event));
+            processSpies(InputEventType::Switch, std::bind(&InputEventSpy::switchEvent, std::placeholders::_1, &event));
+            processFilters(InputEventType::Switch, std::bind(&InputEventFilter::switchEvent, std::placeholders::_1, &event));
         };
         connect(conn, &LibInput::Connection::switchToggledOn, this,
                 std::bind(handleSwitchEvent, SwitchEvent::State::On, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
@@ -2237,37 +2266,37 @@ Toplevel *InputRedirection::findManagedToplevel(const QPoint &pos)
     if (!Workspace::self()) {
         return nullptr;
     }
-    const bool isScreenLocked = waylandServer() && waylandServer()->isScreenLocked();
-    const QList<Toplevel *> &stacking = Workspace::self()->stackingOrder();
-    if (stacking.isEmpty()) {
-        return nullptr;
+    if (!m_hitIndex) {
+        m_hitIndex = new InputHitIndex(this);
     }
-    auto it = stacking.end();
-    do {
-        --it;
-        Toplevel *t = (*it);
-        if (t->isDeleted()) {
-            // a deleted window doesn't get mouse events
-            continue;
-        }
-        if (AbstractClient *c = dynamic_cast<AbstractClient*>(t)) {
-            if (!c->isOnCurrentActivity() || !c->isOnCurrentDesktop() || c->isMinimized() || c->isHiddenInternal()) {
-                continue;
+    const bool isScreenLocked = waylandServer() && waylandServer()->isScreenLocked();
+    return m_hitIndex->findAt(pos,
+        [isScreenLocked, pos] (Toplevel *t) {
+            if (t->isDeleted()) {
+                // a deleted window doesn't get mouse events
+                return false;
             }
-        }
-        if (!t->readyForPainting()) {
-            continue;
-        }
-        if (isScreenLocked) {
-            if (!t->isLockScreen() && !t->isInputMethod()) {
-                continue;
+            if (AbstractClient *c = dynamic_cast<AbstractClient*>(t)) {
+                if (!c->isOnCurrentActivity() || !c->isOnCurrentDesktop() || c->isMinimized() || c->isHiddenInternal()) {
+                    return false;
+                }
             }
+            if (!t->readyForPainting()) {
+                return false;
+            }
+            if (isScreenLocked) {
+                if (!t->isLockScreen() && !t->isInputMethod()) {
+                    return false;
+                }
+            }
+            return acceptsInput(t, pos);
         }
-        if (t->inputGeometry().contains(pos) && acceptsInput(t, pos)) {
-            return t;
-        }
-    } while (it != stacking.begin());
-    return nullptr;
+    );
+}
+
+InputHitIndex *InputRedirection::hitIndex() const
+{
+    return m_hitIndex;
 }
 
 Qt::KeyboardModifiers InputRedirection::keyboardModifiers() const
@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #ifndef KWIN_INPUT_H
 #define KWIN_INPUT_H
+#include "input_event_spy.h"
+
 #include <kwinglobals.h>
 #include <QAction>
 #include <QObject>
@@ -44,6 +46,7 @@ namespace KWin
 class GlobalShortcutsManager;
 class Toplevel;
 class InputEventFilter;
+class InputHitIndex;
 class InputEventSpy;
 class KeyboardInputRedirection;
 class PointerInputRedirection;
@@ -182,14 +185,18 @@ public:
 
     Toplevel *findToplevel(const QPoint &pos);
     Toplevel *findManagedToplevel(const QPoint &pos);
+    /**
+     * The spatial index used by findManagedToplevel, @c null until the first lookup.
+     */
+    InputHitIndex *hitIndex() const;
     GlobalShortcutsManager *shortcuts() const {
         return m_shortcuts;
     }
 
     /**
-     * Sends an event through all InputFilters.
-     * The method @p function is invoked on each input filter. Processing is stopped if
-     * a filter returns @c true for @p function.
+     * Sends an event of the given @p type through all InputFilters interested in it.
+     * The method @p function is invoked on each of these input filters. Processing is
+     * stopped if a filter returns @c true for @p function.
      *
      * The UnaryPredicate is defined like the UnaryPredicate of std::any_of.
      * The signature of the function should be equivalent to the following:
@@ -201,13 +208,17 @@ public:
      * bind.
      */
     template <class UnaryPredicate>
-    void processFilters(UnaryPredicate function) {
-        std::any_of(m_filters.constBegin(), m_filters.constEnd(), function);
+    void processFilters(InputEventType type, UnaryPredicate function) {
+        for (InputEventFilter *filter : qAsConst(m_filters)) {
+            if (filter->interests().testFlag(type) && function(filter)) {
+                return;
+            }
+        }
     }
 
     /**
-     * Sends an event through all input event spies.
-     * The @p function is invoked on each InputEventSpy.
+     * Sends an event of the given @p type through all input event spies interested in it.
+     * The @p function is invoked on each of these InputEventSpys.
      *
      * The UnaryFunction is defined like the UnaryFunction of std::for_each.
      * The signature of the function should be equivalent to the following:
@@ -219,8 +230,12 @@ public:
      * bind.
      */
     template <class UnaryFunction>
-    void processSpies(UnaryFunction function) {
-        std::for_each(m_spies.constBegin(), m_spies.constEnd(), function);
+    void processSpies(InputEventType type, UnaryFunction function) {
+        for (InputEventSpy *spy : qAsConst(m_spies)) {
+            if (spy->interests().testFlag(type)) {
+                function(spy);
+            }
+        }
     }
 
     KeyboardInputRedirection *keyboard() const {
@@ -303,6 +318,7 @@ private:
     LibInput::Connection *m_libInput = nullptr;
 
     WindowSelectorFilter *m_windowSelector = nullptr;
+    InputHitIndex *m_hitIndex = nullptr;
 
     QVector<InputEventFilter*> m_filters;
     QVector<InputEventSpy*> m_spies;
@@ -330,15 +346,26 @@ private:
  * a filter returns @c false the next one is invoked. This means a filter
  * installed early gets to see more events than a filter installed later on.
  *
+ * A filter is only asked about the events of the types it is interested in, by default
+ * all of them. The filters which never look at pointer motions should say so, the motions
+ * are by far the most frequent events.
+ *
  * Deleting an instance of InputEventFilter automatically uninstalls it from
  * InputRedirection.
  */
 class KWIN_EXPORT InputEventFilter
 {
 public:
-    InputEventFilter();
+    explicit InputEventFilter(InputEventTypes interests = InputEventType::All);
     virtual ~InputEventFilter();
 
+    /**
+     * The types of events passed to this filter.
+     */
+    InputEventTypes interests() const {
+        return m_interests;
+    }
+
     /**
      * Event filter for pointer events which can be described by a QMouseEvent.
      *
@@ -390,6 +417,13 @@ public:
 
 protected:
     void passToWaylandServer(QKeyEvent *event);
+    /**
+     * Changes the types of events passed to this filter, e.g. when its state changed.
+     */
+    void setInterests(InputEventTypes interests);
+
+private:
+    InputEventTypes m_interests;
 };
 
 class KWIN_EXPORT InputDeviceHandler : public QObject
@@ -26,7 +26,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 namespace KWin
 {
 
-InputEventSpy::InputEventSpy() = default;
+InputEventSpy::InputEventSpy(InputEventTypes interests)
+    : m_interests(interests)
+{
+}
 
 InputEventSpy::~InputEventSpy()
 {
@@ -35,6 +38,11 @@ InputEventSpy::~InputEventSpy()
     }
 }
 
+void InputEventSpy::setInterests(InputEventTypes interests)
+{
+    m_interests = interests;
+}
+
 void InputEventSpy::pointerEvent(MouseEvent *event)
 {
     Q_UNUSED(event)
@@ -21,7 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KWIN_INPUT_EVENT_SPY_H
 #include <kwin_export.h>
 
-#include <QtGlobal>
+#include <QFlags>
 
 class QPointF;
 class QSizeF;
@@ -34,6 +34,22 @@ class MouseEvent;
 class WheelEvent;
 class SwitchEvent;
 
+/**
+ * The kinds of input events an InputEventFilter or InputEventSpy can be interested in.
+ */
+enum class InputEventType {
+    PointerMotion = 1 << 0,
+    PointerButton = 1 << 1,
+    PointerAxis = 1 << 2,
+    Keyboard = 1 << 3,
+    Touch = 1 << 4,
+    Gesture = 1 << 5,
+    Switch = 1 << 6,
+    Tablet = 1 << 7,
+    All = 0xff
+};
+Q_DECLARE_FLAGS(InputEventTypes, InputEventType)
+
 
 /**
  * Base class for spying on input events inside InputRedirection.
@@ -42,15 +58,26 @@ class SwitchEvent;
  * support event filtering. Each InputEventSpy gets to see all input events,
  * the processing happens prior to sending events through the InputEventFilters.
  *
+ * A spy only gets to see the events of the types it is interested in, by default all of
+ * them. This spares the virtual calls for the frequent pointer motions to the spies which
+ * only care about keys.
+ *
  * Deleting an instance of InputEventSpy automatically uninstalls it from
  * InputRedirection.
  */
 class KWIN_EXPORT InputEventSpy
 {
 public:
-    InputEventSpy();
+    explicit InputEventSpy(InputEventTypes interests = InputEventType::All);
     virtual ~InputEventSpy();
 
+    /**
+     * The types of events passed to this spy.
+     */
+    InputEventTypes interests() const {
+        return m_interests;
+    }
+
     /**
      * Event spy for pointer events which can be described by a MouseEvent.
      *
@@ -90,9 +117,20 @@ public:
     virtual void tabletPadButtonEvent(const QSet<uint> &pressedButtons);
     virtual void tabletPadStripEvent(int number, int position, bool isFinger);
     virtual void tabletPadRingEvent(int number, int position, bool isFinger);
+
+protected:
+    /**
+     * Changes the types of events passed to this spy, e.g. when its state changed.
+     */
+    void setInterests(InputEventTypes interests);
+
+private:
+    InputEventTypes m_interests;
 };
 
 
 } // namespace KWin
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(KWin::InputEventTypes)
+
 #endif
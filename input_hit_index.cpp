@@ -0,0 +1,288 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "input_hit_index.h"
+#include "abstract_client.h"
+#include "screens.h"
+#include "toplevel.h"
+#include "virtualdesktops.h"
+#include "workspace.h"
+#ifdef KWIN_BUILD_ACTIVITIES
+#include "activities.h"
+#endif
+
+#include <algorithm>
+
+namespace KWin
+{
+
+static int cellCoordinate(int coordinate)
+{
+    // rounds towards negative infinity, outputs can be placed left of or above the origin
+    if (coordinate >= 0) {
+        return coordinate / InputHitIndex::s_cellSize;
+    }
+    return -((-coordinate - 1) / InputHitIndex::s_cellSize) - 1;
+}
+
+InputHitIndex::InputHitIndex(QObject *parent)
+    : QObject(parent)
+{
+    connect(VirtualDesktopManager::self(), &VirtualDesktopManager::currentChanged, this, &InputHitIndex::invalidateCurrent);
+    connect(VirtualDesktopManager::self(), &VirtualDesktopManager::countChanged, this, &InputHitIndex::invalidate);
+#ifdef KWIN_BUILD_ACTIVITIES
+    if (Activities *activities = Activities::self()) {
+        connect(activities, &Activities::currentChanged, this, &InputHitIndex::invalidateCurrent);
+        connect(activities, &Activities::removed, this, &InputHitIndex::invalidate);
+    }
+#endif
+    connect(screens(), &Screens::changed, this, &InputHitIndex::invalidate);
+}
+
+InputHitIndex::~InputHitIndex() = default;
+
+Toplevel *InputHitIndex::findAt(const QPoint &pos, std::function<bool (Toplevel *)> accept)
+{
+    update();
+    if (!m_current || !m_bounds.contains(pos)) {
+        // only the parts of the windows on the screens are indexed
+        for (auto it = m_stackingOrder.crbegin(); it != m_stackingOrder.crend(); ++it) {
+            Toplevel *t = *it;
+            if (!t->isDeleted() && isIndexed(t) && t->inputGeometry().contains(pos) && accept(t)) {
+                return t;
+            }
+        }
+        return nullptr;
+    }
+    const auto cell = m_current->cells.constFind(cellKey(cellCoordinate(pos.x()), cellCoordinate(pos.y())));
+    if (cell == m_current->cells.constEnd()) {
+        return nullptr;
+    }
+    for (Toplevel *t : *cell) {
+        if (t->inputGeometry().contains(pos) && accept(t)) {
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+int InputHitIndex::indexedCount()
+{
+    update();
+    return m_current ? m_current->windows.count() : 0;
+}
+
+void InputHitIndex::invalidate()
+{
+    m_invalid = true;
+}
+
+void InputHitIndex::invalidateCurrent()
+{
+    m_current = nullptr;
+}
+
+void InputHitIndex::markDirty(Toplevel *window)
+{
+    for (Grid &grid : m_grids) {
+        grid.dirty.insert(window);
+    }
+}
+
+void InputHitIndex::update()
+{
+    if (!workspace()) {
+        return;
+    }
+    if (m_invalid) {
+        m_invalid = false;
+        m_grids.clear();
+        m_current = nullptr;
+        m_bounds = screens()->geometry();
+    }
+    // Any modification of the stacking order detaches it from our copy, which is much
+    // cheaper to check than comparing the lists on every lookup.
+    if (!m_stackingOrder.isSharedWith(workspace()->stackingOrder())) {
+        updateStackingOrder();
+    }
+    if (!m_current) {
+        QString activity;
+#ifdef KWIN_BUILD_ACTIVITIES
+        if (Activities *activities = Activities::self()) {
+            activity = activities->current();
+        }
+#endif
+        const auto key = qMakePair(VirtualDesktopManager::self()->current(), activity);
+        auto it = m_grids.find(key);
+        if (it == m_grids.end()) {
+            // built on the first visit, kept up to date afterwards
+            it = m_grids.insert(key, Grid());
+            for (auto window = m_stackingPositions.cbegin(); window != m_stackingPositions.cend(); ++window) {
+                it->dirty.insert(window.key());
+            }
+        }
+        m_current = &(*it);
+    }
+    Grid &grid = *m_current;
+    if (grid.unsorted) {
+        grid.unsorted = false;
+        for (auto it = grid.cells.begin(); it != grid.cells.end(); ++it) {
+            sortCell(*it);
+        }
+    }
+    for (Toplevel *window : qAsConst(grid.dirty)) {
+        if (!m_stackingPositions.contains(window)) {
+            continue;
+        }
+        remove(grid, window);
+        if (isIndexed(window)) {
+            insert(grid, window);
+        }
+    }
+    grid.dirty.clear();
+}
+
+void InputHitIndex::updateStackingOrder()
+{
+    const QList<Toplevel *> &stacking = workspace()->stackingOrder();
+    if (m_stackingOrder == stacking) {
+        m_stackingOrder = stacking;
+        return;
+    }
+    m_stackingOrder = stacking;
+
+    QHash<Toplevel *, int> positions;
+    positions.reserve(stacking.count());
+    for (int i = 0; i < stacking.count(); ++i) {
+        Toplevel *t = stacking.at(i);
+        if (t->isDeleted()) {
+            // a deleted window doesn't get input events
+            continue;
+        }
+        positions.insert(t, i);
+        if (!m_stackingPositions.contains(t)) {
+            watch(t);
+            markDirty(t);
+        }
+    }
+
+    QVector<Toplevel *> gone;
+    for (auto it = m_stackingPositions.cbegin(); it != m_stackingPositions.cend(); ++it) {
+        if (!positions.contains(it.key())) {
+            gone << it.key();
+        }
+    }
+    m_stackingPositions = positions;
+    for (Toplevel *t : gone) {
+        disconnect(t, nullptr, this, nullptr);
+        forget(t);
+    }
+
+    // the grids of the other desktops and activities get sorted when they are used again
+    for (Grid &grid : m_grids) {
+        grid.unsorted = true;
+    }
+}
+
+void InputHitIndex::watch(Toplevel *window)
+{
+    connect(window, &Toplevel::geometryShapeChanged, this, [this, window] { markDirty(window); });
+    connect(window, &Toplevel::geometryChanged, this, [this, window] { markDirty(window); });
+    connect(window, &Toplevel::activitiesChanged, this, [this, window] { markDirty(window); });
+    if (AbstractClient *client = qobject_cast<AbstractClient *>(window)) {
+        connect(client, &AbstractClient::desktopChanged, this, [this, window] { markDirty(window); });
+    }
+    // the window might get destroyed before the stacking order is updated
+    connect(window, &QObject::destroyed, this, [this, window] { forget(window); });
+}
+
+void InputHitIndex::forget(Toplevel *window)
+{
+    m_stackingPositions.remove(window);
+    for (Grid &grid : m_grids) {
+        remove(grid, window);
+        grid.dirty.remove(window);
+    }
+}
+
+bool InputHitIndex::isIndexed(Toplevel *window) const
+{
+    return window->isOnCurrentDesktop() && window->isOnCurrentActivity();
+}
+
+QRect InputHitIndex::cellsFor(const QRect &geometry) const
+{
+    const QRect rect = geometry & m_bounds;
+    if (rect.isEmpty()) {
+        return QRect();
+    }
+    return QRect(QPoint(cellCoordinate(rect.left()), cellCoordinate(rect.top())),
+                 QPoint(cellCoordinate(rect.right()), cellCoordinate(rect.bottom())));
+}
+
+void InputHitIndex::insert(Grid &grid, Toplevel *window)
+{
+    const QRect cells = cellsFor(window->inputGeometry());
+    if (!cells.isValid()) {
+        return;
+    }
+    grid.windows.insert(window, cells);
+    const int position = m_stackingPositions.value(window, -1);
+    const auto isBelow = [this, position] (Toplevel *other) {
+        return m_stackingPositions.value(other, -1) < position;
+    };
+    for (int y = cells.top(); y <= cells.bottom(); ++y) {
+        for (int x = cells.left(); x <= cells.right(); ++x) {
+            QVector<Toplevel *> &cell = grid.cells[cellKey(x, y)];
+            // cells are ordered top most first
+            cell.insert(std::find_if(cell.begin(), cell.end(), isBelow), window);
+        }
+    }
+}
+
+void InputHitIndex::remove(Grid &grid, Toplevel *window)
+{
+    const QRect cells = grid.windows.take(window);
+    if (!cells.isValid()) {
+        return;
+    }
+    for (int y = cells.top(); y <= cells.bottom(); ++y) {
+        for (int x = cells.left(); x <= cells.right(); ++x) {
+            auto it = grid.cells.find(cellKey(x, y));
+            if (it == grid.cells.end()) {
+                continue;
+            }
+            it->removeOne(window);
+            if (it->isEmpty()) {
+                grid.cells.erase(it);
+            }
+        }
+    }
+}
+
+void InputHitIndex::sortCell(QVector<Toplevel *> &cell) const
+{
+    std::sort(cell.begin(), cell.end(),
+        [this] (Toplevel *a, Toplevel *b) {
+            return m_stackingPositions.value(a, -1) > m_stackingPositions.value(b, -1);
+        }
+    );
+}
+
+}
@@ -0,0 +1,125 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_INPUT_HIT_INDEX_H
+#define KWIN_INPUT_HIT_INDEX_H
+
+#include <kwinglobals.h>
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QRect>
+#include <QSet>
+#include <QVector>
+
+#include <functional>
+
+namespace KWin
+{
+
+class Toplevel;
+
+/**
+ * @brief Spatial index over the input geometries of the windows in the stacking order.
+ *
+ * The workspace is split into a uniform grid. Each cell knows the windows whose input
+ * geometry intersects it, ordered from the top most to the bottom most one. Looking up
+ * the window at a position thus only has to consider the few windows overlapping the
+ * cell instead of walking the complete stacking order.
+ *
+ * There is a grid for each virtual desktop and activity, holding the windows on them. It is
+ * built on the first lookup on that desktop and activity and kept afterwards, switching
+ * back to it only has to re-insert the windows which changed in the meantime. The grids are
+ * updated incrementally: windows which changed their geometry, desktop or activities are
+ * re-inserted on the next lookup, a changed stacking order only updates the order of the
+ * cells, and all grids are only dropped if the screens or the number of desktops changed,
+ * or an activity got removed.
+ *
+ * The index only narrows down the candidates, the caller still has to check whether a
+ * window wants to get input at the position.
+ */
+class KWIN_EXPORT InputHitIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InputHitIndex(QObject *parent = nullptr);
+    ~InputHitIndex() override;
+
+    /**
+     * Returns the top most window whose input geometry contains @p pos and for which
+     * @p accept returns @c true, or @c null if there is no such window.
+     */
+    Toplevel *findAt(const QPoint &pos, std::function<bool (Toplevel *)> accept);
+
+    /**
+     * The number of windows which are put into the grid of the current desktop and activity.
+     */
+    int indexedCount();
+
+    static const int s_cellSize = 256;
+
+private:
+    struct Grid {
+        QHash<quint64, QVector<Toplevel *>> cells;
+        /**
+         * The cells covered by each window of this grid.
+         */
+        QHash<Toplevel *, QRect> windows;
+        /**
+         * The windows to insert again on the next lookup.
+         */
+        QSet<Toplevel *> dirty;
+        /**
+         * Whether the stacking order changed since the cells got sorted.
+         */
+        bool unsorted = false;
+    };
+
+    void update();
+    void updateStackingOrder();
+    void invalidate();
+    void invalidateCurrent();
+    void markDirty(Toplevel *window);
+    void watch(Toplevel *window);
+    void forget(Toplevel *window);
+    void insert(Grid &grid, Toplevel *window);
+    void remove(Grid &grid, Toplevel *window);
+    bool isIndexed(Toplevel *window) const;
+    QRect cellsFor(const QRect &geometry) const;
+    void sortCell(QVector<Toplevel *> &cell) const;
+
+    static quint64 cellKey(int x, int y) {
+        return (quint64(quint32(x)) << 32) | quint32(y);
+    }
+
+    // the grids by desktop and activity
+    QHash<QPair<uint, QString>, Grid> m_grids;
+    Grid *m_current = nullptr;
+    // the position of each window in the stacking order
+    QHash<Toplevel *, int> m_stackingPositions;
+    QList<Toplevel *> m_stackingOrder;
+    QRect m_bounds;
+    bool m_invalid = true;
+};
+
+}
+
+#endif
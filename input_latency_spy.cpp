@@ -0,0 +1,105 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "input_latency_spy.h"
+#include "composite.h"
+#include "framescheduler.h"
+#include "input_event.h"
+#include "screens.h"
+
+#include <QTabletEvent>
+
+namespace KWin
+{
+
+InputLatencySpy::InputLatencySpy()
+    : InputEventSpy(InputEventType::PointerMotion | InputEventType::PointerButton |
+                    InputEventType::PointerAxis | InputEventType::Keyboard |
+                    InputEventType::Touch | InputEventType::Tablet)
+{
+}
+
+void InputLatencySpy::pointerEvent(MouseEvent *event)
+{
+    if (event->timestampMicroseconds()) {
+        addEventMicroseconds(event->timestampMicroseconds(), event->screenPos());
+    } else {
+        addEvent(event->timestamp(), event->screenPos());
+    }
+}
+
+void InputLatencySpy::wheelEvent(WheelEvent *event)
+{
+    addEvent(event->timestamp(), event->globalPosF());
+}
+
+void InputLatencySpy::keyEvent(KeyEvent *event)
+{
+    addEvent(event->timestamp(), screens()->geometry(screens()->current()).center());
+}
+
+void InputLatencySpy::touchDown(qint32 id, const QPointF &pos, quint32 time)
+{
+    m_touchPoints.insert(id, pos);
+    addEvent(time, pos);
+}
+
+void InputLatencySpy::touchMotion(qint32 id, const QPointF &pos, quint32 time)
+{
+    m_touchPoints.insert(id, pos);
+    addEvent(time, pos);
+}
+
+void InputLatencySpy::touchUp(qint32 id, quint32 time)
+{
+    addEvent(time, m_touchPoints.take(id));
+}
+
+void InputLatencySpy::tabletToolEvent(QTabletEvent *event)
+{
+    addEvent(event->timestamp(), event->globalPosF());
+}
+
+void InputLatencySpy::addEvent(quint32 time, const QPointF &pos)
+{
+    // The millisecond timestamps are the monotonic clock truncated to 32 bits. The
+    // difference to the truncated current time gives the age even across a wrap around.
+    const qint64 now = FrameScheduler::monotonicTime();
+    const quint32 age = quint32(now / (1000 * 1000)) - time;
+    addEventMicroseconds((now - qint64(age) * 1000 * 1000) / 1000, pos);
+}
+
+void InputLatencySpy::addEventMicroseconds(quint64 time, const QPointF &pos)
+{
+    Compositor *compositor = Compositor::self();
+    if (!compositor) {
+        return;
+    }
+    // only the output showing the event relates it to its frames
+    const QPoint point = pos.toPoint();
+    const auto schedulers = compositor->frameSchedulers();
+    for (FrameScheduler *scheduler : schedulers) {
+        if (scheduler->geometry().contains(point)) {
+            scheduler->addInputEvent(qint64(time) * 1000);
+            return;
+        }
+    }
+}
+
+}
@@ -0,0 +1,55 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#pragma once
+#include "input_event_spy.h"
+
+#include <QHash>
+#include <QPointF>
+
+namespace KWin
+{
+
+/**
+ * Passes the timestamps of the input events to the FrameSchedulers, which relate them to
+ * the frames showing their effect. Each event goes to the scheduler of the output under the
+ * pointer or touch point, keyboard events to the one of the active output.
+ */
+class InputLatencySpy : public InputEventSpy
+{
+public:
+    InputLatencySpy();
+
+    void pointerEvent(KWin::MouseEvent *event) override;
+    void wheelEvent(KWin::WheelEvent *event) override;
+    void keyEvent(KWin::KeyEvent *event) override;
+    void touchDown(qint32 id, const QPointF &pos, quint32 time) override;
+    void touchMotion(qint32 id, const QPointF &pos, quint32 time) override;
+    void touchUp(qint32 id, quint32 time) override;
+    void tabletToolEvent(QTabletEvent *event) override;
+
+private:
+    void addEvent(quint32 time, const QPointF &pos);
+    void addEventMicroseconds(quint64 time, const QPointF &pos);
+
+    // the touch up events don't carry a position
+    QHash<qint32, QPointF> m_touchPoints;
+};
+
+}
@@ -59,7 +59,8 @@ class KeyStateChangedSpy : public InputEventSpy
 {
 public:
     KeyStateChangedSpy(InputRedirection *input)
-        : m_input(input)
+        : InputEventSpy(InputEventType::Keyboard)
+        , m_input(input)
     {
     }
 
@@ -79,7 +80,8 @@ class ModifiersChangedSpy : public InputEventSpy
 {
 public:
     ModifiersChangedSpy(InputRedirection *input)
-        : m_input(input)
+        : InputEventSpy(InputEventType::Keyboard)
+        , m_input(input)
         , m_modifiers()
     {
     }
@@ -224,11 +226,11 @@ void KeyboardInputRedirection::processKey(uint32_t key, InputRedirection::Keyboa
                    device);
     event.setModifiersRelevantForGlobalShortcuts(m_xkb->modifiersRelevantForGlobalShortcuts());
 
-    m_input->processSpies(std::bind(&InputEventSpy::keyEvent, std::placeholders::_1, &event));
+    m_input->processSpies(InputEventType::Keyboard, std::bind(&InputEventSpy::keyEvent, std::placeholders::_1, &event));
     if (!m_inited) {
         return;
     }
-    m_input->processFilters(std::bind(&InputEventFilter::keyEvent, std::placeholders::_1, &event));
+    m_input->processFilters(InputEventType::Keyboard, std::bind(&InputEventFilter::keyEvent, std::placeholders::_1, &event));
 
     m_xkb->forwardModifiers();
 }
@@ -40,6 +40,7 @@ namespace KWin
 
 KeyboardLayout::KeyboardLayout(Xkb *xkb)
     : QObject()
+    , InputEventSpy(InputEventType::Keyboard)
     , m_xkb(xkb)
     , m_notifierItem(nullptr)
 {
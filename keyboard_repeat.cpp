@@ -31,6 +31,7 @@ namespace KWin
 
 KeyboardRepeat::KeyboardRepeat(Xkb *xkb)
     : QObject()
+    , InputEventSpy(InputEventType::Keyboard)
     , m_timer(new QTimer)
     , m_xkb(xkb)
 {
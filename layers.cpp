@@ -77,6 +77,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  helper class) it's possible to temporarily disable updates
  and the stacking order will be updated once after it's allowed again.
 
+ Raising or lowering a single window doesn't rebuild the stacking order, the window
+ and its transients are moved to the top or bottom of their layer in
+ Workspace::stacking_order instead (see Workspace::applyRestackHint()). Anything else
+ which changes the unconstrained stacking order, a layer or the transients of a window
+ has to call Workspace::invalidateRestackHint().
+
 */
 
 #include "utils.h"
@@ -99,6 +105,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QDebug>
 
+#include <algorithm>
+
 namespace KWin
 {
 
@@ -119,7 +127,16 @@ void Workspace::updateStackingOrder(bool propagate_new_clients)
             blocked_propagating_new_clients = true;
         return;
     }
-    QList<Toplevel *> new_stacking_order = constrainedStackingOrder();
+    // A single raise or lower is applied to the current stacking order, only the area in
+    // which windows changed their relative order has to be repainted.
+    QList<Toplevel *> new_stacking_order = stacking_order;
+    QRegion repaints;
+    bool repaintFull = false;
+    if (propagate_new_clients || !applyRestackHint(new_stacking_order, repaints)) {
+        new_stacking_order = constrainedStackingOrder();
+        repaintFull = !restackRepaints(stacking_order, new_stacking_order, repaints);
+    }
+    m_restackHint = RestackHint();
     bool changed = (force_restacking || new_stacking_order != stacking_order);
     force_restacking = false;
     stacking_order = new_stacking_order;
@@ -127,7 +144,16 @@ void Workspace::updateStackingOrder(bool propagate_new_clients)
         propagateClients(propagate_new_clients);
         emit stackingOrderChanged();
         if (m_compositor) {
-            m_compositor->addRepaintFull();
+            // the partial repaints assume that the windows are painted at their geometry, which
+            // active effects like Present Windows or Blur don't guarantee
+            if (effects && static_cast<EffectsHandlerImpl *>(effects)->hasActiveEffects()) {
+                repaintFull = true;
+            }
+            if (repaintFull) {
+                m_compositor->addRepaintFull();
+            } else if (!repaints.isEmpty()) {
+                m_compositor->addRepaint(repaints);
+            }
         }
 
         if (active_client)
@@ -320,6 +346,7 @@ void Workspace::lowerClient(AbstractClient* c, bool nogroup)
 
     unconstrained_stacking_order.removeAll(c);
     unconstrained_stacking_order.prepend(c);
+    addRestackHint(c, false);
     if (!nogroup && c->isTransient()) {
         // lower also all windows in the group, in their reversed stacking order
         QList<X11Client *> wins;
@@ -346,6 +373,7 @@ void Workspace::lowerClientWithinApplication(AbstractClient* c)
     c->cancelAutoRaise();
 
     StackingUpdatesBlocker blocker(this);
+    invalidateRestackHint();
 
     unconstrained_stacking_order.removeAll(c);
     bool lowered = false;
@@ -388,6 +416,7 @@ void Workspace::raiseClient(AbstractClient* c, bool nogroup)
 
     unconstrained_stacking_order.removeAll(c);
     unconstrained_stacking_order.append(c);
+    addRestackHint(c, true);
 
     if (!c->isSpecialWindow()) {
         most_recently_raised = c;
@@ -415,6 +444,7 @@ void Workspace::raiseClientWithinApplication(AbstractClient* c)
         if (AbstractClient::belongToSameApplication(other, c)) {
             unconstrained_stacking_order.removeAll(c);
             unconstrained_stacking_order.insert(unconstrained_stacking_order.indexOf(other) + 1, c);   // insert after the found one
+            invalidateRestackHint();
             break;
         }
     }
@@ -463,6 +493,7 @@ void Workspace::restack(AbstractClient* c, AbstractClient* under, bool force)
     if (under) {
         unconstrained_stacking_order.removeAll(c);
         unconstrained_stacking_order.insert(unconstrained_stacking_order.indexOf(under), c);
+        invalidateRestackHint();
     }
 
     Q_ASSERT(unconstrained_stacking_order.contains(c));
@@ -484,6 +515,7 @@ void Workspace::restoreSessionStackingOrder(X11Client *c)
     if (c->sessionStackingOrder() < 0)
         return;
     StackingUpdatesBlocker blocker(this);
+    invalidateRestackHint();
     unconstrained_stacking_order.removeAll(c);
     for (auto it = unconstrained_stacking_order.begin();  // from bottom
             it != unconstrained_stacking_order.end();
@@ -620,6 +652,189 @@ QList<Toplevel *> Workspace::constrainedStackingOrder()
     return stacking;
 }
 
+void Workspace::addRestackHint(AbstractClient *c, bool raise)
+{
+    if (m_restackHint.client && (m_restackHint.client != c || m_restackHint.raise != raise)) {
+        // more than one window got restacked, that's up to constrainedStackingOrder()
+        m_restackHint.valid = false;
+    }
+    m_restackHint.client = c;
+    m_restackHint.raise = raise;
+}
+
+void Workspace::invalidateRestackHint()
+{
+    m_restackHint.valid = false;
+}
+
+/**
+ * Whether the position of @p window in the constrained stacking order only depends on its
+ * layer, i.e. it is neither kept above a main window nor lifted by its window group.
+ */
+static bool isStackedByLayer(Toplevel *window)
+{
+    if (auto *client = qobject_cast<AbstractClient *>(window)) {
+        if (client->isTransient()) {
+            return false;
+        }
+        if (auto *x11Client = qobject_cast<X11Client *>(client)) {
+            return x11Client->group() && x11Client->group()->members().count() == 1;
+        }
+        return true;
+    }
+    if (auto *deleted = qobject_cast<Deleted *>(window)) {
+        return !deleted->wasTransient() && !deleted->wasGroupTransient();
+    }
+    return true;
+}
+
+/**
+ * Applies the raise or lower recorded in m_restackHint to @p stacking, which has to be the
+ * current constrained stacking order. The result is the same as what constrainedStackingOrder()
+ * would return, only the window and its transients have to be moved. Returns @c false if the
+ * hint can't be applied, the stacking order has to be rebuilt then.
+ *
+ * @p repaints is set to the area in which the moved windows overlap the windows they passed.
+ */
+bool Workspace::applyRestackHint(QList<Toplevel *> &stacking, QRegion &repaints)
+{
+    AbstractClient *c = m_restackHint.client;
+    if (!c || !m_restackHint.valid || !isStackedByLayer(c)) {
+        return false;
+    }
+    const int index = stacking.indexOf(c);
+    if (index == -1) {
+        return false;
+    }
+    const Layer layer = c->layer();
+    for (const Deleted *deletedWindow : deletedList()) {
+        if (deletedWindow->wasTransientFor(c)) {
+            return false;
+        }
+    }
+
+    // The moved windows, bottom most first. When raised, the transients end up right above
+    // the window in their current order. When lowered, they keep their position, which would
+    // be right above the window only if they were not above it in the unconstrained order.
+    QVector<int> moved{index};
+    const QList<AbstractClient *> transients = c->transients();
+    if (!m_restackHint.raise && !transients.isEmpty()) {
+        return false;
+    }
+    for (AbstractClient *transient : transients) {
+        if (transient->layer() != layer || !transient->transients().isEmpty()
+                || transient->mainClients() != QList<AbstractClient *>{c}
+                || !keepTransientAbove(c, transient)) {
+            return false;
+        }
+        const int transientIndex = stacking.indexOf(transient);
+        if (transientIndex == -1) {
+            return false;
+        }
+        moved.append(transientIndex);
+    }
+    std::sort(moved.begin(), moved.end());
+
+    // find the top or the bottom of the window's layer
+    int target = -1;
+    if (m_restackHint.raise) {
+        target = 0;
+        for (int i = stacking.count() - 1; i >= 0; --i) {
+            Toplevel *t = stacking.at(i);
+            if (t->layer() > layer || moved.contains(i)) {
+                continue;
+            }
+            if (!isStackedByLayer(t)) {
+                return false;
+            }
+            target = i + 1;
+            break;
+        }
+    } else {
+        target = index;
+        for (int i = 0; i < index; ++i) {
+            Toplevel *t = stacking.at(i);
+            if (t->layer() < layer) {
+                continue;
+            }
+            if (!isStackedByLayer(t)) {
+                return false;
+            }
+            target = i;
+            break;
+        }
+    }
+
+    // the windows between the old and the new position change their order relative to the moved ones
+    const int first = std::min(moved.first(), target);
+    const int last = std::max(moved.last() + 1, target);
+    QRegion movedArea;
+    QRegion passedArea;
+    for (int i = first; i < last; ++i) {
+        if (moved.contains(i)) {
+            movedArea += stacking.at(i)->visibleRect();
+        } else {
+            passedArea += stacking.at(i)->visibleRect();
+        }
+    }
+    if (passedArea.isEmpty() && last - first == moved.count()) {
+        // already in place
+        repaints = QRegion();
+        return true;
+    }
+    repaints = movedArea & passedArea;
+
+    QVector<Toplevel *> windows;
+    windows.reserve(moved.count());
+    int insertAt = target;
+    for (int i = moved.count() - 1; i >= 0; --i) {
+        windows.prepend(stacking.takeAt(moved.at(i)));
+        if (moved.at(i) < target) {
+            --insertAt;
+        }
+    }
+    for (Toplevel *window : qAsConst(windows)) {
+        stacking.insert(insertAt++, window);
+    }
+    return true;
+}
+
+/**
+ * Computes the area to repaint after the stacking order changed from @p oldOrder to @p newOrder.
+ * Only the windows between the first and the last position which differ can have changed their
+ * relative order. Returns @c false if windows got added or removed, everything has to be
+ * repainted then.
+ */
+bool Workspace::restackRepaints(const QList<Toplevel *> &oldOrder, const QList<Toplevel *> &newOrder, QRegion &repaints) const
+{
+    if (oldOrder.count() != newOrder.count()) {
+        return false;
+    }
+    int first = 0;
+    int last = newOrder.count() - 1;
+    while (first <= last && oldOrder.at(first) == newOrder.at(first)) {
+        ++first;
+    }
+    while (last >= first && oldOrder.at(last) == newOrder.at(last)) {
+        --last;
+    }
+    if (first > last) {
+        return true;
+    }
+    // the windows of the old order might be gone already, don't touch them
+    QVector<Toplevel *> before = oldOrder.mid(first, last - first + 1).toVector();
+    QVector<Toplevel *> after = newOrder.mid(first, last - first + 1).toVector();
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    if (before != after) {
+        return false;
+    }
+    for (int i = first; i <= last; ++i) {
+        repaints += newOrder.at(i)->visibleRect();
+    }
+    return true;
+}
+
 void Workspace::blockStackingUpdates(bool block)
 {
     if (block) {
@@ -48,6 +48,10 @@ class ConnectionAdaptor : public QObject
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.KWin.InputDeviceManager")
     Q_PROPERTY(QStringList devicesSysNames READ devicesSysNames CONSTANT)
+    Q_PROPERTY(int eventQueueDepth READ eventQueueDepth)
+    Q_PROPERTY(int eventQueueMaxDepth READ eventQueueMaxDepth)
+    Q_PROPERTY(qulonglong eventQueueOverflows READ eventQueueOverflows)
+    Q_PROPERTY(qulonglong mergedEvents READ mergedEvents)
 
 private:
     Connection *m_con;
@@ -76,6 +80,20 @@ public:
         return m_con->devicesSysNames();
     }
 
+    // the counters are atomics, reading them from the main thread is fine
+    int eventQueueDepth() const {
+        return m_con->eventQueueDepth();
+    }
+    int eventQueueMaxDepth() const {
+        return m_con->eventQueueMaxDepth();
+    }
+    qulonglong eventQueueOverflows() const {
+        return m_con->eventQueueOverflows();
+    }
+    qulonglong mergedEvents() const {
+        return m_con->mergedEvents();
+    }
+
 Q_SIGNALS:
     void deviceAdded(QString sysName);
     void deviceRemoved(QString sysName);
@@ -229,17 +247,26 @@ void Connection::deactivate()
 
 void Connection::handleEvent()
 {
-    QMutexLocker locker(&m_mutex);
-    const bool wasEmpty = m_eventQueue.isEmpty();
-    do {
+    // deactivate() reads the remaining events from the main thread
+    QMutexLocker locker(&m_readMutex);
+    const int read = m_eventQueue.fill([this] {
         m_input->dispatch();
-        Event *event = m_input->event();
-        if (!event) {
-            break;
-        }
-        m_eventQueue << event;
-    } while (true);
-    if (wasEmpty && !m_eventQueue.isEmpty()) {
+        return m_input->event();
+    });
+    if (m_eventQueue.isFull()) {
+        // The main thread lags behind, the events stay in libinput's queue until
+        // processEvents() made room again.
+        m_eventQueueOverflows.fetch_add(1, std::memory_order_relaxed);
+        m_readingPaused = true;
+    }
+    if (!read) {
+        return;
+    }
+    const int depth = m_eventQueue.count();
+    if (depth > m_eventQueueMaxDepth.load(std::memory_order_relaxed)) {
+        m_eventQueueMaxDepth.store(depth, std::memory_order_relaxed);
+    }
+    if (!m_processingScheduled.exchange(true)) {
         emit eventsRead();
     }
 }
@@ -247,8 +274,10 @@ void Connection::handleEvent()
 void Connection::processEvents()
 {
     QMutexLocker locker(&m_mutex);
-    while (!m_eventQueue.isEmpty()) {
-        QScopedPointer<Event> event(m_eventQueue.takeFirst());
+    // cleared before draining the queue, events read meanwhile schedule another call
+    m_processingScheduled = false;
+    while (Event *next = m_eventQueue.pop()) {
+        QScopedPointer<Event> event(next);
         switch (event->type()) {
             case LIBINPUT_EVENT_DEVICE_ADDED: {
                 auto device = new Device(event->nativeDevice());
@@ -361,18 +390,20 @@ void Connection::processEvents()
                 auto deltaNonAccel = pe->deltaUnaccelerated();
                 quint32 latestTime = pe->time();
                 quint64 latestTimeUsec = pe->timeMicroseconds();
-                auto it = m_eventQueue.begin();
-                while (it != m_eventQueue.end()) {
-                    if ((*it)->type() == LIBINPUT_EVENT_POINTER_MOTION) {
-                        QScopedPointer<PointerEvent> p(static_cast<PointerEvent*>(*it));
-                        delta += p->delta();
-                        deltaNonAccel += p->deltaUnaccelerated();
-                        latestTime = p->time();
-                        latestTimeUsec = p->timeMicroseconds();
-                        it = m_eventQueue.erase(it);
-                    } else {
+                quint64 merged = 0;
+                while (Event *next = m_eventQueue.peek()) {
+                    if (next->type() != LIBINPUT_EVENT_POINTER_MOTION) {
                         break;
                     }
+                    QScopedPointer<PointerEvent> p(static_cast<PointerEvent*>(m_eventQueue.pop()));
+                    delta += p->delta();
+                    deltaNonAccel += p->deltaUnaccelerated();
+                    latestTime = p->time();
+                    latestTimeUsec = p->timeMicroseconds();
+                    merged++;
+                }
+                if (merged) {
+                    m_mergedEvents.fetch_add(merged, std::memory_order_relaxed);
                 }
                 emit pointerMotion(delta, deltaNonAccel, latestTime, latestTimeUsec, pe->device());
                 break;
@@ -397,9 +428,18 @@ void Connection::processEvents()
             }
             case LIBINPUT_EVENT_TOUCH_MOTION: {
 #ifndef KWIN_BUILD_TESTING
-                TouchEvent *te = static_cast<TouchEvent*>(event.data());
-                const auto &geo = screens()->geometry(te->device()->screenId());
-                emit touchMotion(te->id(), geo.topLeft() + te->absolutePos(geo.size()), te->time(), te->device());
+                // if further frames of motions are queued up, only the last motion of each
+                // touch point is needed, followed by a single frame
+                const int superseded = m_eventQueue.takeTouchMotions(static_cast<TouchEvent*>(event.take()), m_touchMotions);
+                if (superseded) {
+                    m_mergedEvents.fetch_add(superseded, std::memory_order_relaxed);
+                }
+                for (TouchEvent *te : m_touchMotions) {
+                    const auto &geo = screens()->geometry(te->device()->screenId());
+                    emit touchMotion(te->id(), geo.topLeft() + te->absolutePos(geo.size()), te->time(), te->device());
+                    delete te;
+                }
+                m_touchMotions.clear();
                 break;
 #endif
             }
@@ -542,6 +582,10 @@ void Connection::processEvents()
         }
         wasSuspended = false;
     }
+    if (m_readingPaused.exchange(false)) {
+        // there is room again for the events left in libinput's queue
+        QMetaObject::invokeMethod(this, [this] { handleEvent(); }, Qt::QueuedConnection);
+    }
 }
 
 void Connection::setScreenSize(const QSize &size)
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KWIN_LIBINPUT_CONNECTION_H
 #define KWIN_LIBINPUT_CONNECTION_H
 
+#include "eventqueue.h"
 #include "../input.h"
 #include "../keyboard_input.h"
 #include <kwinglobals.h>
@@ -31,6 +32,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QVector>
 #include <QStringList>
 
+#include <atomic>
+
 class QSocketNotifier;
 class QThread;
 
@@ -42,6 +45,7 @@ namespace LibInput
 class Event;
 class Device;
 class Context;
+class TouchEvent;
 
 class KWIN_EXPORT Connection : public QObject
 {
@@ -85,6 +89,32 @@ public:
 
     void processEvents();
 
+    /**
+     * The number of events read from libinput which are not processed yet.
+     */
+    int eventQueueDepth() const {
+        return m_eventQueue.count();
+    }
+    /**
+     * The highest number of unprocessed events so far.
+     */
+    int eventQueueMaxDepth() const {
+        return m_eventQueueMaxDepth.load(std::memory_order_relaxed);
+    }
+    /**
+     * How often reading from libinput got paused because the event queue was full.
+     */
+    quint64 eventQueueOverflows() const {
+        return m_eventQueueOverflows.load(std::memory_order_relaxed);
+    }
+    /**
+     * The number of pointer and touch motion events merged into a following one because
+     * the main thread couldn't keep up.
+     */
+    quint64 mergedEvents() const {
+        return m_mergedEvents.load(std::memory_order_relaxed);
+    }
+
     void toggleTouchpads();
     void enableTouchpads();
     void disableTouchpads();
@@ -165,7 +195,15 @@ private:
     bool m_touchBeforeSuspend = false;
     bool m_tabletModeSwitchBeforeSuspend = false;
     QMutex m_mutex;
-    QVector<Event*> m_eventQueue;
+    QMutex m_readMutex;
+    EventQueue m_eventQueue;
+    std::atomic<bool> m_processingScheduled{false};
+    std::atomic<bool> m_readingPaused{false};
+    std::atomic<int> m_eventQueueMaxDepth{0};
+    std::atomic<quint64> m_eventQueueOverflows{0};
+    std::atomic<quint64> m_mergedEvents{0};
+    // reused for coalescing the touch motions, so that it doesn't allocate on each motion
+    std::vector<TouchEvent *> m_touchMotions;
     bool wasSuspended = false;
     QVector<Device*> m_devices;
     KSharedConfigPtr m_config;
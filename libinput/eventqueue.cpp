@@ -0,0 +1,162 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "eventqueue.h"
+#include "events.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+namespace LibInput
+{
+
+static quint32 roundUpToPowerOfTwo(int value)
+{
+    quint32 result = 1;
+    while (result < quint32(value)) {
+        result <<= 1;
+    }
+    return result;
+}
+
+EventQueue::EventQueue(int capacity)
+    : m_slots(roundUpToPowerOfTwo(qMax(capacity, 1)), nullptr)
+    , m_mask(m_slots.size() - 1)
+{
+}
+
+EventQueue::~EventQueue()
+{
+    while (Event *event = pop()) {
+        delete event;
+    }
+}
+
+int EventQueue::capacity() const
+{
+    return m_slots.size();
+}
+
+int EventQueue::count() const
+{
+    const quint32 head = m_head.load(std::memory_order_acquire);
+    const quint32 tail = m_tail.load(std::memory_order_acquire);
+    return tail - head;
+}
+
+bool EventQueue::isEmpty() const
+{
+    return count() == 0;
+}
+
+bool EventQueue::isFull() const
+{
+    return count() == capacity();
+}
+
+bool EventQueue::push(Event *event)
+{
+    const quint32 tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+        return false;
+    }
+    m_slots[tail & m_mask] = event;
+    // publishes the slot to the consumer
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+int EventQueue::fill(const std::function<Event *()> &next)
+{
+    int pushed = 0;
+    while (!isFull()) {
+        Event *event = next();
+        if (!event) {
+            break;
+        }
+        push(event);
+        pushed++;
+    }
+    return pushed;
+}
+
+Event *EventQueue::peek(int offset) const
+{
+    const quint32 head = m_head.load(std::memory_order_relaxed);
+    if (m_tail.load(std::memory_order_acquire) - head <= quint32(offset)) {
+        return nullptr;
+    }
+    return m_slots[(head + offset) & m_mask];
+}
+
+Event *EventQueue::pop()
+{
+    const quint32 head = m_head.load(std::memory_order_relaxed);
+    if (m_tail.load(std::memory_order_acquire) == head) {
+        return nullptr;
+    }
+    Event *event = m_slots[head & m_mask];
+    // hands the slot back to the producer
+    m_head.store(head + 1, std::memory_order_release);
+    return event;
+}
+
+int EventQueue::takeTouchMotions(TouchEvent *motion, std::vector<TouchEvent *> &motions)
+{
+    motions.clear();
+    motions.push_back(motion);
+    // the events before the last frame made of nothing but motions of the same device
+    int count = 0;
+    for (int offset = 0; Event *event = peek(offset); ++offset) {
+        if (event->device() != motion->device()) {
+            break;
+        }
+        if (event->type() == LIBINPUT_EVENT_TOUCH_FRAME) {
+            count = offset;
+        } else if (event->type() != LIBINPUT_EVENT_TOUCH_MOTION) {
+            break;
+        }
+    }
+    int superseded = 0;
+    for (int i = 0; i < count; ++i) {
+        Event *event = pop();
+        if (event->type() == LIBINPUT_EVENT_TOUCH_FRAME) {
+            delete event;
+            continue;
+        }
+        TouchEvent *next = static_cast<TouchEvent*>(event);
+        auto it = std::find_if(motions.begin(), motions.end(),
+            [next] (TouchEvent *taken) {
+                return taken->id() == next->id();
+            }
+        );
+        if (it == motions.end()) {
+            motions.push_back(next);
+        } else {
+            delete *it;
+            *it = next;
+            superseded++;
+        }
+    }
+    return superseded;
+}
+
+}
+}
@@ -0,0 +1,116 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_LIBINPUT_EVENTQUEUE_H
+#define KWIN_LIBINPUT_EVENTQUEUE_H
+
+#include <kwinglobals.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace KWin
+{
+namespace LibInput
+{
+
+class Event;
+class TouchEvent;
+
+/**
+ * @brief Bounded queue handing the events read on the libinput thread over to the main thread.
+ *
+ * The queue is a ring buffer of preallocated slots with exactly one producer, the thread
+ * reading from libinput, and exactly one consumer, the thread processing the events. Neither
+ * side ever blocks or allocates: the producer publishes a slot by advancing the tail, the
+ * consumer frees it by advancing the head.
+ *
+ * The queue owns the events it holds, events which are still queued on destruction get deleted.
+ */
+class KWIN_EXPORT EventQueue
+{
+public:
+    /**
+     * Creates a queue for at least @p capacity events, the capacity is rounded up to the
+     * next power of two.
+     */
+    explicit EventQueue(int capacity = s_defaultCapacity);
+    ~EventQueue();
+
+    int capacity() const;
+
+    /**
+     * The number of queued events. Only exact if called from the producer or the consumer
+     * while the other side is idle.
+     */
+    int count() const;
+    bool isEmpty() const;
+    /**
+     * Whether the next push would fail. Meant to be called by the producer.
+     */
+    bool isFull() const;
+
+    /**
+     * Appends @p event, returns @c false and keeps the ownership with the caller if the queue
+     * is full. Must only be called by the producer.
+     */
+    bool push(Event *event);
+    /**
+     * Pushes the events returned by @p next until it returns @c null or the queue is full.
+     * Once the queue is full @p next doesn't get called anymore, so the remaining events stay
+     * with their source until the consumer made room again. Returns the number of pushed
+     * events. Must only be called by the producer.
+     */
+    int fill(const std::function<Event *()> &next);
+    /**
+     * The event @p offset positions after the head of the queue, @c null if there are not
+     * that many events. Must only be called by the consumer.
+     */
+    Event *peek(int offset = 0) const;
+    /**
+     * Takes the event at the head of the queue, @c null if it is empty. The caller gets the
+     * ownership. Must only be called by the consumer.
+     */
+    Event *pop();
+    /**
+     * Coalesces the touch motions of the frames queued after @p motion. As long as the queued
+     * frames of @p motion's device contain nothing but motions, they are taken up to, but not
+     * including, the last complete frame. Of each touch point only the latest motion is kept:
+     * @p motions gets @p motion and the taken motions which are not superseded, in the order
+     * the touch points first moved, the superseded motions and the taken frames get deleted.
+     * Takes the ownership of @p motion, the caller gets the ownership of @p motions. Returns
+     * the number of superseded motions. Must only be called by the consumer.
+     */
+    int takeTouchMotions(TouchEvent *motion, std::vector<TouchEvent *> &motions);
+
+    static const int s_defaultCapacity = 4096;
+
+private:
+    std::vector<Event *> m_slots;
+    quint32 m_mask;
+    // the indices are never wrapped, only the slot lookup is masked
+    alignas(64) std::atomic<quint32> m_head{0};
+    alignas(64) std::atomic<quint32> m_tail{0};
+};
+
+}
+}
+
+#endif
@@ -385,6 +385,12 @@ protected:
      */
     AniMap state() const;
 
+    /**
+     * Whether there are animations for @p w, running or waiting for their start.
+     * @since 5.18
+     */
+    bool isAnimating(EffectWindow *w) const;
+
 private:
     quint64 p_animate(EffectWindow *w, Attribute a, uint meta, int ms, FPx2 to, const QEasingCurve &curve, int delay, FPx2 from, bool keepAtTarget, bool fullScreenEffect, bool keepAlive);
     QRect clipRect(const QRect &windowRect, const AniData&) const;
@@ -49,6 +49,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #if defined(__SSE2__)
 #  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
 #endif
 
 
@@ -610,6 +612,22 @@ QString Effect::debug(const QString &) const
     return QString();
 }
 
+bool Effect::blocksDirectScanout() const
+{
+    return true;
+}
+
+Effect::PaintHooks Effect::paintHooks() const
+{
+    return AllPaintHooks;
+}
+
+bool Effect::isActiveForWindow(EffectWindow *w) const
+{
+    Q_UNUSED(w)
+    return true;
+}
+
 void Effect::drawWindow(EffectWindow* w, int mask, const QRegion &region, WindowPaintData& data)
 {
     effects->drawWindow(w, mask, region, data);
@@ -1015,7 +1033,10 @@ WindowQuadList WindowQuadList::makeGrid(int maxQuadSize) const
         bottom = qMax(bottom, quad.bottom());
     }
 
+    // Usually the quads don't overlap, so the grid cells of the bounding rectangle
+    // are a good estimate for the number of sub-quads
     WindowQuadList ret;
+    ret.reserve(qMax(count(), qCeil((right - left) / maxQuadSize) * qCeil((bottom - top) / maxQuadSize)));
 
     foreach (const WindowQuad &quad, *this) {
         const double quadLeft   = quad.left();
@@ -1076,6 +1097,7 @@ WindowQuadList WindowQuadList::makeRegularGrid(int xSubdivisions, int ySubdivisi
     double yIncrement = (bottom - top) / ySubdivisions;
 
     WindowQuadList ret;
+    ret.reserve(qMax(count(), xSubdivisions * ySubdivisions));
 
     foreach (const WindowQuad &quad, *this) {
         const double quadLeft   = quad.left();
@@ -1129,110 +1151,75 @@ void WindowQuadList::makeInterleavedArrays(unsigned int type, GLVertex2D *vertic
 
     Q_ASSERT(type == GL_QUADS || type == GL_TRIANGLES);
 
+    // The position and the texture coordinate of a WindowVertex are pairs of floats, which
+    // matches the layout of GLVertex2D. Each vertex is transformed with a single multiply-add.
+#if defined(__SSE2__)
+    const __m128 scale = _mm_setr_ps(1.0f, 1.0f, coeff.x(), coeff.y());
+    const __m128 translation = _mm_setr_ps(0.0f, 0.0f, offset.x(), offset.y());
+    auto transform = [scale, translation](const WindowVertex &wv) {
+        const __m128 position = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(&wv.px));
+        const __m128 texcoord = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(&wv.tx));
+        return _mm_add_ps(_mm_mul_ps(_mm_movelh_ps(position, texcoord), scale), translation);
+    };
+    // Non-temporal stores bypass the cache, but need an aligned destination
+    const bool aligned = !(intptr_t(vertex) & 0xf);
+    auto store = [aligned](GLVertex2D *dst, __m128 v) {
+        if (aligned) {
+            _mm_stream_ps(reinterpret_cast<float *>(dst), v);
+        } else {
+            _mm_storeu_ps(reinterpret_cast<float *>(dst), v);
+        }
+    };
+#elif defined(__ARM_NEON)
+    const float32x4_t scale = {1.0f, 1.0f, coeff.x(), coeff.y()};
+    const float32x4_t translation = {0.0f, 0.0f, offset.x(), offset.y()};
+    auto transform = [scale, translation](const WindowVertex &wv) {
+        const float32x4_t v = vcombine_f32(vld1_f32(&wv.px), vld1_f32(&wv.tx));
+        return vmlaq_f32(translation, v, scale);
+    };
+    auto store = [](GLVertex2D *dst, float32x4_t v) {
+        vst1q_f32(reinterpret_cast<float *>(dst), v);
+    };
+#else
+    auto transform = [coeff, offset](const WindowVertex &wv) {
+        GLVertex2D v;
+        v.position = QVector2D(wv.px, wv.py);
+        v.texcoord = QVector2D(wv.tx, wv.ty) * coeff + offset;
+        return v;
+    };
+    auto store = [](GLVertex2D *dst, const GLVertex2D &v) {
+        *dst = v;
+    };
+#endif
+
     switch (type)
     {
     case GL_QUADS:
-#if defined(__SSE2__)
-        if (!(intptr_t(vertex) & 0xf)) {
-            for (int i = 0; i < count(); i++) {
-                const WindowQuad &quad = at(i);
-                alignas(16) GLVertex2D v[4];
-
-                for (int j = 0; j < 4; j++) {
-                    const WindowVertex &wv = quad[j];
-
-                    v[j].position = QVector2D(wv.x(), wv.y());
-                    v[j].texcoord = QVector2D(wv.u(), wv.v()) * coeff + offset;
-                }
-
-                const __m128i *srcP = reinterpret_cast<const __m128i *>(&v);
-                __m128i *dstP = reinterpret_cast<__m128i *>(vertex);
-
-                _mm_stream_si128(&dstP[0], _mm_load_si128(&srcP[0])); // Top-left
-                _mm_stream_si128(&dstP[1], _mm_load_si128(&srcP[1])); // Top-right
-                _mm_stream_si128(&dstP[2], _mm_load_si128(&srcP[2])); // Bottom-right
-                _mm_stream_si128(&dstP[3], _mm_load_si128(&srcP[3])); // Bottom-left
-
-                vertex += 4;
-            }
-        } else
-#endif // __SSE2__
-        {
-            for (int i = 0; i < count(); i++) {
-                const WindowQuad &quad = at(i);
-
-                for (int j = 0; j < 4; j++) {
-                    const WindowVertex &wv = quad[j];
-
-                    GLVertex2D v;
-                    v.position = QVector2D(wv.x(), wv.y());
-                    v.texcoord = QVector2D(wv.u(), wv.v()) * coeff + offset;
-
-                    *(vertex++) = v;
-                }
-            }
+        for (const WindowQuad &quad : *this) {
+            store(vertex++, transform(quad.verts[0])); // Top-left
+            store(vertex++, transform(quad.verts[1])); // Top-right
+            store(vertex++, transform(quad.verts[2])); // Bottom-right
+            store(vertex++, transform(quad.verts[3])); // Bottom-left
         }
         break;
 
     case GL_TRIANGLES:
-#if defined(__SSE2__)
-        if (!(intptr_t(vertex) & 0xf)) {
-            for (int i = 0; i < count(); i++) {
-                const WindowQuad &quad = at(i);
-                alignas(16) GLVertex2D v[4];
-
-                for (int j = 0; j < 4; j++) {
-                    const WindowVertex &wv = quad[j];
-
-                    v[j].position = QVector2D(wv.x(), wv.y());
-                    v[j].texcoord = QVector2D(wv.u(), wv.v()) * coeff + offset;
-                }
-
-                const __m128i *srcP = reinterpret_cast<const __m128i *>(&v);
-                __m128i *dstP = reinterpret_cast<__m128i *>(vertex);
-
-                __m128i src[4];
-                src[0] = _mm_load_si128(&srcP[0]); // Top-left
-                src[1] = _mm_load_si128(&srcP[1]); // Top-right
-                src[2] = _mm_load_si128(&srcP[2]); // Bottom-right
-                src[3] = _mm_load_si128(&srcP[3]); // Bottom-left
-
-                // First triangle
-                _mm_stream_si128(&dstP[0], src[1]); // Top-right
-                _mm_stream_si128(&dstP[1], src[0]); // Top-left
-                _mm_stream_si128(&dstP[2], src[3]); // Bottom-left
-
-                // Second triangle
-                _mm_stream_si128(&dstP[3], src[3]); // Bottom-left
-                _mm_stream_si128(&dstP[4], src[2]); // Bottom-right
-                _mm_stream_si128(&dstP[5], src[1]); // Top-right
-
-                vertex += 6;
-            }
-        } else
-#endif // __SSE2__
-        {
-            for (int i = 0; i < count(); i++) {
-                const WindowQuad &quad = at(i);
-                GLVertex2D v[4]; // Four unique vertices / quad
-
-                for (int j = 0; j < 4; j++) {
-                    const WindowVertex &wv = quad[j];
-
-                    v[j].position = QVector2D(wv.x(), wv.y());
-                    v[j].texcoord = QVector2D(wv.u(), wv.v()) * coeff + offset;
-                }
-
-                // First triangle
-                *(vertex++) = v[1]; // Top-right
-                *(vertex++) = v[0]; // Top-left
-                *(vertex++) = v[3]; // Bottom-left
-
-                // Second triangle
-                *(vertex++) = v[3]; // Bottom-left
-                *(vertex++) = v[2]; // Bottom-right
-                *(vertex++) = v[1]; // Top-right
-            }
+        for (const WindowQuad &quad : *this) {
+            // Four unique vertices / quad
+            const auto topLeft = transform(quad.verts[0]);
+            const auto topRight = transform(quad.verts[1]);
+            const auto bottomRight = transform(quad.verts[2]);
+            const auto bottomLeft = transform(quad.verts[3]);
+
+            // First triangle
+            store(vertex++, topRight);
+            store(vertex++, topLeft);
+            store(vertex++, bottomLeft);
+
+            // Second triangle
+            store(vertex++, bottomLeft);
+            store(vertex++, bottomRight);
+            store(vertex++, topRight);
         }
         break;
 
@@ -188,7 +188,7 @@ X-KDE-Library=kwin4_effect_cooleffect
 
 #define KWIN_EFFECT_API_MAKE_VERSION( major, minor ) (( major ) << 8 | ( minor ))
 #define KWIN_EFFECT_API_VERSION_MAJOR 0
-#define KWIN_EFFECT_API_VERSION_MINOR 229
+#define KWIN_EFFECT_API_VERSION_MINOR 232
 #define KWIN_EFFECT_API_VERSION KWIN_EFFECT_API_MAKE_VERSION( \
         KWIN_EFFECT_API_VERSION_MAJOR, KWIN_EFFECT_API_VERSION_MINOR )
 
@@ -224,7 +224,7 @@ enum DataRole {
     WindowBlurBehindRole, ///< For single windows to blur behind
     WindowForceBackgroundContrastRole, ///< For fullscreen effects to enforce the background contrast,
     WindowBackgroundContrastRole, ///< For single windows to enable Background contrast
-    LanczosCacheRole
+    LanczosCacheRole ///< Unused, the OpenGL scene manages the cache of scaled windows itself
 };
 
 /**
@@ -392,6 +392,24 @@ public:
     };
     Q_DECLARE_FLAGS(ReconfigureFlags, ReconfigureFlag)
 
+    /**
+     * The paint methods of an Effect, see paintHooks().
+     * @since 5.18
+     */
+    enum PaintHook {
+        PrePaintScreenHook = 1 << 0,
+        PaintScreenHook = 1 << 1,
+        PostPaintScreenHook = 1 << 2,
+        PrePaintWindowHook = 1 << 3,
+        PaintWindowHook = 1 << 4,
+        PostPaintWindowHook = 1 << 5,
+        DrawWindowHook = 1 << 6,
+        BuildQuadsHook = 1 << 7,
+        PaintEffectFrameHook = 1 << 8,
+        AllPaintHooks = (1 << 9) - 1
+    };
+    Q_DECLARE_FLAGS(PaintHooks, PaintHook)
+
     /**
      * Called when configuration changes (either the effect's or KWin's global).
      *
@@ -557,6 +575,43 @@ public:
      */
     virtual QString debug(const QString &parameter) const;
 
+    /**
+     * Whether the Effect prevents client buffers from being shown directly on hardware planes
+     * while it is active. Planes bypass the paint methods, so an Effect which modifies how
+     * windows are painted must not allow it. Effects which only paint behind windows, like
+     * blur, can reimplement this method to return @c false.
+     *
+     * The default implementation returns @c true.
+     * @since 5.18
+     */
+    virtual bool blocksDirectScanout() const;
+
+    /**
+     * Reimplement this method to tell which of the paint methods the Effect reimplements.
+     * While painting, the effects handler only passes the paint calls through the Effects
+     * which reimplement them, instead of through every active Effect.
+     *
+     * An Effect inheriting another Effect has to include the paint hooks of the base class.
+     *
+     * The default implementation returns AllPaintHooks.
+     * @since 5.18
+     */
+    virtual PaintHooks paintHooks() const;
+
+    /**
+     * Reimplement this method to tell whether prePaintWindow(), paintWindow(), postPaintWindow()
+     * and drawWindow() have to be called for @p w. An active Effect which only changes some of
+     * the windows can return @c false for the other ones, so that they are painted without
+     * going through it.
+     *
+     * The result is cached while painting a frame, it has to stay the same until the frame
+     * is done.
+     *
+     * The default implementation returns @c true.
+     * @since 5.18
+     */
+    virtual bool isActiveForWindow(EffectWindow *w) const;
+
     /**
      * Reimplement this method to indicate where in the Effect chain the Effect should be placed.
      *
@@ -686,6 +741,8 @@ protected:
     void initConfig();
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Effect::PaintHooks)
+
 
 /**
  * Prefer the KWIN_EFFECT_FACTORY macros.
@@ -2536,9 +2593,11 @@ public:
 private:
     friend class WindowQuad;
     friend class WindowQuadList;
-    double px, py; // position
-    double ox, oy; // origional position
-    double tx, ty; // texture coords
+    // Stored as pairs of floats, the layout of GLVertex2D, so that they can be copied
+    // into vertex buffers without conversion.
+    float px, py; // position
+    float ox, oy; // origional position
+    float tx, ty; // texture coords
 };
 
 /**
@@ -2578,8 +2637,22 @@ private:
     int quadID;
 };
 
+} // namespace KWin
+
+Q_DECLARE_TYPEINFO(KWin::WindowVertex, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(KWin::WindowQuad, Q_MOVABLE_TYPE);
+
+namespace KWin
+{
+
+/**
+ * @short A list of WindowQuads.
+ *
+ * The quads are stored contiguously, so iterating over them and converting them into
+ * vertex arrays is cache friendly even for the large grids used by deforming effects.
+ */
 class KWINEFFECTS_EXPORT WindowQuadList
-    : public QList< WindowQuad >
+    : public QVector< WindowQuad >
 {
 public:
     WindowQuadList splitAtX(double x) const;
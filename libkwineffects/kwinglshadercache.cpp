@@ -0,0 +1,146 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "kwinglshadercache_p.h"
+#include "kwinglplatform.h"
+#include "kwinglutils.h"
+#include "logging_p.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
+
+namespace KWin
+{
+
+GLShaderCache::GLShaderCache()
+{
+    if (qgetenv("KWIN_GL_PROGRAM_CACHE") == QByteArrayLiteral("0")) {
+        return;
+    }
+    GLPlatform *gl = GLPlatform::instance();
+    const bool supported = gl->isGLES() ? hasGLVersion(3, 0)
+                                        : (hasGLVersion(4, 1) || hasGLExtension(QByteArrayLiteral("GL_ARB_get_program_binary")));
+    if (!supported) {
+        return;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+        return;
+    }
+    m_directory = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QStringLiteral("/kwin/glprograms/");
+    if (!QDir().mkpath(m_directory)) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to create the program cache directory" << m_directory;
+        return;
+    }
+    // the binaries are only valid for the driver which created them
+    m_driver = gl->glVendorString() + '\n' + gl->glRendererString() + '\n' + gl->glVersionString() + '\n'
+             + gl->glShadingLanguageVersionString() + '\n';
+    m_driverKey = QCryptographicHash::hash(m_driver, QCryptographicHash::Sha1).toHex().left(16) + '-';
+    m_enabled = true;
+    prune();
+}
+
+void GLShaderCache::prune()
+{
+    // nothing else will ever load the binaries of the previous driver
+    QDir directory(m_directory);
+    const QStringList files = directory.entryList(QDir::Files);
+    for (const QString &file : files) {
+        if (!file.startsWith(QLatin1String(m_driverKey))) {
+            directory.remove(file);
+        }
+    }
+}
+
+QByteArray GLShaderCache::key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(m_driver);
+    hash.addData(bindings);
+    hash.addData(vertexSource);
+    hash.addData(QByteArrayLiteral("\n---\n"));
+    hash.addData(fragmentSource);
+    return m_driverKey + hash.result().toHex();
+}
+
+QString GLShaderCache::fileName(const QByteArray &key) const
+{
+    return m_directory + QString::fromLatin1(key);
+}
+
+bool GLShaderCache::load(GLuint program, const QByteArray &key)
+{
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_misses++;
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    file.close();
+    if (data.size() <= int(sizeof(GLenum))) {
+        file.remove();
+        m_misses++;
+        return false;
+    }
+    GLenum format;
+    memcpy(&format, data.constData(), sizeof(GLenum));
+    glProgramBinary(program, format, data.constData() + sizeof(GLenum), data.size() - sizeof(GLenum));
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        qCDebug(LIBKWINGLUTILS) << "Program binary got rejected by the driver:" << key;
+        file.remove();
+        // the failed glProgramBinary might have set an error
+        while (glGetError() != GL_NO_ERROR) {
+        }
+        m_misses++;
+        return false;
+    }
+    m_hits++;
+    return true;
+}
+
+void GLShaderCache::store(GLuint program, const QByteArray &key)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    QByteArray data(sizeof(GLenum) + length, Qt::Uninitialized);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, data.data() + sizeof(GLenum));
+    memcpy(data.data(), &format, sizeof(GLenum));
+    data.resize(sizeof(GLenum) + length);
+
+    // other KWin instances might read the file meanwhile
+    QSaveFile file(fileName(key));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(LIBKWINGLUTILS) << "Failed to store program binary" << file.fileName();
+    }
+}
+
+}
@@ -0,0 +1,93 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_GLSHADERCACHE_P_H
+#define KWIN_GLSHADERCACHE_P_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <epoxy/gl.h>
+
+namespace KWin
+{
+
+/**
+ * @internal
+ *
+ * Stores the binaries of linked programs on disk, so that the shaders don't have to be
+ * compiled again the next time KWin starts. The binaries are keyed by the driver and the
+ * sources of the program. If the driver rejects a binary, e.g. because it got updated
+ * without changing its version string, the program is compiled and stored again. Binaries
+ * of another driver are removed when the cache gets created.
+ */
+class GLShaderCache
+{
+public:
+    GLShaderCache();
+
+    /**
+     * Whether the driver supports program binaries and the cache is not disabled
+     * through KWIN_GL_PROGRAM_CACHE=0.
+     */
+    bool isEnabled() const {
+        return m_enabled;
+    }
+    QString directory() const {
+        return m_directory;
+    }
+    /**
+     * The number of programs loaded from the cache.
+     */
+    int hits() const {
+        return m_hits;
+    }
+    /**
+     * The number of programs which had to be linked because the cache held no usable binary.
+     */
+    int misses() const {
+        return m_misses;
+    }
+
+    QByteArray key(const QByteArray &vertexSource, const QByteArray &fragmentSource, const QByteArray &bindings) const;
+    /**
+     * Loads the binary stored for @p key into @p program. Returns @c false if there is
+     * none or the driver rejected it, in that case the program has to be linked normally.
+     */
+    bool load(GLuint program, const QByteArray &key);
+    /**
+     * Stores the binary of the linked @p program for @p key.
+     */
+    void store(GLuint program, const QByteArray &key);
+
+private:
+    QString fileName(const QByteArray &key) const;
+    void prune();
+
+    bool m_enabled = false;
+    QString m_directory;
+    QByteArray m_driver;
+    QByteArray m_driverKey;
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "kwineffects.h"
 #include "kwinglplatform.h"
+#include "kwinglshadercache_p.h"
 #include "logging_p.h"
 
 #include <QPixmap>
@@ -195,6 +196,28 @@ bool GLShader::link()
     // Be optimistic
     mValid = true;
 
+    GLShaderCache *cache = ShaderManager::instance()->m_programCache.data();
+    const bool cacheable = cache->isEnabled() && !(mVertexSource.isEmpty() && mFragmentSource.isEmpty());
+    QByteArray key;
+    if (cacheable) {
+        key = cache->key(prepareSource(GL_VERTEX_SHADER, mVertexSource),
+                         prepareSource(GL_FRAGMENT_SHADER, mFragmentSource),
+                         mBindings);
+        if (cache->load(mProgram, key)) {
+            mVertexSource.clear();
+            mFragmentSource.clear();
+            return mValid;
+        }
+    }
+
+    if (!compileSources()) {
+        mValid = false;
+        return false;
+    }
+    if (cacheable) {
+        glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     glLinkProgram(mProgram);
 
     // Get the program info log
@@ -215,9 +238,37 @@ bool GLShader::link()
         qCDebug(LIBKWINGLUTILS) << "Shader link log:" << log;
     }
 
+    if (mValid && cacheable) {
+        cache->store(mProgram, key);
+    }
     return mValid;
 }
 
+bool GLShader::compileSources()
+{
+    const QByteArray vertexSource = mVertexSource;
+    const QByteArray fragmentSource = mFragmentSource;
+    mVertexSource.clear();
+    mFragmentSource.clear();
+
+    // Compile the vertex shader
+    if (!vertexSource.isEmpty()) {
+        bool success = compile(mProgram, GL_VERTEX_SHADER, vertexSource);
+
+        if (!success)
+            return false;
+    }
+
+    // Compile the fragment shader
+    if (!fragmentSource.isEmpty()) {
+        bool success = compile(mProgram, GL_FRAGMENT_SHADER, fragmentSource);
+
+        if (!success)
+            return false;
+    }
+    return true;
+}
+
 const QByteArray GLShader::prepareSource(GLenum shaderType, const QByteArray &source) const
 {
     Q_UNUSED(shaderType)
@@ -284,21 +335,10 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
 
     mValid = false;
 
-    // Compile the vertex shader
-    if (!vertexSource.isEmpty()) {
-        bool success = compile(mProgram, GL_VERTEX_SHADER, vertexSource);
-
-        if (!success)
-            return false;
-    }
-
-    // Compile the fragment shader
-    if (!fragmentSource.isEmpty()) {
-        bool success = compile(mProgram, GL_FRAGMENT_SHADER, fragmentSource);
-
-        if (!success)
-            return false;
-    }
+    // The shaders get compiled when linking, unless the program binary is cached.
+    // With explicit linking compile errors are thus only reported by link().
+    mVertexSource = vertexSource;
+    mFragmentSource = fragmentSource;
 
     if (mExplicitLinking)
         return true;
@@ -310,12 +350,16 @@ bool GLShader::load(const QByteArray &vertexSource, const QByteArray &fragmentSo
 void GLShader::bindAttributeLocation(const char *name, int index)
 {
     glBindAttribLocation(mProgram, index, name);
+    // the locations are part of the program binary
+    mBindings += QByteArray(name) + '=' + QByteArray::number(index) + ';';
 }
 
 void GLShader::bindFragDataLocation(const char *name, int index)
 {
-    if (!GLPlatform::instance()->isGLES() && (hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_EXT_gpu_shader4"))))
+    if (!GLPlatform::instance()->isGLES() && (hasGLVersion(3, 0) || hasGLExtension(QByteArrayLiteral("GL_EXT_gpu_shader4")))) {
         glBindFragDataLocation(mProgram, index, name);
+        mBindings += QByteArrayLiteral("out:") + name + '=' + QByteArray::number(index) + ';';
+    }
 }
 
 void GLShader::bind()
@@ -555,6 +599,7 @@ void ShaderManager::cleanup()
 }
 
 ShaderManager::ShaderManager()
+    : m_programCache(new GLShaderCache)
 {
     m_debug = qstrcmp(qgetenv("KWIN_GL_DEBUG"), "1") == 0;
 
@@ -989,6 +1034,21 @@ bool ShaderManager::isShaderDebug() const
     return m_debug;
 }
 
+bool ShaderManager::isProgramCacheEnabled() const
+{
+    return m_programCache->isEnabled();
+}
+
+int ShaderManager::programCacheHits() const
+{
+    return m_programCache->hits();
+}
+
+int ShaderManager::programCacheMisses() const
+{
+    return m_programCache->misses();
+}
+
 GLShader *ShaderManager::pushShader(ShaderTraits traits)
 {
     GLShader *shader = this->shader(traits);
@@ -1327,6 +1387,282 @@ void GLRenderTarget::detachTexture()
 }
 
 
+//*********************************
+// PixelBufferRing
+//*********************************
+
+// Large enough for a few damaged rects of a 4K window without growing the buffer
+static const qint64 s_minPixelBufferSize = 8 * 1024 * 1024;
+// Twice a complete 4K window, larger transfers don't go through the ring
+static const qint64 s_maxPixelBufferSize = 64 * 1024 * 1024;
+
+static qint64 alignSize(qint64 value, qint64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+PixelBufferRing::PixelBufferRing(GLenum target)
+    : m_target(target)
+{
+    for (Buffer &buffer : m_buffers) {
+        glGenBuffers(1, &buffer.buffer);
+    }
+}
+
+PixelBufferRing::~PixelBufferRing()
+{
+    for (Buffer &buffer : m_buffers) {
+        if (buffer.fence) {
+            glDeleteSync(buffer.fence);
+        }
+        glDeleteBuffers(1, &buffer.buffer);
+    }
+}
+
+bool PixelBufferRing::isSupported()
+{
+    if (GLPlatform::instance()->isGLES()) {
+        return hasGLVersion(3, 0);
+    }
+    return hasGLVersion(3, 2) || (hasGLExtension(QByteArrayLiteral("GL_ARB_pixel_buffer_object")) &&
+                                  hasGLExtension(QByteArrayLiteral("GL_ARB_map_buffer_range")) &&
+                                  hasGLExtension(QByteArrayLiteral("GL_ARB_sync")));
+}
+
+bool PixelBufferRing::isIdle(Buffer &buffer)
+{
+    if (!buffer.fence) {
+        return true;
+    }
+    // The compositor must not block on the GPU, a busy buffer is replaced instead
+    const GLenum result = glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+    if (result == GL_WAIT_FAILED) {
+        qCWarning(LIBKWINGLUTILS) << "Checking the fence of a pixel buffer failed";
+    }
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+void PixelBufferRing::allocate(Buffer &buffer, qint64 size)
+{
+    // New storage doesn't have to wait for the GPU, the driver frees the old one once the
+    // GPU is done with it
+    buffer.size = alignSize(qMax(size, s_minPixelBufferSize), 64 * 1024);
+    glBufferData(m_target, buffer.size, nullptr, m_target == GL_PIXEL_PACK_BUFFER ? GL_STREAM_READ : GL_STREAM_DRAW);
+}
+
+uchar *PixelBufferRing::map(qint64 size)
+{
+    Q_ASSERT(m_target == GL_PIXEL_UNPACK_BUFFER);
+    const qint64 alignedSize = alignSize(size, 64);
+    if (alignedSize > s_maxPixelBufferSize) {
+        return nullptr;
+    }
+    Buffer *buffer = &m_buffers[m_current];
+    if (m_nextOffset + alignedSize > buffer->size && m_nextOffset > 0) {
+        // The current buffer is full, the GPU is done with it once the fence is signalled
+        buffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_current = (m_current + 1) % s_bufferCount;
+        m_nextOffset = 0;
+        buffer = &m_buffers[m_current];
+    }
+
+    glBindBuffer(m_target, buffer->buffer);
+    const bool idle = isIdle(*buffer);
+    // A buffer which grew for a large upload shrinks again
+    const bool shrink = buffer->size > s_minPixelBufferSize && alignedSize <= s_minPixelBufferSize;
+    if (alignedSize > buffer->size || (m_nextOffset == 0 && (!idle || shrink))) {
+        allocate(*buffer, alignedSize);
+    }
+    // The fences tell us which parts are still in use, the driver doesn't need to sync
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    void *data = glMapBufferRange(m_target, m_nextOffset, size, access);
+    if (!data) {
+        glBindBuffer(m_target, 0);
+        return nullptr;
+    }
+    m_mappedOffset = m_nextOffset;
+    m_mappedSize = alignedSize;
+    return static_cast<uchar *>(data);
+}
+
+bool PixelBufferRing::unmap()
+{
+    return glUnmapBuffer(m_target) == GL_TRUE;
+}
+
+const GLvoid *PixelBufferRing::offset() const
+{
+    return reinterpret_cast<const GLvoid *>(m_mappedOffset);
+}
+
+void PixelBufferRing::release()
+{
+    glBindBuffer(m_target, 0);
+    m_nextOffset = m_mappedOffset + m_mappedSize;
+    m_mappedSize = 0;
+}
+
+int PixelBufferRing::acquire(qint64 size)
+{
+    Q_ASSERT(m_target == GL_PIXEL_PACK_BUFFER);
+    if (size > s_maxPixelBufferSize) {
+        return -1;
+    }
+    for (int i = 0; i < s_bufferCount; ++i) {
+        // Round robin, so that the buffers which got read last have the most time
+        const int index = (m_current + i) % s_bufferCount;
+        Buffer &buffer = m_buffers[index];
+        if (buffer.acquired) {
+            continue;
+        }
+        m_current = (index + 1) % s_bufferCount;
+        buffer.acquired = true;
+        glBindBuffer(m_target, buffer.buffer);
+        const bool shrink = buffer.size > s_minPixelBufferSize && size <= s_minPixelBufferSize;
+        if (size > buffer.size || shrink) {
+            allocate(buffer, size);
+        }
+        return index;
+    }
+    return -1;
+}
+
+void PixelBufferRing::fence(int index)
+{
+    Buffer &buffer = m_buffers[index];
+    glBindBuffer(m_target, 0);
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // make sure the fence gets submitted, polling it doesn't flush
+    glFlush();
+}
+
+bool PixelBufferRing::isSignalled(int index) const
+{
+    const Buffer &buffer = m_buffers[index];
+    if (!buffer.fence) {
+        return false;
+    }
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(buffer.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+    return status == GL_SIGNALED;
+}
+
+const uchar *PixelBufferRing::mapForReading(int index, qint64 size)
+{
+    Buffer &buffer = m_buffers[index];
+    if (!isSignalled(index) || buffer.mapped) {
+        return nullptr;
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+    glBindBuffer(m_target, buffer.buffer);
+    void *data = glMapBufferRange(m_target, 0, size, GL_MAP_READ_BIT);
+    glBindBuffer(m_target, 0);
+    buffer.mapped = data != nullptr;
+    return static_cast<const uchar *>(data);
+}
+
+void PixelBufferRing::recycle(int index)
+{
+    Buffer &buffer = m_buffers[index];
+    if (buffer.mapped) {
+        glBindBuffer(m_target, buffer.buffer);
+        glUnmapBuffer(m_target);
+        glBindBuffer(m_target, 0);
+        buffer.mapped = false;
+    }
+    if (buffer.fence) {
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+    }
+    buffer.acquired = false;
+}
+
+//*********************************
+// GLPixelReadback
+//*********************************
+
+GLPixelReadback::GLPixelReadback(PixelBufferRing *ring)
+    : m_ring(ring)
+{
+}
+
+GLPixelReadback::~GLPixelReadback()
+{
+    if (m_buffer != -1) {
+        m_ring->recycle(m_buffer);
+    }
+}
+
+bool GLPixelReadback::supported()
+{
+    return PixelBufferRing::isSupported();
+}
+
+bool GLPixelReadback::read(const QRect &rect)
+{
+    if (m_buffer != -1 || rect.isEmpty()) {
+        return false;
+    }
+    m_buffer = m_ring->acquire(qint64(rect.width()) * rect.height() * 4);
+    if (m_buffer == -1) {
+        return false;
+    }
+    m_size = rect.size();
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // with a pack buffer bound the pointer is an offset into it and the call doesn't wait
+    glReadPixels(rect.x(), rect.y(), rect.width(), rect.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    m_ring->fence(m_buffer);
+    return true;
+}
+
+bool GLPixelReadback::isFinished()
+{
+    return m_buffer != -1 && m_ring->isSignalled(m_buffer);
+}
+
+const uchar *GLPixelReadback::map()
+{
+    if (m_buffer == -1) {
+        return nullptr;
+    }
+    return m_ring->mapForReading(m_buffer, qint64(m_size.width()) * m_size.height() * 4);
+}
+
+void GLPixelReadback::unmap()
+{
+    if (m_buffer == -1) {
+        return;
+    }
+    m_ring->recycle(m_buffer);
+    m_buffer = -1;
+}
+
+QImage GLPixelReadback::toImage(const uchar *data, const QSize &size)
+{
+    QImage image(size, QImage::Format_ARGB32);
+    const int stride = size.width() * 4;
+    for (int y = 0; y < size.height(); ++y) {
+        // OpenGL starts with the bottom row
+        const quint32 *source = reinterpret_cast<const quint32 *>(data + (size.height() - y - 1) * stride);
+        quint32 *target = reinterpret_cast<quint32 *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const quint32 pixel = source[x];
+            if (QSysInfo::ByteOrder == QSysInfo::BigEndian) {
+                // OpenGL gives RGBA; Qt wants ARGB
+                target[x] = (pixel >> 8) | (pixel << 24);
+            } else {
+                // OpenGL gives ABGR (i.e. RGBA backwards); Qt wants ARGB
+                target[x] = ((pixel << 16) & 0xff0000) | ((pixel >> 16) & 0xff) | (pixel & 0xff00ff00);
+            }
+        }
+    }
+    return image;
+}
+
+
 // ------------------------------------------------------------------
 
 static const uint16_t indices[] = {
@@ -28,9 +28,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "kwingltexture.h"
 
 // Qt
+#include <QScopedPointer>
 #include <QSize>
 #include <QStack>
 
+#include <array>
+
 /** @addtogroup kwineffects */
 /** @{ */
 
@@ -66,6 +69,8 @@ bool KWINGLUTILS_EXPORT checkGLError(const char* txt);
 
 QList<QByteArray> KWINGLUTILS_EXPORT openGLExtensions();
 
+class GLShaderCache;
+
 class KWINGLUTILS_EXPORT GLShader
 {
 public:
@@ -161,12 +166,17 @@ protected:
     bool load(const QByteArray &vertexSource, const QByteArray &fragmentSource);
     const QByteArray prepareSource(GLenum shaderType, const QByteArray &sourceCode) const;
     bool compile(GLuint program, GLenum shaderType, const QByteArray &sourceCode) const;
+    bool compileSources();
     void bind();
     void unbind();
     void resolveLocations();
 
 private:
     unsigned int mProgram;
+    // the sources are only compiled while linking, if there is no cached binary
+    QByteArray mVertexSource;
+    QByteArray mFragmentSource;
+    QByteArray mBindings;
     bool mValid:1;
     bool mLocationsResolved:1;
     bool mExplicitLinking:1;
@@ -307,6 +317,22 @@ public:
      */
     bool selfTest();
 
+    /**
+     * Whether linked programs are stored on disk and loaded from there the next time
+     * they are needed, instead of compiling the shaders again.
+     */
+    bool isProgramCacheEnabled() const;
+    /**
+     * The number of programs loaded from the program cache since the ShaderManager got created.
+     * @internal
+     */
+    int programCacheHits() const;
+    /**
+     * The number of programs which had to be compiled although the program cache is enabled.
+     * @internal
+     */
+    int programCacheMisses() const;
+
     /**
      * @return a pointer to the ShaderManager instance
      */
@@ -332,7 +358,10 @@ private:
     QHash<ShaderTraits, GLShader *> m_shaderHash;
     bool m_debug;
     QString m_resourcePath;
+    QScopedPointer<GLShaderCache> m_programCache;
     static ShaderManager *s_shaderManager;
+
+    friend class GLShader;
 };
 
 /**
@@ -566,6 +595,184 @@ private:
     GLuint mFramebuffer;
 };
 
+/**
+ * @short A ring of pixel buffer objects to stream pixels between the CPU and the GPU.
+ *
+ * A ring on GL_PIXEL_UNPACK_BUFFER streams texture uploads. The pixel data is written into
+ * a pixel buffer object, the texture uploads then read from it while the GPU is busy with
+ * other work. Uploads are appended to the current buffer until it is full. Then a fence is
+ * inserted and the next buffer in the ring is used. A buffer is only written again once the
+ * GPU signalled its fence, so the data of previous frames is never overwritten while it is
+ * still being consumed. If the GPU is not done with it yet, the buffer gets fresh storage
+ * instead of waiting for it.
+ *
+ * An upload looks like this:
+ * @code
+ * if (uchar *data = ring->map(size)) {
+ *     // write the pixel data
+ *     if (ring->unmap()) {
+ *         glTexSubImage2D(..., ring->offset());
+ *     }
+ *     ring->release();
+ * }
+ * @endcode
+ *
+ * A ring on GL_PIXEL_PACK_BUFFER hands out complete buffers for read backs instead, see
+ * acquire(). GLPixelReadback uses such a ring.
+ *
+ * Uploads and read backs larger than 64 MiB are not supported. A buffer which grew for a
+ * large transfer shrinks again once it is reused for small ones.
+ *
+ * All methods and the destructor have to be called with the context current in which the
+ * ring got created.
+ *
+ * @since 5.18
+ */
+class KWINGLUTILS_EXPORT PixelBufferRing
+{
+public:
+    explicit PixelBufferRing(GLenum target = GL_PIXEL_UNPACK_BUFFER);
+    ~PixelBufferRing();
+
+    /**
+     * Whether the OpenGL context supports pixel buffer objects, mapping buffer ranges
+     * and fences, which the ring requires. The context must be current.
+     */
+    static bool isSupported();
+
+    /**
+     * Maps @p size bytes of the ring for writing and binds the buffer to
+     * GL_PIXEL_UNPACK_BUFFER.
+     *
+     * @returns the mapped memory or @c null on failure or if @p size is too large
+     */
+    uchar *map(qint64 size);
+    /**
+     * Unmaps the range mapped by map, the buffer stays bound.
+     *
+     * @returns @c false if the content of the range got lost and has to be uploaded another way
+     */
+    bool unmap();
+    /**
+     * The offset of the mapped range in the bound buffer, to be passed as the pixel
+     * pointer to glTexSubImage2D.
+     */
+    const GLvoid *offset() const;
+    /**
+     * Unbinds the buffer and marks the mapped range as used.
+     */
+    void release();
+
+    /**
+     * Binds a buffer with room for @p size bytes to GL_PIXEL_PACK_BUFFER, e.g. for
+     * glReadPixels. The buffer belongs to the caller until it gets handed back with recycle().
+     *
+     * @returns the index of the buffer, @c -1 if all buffers are in use or @p size is too large
+     */
+    int acquire(qint64 size);
+    /**
+     * Unbinds the buffer @p index and puts a fence behind the commands writing into it.
+     */
+    void fence(int index);
+    /**
+     * Whether the GPU passed the fence of buffer @p index. Doesn't block.
+     */
+    bool isSignalled(int index) const;
+    /**
+     * Maps @p size bytes of the buffer @p index for reading, once isSignalled().
+     *
+     * @returns the mapped memory or @c null on failure
+     */
+    const uchar *mapForReading(int index, qint64 size);
+    /**
+     * Unmaps buffer @p index if it is mapped and hands it back to the ring.
+     */
+    void recycle(int index);
+
+private:
+    struct Buffer {
+        GLuint buffer = 0;
+        qint64 size = 0;
+        GLsync fence = nullptr;
+        bool acquired = false;
+        bool mapped = false;
+    };
+    bool isIdle(Buffer &buffer);
+    void allocate(Buffer &buffer, qint64 size);
+
+    static const int s_bufferCount = 4;
+    GLenum m_target;
+    std::array<Buffer, s_bufferCount> m_buffers;
+    int m_current = 0;
+    qint64 m_nextOffset = 0;
+    qint64 m_mappedOffset = 0;
+    qint64 m_mappedSize = 0;
+};
+
+/**
+ * @short Reads pixels back from the GPU without stalling the pipeline
+ *
+ * read() starts copying a rectangle of the bound framebuffer into a buffer of a
+ * PixelBufferRing on GL_PIXEL_PACK_BUFFER and puts a fence behind the copy, so the call
+ * returns without waiting for the GPU to finish the frame. Once isFinished() reports that
+ * the GPU passed the fence, map() gives access to the pixels. No OpenGL call is needed to
+ * access the mapped memory, so the conversion with toImage() can be done on another thread
+ * until unmap() is called, which hands the buffer back to the ring.
+ *
+ * All other methods and the destructor have to be called with the context current in
+ * which the read back got started.
+ *
+ * @since 5.18
+ */
+class KWINGLUTILS_EXPORT GLPixelReadback
+{
+public:
+    /**
+     * The pixels are read into a buffer of @p ring, which has to outlive the read back.
+     */
+    explicit GLPixelReadback(PixelBufferRing *ring);
+    ~GLPixelReadback();
+
+    /**
+     * Whether pixel buffer objects and fences are supported by the current context.
+     */
+    static bool supported();
+
+    /**
+     * Starts reading @p rect of the currently bound framebuffer. The rect is in
+     * framebuffer coordinates, that is with the origin in the bottom left corner.
+     * Fails if all buffers of the ring are in use by other read backs.
+     */
+    bool read(const QRect &rect);
+    /**
+     * Whether the GPU finished copying the pixels. Doesn't block.
+     */
+    bool isFinished();
+    /**
+     * Maps the pixels once isFinished(). The rows are tightly packed RGBA and start with
+     * the bottom row.
+     *
+     * @returns the mapped memory or @c null on failure
+     */
+    const uchar *map();
+    void unmap();
+
+    QSize size() const {
+        return m_size;
+    }
+
+    /**
+     * Converts the pixels returned by map() into an image of @p size in the format
+     * QImage::Format_ARGB32 with the top row first. Can be called from any thread.
+     */
+    static QImage toImage(const uchar *data, const QSize &size);
+
+private:
+    PixelBufferRing *m_ring;
+    int m_buffer = -1;
+    QSize m_size;
+};
+
 enum VertexAttributeType {
     VA_Position = 0,
     VA_TexCoord = 1,
@@ -32,7 +32,7 @@ namespace KWin
 
 ModifierOnlyShortcuts::ModifierOnlyShortcuts()
     : QObject()
-    , InputEventSpy()
+    , InputEventSpy(InputEventType::Keyboard | InputEventType::PointerButton | InputEventType::PointerAxis)
 {
     connect(ScreenLockerWatcher::self(), &ScreenLockerWatcher::locked, this, &ModifierOnlyShortcuts::reset);
 }
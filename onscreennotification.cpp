@@ -50,7 +50,8 @@ private:
 };
 
 OnScreenNotificationInputEventSpy::OnScreenNotificationInputEventSpy(OnScreenNotification *parent)
-    : m_parent(parent)
+    : InputEventSpy(InputEventType::PointerMotion)
+    , m_parent(parent)
 {
 }
 
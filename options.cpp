@@ -110,6 +110,7 @@ Options::Options(QObject *parent)
     , m_useCompositing(Options::defaultUseCompositing())
     , m_hiddenPreviews(Options::defaultHiddenPreviews())
     , m_glSmoothScale(Options::defaultGlSmoothScale())
+    , m_glScaleCacheSize(Options::defaultGlScaleCacheSize())
     , m_xrenderSmoothScale(Options::defaultXrenderSmoothScale())
     , m_maxFpsInterval(Options::defaultMaxFpsInterval())
     , m_refreshRate(Options::defaultRefreshRate())
@@ -598,6 +599,15 @@ void Options::setGlSmoothScale(int glSmoothScale)
     emit glSmoothScaleChanged();
 }
 
+void Options::setGlScaleCacheSize(int glScaleCacheSize)
+{
+    if (m_glScaleCacheSize == glScaleCacheSize) {
+        return;
+    }
+    m_glScaleCacheSize = glScaleCacheSize;
+    emit glScaleCacheSizeChanged();
+}
+
 void Options::setXrenderSmoothScale(bool xrenderSmoothScale)
 {
     if (m_xrenderSmoothScale == xrenderSmoothScale) {
@@ -912,6 +922,7 @@ void Options::reloadCompositingSettings(bool force)
     KConfigGroup config(m_settings->config(), "Compositing");
 
     setGlSmoothScale(qBound(-1, config.readEntry("GLTextureFilter", Options::defaultGlSmoothScale()), 2));
+    setGlScaleCacheSize(qMax(0, config.readEntry("GLScaleCacheSize", Options::defaultGlScaleCacheSize())));
     setGlStrictBindingFollowsDriver(!config.hasKey("GLStrictBinding"));
     if (!isGlStrictBindingFollowsDriver()) {
         setGlStrictBinding(config.readEntry("GLStrictBinding", Options::defaultGlStrictBinding()));
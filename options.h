@@ -169,6 +169,11 @@ class KWIN_EXPORT Options : public QObject
      * -1 = auto
      */
     Q_PROPERTY(int glSmoothScale READ glSmoothScale WRITE setGlSmoothScale NOTIFY glSmoothScaleChanged)
+    /**
+     * The video memory in MiB the OpenGL scene may use to cache smoothly scaled windows,
+     * e.g. the thumbnails of Present Windows.
+     */
+    Q_PROPERTY(int glScaleCacheSize READ glScaleCacheSize WRITE setGlScaleCacheSize NOTIFY glScaleCacheSizeChanged)
     Q_PROPERTY(bool xrenderSmoothScale READ isXrenderSmoothScale WRITE setXrenderSmoothScale NOTIFY xrenderSmoothScaleChanged)
     Q_PROPERTY(qint64 maxFpsInterval READ maxFpsInterval WRITE setMaxFpsInterval NOTIFY maxFpsIntervalChanged)
     Q_PROPERTY(uint refreshRate READ refreshRate WRITE setRefreshRate NOTIFY refreshRateChanged)
@@ -542,6 +547,9 @@ public:
     int glSmoothScale() const {
         return m_glSmoothScale;
     }
+    int glScaleCacheSize() const {
+        return m_glScaleCacheSize;
+    }
     // XRender
     bool isXrenderSmoothScale() const {
         return m_xrenderSmoothScale;
@@ -629,6 +637,7 @@ public:
     void setUseCompositing(bool useCompositing);
     void setHiddenPreviews(int hiddenPreviews);
     void setGlSmoothScale(int glSmoothScale);
+    void setGlScaleCacheSize(int glScaleCacheSize);
     void setXrenderSmoothScale(bool xrenderSmoothScale);
     void setMaxFpsInterval(qint64 maxFpsInterval);
     void setRefreshRate(uint refreshRate);
@@ -713,6 +722,9 @@ public:
     static int defaultGlSmoothScale() {
         return 2;
     }
+    static int defaultGlScaleCacheSize() {
+        return 128;
+    }
     static bool defaultXrenderSmoothScale() {
         return false;
     }
@@ -805,6 +817,7 @@ Q_SIGNALS:
     void useCompositingChanged();
     void hiddenPreviewsChanged();
     void glSmoothScaleChanged();
+    void glScaleCacheSizeChanged();
     void xrenderSmoothScaleChanged();
     void maxFpsIntervalChanged();
     void refreshRateChanged();
@@ -848,6 +861,7 @@ private:
     bool m_useCompositing;
     HiddenPreviews m_hiddenPreviews;
     int m_glSmoothScale;
+    int m_glScaleCacheSize;
     bool m_xrenderSmoothScale;
     qint64 m_maxFpsInterval;
     // Settings that should be auto-detected
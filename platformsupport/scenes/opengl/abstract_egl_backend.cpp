@@ -80,6 +80,8 @@ void AbstractEglBackend::unbindWaylandDisplay()
 
 void AbstractEglBackend::cleanup()
 {
+    delete m_pixelBufferRing;
+    m_pixelBufferRing = nullptr;
     cleanupGL();
     doneCurrent();
     eglDestroyContext(m_display, m_context);
@@ -140,6 +142,19 @@ void AbstractEglBackend::initKWinGL()
         options->setGlPreferBufferSwap('e'); // for unknown drivers - should not happen
     glPlatform->printResults();
     initGL(&getProcAddress);
+    initPixelBufferRing();
+}
+
+void AbstractEglBackend::initPixelBufferRing()
+{
+    // Only Wayland clients provide shm buffers, which are streamed through the ring
+    if (!WaylandServer::self() || !PixelBufferRing::isSupported()) {
+        return;
+    }
+    const QByteArray usePixelBuffers = qgetenv("KWIN_USE_PBO_UPLOAD");
+    if (usePixelBuffers != "0") {
+        m_pixelBufferRing = new PixelBufferRing;
+    }
 }
 
 void AbstractEglBackend::initBufferAge()
@@ -434,37 +449,134 @@ void AbstractEglTexture::updateTexture(WindowPixmap *pixmap)
         }
     }
     Q_ASSERT(image.size() == m_size);
-    q->bind();
     const QRegion damage = s->trackedDamage();
     s->resetTrackedDamage();
-    auto scale = s->scale(); //damage is normalised, so needs converting up to match texture
+    //damage is normalised, so needs converting up to match texture
+    uploadDamage(image, damage, s->scale());
+}
 
+// Every upload has a fixed cost, very fragmented damage is merged into fewer rects.
+static const int s_maxUploadRects = 16;
+
+static QVector<QRect> mergeDamage(const QRegion &damage)
+{
+    if (damage.rectCount() <= s_maxUploadRects) {
+        return QVector<QRect>(damage.begin(), damage.end());
+    }
+    // Merge the rects per cell of a grid over the damaged area. This bounds the number
+    // of uploads without uploading much more than what changed.
+    const int gridSize = 4;
+    static_assert(gridSize * gridSize <= s_maxUploadRects, "Grid has too many cells");
+    const QRect bounds = damage.boundingRect();
+    QRect cells[gridSize * gridSize];
+    for (const QRect &rect : damage) {
+        const QPoint center = rect.center() - bounds.topLeft();
+        const int column = qBound(0, center.x() * gridSize / bounds.width(), gridSize - 1);
+        const int row = qBound(0, center.y() * gridSize / bounds.height(), gridSize - 1);
+        cells[row * gridSize + column] |= rect;
+    }
+    QVector<QRect> rects;
+    rects.reserve(gridSize * gridSize);
+    for (const QRect &cell : cells) {
+        if (!cell.isEmpty()) {
+            rects << cell;
+        }
+    }
+    return rects;
+}
+
+void AbstractEglTexture::uploadDamage(const QImage &image, const QRegion &damage, qreal scale)
+{
     // TODO: this should be shared with GLTexture::update
+    QImage::Format uploadFormat = QImage::Format_ARGB32_Premultiplied;
+    GLenum glFormat = GL_BGRA;
+    // Formats which only differ in the alpha channel of opaque images need no conversion
+    bool needsConversion = image.format() != uploadFormat && image.format() != QImage::Format_RGB32;
     if (GLPlatform::instance()->isGLES()) {
         if (s_supportsARGB32 && (image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_ARGB32_Premultiplied)) {
-            const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-            for (const QRect &rect : damage) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_BGRA_EXT, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
-            }
+            glFormat = GL_BGRA_EXT;
         } else {
-            const QImage im = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
-            for (const QRect &rect : damage) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_RGBA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
+            uploadFormat = QImage::Format_RGBA8888_Premultiplied;
+            glFormat = GL_RGBA;
+        }
+        needsConversion = image.format() != uploadFormat;
+    }
+
+    QVector<QRect> rects;
+    qint64 uploadSize = 0;
+    const QVector<QRect> mergedDamage = mergeDamage(damage);
+    for (const QRect &rect : mergedDamage) {
+        const QRect scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale)
+            .intersected(image.rect());
+        if (!scaledRect.isEmpty()) {
+            rects << scaledRect;
+            uploadSize += qint64(scaledRect.width()) * scaledRect.height() * 4;
+        }
+    }
+    if (rects.isEmpty()) {
+        return;
+    }
+    // Only the damaged part of the image is touched, it is referenced without a copy
+    auto damagedImage = [&image] (const QRect &rect) {
+        const uchar *bits = image.constBits() + rect.y() * image.bytesPerLine() + rect.x() * 4;
+        return QImage(bits, rect.width(), rect.height(), image.bytesPerLine(), image.format());
+    };
+
+    q->bind();
+    bool streamed = false;
+    if (PixelBufferRing *ring = m_backend->pixelBufferRing()) {
+        // The data is copied into a pixel buffer, the GPU fetches it from there while
+        // rendering continues. The client buffer is not needed afterwards.
+        if (uchar *data = ring->map(uploadSize)) {
+            uchar *dst = data;
+            for (const QRect &rect : qAsConst(rects)) {
+                const QImage im = needsConversion ? damagedImage(rect).convertToFormat(uploadFormat) : damagedImage(rect);
+                const int rowSize = rect.width() * 4;
+                for (int y = 0; y < rect.height(); ++y) {
+                    memcpy(dst, im.constScanLine(y), rowSize);
+                    dst += rowSize;
+                }
+            }
+            if (ring->unmap()) {
+                const uchar *offset = static_cast<const uchar *>(ring->offset());
+                for (const QRect &rect : qAsConst(rects)) {
+                    glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                                    glFormat, GL_UNSIGNED_BYTE, offset);
+                    offset += qint64(rect.width()) * rect.height() * 4;
+                }
+                streamed = true;
             }
+            ring->release();
         }
-    } else {
-        const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-        for (const QRect &rect : damage) {
-            auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-            glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                            GL_BGRA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
+    }
+    if (!streamed) {
+        // Without conversion the damaged rects are uploaded straight from the client buffer
+        const bool useUnpack = !needsConversion && s_supportsUnpack;
+        if (useUnpack) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, image.bytesPerLine() / 4);
+        }
+        for (const QRect &rect : qAsConst(rects)) {
+            const QImage damaged = damagedImage(rect);
+            if (useUnpack || (!needsConversion && image.bytesPerLine() == rect.width() * 4)) {
+                glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                                glFormat, GL_UNSIGNED_BYTE, damaged.constBits());
+            } else {
+                // Converting creates a tightly packed image, which is all GL needs
+                const QImage im = needsConversion ? damaged.convertToFormat(uploadFormat) : damaged.copy();
+                glTexSubImage2D(m_target, 0, rect.x(), rect.y(), rect.width(), rect.height(),
+                                glFormat, GL_UNSIGNED_BYTE, im.constBits());
+            }
+        }
+        if (useUnpack) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
         }
     }
     q->unbind();
+
+    m_backend->addTextureUploadBytes(uploadSize);
+    if (streamed) {
+        m_backend->addStreamedTextureUploadBytes(uploadSize);
+    }
 }
 
 bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::BufferInterface > &buffer)
@@ -493,22 +605,22 @@ bool AbstractEglTexture::loadShmTexture(const QPointer< KWayland::Server::Buffer
     default:
         return false;
     }
+    // Only allocate the storage, the content is uploaded like any later damage
     if (GLPlatform::instance()->isGLES()) {
         if (s_supportsARGB32 && format == GL_RGBA8) {
-            const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-            glTexImage2D(m_target, 0, GL_BGRA_EXT, im.width(), im.height(),
-                         0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, im.bits());
+            glTexImage2D(m_target, 0, GL_BGRA_EXT, size.width(), size.height(),
+                         0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, nullptr);
         } else {
-            const QImage im = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
-            glTexImage2D(m_target, 0, GL_RGBA, im.width(), im.height(),
-                         0, GL_RGBA, GL_UNSIGNED_BYTE, im.bits());
+            glTexImage2D(m_target, 0, GL_RGBA, size.width(), size.height(),
+                         0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         }
     } else {
         glTexImage2D(m_target, 0, format, size.width(), size.height(), 0,
-                    GL_BGRA, GL_UNSIGNED_BYTE, image.bits());
+                    GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
     }
 
     q->unbind();
+    uploadDamage(image, image.rect(), 1);
     q->setYInverted(true);
     m_size = size;
     updateMatrix();
@@ -660,8 +772,6 @@ bool AbstractEglTexture::updateFromFBO(const QSharedPointer<QOpenGLFramebufferOb
 
 bool AbstractEglTexture::updateFromInternalImageObject(WindowPixmap *pixmap)
 {
-    // FIXME: Share some code with the shm fallback in updateTexture().
-
     const QImage image = pixmap->internalImage();
     if (image.isNull()) {
         return false;
@@ -673,37 +783,7 @@ bool AbstractEglTexture::updateFromInternalImageObject(WindowPixmap *pixmap)
     }
 
     const QRegion damage = pixmap->toplevel()->damage();
-    const qreal scale = image.devicePixelRatio();
-
-    q->bind();
-
-    // TODO: this should be shared with GLTexture::update
-    if (GLPlatform::instance()->isGLES()) {
-        if (s_supportsARGB32 && (image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_ARGB32_Premultiplied)) {
-            const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-            for (const QRect &rect : damage) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_BGRA_EXT, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
-            }
-        } else {
-            const QImage im = image.convertToFormat(QImage::Format_RGBA8888_Premultiplied);
-            for (const QRect &rect : damage) {
-                auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-                glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                                GL_RGBA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
-            }
-        }
-    } else {
-        const QImage im = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-        for (const QRect &rect : damage) {
-            auto scaledRect = QRect(rect.x() * scale, rect.y() * scale, rect.width() * scale, rect.height() * scale);
-            glTexSubImage2D(m_target, 0, scaledRect.x(), scaledRect.y(), scaledRect.width(), scaledRect.height(),
-                            GL_BGRA, GL_UNSIGNED_BYTE, im.copy(scaledRect).bits());
-        }
-    }
-
-    q->unbind();
+    uploadDamage(image, damage, image.devicePixelRatio());
 
     return true;
 }
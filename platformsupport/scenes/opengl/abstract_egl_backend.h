@@ -40,6 +40,7 @@ namespace KWin
 {
 
 class EglDmabuf;
+class PixelBufferRing;
 
 class KWIN_EXPORT AbstractEglBackend : public QObject, public OpenGLBackend
 {
@@ -61,6 +62,13 @@ public:
     EGLConfig config() const {
         return m_config;
     }
+    /**
+     * The ring used to stream shm buffers into textures, @c null if the textures
+     * are updated directly from client memory.
+     */
+    PixelBufferRing *pixelBufferRing() const {
+        return m_pixelBufferRing;
+    }
 
 protected:
     AbstractEglBackend();
@@ -72,6 +80,7 @@ protected:
     bool initEglAPI();
     void initKWinGL();
     void initBufferAge();
+    void initPixelBufferRing();
     void initClientExtensions();
     void initWayland();
     bool hasClientExtension(const QByteArray &ext) const;
@@ -88,6 +97,7 @@ private:
     EGLConfig m_config = nullptr;
     QList<QByteArray> m_clientExtensions;
     EglDmabuf *m_dmaBuf = nullptr;
+    PixelBufferRing *m_pixelBufferRing = nullptr;
 };
 
 class KWIN_EXPORT AbstractEglTexture : public SceneOpenGLTexturePrivate
@@ -118,6 +128,10 @@ private:
     EGLImageKHR attach(const QPointer<KWayland::Server::BufferInterface> &buffer);
     bool updateFromFBO(const QSharedPointer<QOpenGLFramebufferObject> &fbo);
     bool updateFromInternalImageObject(WindowPixmap *pixmap);
+    /**
+     * Uploads the @p damage of the shm or internal @p image into the texture.
+     */
+    void uploadDamage(const QImage &image, const QRegion &damage, qreal scale);
     SceneOpenGLTexture *q;
     AbstractEglBackend *m_backend;
     EGLImageKHR m_image;
@@ -101,6 +101,24 @@ bool OpenGLBackend::perScreenRendering() const
     return false;
 }
 
+bool OpenGLBackend::perOutputScheduling() const
+{
+    return false;
+}
+
+bool OpenGLBackend::scanout(int screenId, const ScanoutCandidate &candidate)
+{
+    Q_UNUSED(screenId)
+    Q_UNUSED(candidate)
+    return false;
+}
+
+QVector<bool> OpenGLBackend::assignPlanes(int screenId, const QVector<ScanoutCandidate> &candidates)
+{
+    Q_UNUSED(screenId)
+    return QVector<bool>(candidates.count(), false);
+}
+
 void OpenGLBackend::copyPixels(const QRegion &region)
 {
     const int height = screens()->size().height();
@@ -23,9 +23,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QElapsedTimer>
 #include <QRegion>
+#include <QVector>
 
 #include <kwin_export.h>
 
+namespace KWayland
+{
+namespace Server
+{
+class BufferInterface;
+}
+}
+
 namespace KWin
 {
 class OpenGLBackend;
@@ -91,7 +100,62 @@ public:
      * Default implementation returns @c false.
      */
     virtual bool perScreenRendering() const;
+    /**
+     * Whether each screen can be rendered on its own schedule. This requires perScreenRendering
+     * and that buffer swaps are reported per output through Compositor::aboutToSwapBuffers.
+     * Default implementation returns @c false.
+     */
+    virtual bool perOutputScheduling() const;
     virtual QRegion prepareRenderingForScreen(int screenId);
+    /**
+     * A client buffer which could be shown by the display hardware without compositing it.
+     */
+    struct ScanoutCandidate {
+        KWayland::Server::BufferInterface *buffer = nullptr;
+        /**
+         * The geometry of the buffer in global compositor coordinates.
+         */
+        QRect geometry;
+    };
+    /**
+     * Presents the @p candidate covering the complete screen @p screenId instead of rendering
+     * the screen. If this returns @c true the frame is done for the screen.
+     * Default implementation returns @c false.
+     */
+    virtual bool scanout(int screenId, const ScanoutCandidate &candidate);
+    /**
+     * Puts the @p candidates on hardware planes of screen @p screenId with the next present,
+     * the candidates are ordered top most first and don't overlap. Returns for each candidate
+     * whether it got a plane, these don't have to be rendered. Gets called for each frame,
+     * also without candidates to release the planes.
+     * Default implementation assigns no plane.
+     */
+    virtual QVector<bool> assignPlanes(int screenId, const QVector<ScanoutCandidate> &candidates);
+    /**
+     * Accounts for @p bytes of pixel data which got uploaded into window textures.
+     */
+    void addTextureUploadBytes(qint64 bytes) {
+        m_textureUploadBytes += bytes;
+    }
+    /**
+     * The number of bytes of pixel data uploaded into window textures since the
+     * backend got created.
+     */
+    qint64 textureUploadBytes() const {
+        return m_textureUploadBytes;
+    }
+    /**
+     * Accounts for @p bytes of the texture uploads which got streamed through pixel buffers.
+     */
+    void addStreamedTextureUploadBytes(qint64 bytes) {
+        m_streamedTextureUploadBytes += bytes;
+    }
+    /**
+     * The part of textureUploadBytes which got streamed through pixel buffers.
+     */
+    qint64 streamedTextureUploadBytes() const {
+        return m_streamedTextureUploadBytes;
+    }
     /**
      * @brief Compositor is going into idle mode, flushes any pending paints.
      */
@@ -269,6 +333,14 @@ private:
      * @brief Timer to measure how long a frame renders.
      */
     QElapsedTimer m_renderTimer;
+    /**
+     * @brief Bytes uploaded into window textures.
+     */
+    qint64 m_textureUploadBytes = 0;
+    /**
+     * @brief Bytes of m_textureUploadBytes streamed through pixel buffers.
+     */
+    qint64 m_streamedTextureUploadBytes = 0;
     bool m_surfaceLessContext = false;
 
     QList<QByteArray> m_extensions;
@@ -59,6 +59,23 @@ bool QPainterBackend::perScreenRendering() const
     return false;
 }
 
+bool QPainterBackend::perOutputScheduling() const
+{
+    return false;
+}
+
+void QPainterBackend::prepareRenderingForScreen(int screenId)
+{
+    Q_UNUSED(screenId)
+    prepareRenderingFrame();
+}
+
+void QPainterBackend::presentScreen(int screenId, int mask, const QRegion &damage)
+{
+    Q_UNUSED(screenId)
+    present(mask, damage);
+}
+
 QImage *QPainterBackend::bufferForScreen(int screenId)
 {
     Q_UNUSED(screenId)
@@ -86,6 +86,23 @@ public:
      * Default implementation returns @c false.
      */
     virtual bool perScreenRendering() const;
+    /**
+     * Whether each screen can be rendered on its own schedule. Backends returning @c true
+     * have to implement prepareRenderingForScreen and presentScreen and report buffer swaps
+     * per output through Compositor::aboutToSwapBuffers.
+     * Default implementation returns @c false.
+     */
+    virtual bool perOutputScheduling() const;
+    /**
+     * Prepares rendering a frame for the screen with @p screenId only.
+     * Default implementation calls prepareRenderingFrame.
+     */
+    virtual void prepareRenderingForScreen(int screenId);
+    /**
+     * Presents the buffer of the screen with @p screenId only.
+     * Default implementation calls present.
+     */
+    virtual void presentScreen(int screenId, int mask, const QRegion &damage);
 
 protected:
     QPainterBackend();
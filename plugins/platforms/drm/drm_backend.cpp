@@ -218,7 +218,7 @@ void DrmBackend::deactivate()
         return;
     }
     // block compositor
-    if (m_pageFlipsPending == 0 && Compositor::self()) {
+    if (Compositor::self()) {
         Compositor::self()->aboutToSwapBuffers();
     }
     // hide cursor and disable
@@ -239,13 +239,9 @@ void DrmBackend::pageFlipHandler(int fd, unsigned int frame, unsigned int sec, u
 
     output->pageFlipped();
     output->m_backend->m_pageFlipsPending--;
-    if (output->m_backend->m_pageFlipsPending == 0) {
-        // TODO: improve, this currently means we wait for all page flips or all outputs.
-        // It would be better to driver the repaint per output
-
-        if (Compositor::self()) {
-            Compositor::self()->bufferSwapComplete();
-        }
+    // While deactivated the compositor stays blocked until reactivate.
+    if (output->m_backend->m_active && Compositor::self()) {
+        Compositor::self()->bufferSwapComplete(output);
     }
 }
 
@@ -595,8 +591,8 @@ bool DrmBackend::present(DrmBuffer *buffer, DrmOutput *output)
 
     if (output->present(buffer)) {
         m_pageFlipsPending++;
-        if (m_pageFlipsPending == 1 && Compositor::self()) {
-            Compositor::self()->aboutToSwapBuffers();
+        if (Compositor::self()) {
+            Compositor::self()->aboutToSwapBuffers(output);
         }
         return true;
     } else if (m_deleteBufferAfterPageFlip) {
@@ -605,6 +601,21 @@ bool DrmBackend::present(DrmBuffer *buffer, DrmOutput *output)
     return false;
 }
 
+bool DrmBackend::scanout(DrmBuffer *buffer, uint32_t format, DrmOutput *output)
+{
+    if (!buffer || buffer->bufferId() == 0) {
+        return false;
+    }
+    if (!output->scanout(buffer, format)) {
+        return false;
+    }
+    m_pageFlipsPending++;
+    if (Compositor::self()) {
+        Compositor::self()->aboutToSwapBuffers(output);
+    }
+    return true;
+}
+
 void DrmBackend::initCursor()
 {
 
@@ -76,6 +76,11 @@ public:
     DrmSurfaceBuffer *createBuffer(const std::shared_ptr<GbmSurface> &surface);
 #endif
     bool present(DrmBuffer *buffer, DrmOutput *output);
+    /**
+     * Presents the client @p buffer on @p output instead of a composited image. Unlike
+     * present the buffer is not deleted on failure, the caller has to composite instead.
+     */
+    bool scanout(DrmBuffer *buffer, uint32_t format, DrmOutput *output);
 
     int fd() const {
         return m_fd;
@@ -22,15 +22,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gbm_surface.h"
 
 #include "logging.h"
+#include "linux_dmabuf.h"
 
+// KWayland
+#include <KWayland/Server/buffer_interface.h>
 // system
 #include <sys/mman.h>
 // c++
 #include <cerrno>
+#include <cstring>
 // drm
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <gbm.h>
+#include <drm_fourcc.h>
 
 namespace KWin
 {
@@ -66,4 +71,96 @@ void DrmSurfaceBuffer::releaseGbm()
     m_bo = nullptr;
 }
 
+// DrmDmabufImport
+DrmDmabufImport::DrmDmabufImport(int fd, gbm_device *device, KWayland::Server::BufferInterface *buffer)
+    : m_fd(fd)
+{
+    auto *dmabuf = static_cast<DmabufBuffer *>(buffer->linuxDmabufBuffer());
+    if (!dmabuf || dmabuf->planes().isEmpty() || dmabuf->planes().count() > 4) {
+        return;
+    }
+    // scanout starts at the upper left corner
+    if (dmabuf->flags() & KWayland::Server::LinuxDmabufUnstableV1Interface::YInverted) {
+        return;
+    }
+    const auto &planes = dmabuf->planes();
+    const uint64_t modifier = planes.first().modifier;
+    if (planes.count() == 1 && modifier == DRM_FORMAT_MOD_INVALID) {
+        gbm_import_fd_data data = {};
+        data.fd = planes.first().fd;
+        data.width = dmabuf->size().width();
+        data.height = dmabuf->size().height();
+        data.stride = planes.first().stride;
+        data.format = dmabuf->format();
+        m_bo = gbm_bo_import(device, GBM_BO_IMPORT_FD, &data, GBM_BO_USE_SCANOUT);
+    } else {
+        gbm_import_fd_modifier_data data = {};
+        data.width = dmabuf->size().width();
+        data.height = dmabuf->size().height();
+        data.format = dmabuf->format();
+        data.num_fds = planes.count();
+        data.modifier = modifier;
+        for (int i = 0; i < planes.count(); ++i) {
+            data.fds[i] = planes.at(i).fd;
+            data.strides[i] = planes.at(i).stride;
+            data.offsets[i] = planes.at(i).offset;
+        }
+        m_bo = gbm_bo_import(device, GBM_BO_IMPORT_FD_MODIFIER, &data, GBM_BO_USE_SCANOUT);
+    }
+    if (!m_bo) {
+        qCDebug(KWIN_DRM) << "Importing the client buffer for scanout failed";
+        return;
+    }
+
+    uint32_t handles[4] = {};
+    uint32_t strides[4] = {};
+    uint32_t offsets[4] = {};
+    uint64_t modifiers[4] = {};
+    for (int i = 0; i < planes.count(); ++i) {
+        handles[i] = gbm_bo_get_handle_for_plane(m_bo, i).u32;
+        strides[i] = planes.at(i).stride;
+        offsets[i] = planes.at(i).offset;
+        modifiers[i] = modifier;
+    }
+    const bool hasModifier = modifier != DRM_FORMAT_MOD_INVALID;
+    if (drmModeAddFB2WithModifiers(fd, dmabuf->size().width(), dmabuf->size().height(), dmabuf->format(),
+                                   handles, strides, offsets, hasModifier ? modifiers : nullptr, &m_bufferId,
+                                   hasModifier ? DRM_MODE_FB_MODIFIERS : 0) != 0) {
+        qCDebug(KWIN_DRM) << "drmModeAddFB2WithModifiers failed for client buffer:" << strerror(errno);
+        m_bufferId = 0;
+        return;
+    }
+    m_size = dmabuf->size();
+    m_format = dmabuf->format();
+}
+
+DrmDmabufImport::~DrmDmabufImport()
+{
+    if (m_bufferId) {
+        drmModeRmFB(m_fd, m_bufferId);
+    }
+    if (m_bo) {
+        gbm_bo_destroy(m_bo);
+    }
+}
+
+// DrmDmabufBuffer
+DrmDmabufBuffer::DrmDmabufBuffer(const std::shared_ptr<DrmDmabufImport> &import, KWayland::Server::BufferInterface *buffer)
+    : DrmBuffer(import->fd())
+    , m_import(import)
+    , m_buffer(buffer)
+{
+    m_buffer->ref();
+    m_bufferId = m_import->bufferId();
+    m_size = m_import->size();
+}
+
+DrmDmabufBuffer::~DrmDmabufBuffer()
+{
+    // the framebuffer belongs to the import
+    if (m_buffer) {
+        m_buffer->unref();
+    }
+}
+
 }
@@ -23,9 +23,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "drm_buffer.h"
 
+#include <QPointer>
+
 #include <memory>
 
 struct gbm_bo;
+struct gbm_device;
+
+namespace KWayland
+{
+namespace Server
+{
+class BufferInterface;
+}
+}
 
 namespace KWin
 {
@@ -61,6 +72,61 @@ private:
     gbm_bo *m_bo = nullptr;
 };
 
+/**
+ * @brief The gbm import and the framebuffer of the linux-dmabuf buffer of a client.
+ *
+ * Clients attach the same few buffers again and again, thus the import is kept until the
+ * client destroys the buffer instead of importing it for every frame. Check bufferId() to
+ * find out whether the import succeeded.
+ */
+class DrmDmabufImport
+{
+public:
+    DrmDmabufImport(int fd, gbm_device *device, KWayland::Server::BufferInterface *buffer);
+    ~DrmDmabufImport();
+
+    int fd() const {
+        return m_fd;
+    }
+    quint32 bufferId() const {
+        return m_bufferId;
+    }
+    const QSize &size() const {
+        return m_size;
+    }
+    uint32_t format() const {
+        return m_format;
+    }
+
+private:
+    int m_fd;
+    gbm_bo *m_bo = nullptr;
+    quint32 m_bufferId = 0;
+    QSize m_size;
+    uint32_t m_format = 0;
+};
+
+/**
+ * @brief Framebuffer for the linux-dmabuf buffer of a client, to scan it out directly.
+ *
+ * The client buffer is referenced as long as the framebuffer exists, thus the client only
+ * gets it released once the buffer is not shown anymore.
+ */
+class DrmDmabufBuffer : public DrmBuffer
+{
+public:
+    DrmDmabufBuffer(const std::shared_ptr<DrmDmabufImport> &import, KWayland::Server::BufferInterface *buffer);
+    ~DrmDmabufBuffer() override;
+
+    uint32_t format() const {
+        return m_import->format();
+    }
+
+private:
+    std::shared_ptr<DrmDmabufImport> m_import;
+    QPointer<KWayland::Server::BufferInterface> m_buffer;
+};
+
 }
 
 #endif
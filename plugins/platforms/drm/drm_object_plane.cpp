@@ -158,6 +158,27 @@ void DrmPlane::setNext(DrmBuffer *b)
     m_next = b;
 }
 
+void DrmPlane::setScanout(DrmBuffer *b, const QRect &geometry, uint32_t crtcId)
+{
+    setValue(int(PropertyIndex::SrcX), 0);
+    setValue(int(PropertyIndex::SrcY), 0);
+    // the source rectangle is in 16.16 fixed point
+    setValue(int(PropertyIndex::SrcW), uint64_t(b->size().width()) << 16);
+    setValue(int(PropertyIndex::SrcH), uint64_t(b->size().height()) << 16);
+    setValue(int(PropertyIndex::CrtcX), geometry.x());
+    setValue(int(PropertyIndex::CrtcY), geometry.y());
+    setValue(int(PropertyIndex::CrtcW), geometry.width());
+    setValue(int(PropertyIndex::CrtcH), geometry.height());
+    setValue(int(PropertyIndex::CrtcId), crtcId);
+    setNext(b);
+}
+
+void DrmPlane::disable()
+{
+    setValue(int(PropertyIndex::CrtcId), 0);
+    setNext(nullptr);
+}
+
 void DrmPlane::setTransformation(Transformations t)
 {
     // TODO: When being pedantic, this should go through the enum mapping. Just remember
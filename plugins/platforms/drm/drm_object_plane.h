@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "drm_object.h"
 
+#include <QRect>
+
 #include <xf86drmMode.h>
 
 namespace KWin
@@ -78,6 +80,9 @@ public:
     QVector<uint32_t> formats() const {
         return m_formats;
     }
+    bool isFormatSupported(uint32_t format) const {
+        return m_formats.contains(format);
+    }
 
     DrmBuffer *current() const {
         return m_current;
@@ -89,6 +94,15 @@ public:
         m_current = b;
     }
     void setNext(DrmBuffer *b);
+    /**
+     * Shows the complete buffer @p b at @p geometry of the CRTC with @p crtcId,
+     * the geometry is in device pixels.
+     */
+    void setScanout(DrmBuffer *b, const QRect &geometry, uint32_t crtcId);
+    /**
+     * Detaches the plane from its CRTC with the next commit.
+     */
+    void disable();
     void setTransformation(Transformations t);
     Transformations transformation();
 
@@ -105,11 +119,9 @@ private:
     DrmBuffer *m_current = nullptr;
     DrmBuffer *m_next = nullptr;
 
-    // TODO: See weston drm_output_check_plane_format for future use of these member variables
     QVector<uint32_t> m_formats;        // Possible formats, which can be presented on this plane
 
-    // TODO: when using overlay planes in the future: restrict possible screens / crtcs of planes
-    uint32_t m_possibleCrtcs;
+    uint32_t m_possibleCrtcs = 0;
 
     Transformations m_supportedTransformations = Transformation::Rotate0;
 };
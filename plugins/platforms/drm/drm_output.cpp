@@ -41,6 +41,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QCryptographicHash>
 #include <QPainter>
 // c++
+#include <algorithm>
 #include <cerrno>
 // drm
 #include <xf86drm.h>
@@ -71,8 +72,16 @@ void DrmOutput::teardown()
     hideCursor();
     m_crtc->blank();
 
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        delete p->next();
+        p->disable();
+        delete p->current();
+        p->setCurrent(nullptr);
+        p->setOutput(nullptr);
+    }
+    m_overlayPlanes.clear();
+
     if (m_primaryPlane) {
-        // TODO: when having multiple planes, also clean up these
         m_primaryPlane->setOutput(nullptr);
 
         if (m_backend->deleteBufferAfterPageFlip()) {
@@ -729,9 +738,6 @@ void DrmOutput::pageFlipped()
         if (m_backend->atomicModeSetting()) {
             if (!m_primaryPlane->next()) {
                 // on manual vt switch
-                // TODO: when we later use overlay planes it might happen, that we have a page flip with only
-                //       damage on one of these, and therefore the primary plane has no next buffer
-                //       -> Then we don't want to return here!
                 if (m_primaryPlane->current()) {
                     m_primaryPlane->current()->releaseGbm();
                 }
@@ -741,6 +747,7 @@ void DrmOutput::pageFlipped()
                 p->flipBufferWithDelete();
             }
             m_nextPlanesFlipList.clear();
+            releaseOverlays();
         } else {
             if (!m_crtc->next()) {
                 // on manual vt switch
@@ -783,10 +790,10 @@ bool DrmOutput::dpmsAtomicOff()
 {
     m_atomicOffPending = false;
 
-    // TODO: With multiple planes: deactivate all of them here
     delete m_primaryPlane->next();
     m_primaryPlane->setNext(nullptr);
-    m_nextPlanesFlipList << m_primaryPlane;
+    disableOverlays();
+    m_nextPlanesFlipList << m_primaryPlane << m_overlayPlanes;
 
     if (!doAtomicCommit(AtomicCommitMode::Test)) {
         qCDebug(KWIN_DRM) << "Atomic test commit to Dpms Off failed. Aborting.";
@@ -823,11 +830,30 @@ bool DrmOutput::presentAtomically(DrmBuffer *buffer)
     }
 #endif
 
+    QVector<DrmBuffer *> overlayBuffers;
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        if (p->next()) {
+            overlayBuffers << p->next();
+        }
+    }
     m_primaryPlane->setNext(buffer);
-    m_nextPlanesFlipList << m_primaryPlane;
-
-    if (!doAtomicCommit(AtomicCommitMode::Test)) {
-        //TODO: When we use planes for layered rendering, fallback to renderer instead. Also for direct scanout?
+    m_nextPlanesFlipList << m_primaryPlane << m_overlayPlanes;
+
+    bool tested = doAtomicCommit(AtomicCommitMode::Test);
+    if (!tested && !overlayBuffers.isEmpty()) {
+        // The overlays passed the test with the previous composited image. Retry without
+        // them, the windows on them are composited with the next frame.
+        qCDebug(KWIN_DRM) << "Atomic test commit with overlays failed, disabling them.";
+        qDeleteAll(overlayBuffers);
+        disableOverlays();
+        m_primaryPlane->setNext(buffer);
+        m_nextPlanesFlipList << m_primaryPlane << m_overlayPlanes;
+        tested = doAtomicCommit(AtomicCommitMode::Test);
+        if (Compositor *compositor = Compositor::self()) {
+            compositor->addRepaint(geometry());
+        }
+    }
+    if (!tested) {
         //TODO: Probably should undo setNext and reset the flip list
         qCDebug(KWIN_DRM) << "Atomic test commit failed. Aborting present.";
         // go back to previous state
@@ -868,6 +894,97 @@ bool DrmOutput::presentAtomically(DrmBuffer *buffer)
     return true;
 }
 
+bool DrmOutput::scanout(DrmBuffer *buffer, uint32_t format)
+{
+    if (!m_backend->atomicModeSetting() || m_modesetRequested || m_pageFlipPending) {
+        return false;
+    }
+    if (m_dpmsModePending != DpmsMode::On || !LogindIntegration::self()->isActiveSession()) {
+        return false;
+    }
+    // the client buffer can't be rotated
+    if (transform() != Transform::Normal) {
+        return false;
+    }
+#if HAVE_EGL_STREAMS
+    if (m_backend->useEglStreams()) {
+        return false;
+    }
+#endif
+    const QSize modeSize(m_mode.hdisplay, m_mode.vdisplay);
+    disableOverlays();
+    DrmPlaneAssignment assignment(m_backend->fd(), m_crtc->id(), m_crtc->resIndex());
+    if (!assignment.assignPrimary(m_primaryPlane, {buffer, format, QRect(QPoint(0, 0), modeSize)}, modeSize, m_overlayPlanes)) {
+        return false;
+    }
+    m_nextPlanesFlipList << m_primaryPlane << m_overlayPlanes;
+    if (!doAtomicCommit(AtomicCommitMode::Real)) {
+        qCWarning(KWIN_DRM) << "Direct scanout failed although the test commit passed.";
+        return false;
+    }
+    m_pageFlipPending = true;
+    return true;
+}
+
+QVector<bool> DrmOutput::assignOverlays(const QVector<DrmLayer> &layers)
+{
+    QVector<bool> assigned(layers.count(), false);
+    if (!m_backend->atomicModeSetting() || (layers.isEmpty() && m_overlayPlanes.isEmpty())) {
+        return assigned;
+    }
+    // buffers which were assigned but never presented
+    disableOverlays();
+    if (m_modesetRequested || m_pageFlipPending || transform() != Transform::Normal) {
+        return assigned;
+    }
+    QVector<DrmPlane *> planes = m_overlayPlanes;
+    if (!layers.isEmpty()) {
+        for (DrmPlane *p : m_backend->overlayPlanes()) {
+            if (!p->output() && p->isCrtcSupported(m_crtc->resIndex())) {
+                planes << p;
+            }
+        }
+    }
+    DrmPlaneAssignment assignment(m_backend->fd(), m_crtc->id(), m_crtc->resIndex());
+    const QVector<DrmPlane *> result = assignment.assignOverlays(m_primaryPlane, planes, layers);
+    for (int i = 0; i < result.count(); ++i) {
+        assigned[i] = result.at(i) != nullptr;
+    }
+    m_overlayPlanes.clear();
+    for (DrmPlane *p : qAsConst(planes)) {
+        if (p->next() || p->current()) {
+            p->setOutput(this);
+            m_overlayPlanes << p;
+        } else {
+            p->setOutput(nullptr);
+        }
+    }
+    return assigned;
+}
+
+void DrmOutput::disableOverlays()
+{
+    for (DrmPlane *p : qAsConst(m_overlayPlanes)) {
+        delete p->next();
+        p->disable();
+    }
+}
+
+void DrmOutput::releaseOverlays()
+{
+    // overlays which are disabled now can be used by other outputs
+    auto it = std::remove_if(m_overlayPlanes.begin(), m_overlayPlanes.end(),
+        [] (DrmPlane *p) {
+            if (p->current()) {
+                return false;
+            }
+            p->setOutput(nullptr);
+            return true;
+        }
+    );
+    m_overlayPlanes.erase(it, m_overlayPlanes.end());
+}
+
 bool DrmOutput::presentLegacy(DrmBuffer *buffer)
 {
     if (m_crtc->next()) {
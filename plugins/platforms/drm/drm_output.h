@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "drm_pointer.h"
 #include "drm_object.h"
 #include "drm_object_plane.h"
+#include "drm_plane_assignment.h"
 #include "edid.h"
 
 #include <QObject>
@@ -58,6 +59,17 @@ public:
     void moveCursor(const QPoint &globalPos);
     bool init(drmModeConnector *connector);
     bool present(DrmBuffer *buffer);
+    /**
+     * Presents the client @p buffer directly on the primary plane instead of a composited
+     * image. Returns @c false if the buffer can't be scanned out, it has to be composited then.
+     */
+    bool scanout(DrmBuffer *buffer, uint32_t format);
+    /**
+     * Puts the @p layers on overlay planes with the next present. Returns for each layer
+     * whether it got a plane, the other layers have to be composited. Overlays which are not
+     * needed anymore are disabled with the next present.
+     */
+    QVector<bool> assignOverlays(const QVector<DrmLayer> &layers);
     void pageFlipped();
 
     // These values are defined by the kernel
@@ -113,6 +125,8 @@ private:
     void updateEnablement(bool enable) override;
 
     bool dpmsAtomicOff();
+    void disableOverlays();
+    void releaseOverlays();
     bool dpmsLegacyApply();
 
     void dpmsFinishOn();
@@ -144,6 +158,8 @@ private:
     uint32_t m_blobId = 0;
     DrmPlane* m_primaryPlane = nullptr;
     DrmPlane* m_cursorPlane = nullptr;
+    // overlays which show a client buffer or still need to be disabled
+    QVector<DrmPlane*> m_overlayPlanes;
     QVector<DrmPlane*> m_nextPlanesFlipList;
     bool m_pageFlipPending = false;
     bool m_atomicOffPending = false;
@@ -0,0 +1,107 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "drm_plane_assignment.h"
+#include "drm_buffer.h"
+#include "drm_object_plane.h"
+#include "drm_pointer.h"
+#include "logging.h"
+
+namespace KWin
+{
+
+DrmPlaneAssignment::DrmPlaneAssignment(int fd, uint32_t crtcId, int crtcIndex)
+    : m_fd(fd)
+    , m_crtcId(crtcId)
+    , m_crtcIndex(crtcIndex)
+{
+}
+
+bool DrmPlaneAssignment::assignPrimary(DrmPlane *primary, const DrmLayer &layer, const QSize &modeSize, const QVector<DrmPlane *> &overlays)
+{
+    if (!layer.buffer || !primary->isFormatSupported(layer.format)) {
+        return false;
+    }
+    // the primary plane keeps the source and destination rectangles of the mode set
+    if (layer.buffer->size() != modeSize || layer.geometry != QRect(QPoint(0, 0), modeSize)) {
+        return false;
+    }
+    for (DrmPlane *plane : overlays) {
+        plane->disable();
+    }
+    if (!test(primary, layer.buffer, overlays)) {
+        qCDebug(KWIN_DRM) << "Direct scanout rejected on plane" << primary->id();
+        return false;
+    }
+    primary->setNext(layer.buffer);
+    return true;
+}
+
+QVector<DrmPlane *> DrmPlaneAssignment::assignOverlays(DrmPlane *primary, const QVector<DrmPlane *> &overlays, const QVector<DrmLayer> &layers)
+{
+    QVector<DrmPlane *> assigned(layers.count(), nullptr);
+    for (DrmPlane *plane : overlays) {
+        plane->disable();
+    }
+    // the composited image for this frame is not rendered yet, test with the current one
+    DrmBuffer *composited = primary->next() ? primary->next() : primary->current();
+    if (!composited) {
+        return assigned;
+    }
+    for (int i = 0; i < layers.count(); ++i) {
+        const DrmLayer &layer = layers.at(i);
+        if (!layer.buffer) {
+            continue;
+        }
+        for (DrmPlane *plane : overlays) {
+            if (plane->next() || !plane->isCrtcSupported(m_crtcIndex) || !plane->isFormatSupported(layer.format)) {
+                continue;
+            }
+            plane->setScanout(layer.buffer, layer.geometry, m_crtcId);
+            if (test(primary, composited, overlays)) {
+                assigned[i] = plane;
+                break;
+            }
+            plane->disable();
+        }
+    }
+    return assigned;
+}
+
+bool DrmPlaneAssignment::test(DrmPlane *primary, DrmBuffer *primaryBuffer, const QVector<DrmPlane *> &overlays) const
+{
+    DrmScopedPointer<drmModeAtomicReq> req(drmModeAtomicAlloc());
+    if (!req) {
+        qCWarning(KWIN_DRM) << "DRM: couldn't allocate atomic request";
+        return false;
+    }
+    const int fbId = int(DrmPlane::PropertyIndex::FbId);
+    primary->setValue(fbId, primaryBuffer->bufferId());
+    bool ret = primary->atomicPopulate(req.data());
+    primary->setValue(fbId, primary->next() ? primary->next()->bufferId() : 0);
+    for (DrmPlane *plane : overlays) {
+        ret &= plane->atomicPopulate(req.data());
+    }
+    if (!ret) {
+        return false;
+    }
+    return drmModeAtomicCommit(m_fd, req.data(), DRM_MODE_ATOMIC_TEST_ONLY, nullptr) == 0;
+}
+
+}
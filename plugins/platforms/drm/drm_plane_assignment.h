@@ -0,0 +1,82 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_DRM_PLANE_ASSIGNMENT_H
+#define KWIN_DRM_PLANE_ASSIGNMENT_H
+
+#include <QRect>
+#include <QSize>
+#include <QVector>
+
+namespace KWin
+{
+
+class DrmBuffer;
+class DrmPlane;
+
+/**
+ * A client buffer which could be shown on a plane instead of being composited.
+ */
+struct DrmLayer
+{
+    DrmBuffer *buffer = nullptr;
+    uint32_t format = 0;
+    /**
+     * Where the buffer is shown on the CRTC, in device pixels.
+     */
+    QRect geometry;
+};
+
+/**
+ * @brief Assigns client buffers to the planes of a CRTC.
+ *
+ * Whether the hardware can show a buffer on a plane depends on much more than the formats
+ * announced by the plane, e.g. on scaling limits or on the available memory bandwidth. Each
+ * assignment is therefore verified with an atomic test commit. Layers which don't pass the
+ * test have to be composited.
+ */
+class DrmPlaneAssignment
+{
+public:
+    DrmPlaneAssignment(int fd, uint32_t crtcId, int crtcIndex);
+
+    /**
+     * Tries to show @p layer on the @p primary plane instead of the composited image. Only
+     * layers covering the complete mode of @p modeSize qualify. The @p overlays are disabled.
+     */
+    bool assignPrimary(DrmPlane *primary, const DrmLayer &layer, const QSize &modeSize, const QVector<DrmPlane *> &overlays);
+
+    /**
+     * Tries to put the @p layers on the @p overlays while the @p primary plane keeps showing
+     * the composited image. Returns the plane each layer got, or @c null if it has to be
+     * composited. The overlays which didn't get a layer are disabled.
+     */
+    QVector<DrmPlane *> assignOverlays(DrmPlane *primary, const QVector<DrmPlane *> &overlays, const QVector<DrmLayer> &layers);
+
+private:
+    bool test(DrmPlane *primary, DrmBuffer *primaryBuffer, const QVector<DrmPlane *> &overlays) const;
+
+    int m_fd;
+    uint32_t m_crtcId;
+    int m_crtcIndex;
+};
+
+}
+
+#endif
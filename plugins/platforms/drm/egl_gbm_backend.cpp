@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // kwin
 #include "composite.h"
 #include "drm_backend.h"
+#include "drm_buffer_gbm.h"
 #include "drm_output.h"
 #include "gbm_surface.h"
 #include "logging.h"
@@ -28,6 +29,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 // kwin libs
 #include <kwinglplatform.h>
+// KWayland
+#include <KWayland/Server/buffer_interface.h>
 // Qt
 #include <QOpenGLContext>
 // system
@@ -389,6 +392,84 @@ QRegion EglGbmBackend::prepareRenderingForScreen(int screenId)
     return QRegion();
 }
 
+DrmDmabufBuffer *EglGbmBackend::scanoutBuffer(KWayland::Server::BufferInterface *buffer)
+{
+    auto it = m_scanoutImports.find(buffer);
+    if (it == m_scanoutImports.end()) {
+        // a failed import is remembered as well, it would fail again
+        it = m_scanoutImports.insert(buffer, std::make_shared<DrmDmabufImport>(m_backend->fd(), m_backend->gbmDevice(), buffer));
+        connect(buffer, &KWayland::Server::BufferInterface::aboutToBeDestroyed, this,
+            [this] (KWayland::Server::BufferInterface *buffer) {
+                m_scanoutImports.remove(buffer);
+            }
+        );
+    }
+    if (!(*it)->bufferId()) {
+        return nullptr;
+    }
+    return new DrmDmabufBuffer(*it, buffer);
+}
+
+bool EglGbmBackend::scanout(int screenId, const ScanoutCandidate &candidate)
+{
+    Output &output = m_outputs[screenId];
+    if (!candidate.buffer || !candidate.buffer->linuxDmabufBuffer()) {
+        return false;
+    }
+    if (candidate.geometry != output.output->geometry()) {
+        return false;
+    }
+    // the client buffer is not rotated like the composited image
+    if (output.output->transform() != AbstractWaylandOutput::Transform::Normal) {
+        return false;
+    }
+    DrmDmabufBuffer *buffer = scanoutBuffer(candidate.buffer);
+    if (!buffer) {
+        return false;
+    }
+    if (!m_backend->scanout(buffer, buffer->format(), output.output)) {
+        delete buffer;
+        return false;
+    }
+    // the back buffers of the gbm surface lag behind what is on screen now
+    output.damageHistory.clear();
+    output.bufferAge = 0;
+    return true;
+}
+
+QVector<bool> EglGbmBackend::assignPlanes(int screenId, const QVector<ScanoutCandidate> &candidates)
+{
+    Output &output = m_outputs[screenId];
+    const QPoint origin = output.output->geometry().topLeft();
+    const qreal scale = output.output->scale();
+
+    // the overlay planes are not rotated, neither the buffers nor their geometries would match
+    const bool transformed = output.output->transform() != AbstractWaylandOutput::Transform::Normal;
+
+    QVector<DrmLayer> layers;
+    layers.reserve(candidates.count());
+    for (const ScanoutCandidate &candidate : candidates) {
+        DrmLayer layer;
+        if (!transformed && candidate.buffer && candidate.buffer->linuxDmabufBuffer()) {
+            if (DrmDmabufBuffer *buffer = scanoutBuffer(candidate.buffer)) {
+                layer.buffer = buffer;
+                layer.format = buffer->format();
+                layer.geometry = QRect((candidate.geometry.topLeft() - origin) * scale,
+                                       candidate.geometry.size() * scale);
+            }
+        }
+        layers << layer;
+    }
+
+    const QVector<bool> assigned = output.output->assignOverlays(layers);
+    for (int i = 0; i < layers.count(); ++i) {
+        if (!assigned.at(i)) {
+            delete layers.at(i).buffer;
+        }
+    }
+    return assigned;
+}
+
 void EglGbmBackend::endRenderingFrame(const QRegion &renderedRegion, const QRegion &damagedRegion)
 {
     Q_UNUSED(renderedRegion)
@@ -446,6 +527,11 @@ bool EglGbmBackend::perScreenRendering() const
     return true;
 }
 
+bool EglGbmBackend::perOutputScheduling() const
+{
+    return true;
+}
+
 /************************************************
  * EglTexture
  ************************************************/
@@ -22,14 +22,26 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "abstract_egl_backend.h"
 #include "remoteaccess_manager.h"
 
+#include <QHash>
+
 #include <memory>
 
 struct gbm_surface;
 
+namespace KWayland
+{
+namespace Server
+{
+class BufferInterface;
+}
+}
+
 namespace KWin
 {
 class DrmBackend;
 class DrmBuffer;
+class DrmDmabufBuffer;
+class DrmDmabufImport;
 class DrmOutput;
 class GbmSurface;
 
@@ -49,7 +61,10 @@ public:
     void endRenderingFrameForScreen(int screenId, const QRegion &damage, const QRegion &damagedRegion) override;
     bool usesOverlayWindow() const override;
     bool perScreenRendering() const override;
+    bool perOutputScheduling() const override;
     QRegion prepareRenderingForScreen(int screenId) override;
+    bool scanout(int screenId, const ScanoutCandidate &candidate) override;
+    QVector<bool> assignPlanes(int screenId, const QVector<ScanoutCandidate> &candidates) override;
     void init() override;
 
 protected:
@@ -85,8 +100,11 @@ private:
     void removeOutput(DrmOutput *drmOutput);
     void cleanupOutput(const Output &output);
 
+    DrmDmabufBuffer *scanoutBuffer(KWayland::Server::BufferInterface *buffer);
+
     DrmBackend *m_backend;
     QVector<Output> m_outputs;
+    QHash<KWayland::Server::BufferInterface *, std::shared_ptr<DrmDmabufImport>> m_scanoutImports;
     QScopedPointer<RemoteAccessManager> m_remoteaccessManager;
     friend class EglGbmTexture;
 };
@@ -527,6 +527,11 @@ bool EglStreamBackend::perScreenRendering() const
     return true;
 }
 
+bool EglStreamBackend::perOutputScheduling() const
+{
+    return true;
+}
+
 /************************************************
  * EglTexture
  ************************************************/
@@ -48,6 +48,7 @@ public:
     void endRenderingFrameForScreen(int screenId, const QRegion &damage, const QRegion &damagedRegion) override;
     bool usesOverlayWindow() const override;
     bool perScreenRendering() const override;
+    bool perOutputScheduling() const override;
     QRegion prepareRenderingForScreen(int screenId) override;
     void init() override;
 
@@ -131,6 +131,23 @@ void DrmQPainterBackend::present(int mask, const QRegion &damage)
     }
 }
 
+void DrmQPainterBackend::prepareRenderingForScreen(int screenId)
+{
+    Output &o = m_outputs[screenId];
+    o.index = (o.index + 1) % 2;
+}
+
+void DrmQPainterBackend::presentScreen(int screenId, int mask, const QRegion &damage)
+{
+    Q_UNUSED(mask)
+    Q_UNUSED(damage)
+    if (!LogindIntegration::self()->isActiveSession()) {
+        return;
+    }
+    const Output &o = m_outputs.at(screenId);
+    m_backend->present(o.buffer[o.index], o.output);
+}
+
 bool DrmQPainterBackend::usesOverlayWindow() const
 {
     return false;
@@ -141,4 +158,9 @@ bool DrmQPainterBackend::perScreenRendering() const
     return true;
 }
 
+bool DrmQPainterBackend::perOutputScheduling() const
+{
+    return true;
+}
+
 }
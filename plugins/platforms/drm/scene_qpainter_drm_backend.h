@@ -44,6 +44,9 @@ public:
     void prepareRenderingFrame() override;
     void present(int mask, const QRegion &damage) override;
     bool perScreenRendering() const override;
+    bool perOutputScheduling() const override;
+    void prepareRenderingForScreen(int screenId) override;
+    void presentScreen(int screenId, int mask, const QRegion &damage) override;
 
 private:
     void initOutput(DrmOutput *output);
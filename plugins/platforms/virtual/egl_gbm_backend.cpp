@@ -29,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <kwinglutils.h>
 // Qt
 #include <QOpenGLContext>
+#include <QtConcurrentRun>
 
 #ifndef EGL_PLATFORM_SURFACELESS_MESA
 #define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
@@ -47,6 +48,7 @@ EglGbmBackend::EglGbmBackend(VirtualBackend *b)
 
 EglGbmBackend::~EglGbmBackend()
 {
+    processSavedFrames(true);
     while (GLRenderTarget::isRenderTargetBound()) {
         GLRenderTarget::popRenderTarget();
     }
@@ -221,17 +223,63 @@ static void convertFromGLImage(QImage &img, int w, int h)
 void EglGbmBackend::endRenderingFrame(const QRegion &renderedRegion, const QRegion &damagedRegion)
 {
     Q_UNUSED(damagedRegion)
-    glFlush();
     if (m_backend->saveFrames()) {
-        QImage img = QImage(QSize(m_backBuffer->width(), m_backBuffer->height()), QImage::Format_ARGB32);
-        glReadnPixels(0, 0, m_backBuffer->width(), m_backBuffer->height(), GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(), (GLvoid*)img.bits());
-        convertFromGLImage(img, m_backBuffer->width(), m_backBuffer->height());
-        img.save(QStringLiteral("%1/%2.png").arg(m_backend->saveFrames()).arg(QString::number(m_frameCounter++)));
+        const QString fileName = QStringLiteral("%1/%2.png").arg(m_backend->screenshotDirPath(), QString::number(m_frameCounter++));
+        if (GLPixelReadback::supported()) {
+            // the frame gets encoded once the GPU copied it, without blocking the compositor
+            SavedFrame frame;
+            frame.readback = new GLPixelReadback;
+            frame.fileName = fileName;
+            if (frame.readback->read(QRect(0, 0, m_backBuffer->width(), m_backBuffer->height()))) {
+                m_savedFrames << frame;
+            } else {
+                delete frame.readback;
+            }
+        } else {
+            QImage img = QImage(QSize(m_backBuffer->width(), m_backBuffer->height()), QImage::Format_ARGB32);
+            glReadnPixels(0, 0, m_backBuffer->width(), m_backBuffer->height(), GL_RGBA, GL_UNSIGNED_BYTE, img.sizeInBytes(), (GLvoid*)img.bits());
+            convertFromGLImage(img, m_backBuffer->width(), m_backBuffer->height());
+            img.save(fileName);
+        }
     }
+    glFlush();
+    processSavedFrames(false);
     GLRenderTarget::popRenderTarget();
     setLastDamage(renderedRegion);
 }
 
+void EglGbmBackend::processSavedFrames(bool finish)
+{
+    for (auto it = m_savedFrames.begin(); it != m_savedFrames.end();) {
+        if (!it->mapped) {
+            if (!finish && !it->readback->isFinished()) {
+                ++it;
+                continue;
+            }
+            const uchar *data = it->readback->map();
+            it->mapped = true;
+            if (data) {
+                const QSize size = it->readback->size();
+                const QString fileName = it->fileName;
+                it->encoder = QtConcurrent::run(
+                    [data, size, fileName] {
+                        GLPixelReadback::toImage(data, size).save(fileName);
+                    }
+                );
+            }
+        }
+        if (finish) {
+            it->encoder.waitForFinished();
+        } else if (!it->encoder.isFinished()) {
+            ++it;
+            continue;
+        }
+        it->readback->unmap();
+        delete it->readback;
+        it = m_savedFrames.erase(it);
+    }
+}
+
 bool EglGbmBackend::usesOverlayWindow() const
 {
     return false;
@@ -21,9 +21,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define KWIN_EGL_GBM_BACKEND_H
 #include "abstract_egl_backend.h"
 
+#include <QFuture>
+#include <QVector>
+
 namespace KWin
 {
 class VirtualBackend;
+class GLPixelReadback;
 class GLTexture;
 class GLRenderTarget;
 
@@ -49,10 +53,21 @@ private:
     bool initializeEgl();
     bool initBufferConfigs();
     bool initRenderingContext();
+    /**
+     * Encodes the saved frames the GPU finished copying, with @p finish all of them.
+     */
+    void processSavedFrames(bool finish);
     VirtualBackend *m_backend;
     GLTexture *m_backBuffer = nullptr;
     GLRenderTarget *m_fbo = nullptr;
     int m_frameCounter = 0;
+    struct SavedFrame {
+        GLPixelReadback *readback = nullptr;
+        QString fileName;
+        bool mapped = false;
+        QFuture<void> encoder;
+    };
+    QVector<SavedFrame> m_savedFrames;
     friend class EglGbmTexture;
 };
 
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 
 #include <QPainter>
+#include <QtConcurrentRun>
 
 namespace KWin
 {
@@ -71,11 +72,35 @@ void VirtualQPainterBackend::present(int mask, const QRegion &damage)
     Q_UNUSED(damage)
     if (m_backend->saveFrames()) {
         for (int i=0; i < m_backBuffers.size() ; i++) {
-            m_backBuffers[i].save(QStringLiteral("%1/screen%2-%3.png").arg(m_backend->screenshotDirPath(), QString::number(i), QString::number(m_frameCounter++)));
+            saveFrame(i);
         }
     }
 }
 
+void VirtualQPainterBackend::prepareRenderingForScreen(int screenId)
+{
+    Q_UNUSED(screenId)
+}
+
+void VirtualQPainterBackend::presentScreen(int screenId, int mask, const QRegion &damage)
+{
+    Q_UNUSED(mask)
+    Q_UNUSED(damage)
+    if (m_backend->saveFrames()) {
+        saveFrame(screenId);
+    }
+}
+
+void VirtualQPainterBackend::saveFrame(int screenId)
+{
+    // the encoder keeps a shallow copy, painting the next frame detaches the buffer
+    const QString fileName = QStringLiteral("%1/screen%2-%3.png").arg(m_backend->screenshotDirPath(), QString::number(screenId), QString::number(m_frameCounter++));
+    QtConcurrent::run(
+        [] (const QImage &image, const QString &fileName) {
+            image.save(fileName);
+        }, m_backBuffers[screenId], fileName);
+}
+
 bool VirtualQPainterBackend::usesOverlayWindow() const
 {
     return false;
@@ -86,4 +111,9 @@ bool VirtualQPainterBackend::perScreenRendering() const
     return true;
 }
 
+bool VirtualQPainterBackend::perOutputScheduling() const
+{
+    return true;
+}
+
 }
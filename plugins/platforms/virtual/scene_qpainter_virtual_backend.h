@@ -44,9 +44,13 @@ public:
     void prepareRenderingFrame() override;
     void present(int mask, const QRegion &damage) override;
     bool perScreenRendering() const override;
+    bool perOutputScheduling() const override;
+    void prepareRenderingForScreen(int screenId) override;
+    void presentScreen(int screenId, int mask, const QRegion &damage) override;
 
 private:
     void createOutputs();
+    void saveFrame(int screenId);
 
     QVector<QImage> m_backBuffers;
     VirtualBackend *m_backend;
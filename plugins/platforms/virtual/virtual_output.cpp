@@ -32,13 +32,13 @@ VirtualOutput::~VirtualOutput()
 {
 }
 
-void VirtualOutput::init(const QPoint &logicalPosition, const QSize &pixelSize)
+void VirtualOutput::init(const QPoint &logicalPosition, const QSize &pixelSize, int refreshRate)
 {
     KWayland::Server::OutputDeviceInterface::Mode mode;
     mode.id = 0;
     mode.size = pixelSize;
     mode.flags = KWayland::Server::OutputDeviceInterface::ModeFlag::Current;
-    mode.refreshRate = 60000;  // TODO
+    mode.refreshRate = refreshRate;
     initInterfaces("model_TODO", "manufacturer_TODO", "UUID_TODO", pixelSize, { mode });
     setGeometry(QRect(logicalPosition, pixelSize));
 }
@@ -37,7 +37,7 @@ public:
     VirtualOutput(QObject *parent = nullptr);
     ~VirtualOutput() override;
 
-    void init(const QPoint &logicalPosition, const QSize &pixelSize);
+    void init(const QPoint &logicalPosition, const QSize &pixelSize, int refreshRate = 60000);
 
     void setGeometry(const QRect &geo);
 
@@ -0,0 +1,359 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "decoration_atlas.h"
+
+#include <kwinglutils.h>
+
+#include <QImage>
+
+#include <algorithm>
+
+namespace KWin
+{
+
+// an empty row and column between allocations, so that linear filtering doesn't bleed
+static const int s_padding = 1;
+static const QSize s_initialSize(1024, 256);
+// the units below are used by the window shaders and effects like the blur
+static const int s_textureUnit = 3;
+
+static int maxTextureSize()
+{
+    GLint size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &size);
+    return size;
+}
+
+DecorationAtlas::DecorationAtlas(QObject *parent)
+    : QObject(parent)
+{
+}
+
+DecorationAtlas::~DecorationAtlas() = default;
+
+int DecorationAtlas::allocate(const QSize &size)
+{
+    if (size.isEmpty()) {
+        return 0;
+    }
+    const QSize padded = size + QSize(s_padding, s_padding);
+    const int maximum = maxTextureSize();
+    if (padded.width() > maximum || padded.height() > maximum) {
+        return 0;
+    }
+
+    QPoint position;
+    if (!place(padded, &position)) {
+        // a fragmented atlas gets packed tighter before it grows
+        bool defragmented = false;
+        if (m_allocatedArea * 2 < qint64(m_bottom) * m_size.width()) {
+            defragmented = defragment();
+        }
+        while (!place(padded, &position)) {
+            QSize grown = s_initialSize;
+            if (m_size.isValid()) {
+                grown = m_size;
+                if (grown.height() < maximum) {
+                    grown.rheight() *= 2;
+                } else {
+                    grown.rwidth() *= 2;
+                }
+            }
+            while (grown.width() < padded.width()) {
+                grown.rwidth() *= 2;
+            }
+            grown = grown.boundedTo(QSize(maximum, maximum));
+            if (grown == m_size) {
+                if (defragmented || !defragment()) {
+                    return 0;
+                }
+                defragmented = true;
+                continue;
+            }
+            if (!resize(grown)) {
+                return 0;
+            }
+        }
+    }
+
+    const QRect rect(position, padded);
+    clear(rect);
+    m_allocatedArea += qint64(padded.width()) * padded.height();
+    const int id = m_nextId++;
+    m_allocations.insert(id, rect);
+    return id;
+}
+
+void DecorationAtlas::release(int id)
+{
+    const auto it = m_allocations.find(id);
+    if (it == m_allocations.end()) {
+        return;
+    }
+    free(*it);
+    m_allocatedArea -= qint64(it->width()) * it->height();
+    m_allocations.erase(it);
+}
+
+QRect DecorationAtlas::rect(int id) const
+{
+    const QRect rect = m_allocations.value(id);
+    if (rect.isNull()) {
+        return QRect();
+    }
+    return rect.adjusted(0, 0, -s_padding, -s_padding);
+}
+
+qreal DecorationAtlas::occupancy() const
+{
+    if (m_size.isEmpty()) {
+        return 0;
+    }
+    return qreal(m_allocatedArea) / (qreal(m_size.width()) * m_size.height());
+}
+
+void DecorationAtlas::bind(GLenum filter, int unit)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    GLint bound = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound);
+    const bool changed = m_texture->filter() != filter || m_texture->isDirty();
+    if (changed || GLuint(bound) != m_texture->texture()) {
+        m_texture->setFilter(filter);
+        m_texture->bind();
+        m_binds++;
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+int DecorationAtlas::textureUnit()
+{
+    return s_textureUnit;
+}
+
+void DecorationAtlas::frameFinished()
+{
+    m_lastFrameBinds = m_binds;
+    m_binds = 0;
+}
+
+bool DecorationAtlas::place(const QSize &size, QPoint *position)
+{
+    // best fit among the shelves which don't waste too much height
+    Shelf *best = nullptr;
+    int bestSpan = -1;
+    for (Shelf &shelf : m_shelves) {
+        if (shelf.height < size.height() || shelf.height > size.height() * 3 / 2 + 2) {
+            continue;
+        }
+        if (best && best->height <= shelf.height) {
+            continue;
+        }
+        for (int i = 0; i < shelf.free.count(); ++i) {
+            if (shelf.free.at(i).width >= size.width()) {
+                best = &shelf;
+                bestSpan = i;
+                break;
+            }
+        }
+    }
+    if (best) {
+        Span &span = best->free[bestSpan];
+        *position = QPoint(span.x, best->y);
+        span.x += size.width();
+        span.width -= size.width();
+        if (span.width == 0) {
+            best->free.remove(bestSpan);
+        }
+        return true;
+    }
+
+    if (m_bottom + size.height() > m_size.height() || size.width() > m_size.width()) {
+        return false;
+    }
+    Shelf shelf;
+    shelf.y = m_bottom;
+    shelf.height = size.height();
+    if (size.width() < m_size.width()) {
+        shelf.free << Span{size.width(), m_size.width() - size.width()};
+    }
+    m_shelves << shelf;
+    m_bottom += size.height();
+    *position = QPoint(0, shelf.y);
+    return true;
+}
+
+void DecorationAtlas::free(const QRect &rect)
+{
+    auto shelf = std::find_if(m_shelves.begin(), m_shelves.end(),
+        [&rect] (const Shelf &shelf) {
+            return shelf.y == rect.y();
+        }
+    );
+    if (shelf == m_shelves.end()) {
+        return;
+    }
+    QVector<Span> &spans = shelf->free;
+    auto it = std::lower_bound(spans.begin(), spans.end(), rect.x(),
+        [] (const Span &span, int x) {
+            return span.x < x;
+        }
+    );
+    it = spans.insert(it, Span{rect.x(), rect.width()});
+    // merge with the neighbouring free spans
+    if (it + 1 != spans.end() && it->x + it->width == (it + 1)->x) {
+        it->width += (it + 1)->width;
+        spans.erase(it + 1);
+    }
+    if (it != spans.begin() && (it - 1)->x + (it - 1)->width == it->x) {
+        (it - 1)->width += it->width;
+        spans.erase(it);
+    }
+
+    // empty shelves at the end give their height back
+    while (!m_shelves.isEmpty()) {
+        const Shelf &last = m_shelves.last();
+        if (last.free.count() != 1 || last.free.first().width != m_size.width()) {
+            break;
+        }
+        m_bottom = last.y;
+        m_shelves.removeLast();
+    }
+}
+
+bool DecorationAtlas::resize(const QSize &size)
+{
+    QScopedPointer<GLTexture> texture(new GLTexture(GL_RGBA8, size.width(), size.height()));
+    if (texture->isNull()) {
+        return false;
+    }
+    texture->setYInverted(true);
+    texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    texture->clear();
+
+    // the allocations keep their position, the texture coordinates are in pixels
+    bool copied = true;
+    if (m_bottom > 0) {
+        const QRect used(0, 0, m_size.width(), m_bottom);
+        copied = copyTo(texture.data(), {qMakePair(used, used.topLeft())});
+    }
+    const int added = size.width() - m_size.width();
+    if (added > 0) {
+        for (Shelf &shelf : m_shelves) {
+            if (!shelf.free.isEmpty() && shelf.free.last().x + shelf.free.last().width == m_size.width()) {
+                shelf.free.last().width += added;
+            } else {
+                shelf.free << Span{m_size.width(), added};
+            }
+        }
+    }
+    m_texture.swap(texture);
+    m_size = size;
+    if (!copied) {
+        emit relocated(true);
+    }
+    return true;
+}
+
+bool DecorationAtlas::defragment()
+{
+    if (m_allocations.isEmpty() || !m_texture) {
+        return false;
+    }
+    QVector<int> ids;
+    ids.reserve(m_allocations.count());
+    for (auto it = m_allocations.constBegin(); it != m_allocations.constEnd(); ++it) {
+        ids << it.key();
+    }
+    // the tallest allocations first, so that the shelves get filled evenly
+    std::sort(ids.begin(), ids.end(),
+        [this] (int a, int b) {
+            const QRect first = m_allocations.value(a);
+            const QRect second = m_allocations.value(b);
+            if (first.height() != second.height()) {
+                return first.height() > second.height();
+            }
+            return first.width() > second.width();
+        }
+    );
+
+    const QVector<Shelf> shelves = m_shelves;
+    const int bottom = m_bottom;
+    m_shelves.clear();
+    m_bottom = 0;
+    QVector<QPair<QRect, QPoint>> moves;
+    QHash<int, QRect> allocations;
+    for (int id : qAsConst(ids)) {
+        const QRect rect = m_allocations.value(id);
+        QPoint position;
+        if (!place(rect.size(), &position)) {
+            m_shelves = shelves;
+            m_bottom = bottom;
+            return false;
+        }
+        moves << qMakePair(rect, position);
+        allocations.insert(id, QRect(position, rect.size()));
+    }
+
+    QScopedPointer<GLTexture> texture(new GLTexture(GL_RGBA8, m_size.width(), m_size.height()));
+    if (texture->isNull()) {
+        m_shelves = shelves;
+        m_bottom = bottom;
+        return false;
+    }
+    texture->setYInverted(true);
+    texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    texture->clear();
+    const bool copied = copyTo(texture.data(), moves);
+    m_texture.swap(texture);
+    m_allocations = allocations;
+    emit relocated(!copied);
+    return true;
+}
+
+bool DecorationAtlas::copyTo(GLTexture *texture, const QVector<QPair<QRect, QPoint>> &moves)
+{
+    if (!m_texture || !GLRenderTarget::supported()) {
+        return false;
+    }
+    GLRenderTarget source(*m_texture);
+    if (!source.valid()) {
+        return false;
+    }
+    // read from the old texture through a framebuffer, the copy doesn't leave the GPU
+    GLRenderTarget::pushRenderTarget(&source);
+    texture->bind();
+    for (const auto &move : moves) {
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, move.second.x(), move.second.y(),
+                            move.first.x(), move.first.y(), move.first.width(), move.first.height());
+    }
+    texture->unbind();
+    GLRenderTarget::popRenderTarget();
+    return true;
+}
+
+void DecorationAtlas::clear(const QRect &rect)
+{
+    QImage image(rect.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    m_texture->update(image, rect.topLeft());
+}
+
+}
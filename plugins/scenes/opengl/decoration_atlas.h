@@ -0,0 +1,133 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_DECORATION_ATLAS_H
+#define KWIN_DECORATION_ATLAS_H
+
+#include <epoxy/gl.h>
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QRect>
+#include <QScopedPointer>
+#include <QVector>
+
+namespace KWin
+{
+
+class GLTexture;
+
+/**
+ * @brief One texture shared by the decorations of all windows.
+ *
+ * The parts of the decorations are sub-allocated from the texture with a shelf packer: the
+ * texture is split into horizontal shelves and each shelf keeps a list of free spans. An
+ * allocation goes into the lowest shelf it fits into, so that the thin borders of similarly
+ * sized windows end up next to each other.
+ *
+ * If there is no room left, the atlas is defragmented by packing all allocations anew, and
+ * the texture grows up to the maximum texture size supported by the driver. The pixels of
+ * the allocations are copied on the GPU, so that decorations of closed windows, which cannot
+ * be rendered again, survive both. Whenever allocations got moved, relocated() is emitted.
+ *
+ * The texture is y-inverted and its coordinates are in pixels, the positions of allocations
+ * are thus stable when the texture grows. It is bound to a texture unit of its own, so that
+ * it stays bound while the windows in between bind their contents.
+ */
+class DecorationAtlas : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DecorationAtlas(QObject *parent = nullptr);
+    ~DecorationAtlas() override;
+
+    /**
+     * Reserves an area of @p size pixels, cleared to transparent. Returns an id to look up
+     * the area with rect() or @c 0 if the atlas is full.
+     */
+    int allocate(const QSize &size);
+    void release(int id);
+    /**
+     * The area reserved for the allocation @p id, in pixels of texture().
+     */
+    QRect rect(int id) const;
+
+    GLTexture *texture() const {
+        return m_texture.data();
+    }
+
+    /**
+     * The fraction of the texture covered by allocations.
+     */
+    qreal occupancy() const;
+    /**
+     * Makes the texture available with @p filter on @p unit. It is only bound if something
+     * else got bound to the unit or its parameters changed.
+     */
+    void bind(GLenum filter, int unit = textureUnit());
+    static int textureUnit();
+    /**
+     * The number of times the texture actually got bound while painting the last frame.
+     */
+    int lastFrameBinds() const {
+        return m_lastFrameBinds;
+    }
+    void frameFinished();
+
+Q_SIGNALS:
+    /**
+     * Emitted when allocations moved to a different place in the texture. If
+     * @p contentsLost is @c true, the pixels could not be copied and the allocations
+     * are transparent.
+     */
+    void relocated(bool contentsLost);
+
+private:
+    struct Span {
+        int x;
+        int width;
+    };
+    struct Shelf {
+        int y;
+        int height;
+        QVector<Span> free;
+    };
+
+    bool place(const QSize &size, QPoint *position);
+    void free(const QRect &rect);
+    bool resize(const QSize &size);
+    bool defragment();
+    bool copyTo(GLTexture *texture, const QVector<QPair<QRect, QPoint>> &moves);
+    void clear(const QRect &rect);
+
+    QScopedPointer<GLTexture> m_texture;
+    QSize m_size;
+    QVector<Shelf> m_shelves;
+    int m_bottom = 0;
+    QHash<int, QRect> m_allocations;
+    qint64 m_allocatedArea = 0;
+    int m_nextId = 1;
+    int m_binds = 0;
+    int m_lastFrameBinds = 0;
+};
+
+}
+
+#endif
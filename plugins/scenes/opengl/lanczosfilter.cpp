@@ -39,6 +39,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QtMath>
 
 #include <cmath>
+#include <limits>
 
 namespace KWin
 {
@@ -52,10 +53,17 @@ LanczosFilter::LanczosFilter(QObject* parent)
     , m_uOffsets(0)
     , m_uKernel(0)
 {
+    connect(effects, &EffectsHandler::windowDamaged, this, &LanczosFilter::addDamage);
+    connect(effects, &EffectsHandler::windowGeometryShapeChanged, this,
+        [this] (EffectWindow *w) {
+            addDamage(w, QRect());
+        }
+    );
 }
 
 LanczosFilter::~LanczosFilter()
 {
+    discardAllCaches();
     delete m_offscreenTarget;
     delete m_offscreenTex;
 }
@@ -203,187 +211,272 @@ void LanczosFilter::performPaint(EffectWindowImpl* w, int mask, QRegion region,
             const QRect textureRect(tx, ty, tw, th);
             const bool hardwareClipping = !(QRegion(textureRect)-region).isEmpty();
 
-            int sw = width;
-            int sh = height;
-
-            GLTexture *cachedTexture = static_cast< GLTexture*>(w->data(LanczosCacheRole).value<void*>());
-            if (cachedTexture) {
-                if (cachedTexture->width() == tw && cachedTexture->height() == th) {
-                    cachedTexture->bind();
-                    if (hardwareClipping) {
-                        glEnable(GL_SCISSOR_TEST);
-                    }
-
-                    glEnable(GL_BLEND);
-                    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-
-                    const qreal rgb = data.brightness() * data.opacity();
-                    const qreal a = data.opacity();
-
-                    ShaderBinder binder(ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation);
-                    GLShader *shader = binder.shader();
-                    QMatrix4x4 mvp = data.screenProjectionMatrix();
-                    mvp.translate(textureRect.x(), textureRect.y());
-                    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
-                    shader->setUniform(GLShader::ModulationConstant, QVector4D(rgb, rgb, rgb, a));
-                    shader->setUniform(GLShader::Saturation, data.saturation());
-
-                    cachedTexture->render(region, textureRect, hardwareClipping);
-
-                    glDisable(GL_BLEND);
-                    if (hardwareClipping) {
-                        glDisable(GL_SCISSOR_TEST);
-                    }
-                    cachedTexture->unbind();
-                    m_timer.start(5000, this);
-                    return;
-                } else {
-                    // offscreen texture not matching - delete
-                    delete cachedTexture;
-                    cachedTexture = nullptr;
-                    w->setData(LanczosCacheRole, QVariant());
-                }
-            }
+            const QSize sourceSize(width, height);
 
-            WindowPaintData thumbData = data;
-            thumbData.setXScale(1.0);
-            thumbData.setYScale(1.0);
-            thumbData.setXTranslation(-w->x() - left);
-            thumbData.setYTranslation(-w->y() - top);
-            thumbData.setBrightness(1.0);
-            thumbData.setOpacity(1.0);
-            thumbData.setSaturation(1.0);
-
-            // Bind the offscreen FBO and draw the window on it unscaled
-            updateOffscreenSurfaces();
-            GLRenderTarget::pushRenderTarget(m_offscreenTarget);
-
-            QMatrix4x4 modelViewProjectionMatrix;
-            modelViewProjectionMatrix.ortho(0, m_offscreenTex->width(), m_offscreenTex->height(), 0 , 0, 65535);
-            thumbData.setProjectionMatrix(modelViewProjectionMatrix);
-
-            glClearColor(0.0, 0.0, 0.0, 0.0);
-            glClear(GL_COLOR_BUFFER_BIT);
-            w->sceneWindow()->performPaint(mask, infiniteRegion(), thumbData);
-
-            // Create a scratch texture and copy the rendered window into it
-            GLTexture tex(GL_RGBA8, sw, sh);
-            tex.setFilter(GL_LINEAR);
-            tex.setWrapMode(GL_CLAMP_TO_EDGE);
-            tex.bind();
-
-            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, m_offscreenTex->height() - sh, sw, sh);
-
-            // Set up the shader for horizontal scaling
-            float dx = sw / float(tw);
-            int kernelSize;
-            createKernel(dx, &kernelSize);
-            createOffsets(kernelSize, sw, Qt::Horizontal);
-
-            ShaderManager::instance()->pushShader(m_shader.data());
-            m_shader->setUniform(GLShader::ModelViewProjectionMatrix, modelViewProjectionMatrix);
-            setUniforms();
-
-            // Draw the window back into the FBO, this time scaled horizontally
-            glClear(GL_COLOR_BUFFER_BIT);
-            QVector<float> verts;
-            QVector<float> texCoords;
-            verts.reserve(12);
-            texCoords.reserve(12);
-
-            texCoords << 1.0 << 0.0; verts << tw  << 0.0; // Top right
-            texCoords << 0.0 << 0.0; verts << 0.0 << 0.0; // Top left
-            texCoords << 0.0 << 1.0; verts << 0.0 << sh;  // Bottom left
-            texCoords << 0.0 << 1.0; verts << 0.0 << sh;  // Bottom left
-            texCoords << 1.0 << 1.0; verts << tw  << sh;  // Bottom right
-            texCoords << 1.0 << 0.0; verts << tw  << 0.0; // Top right
-            GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
-            vbo->reset();
-            vbo->setData(6, 2, verts.constData(), texCoords.constData());
-            vbo->render(GL_TRIANGLES);
-
-            // At this point we don't need the scratch texture anymore
-            tex.unbind();
-            tex.discard();
-
-            // create scratch texture for second rendering pass
-            GLTexture tex2(GL_RGBA8, tw, sh);
-            tex2.setFilter(GL_LINEAR);
-            tex2.setWrapMode(GL_CLAMP_TO_EDGE);
-            tex2.bind();
-
-            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, m_offscreenTex->height() - sh, tw, sh);
-
-            // Set up the shader for vertical scaling
-            float dy = sh / float(th);
-            createKernel(dy, &kernelSize);
-            createOffsets(kernelSize, m_offscreenTex->height(), Qt::Vertical);
-            setUniforms();
-
-            // Now draw the horizontally scaled window in the FBO at the right
-            // coordinates on the screen, while scaling it vertically and blending it.
-            glClear(GL_COLOR_BUFFER_BIT);
-
-            verts.clear();
-
-            verts << tw  << 0.0; // Top right
-            verts << 0.0 << 0.0; // Top left
-            verts << 0.0 << th;  // Bottom left
-            verts << 0.0 << th;  // Bottom left
-            verts << tw  << th;  // Bottom right
-            verts << tw  << 0.0; // Top right
-            vbo->setData(6, 2, verts.constData(), texCoords.constData());
-            vbo->render(GL_TRIANGLES);
-
-            tex2.unbind();
-            tex2.discard();
-            ShaderManager::instance()->popShader();
-
-            // create cache texture
-            GLTexture *cache = new GLTexture(GL_RGBA8, tw, th);
-
-            cache->setFilter(GL_LINEAR);
-            cache->setWrapMode(GL_CLAMP_TO_EDGE);
-            cache->bind();
-            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, m_offscreenTex->height() - th, tw, th);
-            GLRenderTarget::popRenderTarget();
-
-            if (hardwareClipping) {
-                glEnable(GL_SCISSOR_TEST);
+            CacheEntry &entry = cacheEntry(w, QSize(tw, th));
+            if (entry.sourceSize != sourceSize) {
+                entry.sourceSize = sourceSize;
+                entry.damage = QRect(QPoint(0, 0), sourceSize);
+            }
+            if (!entry.damage.isEmpty()) {
+                filter(w, mask, data, QPoint(left, top), entry);
+            } else {
+                m_cacheHits++;
             }
+            paintCache(entry.texture, region, data, textureRect, hardwareClipping);
 
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            // Delete the offscreen surface and the caches after 5 seconds
+            m_timer.start(5000, this);
+            return;
+        }
+    } // if ( effects->compositingType() == KWin::OpenGLCompositing )
+    w->sceneWindow()->performPaint(mask, region, data);
+} // End of function
 
-            const qreal rgb = data.brightness() * data.opacity();
-            const qreal a = data.opacity();
+void LanczosFilter::filter(EffectWindowImpl *w, int mask, const WindowPaintData &data, const QPoint &offset, CacheEntry &entry)
+{
+    const int sw = entry.sourceSize.width();
+    const int sh = entry.sourceSize.height();
+    const int tw = entry.texture->width();
+    const int th = entry.texture->height();
+    const float dx = sw / float(tw);
+    const float dy = sh / float(th);
+
+    int kernelHeight;
+    createKernel(dy, &kernelHeight);
+    int kernelWidth;
+    createKernel(dx, &kernelWidth);
+
+    // A target pixel depends on the source pixels covered by the kernel around its center,
+    // only the target pixels depending on the damaged source pixels have to be filtered
+    // again. The source is rendered with enough margin to cover all of their kernels.
+    const QRect sourceRect(0, 0, sw, sh);
+    const QRect damage = entry.damage & sourceRect;
+    const QRect targetRect = QRect(QPoint(qFloor((damage.left() - kernelWidth) / dx), qFloor((damage.top() - kernelHeight) / dy)),
+                                   QPoint(qCeil((damage.right() + kernelWidth) / dx), qCeil((damage.bottom() + kernelHeight) / dy)))
+                             & QRect(0, 0, tw, th);
+    const int marginX = 2 * kernelWidth + qCeil(dx);
+    const int marginY = 2 * kernelHeight + qCeil(dy);
+    const QRect renderRect = damage.adjusted(-marginX, -marginY, marginX, marginY) & sourceRect;
+    entry.damage = QRect();
+    if (targetRect.isEmpty()) {
+        return;
+    }
+    m_filteredPixels += qint64(targetRect.width()) * targetRect.height();
+
+    WindowPaintData thumbData = data;
+    thumbData.setXScale(1.0);
+    thumbData.setYScale(1.0);
+    thumbData.setXTranslation(-w->x() - offset.x());
+    thumbData.setYTranslation(-w->y() - offset.y());
+    thumbData.setBrightness(1.0);
+    thumbData.setOpacity(1.0);
+    thumbData.setSaturation(1.0);
+
+    // Bind the offscreen FBO and draw the window on it unscaled
+    updateOffscreenSurfaces();
+    GLRenderTarget::pushRenderTarget(m_offscreenTarget);
+
+    QMatrix4x4 modelViewProjectionMatrix;
+    modelViewProjectionMatrix.ortho(0, m_offscreenTex->width(), m_offscreenTex->height(), 0 , 0, 65535);
+    thumbData.setProjectionMatrix(modelViewProjectionMatrix);
+
+    glEnable(GL_SCISSOR_TEST);
+    scissor(renderRect);
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    w->sceneWindow()->performPaint(mask, infiniteRegion(), thumbData);
+
+    // Create a scratch texture and copy the rendered window into it
+    GLTexture tex(GL_RGBA8, sw, sh);
+    tex.setFilter(GL_LINEAR);
+    tex.setWrapMode(GL_CLAMP_TO_EDGE);
+    tex.bind();
+
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, m_offscreenTex->height() - sh, sw, sh);
+
+    // Set up the shader for horizontal scaling, the kernel was created last
+    createOffsets(kernelWidth, sw, Qt::Horizontal);
+
+    ShaderManager::instance()->pushShader(m_shader.data());
+    m_shader->setUniform(GLShader::ModelViewProjectionMatrix, modelViewProjectionMatrix);
+    setUniforms();
+
+    // Draw the window back into the FBO, this time scaled horizontally. The vertical
+    // pass needs the rows around the target rows, which are all rendered.
+    scissor(QRect(targetRect.x(), renderRect.y(), targetRect.width(), renderRect.height()));
+    glClear(GL_COLOR_BUFFER_BIT);
+    QVector<float> verts;
+    QVector<float> texCoords;
+    verts.reserve(12);
+    texCoords.reserve(12);
+
+    texCoords << 1.0 << 0.0; verts << tw  << 0.0; // Top right
+    texCoords << 0.0 << 0.0; verts << 0.0 << 0.0; // Top left
+    texCoords << 0.0 << 1.0; verts << 0.0 << sh;  // Bottom left
+    texCoords << 0.0 << 1.0; verts << 0.0 << sh;  // Bottom left
+    texCoords << 1.0 << 1.0; verts << tw  << sh;  // Bottom right
+    texCoords << 1.0 << 0.0; verts << tw  << 0.0; // Top right
+    GLVertexBuffer *vbo = GLVertexBuffer::streamingBuffer();
+    vbo->reset();
+    vbo->setData(6, 2, verts.constData(), texCoords.constData());
+    vbo->render(GL_TRIANGLES);
+
+    // At this point we don't need the scratch texture anymore
+    tex.unbind();
+    tex.discard();
+
+    // create scratch texture for second rendering pass
+    GLTexture tex2(GL_RGBA8, tw, sh);
+    tex2.setFilter(GL_LINEAR);
+    tex2.setWrapMode(GL_CLAMP_TO_EDGE);
+    tex2.bind();
+
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, m_offscreenTex->height() - sh, tw, sh);
+
+    // Set up the shader for vertical scaling
+    int kernelSize;
+    createKernel(dy, &kernelSize);
+    createOffsets(kernelSize, m_offscreenTex->height(), Qt::Vertical);
+    setUniforms();
+
+    // Now draw the horizontally scaled window in the FBO at the right
+    // coordinates on the screen, while scaling it vertically and blending it.
+    scissor(targetRect);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    verts.clear();
+
+    verts << tw  << 0.0; // Top right
+    verts << 0.0 << 0.0; // Top left
+    verts << 0.0 << th;  // Bottom left
+    verts << 0.0 << th;  // Bottom left
+    verts << tw  << th;  // Bottom right
+    verts << tw  << 0.0; // Top right
+    vbo->setData(6, 2, verts.constData(), texCoords.constData());
+    vbo->render(GL_TRIANGLES);
+
+    tex2.unbind();
+    tex2.discard();
+    ShaderManager::instance()->popShader();
+    glDisable(GL_SCISSOR_TEST);
+
+    // update the filtered part of the cache texture
+    entry.texture->bind();
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0,
+                        targetRect.x(), th - targetRect.y() - targetRect.height(),
+                        targetRect.x(), m_offscreenTex->height() - targetRect.y() - targetRect.height(),
+                        targetRect.width(), targetRect.height());
+    entry.texture->unbind();
+    GLRenderTarget::popRenderTarget();
+}
+
+void LanczosFilter::paintCache(GLTexture *texture, const QRegion &region, const WindowPaintData &data, const QRect &textureRect, bool hardwareClipping)
+{
+    texture->bind();
+    if (hardwareClipping) {
+        glEnable(GL_SCISSOR_TEST);
+    }
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    const qreal rgb = data.brightness() * data.opacity();
+    const qreal a = data.opacity();
 
-            ShaderBinder binder(ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation);
-            GLShader *shader = binder.shader();
-            QMatrix4x4 mvp = data.screenProjectionMatrix();
-            mvp.translate(textureRect.x(), textureRect.y());
-            shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
-            shader->setUniform(GLShader::ModulationConstant, QVector4D(rgb, rgb, rgb, a));
-            shader->setUniform(GLShader::Saturation, data.saturation());
+    ShaderBinder binder(ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation);
+    GLShader *shader = binder.shader();
+    QMatrix4x4 mvp = data.screenProjectionMatrix();
+    mvp.translate(textureRect.x(), textureRect.y());
+    shader->setUniform(GLShader::ModelViewProjectionMatrix, mvp);
+    shader->setUniform(GLShader::ModulationConstant, QVector4D(rgb, rgb, rgb, a));
+    shader->setUniform(GLShader::Saturation, data.saturation());
 
-            cache->render(region, textureRect, hardwareClipping);
+    texture->render(region, textureRect, hardwareClipping);
 
-            glDisable(GL_BLEND);
+    glDisable(GL_BLEND);
+    if (hardwareClipping) {
+        glDisable(GL_SCISSOR_TEST);
+    }
+    texture->unbind();
+}
+
+void LanczosFilter::scissor(const QRect &rect)
+{
+    // the offscreen FBO is drawn with the origin at the top left
+    glScissor(rect.x(), m_offscreenTex->height() - rect.y() - rect.height(), rect.width(), rect.height());
+}
 
-            if (hardwareClipping) {
-                glDisable(GL_SCISSOR_TEST);
+LanczosFilter::CacheEntry &LanczosFilter::cacheEntry(EffectWindow *w, const QSize &size)
+{
+    auto it = m_cache.find(w);
+    if (it != m_cache.end()) {
+        for (CacheEntry &entry : *it) {
+            if (entry.texture->size() == size) {
+                entry.lastUse = ++m_useCounter;
+                return entry;
             }
+        }
+    }
 
-            cache->unbind();
-            w->setData(LanczosCacheRole, QVariant::fromValue(static_cast<void*>(cache)));
+    const qint64 required = qint64(size.width()) * size.height() * 4;
+    evictCache(required);
+    it = m_cache.find(w);
+    if (it == m_cache.end()) {
+        it = m_cache.insert(w, QVector<CacheEntry>());
+        connect(w, &QObject::destroyed, this, [this, w] { discardCache(w); });
+    }
+    CacheEntry entry;
+    entry.texture = new GLTexture(GL_RGBA8, size.width(), size.height());
+    entry.texture->setFilter(GL_LINEAR);
+    entry.texture->setWrapMode(GL_CLAMP_TO_EDGE);
+    entry.lastUse = ++m_useCounter;
+    it->append(entry);
+    m_cacheMemory += required;
+    return it->last();
+}
 
-            // Delete the offscreen surface after 5 seconds
-            m_timer.start(5000, this);
-            return;
+void LanczosFilter::addDamage(EffectWindow *w, const QRect &damage)
+{
+    auto it = m_cache.find(w);
+    if (it == m_cache.end()) {
+        return;
+    }
+    // the damage is relative to the buffer, the cache to the expanded geometry
+    const QRect rect = damage.isEmpty() ? QRect(QPoint(0, 0), w->expandedGeometry().size())
+                                        : damage.translated(w->bufferGeometry().topLeft() - w->expandedGeometry().topLeft());
+    for (CacheEntry &entry : *it) {
+        entry.damage |= rect;
+    }
+}
+
+void LanczosFilter::evictCache(qint64 required)
+{
+    const qint64 budget = qint64(options->glScaleCacheSize()) * 1024 * 1024;
+    while (!m_cache.isEmpty() && m_cacheMemory + required > budget) {
+        auto oldestWindow = m_cache.end();
+        int oldestIndex = -1;
+        quint64 oldestUse = std::numeric_limits<quint64>::max();
+        for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+            for (int i = 0; i < it->count(); ++i) {
+                if (it->at(i).lastUse < oldestUse) {
+                    oldestUse = it->at(i).lastUse;
+                    oldestWindow = it;
+                    oldestIndex = i;
+                }
+            }
         }
-    } // if ( effects->compositingType() == KWin::OpenGLCompositing )
-    w->sceneWindow()->performPaint(mask, region, data);
-} // End of function
+        const GLTexture *texture = oldestWindow->at(oldestIndex).texture;
+        m_cacheMemory -= qint64(texture->width()) * texture->height() * 4;
+        delete texture;
+        oldestWindow->remove(oldestIndex);
+        m_cacheEvictions++;
+        if (oldestWindow->isEmpty()) {
+            disconnect(oldestWindow.key(), &QObject::destroyed, this, nullptr);
+            m_cache.erase(oldestWindow);
+        }
+    }
+}
 
 void LanczosFilter::timerEvent(QTimerEvent *event)
 {
@@ -395,18 +488,25 @@ void LanczosFilter::timerEvent(QTimerEvent *event)
         m_offscreenTarget = nullptr;
         m_offscreenTex = nullptr;
 
-        workspace()->forEachToplevel([this](Toplevel *toplevel) {
-            discardCacheTexture(toplevel->effectWindow());
-        });
+        discardAllCaches();
+    }
+}
+
+void LanczosFilter::discardCache(EffectWindow *w)
+{
+    const QVector<CacheEntry> entries = m_cache.take(w);
+    for (const CacheEntry &entry : entries) {
+        m_cacheMemory -= qint64(entry.texture->width()) * entry.texture->height() * 4;
+        delete entry.texture;
     }
 }
 
-void LanczosFilter::discardCacheTexture(EffectWindow *w)
+void LanczosFilter::discardAllCaches()
 {
-    QVariant cachedTextureVariant = w->data(LanczosCacheRole);
-    if (cachedTextureVariant.isValid()) {
-        delete static_cast< GLTexture*>(cachedTextureVariant.value<void*>());
-        w->setData(LanczosCacheRole, QVariant());
+    while (!m_cache.isEmpty()) {
+        EffectWindow *w = m_cache.constBegin().key();
+        disconnect(w, &QObject::destroyed, this, nullptr);
+        discardCache(w);
     }
 }
 
@@ -24,6 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QObject>
 #include <QBasicTimer>
+#include <QHash>
+#include <QRect>
 #include <QVector>
 #include <QVector2D>
 #include <QVector4D>
@@ -38,6 +40,15 @@ class GLTexture;
 class GLRenderTarget;
 class GLShader;
 
+/**
+ * Smoothly scales down windows, e.g. for thumbnails or Present Windows.
+ *
+ * Filtering is expensive, so the result is cached per window and target size. The
+ * cache follows the damage of the windows and only the parts of a cached texture which
+ * depend on damaged parts of the window are filtered again. If the cached textures
+ * exceed the budget configured through Options::glScaleCacheSize the least recently
+ * used ones are dropped.
+ */
 class LanczosFilter : public QObject
 {
     Q_OBJECT
@@ -47,13 +58,47 @@ public:
     ~LanczosFilter() override;
     void performPaint(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data);
 
+    /**
+     * The statistics of the cache since the filter got created.
+     */
+    int cacheHits() const {
+        return m_cacheHits;
+    }
+    qint64 filteredPixels() const {
+        return m_filteredPixels;
+    }
+    int cacheEvictions() const {
+        return m_cacheEvictions;
+    }
+
 protected:
     void timerEvent(QTimerEvent*) override;
 private:
+    struct CacheEntry {
+        GLTexture *texture = nullptr;
+        /**
+         * The size of the unscaled window the texture got filtered from.
+         */
+        QSize sourceSize;
+        /**
+         * The part of the unscaled window which changed since it got filtered.
+         */
+        QRect damage;
+        quint64 lastUse = 0;
+    };
+
     void init();
     void updateOffscreenSurfaces();
     void setUniforms();
-    void discardCacheTexture(EffectWindow *w);
+    void filter(EffectWindowImpl *w, int mask, const WindowPaintData &data, const QPoint &offset, CacheEntry &entry);
+    void paintCache(GLTexture *texture, const QRegion &region, const WindowPaintData &data, const QRect &textureRect, bool hardwareClipping);
+    void scissor(const QRect &rect);
+
+    CacheEntry &cacheEntry(EffectWindow *w, const QSize &size);
+    void addDamage(EffectWindow *w, const QRect &damage);
+    void evictCache(qint64 required);
+    void discardCache(EffectWindow *w);
+    void discardAllCaches();
 
     void createKernel(float delta, int *kernelSize);
     void createOffsets(int count, float width, Qt::Orientation direction);
@@ -66,6 +111,13 @@ private:
     int m_uKernel;
     QVector2D m_offsets[16];
     QVector4D m_kernel[16];
+
+    QHash<EffectWindow *, QVector<CacheEntry>> m_cache;
+    qint64 m_cacheMemory = 0;
+    quint64 m_useCounter = 0;
+    int m_cacheHits = 0;
+    qint64 m_filteredPixels = 0;
+    int m_cacheEvictions = 0;
 };
 
 } // namespace
@@ -27,6 +27,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *********************************************************************/
 #include "scene_opengl.h"
+#include "decoration_atlas.h"
 
 #include "platform.h"
 #include "wayland_server.h"
@@ -316,6 +317,7 @@ SceneOpenGL::SceneOpenGL(OpenGLBackend *backend, QObject *parent)
     , m_backend(backend)
     , m_syncManager(nullptr)
     , m_currentFence(nullptr)
+    , m_decorationAtlas(new DecorationAtlas(this))
 {
     if (m_backend->isFailed()) {
         init_ok = false;
@@ -373,6 +375,10 @@ SceneOpenGL::~SceneOpenGL()
     }
     SceneOpenGL::EffectFrame::cleanup();
 
+    // the atlas texture has to go while the context is still current
+    delete m_decorationAtlas;
+    m_decorationAtlas = nullptr;
+
     delete m_syncManager;
 
     // backend might be still needed for a different scene
@@ -654,32 +660,9 @@ qint64 SceneOpenGL::paint(QRegion damage, QList<Toplevel *> toplevels)
         // trigger start render timer
         m_backend->prepareRenderingFrame();
         for (int i = 0; i < screens()->count(); ++i) {
-            const QRect &geo = screens()->geometry(i);
-            QRegion update;
-            QRegion valid;
-            // prepare rendering makes context current on the output
-            QRegion repaint = m_backend->prepareRenderingForScreen(i);
-            GLVertexBuffer::setVirtualScreenGeometry(geo);
-            GLRenderTarget::setVirtualScreenGeometry(geo);
-            GLVertexBuffer::setVirtualScreenScale(screens()->scale(i));
-            GLRenderTarget::setVirtualScreenScale(screens()->scale(i));
-
-            const GLenum status = glGetGraphicsResetStatus();
-            if (status != GL_NO_ERROR) {
-                handleGraphicsReset(status);
+            if (!paintScreenOutput(i, damage)) {
                 return 0;
             }
-
-            int mask = 0;
-            updateProjectionMatrix();
-            paintScreen(&mask, damage.intersected(geo), repaint, &update, &valid, projectionMatrix(), geo);   // call generic implementation
-            paintCursor();
-
-            GLVertexBuffer::streamingBuffer()->endOfFrame();
-
-            m_backend->endRenderingFrameForScreen(i, valid, update);
-
-            GLVertexBuffer::streamingBuffer()->framePosted();
         }
     } else {
         m_backend->makeCurrent();
@@ -721,6 +704,183 @@ qint64 SceneOpenGL::paint(QRegion damage, QList<Toplevel *> toplevels)
         GLVertexBuffer::streamingBuffer()->framePosted();
     }
 
+    updateFences();
+
+    // do cleanup
+    clearStackingOrder();
+    m_decorationAtlas->frameFinished();
+
+    emit frameRendered();
+
+    return m_backend->renderTime();
+}
+
+qint64 SceneOpenGL::paintOutput(int screenId, QRegion damage, QList<Toplevel *> toplevels)
+{
+    if (!m_backend->perScreenRendering()) {
+        return paint(damage, toplevels);
+    }
+    createStackingOrder(toplevels);
+
+    // trigger start render timer
+    m_backend->prepareRenderingFrame();
+    if (!paintScreenOutput(screenId, damage)) {
+        return 0;
+    }
+
+    updateFences();
+
+    clearStackingOrder();
+    m_decorationAtlas->frameFinished();
+
+    emit frameRendered();
+
+    return m_backend->renderTime();
+}
+
+bool SceneOpenGL::perOutputScheduling() const
+{
+    return m_backend->perOutputScheduling();
+}
+
+qint64 SceneOpenGL::textureUploadBytes() const
+{
+    return m_backend->textureUploadBytes();
+}
+
+qint64 SceneOpenGL::streamedTextureUploadBytes() const
+{
+    return m_backend->streamedTextureUploadBytes();
+}
+
+qreal SceneOpenGL::decorationAtlasOccupancy() const
+{
+    return m_decorationAtlas->occupancy();
+}
+
+int SceneOpenGL::decorationTextureBinds() const
+{
+    return m_decorationAtlas->lastFrameBinds();
+}
+
+static bool isScanoutCandidate(Scene::Window *window, const QRect &screenGeometry, qreal screenScale)
+{
+    Toplevel *toplevel = window->window();
+    KWayland::Server::SurfaceInterface *surface = toplevel->surface();
+    if (!surface || !surface->buffer() || !surface->buffer()->linuxDmabufBuffer()) {
+        return false;
+    }
+    // subsurfaces, decorations and shadows would have to be composited into the buffer
+    if (!surface->childSubSurfaces().isEmpty() || window->shadow()) {
+        return false;
+    }
+    const QRect geometry = toplevel->bufferGeometry();
+    if (toplevel->frameGeometry() != geometry || !screenGeometry.contains(geometry)) {
+        return false;
+    }
+    // planes don't blend and scaling might not be supported
+    if (!window->isOpaque() || surface->scale() != screenScale) {
+        return false;
+    }
+    return surface->buffer()->size() == geometry.size() * screenScale;
+}
+
+QVector<Scene::Window *> SceneOpenGL::scanoutCandidates(int screenId) const
+{
+    QVector<Scene::Window *> candidates;
+    if (static_cast<EffectsHandlerImpl *>(effects)->blocksDirectScanout()) {
+        return candidates;
+    }
+    // the cursor is painted into the composited image
+    if (kwinApp()->platform()->usesSoftwareCursor()) {
+        return candidates;
+    }
+    const QRect geo = screens()->geometry(screenId);
+    const qreal scale = screens()->scale(screenId);
+    // overlays are put above the primary plane, a candidate must not be covered by other windows
+    QRegion covered;
+    const QVector<Scene::Window *> &stacking = stackingOrder();
+    for (auto it = stacking.crbegin(); it != stacking.crend() && candidates.count() < 4; ++it) {
+        Scene::Window *window = *it;
+        Toplevel *toplevel = window->window();
+        if (!window->isVisible() || !toplevel->visibleRect().intersects(geo)) {
+            continue;
+        }
+        if (isScanoutCandidate(window, geo, scale) && !covered.intersects(toplevel->bufferGeometry())) {
+            candidates << window;
+        }
+        covered |= toplevel->visibleRect();
+    }
+    return candidates;
+}
+
+bool SceneOpenGL::paintScreenOutput(int screenId, const QRegion &damage)
+{
+    const QRect &geo = screens()->geometry(screenId);
+
+    const QVector<Scene::Window *> candidates = scanoutCandidates(screenId);
+    QVector<OpenGLBackend::ScanoutCandidate> planeCandidates;
+    planeCandidates.reserve(candidates.count());
+    for (Scene::Window *window : candidates) {
+        planeCandidates.append({window->window()->surface()->buffer(), window->window()->bufferGeometry()});
+    }
+    // a window covering the complete screen can't be covered by other windows
+    if (!planeCandidates.isEmpty() && planeCandidates.first().geometry == geo) {
+        if (m_backend->scanout(screenId, planeCandidates.first())) {
+            for (Scene::Window *window : stackingOrder()) {
+                window->window()->resetRepaints();
+            }
+            m_planeRegions[screenId] = geo;
+            return true;
+        }
+    }
+    const QVector<bool> assigned = m_backend->assignPlanes(screenId, planeCandidates);
+    QVector<Toplevel *> scanoutWindows;
+    QRegion planeRegion;
+    for (int i = 0; i < assigned.count(); ++i) {
+        if (assigned.at(i)) {
+            scanoutWindows << candidates.at(i)->window();
+            planeRegion |= planeCandidates.at(i).geometry;
+        }
+    }
+    // windows which are not shown by a plane anymore have to be composited again
+    const QRegion planeDamage = m_planeRegions.value(screenId) - planeRegion;
+    m_planeRegions[screenId] = planeRegion;
+
+    QRegion update;
+    QRegion valid;
+    // prepare rendering makes context current on the output
+    QRegion repaint = m_backend->prepareRenderingForScreen(screenId);
+    GLVertexBuffer::setVirtualScreenGeometry(geo);
+    GLRenderTarget::setVirtualScreenGeometry(geo);
+    GLVertexBuffer::setVirtualScreenScale(screens()->scale(screenId));
+    GLRenderTarget::setVirtualScreenScale(screens()->scale(screenId));
+
+    const GLenum status = glGetGraphicsResetStatus();
+    if (status != GL_NO_ERROR) {
+        handleGraphicsReset(status);
+        return false;
+    }
+
+    int mask = 0;
+    updateProjectionMatrix();
+    setScanoutWindows(scanoutWindows);
+    paintScreen(&mask, (damage | planeDamage).intersected(geo), repaint, &update, &valid, projectionMatrix(), geo);   // call generic implementation
+    setScanoutWindows(QVector<Toplevel *>());
+    paintCursor();
+    // the new buffers on the planes are only shown with a present
+    update |= planeRegion;
+
+    GLVertexBuffer::streamingBuffer()->endOfFrame();
+
+    m_backend->endRenderingFrameForScreen(screenId, valid, update);
+
+    GLVertexBuffer::streamingBuffer()->framePosted();
+    return true;
+}
+
+void SceneOpenGL::updateFences()
+{
     if (m_currentFence) {
         if (!m_syncManager->updateFences()) {
             qCDebug(KWIN_OPENGL) << "Aborting explicit synchronization with the X command stream.";
@@ -730,10 +890,6 @@ qint64 SceneOpenGL::paint(QRegion damage, QList<Toplevel *> toplevels)
         }
         m_currentFence = nullptr;
     }
-
-    // do cleanup
-    clearStackingOrder();
-    return m_backend->renderTime();
 }
 
 QMatrix4x4 SceneOpenGL::transformation(int mask, const ScreenPaintData &data) const
@@ -897,7 +1053,7 @@ Shadow *SceneOpenGL::createShadow(Toplevel *toplevel)
 
 Decoration::Renderer *SceneOpenGL::createDecorationRenderer(Decoration::DecoratedClientImpl *impl)
 {
-    return new SceneOpenGLDecorationRenderer(impl);
+    return new SceneOpenGLDecorationRenderer(impl, m_decorationAtlas);
 }
 
 bool SceneOpenGL::animationsSupported() const
@@ -975,10 +1131,34 @@ SceneOpenGL2::SceneOpenGL2(OpenGLBackend *backend, QObject *parent)
         return;
     }
 
+    // Prepare the shaders used when painting windows while idle, instead of when a window
+    // or an effect needs them the first time. With the program cache this only loads
+    // the binaries.
+    m_pendingShaders = {
+        ShaderTrait::MapTexture | ShaderTrait::Modulate,
+        ShaderTrait::MapTexture | ShaderTrait::AdjustSaturation,
+        ShaderTrait::MapTexture | ShaderTrait::Modulate | ShaderTrait::AdjustSaturation,
+        ShaderTrait::UniformColor,
+        ShaderTrait::UniformColor | ShaderTrait::Modulate,
+    };
+    QTimer::singleShot(0, this, &SceneOpenGL2::warmUpNextShader);
+
     qCDebug(KWIN_OPENGL) << "OpenGL 2 compositing successfully initialized";
     init_ok = true;
 }
 
+void SceneOpenGL2::warmUpNextShader()
+{
+    if (m_pendingShaders.isEmpty() || !makeOpenGLContextCurrent()) {
+        return;
+    }
+    // one at a time, so that painting a frame is not delayed much
+    ShaderManager::instance()->shader(m_pendingShaders.takeFirst());
+    if (!m_pendingShaders.isEmpty()) {
+        QTimer::singleShot(0, this, &SceneOpenGL2::warmUpNextShader);
+    }
+}
+
 SceneOpenGL2::~SceneOpenGL2()
 {
     if (m_lanczosFilter) {
@@ -1069,6 +1249,21 @@ void SceneOpenGL2::finalDrawWindow(EffectWindowImpl* w, int mask, QRegion region
     performPaintWindow(w, mask, region, data);
 }
 
+int SceneOpenGL2::scaleCacheHits() const
+{
+    return m_lanczosFilter ? m_lanczosFilter->cacheHits() : 0;
+}
+
+qint64 SceneOpenGL2::scaleFilteredPixels() const
+{
+    return m_lanczosFilter ? m_lanczosFilter->filteredPixels() : 0;
+}
+
+int SceneOpenGL2::scaleCacheEvictions() const
+{
+    return m_lanczosFilter ? m_lanczosFilter->cacheEvictions() : 0;
+}
+
 void SceneOpenGL2::performPaintWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data)
 {
     if (mask & PAINT_WINDOW_LANCZOS) {
@@ -1246,6 +1441,31 @@ GLTexture *SceneOpenGL::Window::getDecorationTexture() const
     return nullptr;
 }
 
+void SceneOpenGL::Window::decorationTextureOffsets(const QRect *rects, qreal textureScale, QPoint *offsets, Qt::Orientation *orientations) const
+{
+    const SceneOpenGLDecorationRenderer *renderer = nullptr;
+    if (AbstractClient *client = dynamic_cast<AbstractClient *>(toplevel)) {
+        if (client->isDecorated()) {
+            if (SceneOpenGLDecorationRenderer *clientRenderer = static_cast<SceneOpenGLDecorationRenderer*>(client->decoratedClient()->renderer())) {
+                // the quads need to know where the parts go before they get rendered
+                clientRenderer->updateParts();
+                renderer = clientRenderer;
+            }
+        }
+    } else if (toplevel->isDeleted()) {
+        renderer = static_cast<const SceneOpenGLDecorationRenderer*>(static_cast<Deleted *>(toplevel)->decorationRenderer());
+    }
+    if (!renderer) {
+        Scene::Window::decorationTextureOffsets(rects, textureScale, offsets, orientations);
+        return;
+    }
+    for (int i = 0; i < int(SceneOpenGLDecorationRenderer::DecorationPart::Count); i++) {
+        const auto part = SceneOpenGLDecorationRenderer::DecorationPart(i);
+        offsets[i] = renderer->partRect(part).topLeft();
+        orientations[i] = SceneOpenGLDecorationRenderer::orientation(part);
+    }
+}
+
 WindowPixmap* SceneOpenGL::Window::createWindowPixmap()
 {
     return new OpenGLWindowPixmap(this, m_scene);
@@ -1502,11 +1722,23 @@ void SceneOpenGL2Window::performPaint(int mask, QRegion region, WindowPaintData
             opacity = nodes[i].opacity;
         }
 
-        nodes[i].texture->setFilter(filter);
-        nodes[i].texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        nodes[i].texture->bind();
+        DecorationAtlas *atlas = m_scene->decorationAtlas();
+        bool atlasUnit = false;
+        if (i == DecorationLeaf && nodes[i].texture == atlas->texture()) {
+            // shaders of effects might not sample from the unit of the atlas
+            atlasUnit = shader->setUniform("sampler", DecorationAtlas::textureUnit());
+            atlas->bind(filter, atlasUnit ? DecorationAtlas::textureUnit() : 0);
+        } else {
+            nodes[i].texture->setFilter(filter);
+            nodes[i].texture->setWrapMode(GL_CLAMP_TO_EDGE);
+            nodes[i].texture->bind();
+        }
 
         vbo->draw(region, primitiveType, nodes[i].firstVertex, nodes[i].vertexCount, m_hardwareClipping);
+
+        if (atlasUnit) {
+            shader->setUniform("sampler", 0);
+        }
     }
 
     vbo->unbindArrays();
@@ -2487,11 +2719,13 @@ bool SceneOpenGLShadow::prepareBackend()
     return true;
 }
 
-SceneOpenGLDecorationRenderer::SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client)
+SceneOpenGLDecorationRenderer::SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client, DecorationAtlas *atlas)
     : Renderer(client)
-    , m_texture()
+    , m_atlas(atlas)
+    , m_toplevel(client->client())
 {
     connect(this, &Renderer::renderScheduled, client->client(), static_cast<void (AbstractClient::*)(const QRect&)>(&AbstractClient::addRepaint));
+    connect(atlas, &DecorationAtlas::relocated, this, &SceneOpenGLDecorationRenderer::atlasRelocated);
 }
 
 SceneOpenGLDecorationRenderer::~SceneOpenGLDecorationRenderer()
@@ -2499,27 +2733,103 @@ SceneOpenGLDecorationRenderer::~SceneOpenGLDecorationRenderer()
     if (Scene *scene = Compositor::self()->scene()) {
         scene->makeOpenGLContextCurrent();
     }
+    releaseParts();
+}
+
+GLTexture *SceneOpenGLDecorationRenderer::texture() const
+{
+    if (!m_atlas) {
+        return nullptr;
+    }
+    for (int id : m_parts) {
+        if (id) {
+            return m_atlas->texture();
+        }
+    }
+    return nullptr;
+}
+
+QRect SceneOpenGLDecorationRenderer::partRect(DecorationPart part) const
+{
+    if (!m_atlas) {
+        return QRect();
+    }
+    return m_atlas->rect(m_parts[int(part)]);
 }
 
-// Rotates the given source rect 90° counter-clockwise,
-// and flips it vertically
-static QImage rotate(const QImage &srcImage, const QRect &srcRect)
+void SceneOpenGLDecorationRenderer::updateParts()
 {
-    auto dpr = srcImage.devicePixelRatio();
-    QImage image(srcRect.height() * dpr, srcRect.width() * dpr, srcImage.format());
-    image.setDevicePixelRatio(dpr);
-    const QPoint srcPoint(srcRect.x() * dpr, srcRect.y() * dpr);
+    // the decoration of a closed window cannot be rendered again, its parts stay where they are
+    if (!client()) {
+        return;
+    }
+    if (resizeParts()) {
+        m_renderAll = true;
+    }
+}
 
-    const uint32_t *src = reinterpret_cast<const uint32_t *>(srcImage.bits());
-    uint32_t *dst = reinterpret_cast<uint32_t *>(image.bits());
+bool SceneOpenGLDecorationRenderer::resizeParts()
+{
+    if (!m_atlas) {
+        return false;
+    }
+    QRect rects[int(DecorationPart::Count)];
+    client()->client()->layoutDecorationRects(rects[int(DecorationPart::Left)], rects[int(DecorationPart::Top)],
+                                              rects[int(DecorationPart::Right)], rects[int(DecorationPart::Bottom)]);
+    const qreal scale = client()->client()->screenScale();
+
+    bool changed = false;
+    for (int i = 0; i < int(DecorationPart::Count); i++) {
+        QSize size = rects[i].size() * scale;
+        if (orientation(DecorationPart(i)) == Qt::Vertical) {
+            size.transpose();
+        }
+        if (size == m_partSizes[i]) {
+            continue;
+        }
+        m_atlas->release(m_parts[i]);
+        m_parts[i] = m_atlas->allocate(size);
+        m_partSizes[i] = size;
+        changed = true;
+    }
+    return changed;
+}
+
+void SceneOpenGLDecorationRenderer::releaseParts()
+{
+    for (int i = 0; i < int(DecorationPart::Count); i++) {
+        if (m_atlas) {
+            m_atlas->release(m_parts[i]);
+        }
+        m_parts[i] = 0;
+        m_partSizes[i] = QSize();
+    }
+}
+
+void SceneOpenGLDecorationRenderer::atlasRelocated(bool contentsLost)
+{
+    if (contentsLost) {
+        m_renderAll = true;
+    }
+    // the texture coordinates of the decoration quads changed
+    if (EffectWindowImpl *window = m_toplevel->effectWindow()) {
+        if (Scene::Window *sceneWindow = window->sceneWindow()) {
+            sceneWindow->invalidateQuadsCache();
+        }
+    }
+    m_toplevel->addRepaintFull();
+}
 
-    for (int x = 0; x < image.width(); x++) {
-        const uint32_t *s = src + (srcPoint.y() + x) * srcImage.width() + srcPoint.x();
-        uint32_t *d = dst + x;
+// Mirrors the image at its diagonal, the first row becomes the first column
+static QImage transpose(const QImage &srcImage)
+{
+    QImage image(srcImage.height(), srcImage.width(), srcImage.format());
+    image.setDevicePixelRatio(srcImage.devicePixelRatio());
 
-        for (int y = 0; y < image.height(); y++) {
-            *d = s[y];
-            d += image.width();
+    for (int y = 0; y < srcImage.height(); y++) {
+        const uint32_t *s = reinterpret_cast<const uint32_t *>(srcImage.constScanLine(y));
+        for (int x = 0; x < srcImage.width(); x++) {
+            reinterpret_cast<uint32_t *>(image.scanLine(x))[y] = s[x];
         }
     }
 
@@ -2530,70 +2840,40 @@ void SceneOpenGLDecorationRenderer::render()
 {
     const QRegion scheduled = getScheduled();
     const bool dirty = areImageSizesDirty();
-    if (scheduled.isEmpty() && !dirty) {
+    if (scheduled.isEmpty() && !dirty && !m_renderAll) {
         return;
     }
     if (dirty) {
-        resizeTexture();
+        updateParts();
         resetImageSizesDirty();
     }
 
-    if (!m_texture) {
+    GLTexture *texture = this->texture();
+    if (!texture) {
         // for invalid sizes we get no texture, see BUG 361551
         return;
     }
 
-    QRect left, top, right, bottom;
-    client()->client()->layoutDecorationRects(left, top, right, bottom);
+    QRect rects[int(DecorationPart::Count)];
+    client()->client()->layoutDecorationRects(rects[int(DecorationPart::Left)], rects[int(DecorationPart::Top)],
+                                              rects[int(DecorationPart::Right)], rects[int(DecorationPart::Bottom)]);
 
-    const QRect geometry = dirty ? QRect(QPoint(0, 0), client()->client()->size()) : scheduled.boundingRect();
+    const QRect geometry = m_renderAll ? QRect(QPoint(0, 0), client()->client()->size()) : scheduled.boundingRect();
+    m_renderAll = false;
 
-    auto renderPart = [this](const QRect &geo, const QRect &partRect, const QPoint &offset, bool rotated = false) {
-        if (!geo.isValid()) {
-            return;
+    for (int i = 0; i < int(DecorationPart::Count); i++) {
+        const QRect geo = rects[i].intersected(geometry);
+        if (!geo.isValid() || !m_parts[i]) {
+            continue;
         }
         QImage image = renderToImage(geo);
-        if (rotated) {
+        QPoint offset = (geo.topLeft() - rects[i].topLeft()) * image.devicePixelRatio();
+        if (orientation(DecorationPart(i)) == Qt::Vertical) {
             // TODO: get this done directly when rendering to the image
-            image = rotate(image, QRect(geo.topLeft() - partRect.topLeft(), geo.size()));
+            image = transpose(image);
+            offset = QPoint(offset.y(), offset.x());
         }
-        m_texture->update(image, (geo.topLeft() - partRect.topLeft() + offset) * image.devicePixelRatio());
-    };
-    renderPart(left.intersected(geometry), left, QPoint(0, top.height() + bottom.height() + 2), true);
-    renderPart(top.intersected(geometry), top, QPoint(0, 0));
-    renderPart(right.intersected(geometry), right, QPoint(0, top.height() + bottom.height() + left.width() + 3), true);
-    renderPart(bottom.intersected(geometry), bottom, QPoint(0, top.height() + 1));
-}
-
-static int align(int value, int align)
-{
-    return (value + align - 1) & ~(align - 1);
-}
-
-void SceneOpenGLDecorationRenderer::resizeTexture()
-{
-    QRect left, top, right, bottom;
-    client()->client()->layoutDecorationRects(left, top, right, bottom);
-    QSize size;
-
-    size.rwidth() = qMax(qMax(top.width(), bottom.width()),
-                         qMax(left.height(), right.height()));
-    size.rheight() = top.height() + bottom.height() +
-                     left.width() + right.width() + 3;
-
-    size.rwidth() = align(size.width(), 128);
-
-    size *= client()->client()->screenScale();
-    if (m_texture && m_texture->size() == size)
-        return;
-
-    if (!size.isEmpty()) {
-        m_texture.reset(new GLTexture(GL_RGBA8, size.width(), size.height()));
-        m_texture->setYInverted(true);
-        m_texture->setWrapMode(GL_CLAMP_TO_EDGE);
-        m_texture->clear();
-    } else {
-        m_texture.reset();
+        texture->update(image, partRect(DecorationPart(i)).topLeft() + offset);
     }
 }
 
@@ -2601,6 +2881,7 @@ void SceneOpenGLDecorationRenderer::reparent(Deleted *deleted)
 {
     render();
     Renderer::reparent(deleted);
+    m_toplevel = deleted;
 }
 
 
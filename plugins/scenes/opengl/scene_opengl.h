@@ -30,8 +30,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "decorations/decorationrenderer.h"
 #include "platformsupport/scenes/opengl/backend.h"
 
+#include <QMap>
+#include <QPointer>
+
 namespace KWin
 {
+class DecorationAtlas;
 class LanczosFilter;
 class OpenGLBackend;
 class SyncManager;
@@ -48,6 +52,12 @@ public:
     bool initFailed() const override;
     bool hasPendingFlush() const override;
     qint64 paint(QRegion damage, QList<Toplevel *> windows) override;
+    qint64 paintOutput(int screenId, QRegion damage, QList<Toplevel *> windows) override;
+    bool perOutputScheduling() const override;
+    qint64 textureUploadBytes() const override;
+    qint64 streamedTextureUploadBytes() const override;
+    qreal decorationAtlasOccupancy() const override;
+    int decorationTextureBinds() const override;
     Scene::EffectFrame *createEffectFrame(EffectFrameImpl *frame) override;
     Shadow *createShadow(Toplevel *toplevel) override;
     void screenGeometryChanged(const QSize &size) override;
@@ -78,6 +88,12 @@ public:
     OpenGLBackend *backend() const {
         return m_backend;
     }
+    /**
+     * The texture shared by the decorations of all windows.
+     */
+    DecorationAtlas *decorationAtlas() const {
+        return m_decorationAtlas;
+    }
 
     QVector<QByteArray> openGLPlatformInterfaceExtensions() const override;
 
@@ -100,11 +116,17 @@ protected:
     bool init_ok;
 private:
     bool viewportLimitsMatched(const QSize &size) const;
+    bool paintScreenOutput(int screenId, const QRegion &damage);
+    QVector<Scene::Window *> scanoutCandidates(int screenId) const;
+    void updateFences();
 private:
     bool m_debug;
     OpenGLBackend *m_backend;
     SyncManager *m_syncManager;
     SyncObject *m_currentFence;
+    DecorationAtlas *m_decorationAtlas;
+    // the area of each screen which was shown by hardware planes in the last frame
+    QMap<int, QRegion> m_planeRegions;
 };
 
 class SceneOpenGL2 : public SceneOpenGL
@@ -119,6 +141,10 @@ public:
 
     static bool supported(OpenGLBackend *backend);
 
+    int scaleCacheHits() const override;
+    qint64 scaleFilteredPixels() const override;
+    int scaleCacheEvictions() const override;
+
     QMatrix4x4 projectionMatrix() const override { return m_projectionMatrix; }
     QMatrix4x4 screenProjectionMatrix() const override { return m_screenProjectionMatrix; }
 
@@ -134,9 +160,11 @@ protected:
 private:
     void performPaintWindow(EffectWindowImpl* w, int mask, QRegion region, WindowPaintData& data);
     QMatrix4x4 createProjectionMatrix() const;
+    void warmUpNextShader();
 
 private:
     LanczosFilter *m_lanczosFilter;
+    QVector<ShaderTraits> m_pendingShaders;
     QScopedPointer<GLTexture> m_cursorTexture;
     QMatrix4x4 m_projectionMatrix;
     QMatrix4x4 m_screenProjectionMatrix;
@@ -162,6 +190,7 @@ protected:
 
     QMatrix4x4 transformation(int mask, const WindowPaintData &data) const;
     GLTexture *getDecorationTexture() const;
+    void decorationTextureOffsets(const QRect *rects, qreal textureScale, QPoint *offsets, Qt::Orientation *orientations) const override;
 
 protected:
     SceneOpenGL *m_scene;
@@ -301,22 +330,43 @@ public:
         Bottom,
         Count
     };
-    explicit SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client);
+    explicit SceneOpenGLDecorationRenderer(Decoration::DecoratedClientImpl *client, DecorationAtlas *atlas);
     ~SceneOpenGLDecorationRenderer() override;
 
     void render() override;
     void reparent(Deleted *deleted) override;
 
-    GLTexture *texture() {
-        return m_texture.data();
-    }
-    GLTexture *texture() const {
-        return m_texture.data();
+    /**
+     * The atlas texture holding the decoration, or @c null if there is nothing to show.
+     */
+    GLTexture *texture() const;
+    /**
+     * Makes sure the atlas has room for the decoration parts in their current size.
+     * Does nothing once the renderer got reparented to a Deleted.
+     */
+    void updateParts();
+    /**
+     * Where @p part is stored in texture(), in pixels.
+     */
+    QRect partRect(DecorationPart part) const;
+    /**
+     * The left and right borders are stored transposed, so that they pack into the
+     * shelves of the atlas like the top and bottom borders.
+     */
+    static Qt::Orientation orientation(DecorationPart part) {
+        return part == DecorationPart::Left || part == DecorationPart::Right ? Qt::Vertical : Qt::Horizontal;
     }
 
 private:
-    void resizeTexture();
-    QScopedPointer<GLTexture> m_texture;
+    bool resizeParts();
+    void releaseParts();
+    void atlasRelocated(bool contentsLost);
+
+    QPointer<DecorationAtlas> m_atlas;
+    Toplevel *m_toplevel;
+    int m_parts[int(DecorationPart::Count)] = {};
+    QSize m_partSizes[int(DecorationPart::Count)];
+    bool m_renderAll = true;
 };
 
 inline bool SceneOpenGL::hasPendingFlush() const
@@ -39,6 +39,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // Qt
 #include <QDebug>
 #include <QPainter>
+#include <QThread>
 #include <KDecoration2/Decoration>
 
 #include <cmath>
@@ -66,6 +67,13 @@ SceneQPainter::SceneQPainter(QPainterBackend *backend, QObject *parent)
     , m_backend(backend)
     , m_painter(new QPainter())
 {
+    // KWIN_QPAINTER_THREADS=1 renders each frame on the main thread only
+    const int threads = qEnvironmentVariableIsSet("KWIN_QPAINTER_THREADS")
+        ? qEnvironmentVariableIntValue("KWIN_QPAINTER_THREADS")
+        : qMin(QThread::idealThreadCount(), 4);
+    if (threads > 1) {
+        m_tileRenderer.reset(new QPainterTileRenderer(threads));
+    }
 }
 
 SceneQPainter::~SceneQPainter()
@@ -108,22 +116,7 @@ qint64 SceneQPainter::paint(QRegion damage, QList<Toplevel *> toplevels)
         }
         QRegion overallUpdate;
         for (int i = 0; i < screens()->count(); ++i) {
-            const QRect geometry = screens()->geometry(i);
-            QImage *buffer = m_backend->bufferForScreen(i);
-            if (!buffer || buffer->isNull()) {
-                continue;
-            }
-            m_painter->begin(buffer);
-            m_painter->save();
-            m_painter->setWindow(geometry);
-
-            QRegion updateRegion, validRegion;
-            paintScreen(&mask, damage.intersected(geometry), QRegion(), &updateRegion, &validRegion);
-            overallUpdate = overallUpdate.united(updateRegion);
-            paintCursor();
-
-            m_painter->restore();
-            m_painter->end();
+            overallUpdate = overallUpdate.united(paintScreenOutput(i, &mask, damage));
         }
         m_backend->showOverlay();
         m_backend->present(mask, overallUpdate);
@@ -135,8 +128,14 @@ qint64 SceneQPainter::paint(QRegion damage, QList<Toplevel *> toplevels)
             mask |= Scene::PAINT_SCREEN_BACKGROUND_FIRST;
             damage = screens()->geometry();
         }
+        if (m_tileRenderer) {
+            m_tileRenderer->begin(m_backend->buffer(), m_painter.data());
+        }
         QRegion updateRegion, validRegion;
         paintScreen(&mask, damage, QRegion(), &updateRegion, &validRegion);
+        if (m_tileRenderer) {
+            m_tileRenderer->end();
+        }
 
         paintCursor();
         m_backend->showOverlay();
@@ -153,14 +152,96 @@ qint64 SceneQPainter::paint(QRegion damage, QList<Toplevel *> toplevels)
     return renderTimer.nsecsElapsed();
 }
 
+qint64 SceneQPainter::paintOutput(int screenId, QRegion damage, QList<Toplevel *> toplevels)
+{
+    if (!m_backend->perScreenRendering()) {
+        return paint(damage, toplevels);
+    }
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+
+    createStackingOrder(toplevels);
+
+    int mask = 0;
+    m_backend->prepareRenderingForScreen(screenId);
+    if (m_backend->needsFullRepaint()) {
+        mask |= Scene::PAINT_SCREEN_BACKGROUND_FIRST;
+        damage = screens()->geometry(screenId);
+    }
+    const QRegion updateRegion = paintScreenOutput(screenId, &mask, damage);
+    m_backend->showOverlay();
+    m_backend->presentScreen(screenId, mask, updateRegion);
+
+    clearStackingOrder();
+
+    emit frameRendered();
+
+    return renderTimer.nsecsElapsed();
+}
+
+bool SceneQPainter::perOutputScheduling() const
+{
+    return m_backend->perOutputScheduling();
+}
+
+QRegion SceneQPainter::paintScreenOutput(int screenId, int *mask, const QRegion &damage)
+{
+    const QRect geometry = screens()->geometry(screenId);
+    QImage *buffer = m_backend->bufferForScreen(screenId);
+    if (!buffer || buffer->isNull()) {
+        return QRegion();
+    }
+    m_painter->begin(buffer);
+    m_painter->save();
+    m_painter->setWindow(geometry);
+    if (m_tileRenderer) {
+        m_tileRenderer->begin(buffer, m_painter.data());
+    }
+
+    QRegion updateRegion, validRegion;
+    paintScreen(mask, damage.intersected(geometry), QRegion(), &updateRegion, &validRegion);
+    if (m_tileRenderer) {
+        m_tileRenderer->end();
+    }
+    paintCursor();
+
+    m_painter->restore();
+    m_painter->end();
+    return updateRegion;
+}
+
 void SceneQPainter::paintBackground(QRegion region)
 {
+    if (m_tileRenderer && m_tileRenderer->isRecording()) {
+        for (const QRect &rect : region) {
+            m_tileRenderer->drawRect(rect, Qt::black);
+        }
+        return;
+    }
     m_painter->setBrush(Qt::black);
     for (const QRect &rect : region) {
         m_painter->drawRect(rect);
     }
 }
 
+QPainter *SceneQPainter::scenePainter() const
+{
+    // whoever paints directly has to paint on top of the recorded windows
+    if (m_tileRenderer) {
+        m_tileRenderer->flush();
+    }
+    return m_painter.data();
+}
+
+void SceneQPainter::drawImage(QPainter *painter, const QRectF &target, const QImage &image, const QRectF &source)
+{
+    if (m_tileRenderer && m_tileRenderer->isRecording() && painter == m_painter.data()) {
+        m_tileRenderer->drawImage(target, image, source);
+    } else {
+        painter->drawImage(target, image, source);
+    }
+}
+
 void SceneQPainter::paintCursor()
 {
     if (!kwinApp()->platform()->usesSoftwareCursor()) {
@@ -225,21 +306,22 @@ SceneQPainter::Window::~Window()
 {
 }
 
-static void paintSubSurface(QPainter *painter, const QPoint &pos, QPainterWindowPixmap *pixmap)
+static void paintSubSurface(SceneQPainter *scene, QPainter *painter, const QPoint &pos, QPainterWindowPixmap *pixmap)
 {
     QPoint p = pos;
     if (!pixmap->subSurface().isNull()) {
         p += pixmap->subSurface()->position();
     }
 
-    painter->drawImage(QRect(pos, pixmap->size()), pixmap->image());
+    const QImage &image = pixmap->image();
+    scene->drawImage(painter, QRect(pos, pixmap->size()), image, image.rect());
     const auto &children = pixmap->children();
     for (auto it = children.begin(); it != children.end(); ++it) {
         auto pixmap = static_cast<QPainterWindowPixmap*>(*it);
         if (pixmap->subSurface().isNull() || pixmap->subSurface()->surface().isNull() || !pixmap->subSurface()->surface()->isMapped()) {
             continue;
         }
-        paintSubSurface(painter, p, pixmap);
+        paintSubSurface(scene, painter, p, pixmap);
     }
 }
 
@@ -259,7 +341,8 @@ void SceneQPainter::Window::performPaint(int mask, QRegion region, WindowPaintDa
         toplevel->resetDamage();
     }
 
-    QPainter *scenePainter = m_scene->scenePainter();
+    // not scenePainter(), the window gets recorded when painting with several threads
+    QPainter *scenePainter = m_scene->m_painter.data();
     QPainter *painter = scenePainter;
     painter->save();
     painter->setClipRegion(region);
@@ -297,7 +380,7 @@ void SceneQPainter::Window::performPaint(int mask, QRegion region, WindowPaintDa
         source = pixmap->image().rect();
         target = toplevel->bufferGeometry().translated(-pos());
     }
-    painter->drawImage(target, pixmap->image(), source);
+    m_scene->drawImage(painter, target, pixmap->image(), source);
 
     // render subsurfaces
     const auto &children = pixmap->children();
@@ -305,7 +388,7 @@ void SceneQPainter::Window::performPaint(int mask, QRegion region, WindowPaintDa
         if (pixmap->subSurface().isNull() || pixmap->subSurface()->surface().isNull() || !pixmap->subSurface()->surface()->isMapped()) {
             continue;
         }
-        paintSubSurface(painter, bufferOffset(), static_cast<QPainterWindowPixmap*>(pixmap));
+        paintSubSurface(m_scene, painter, bufferOffset(), static_cast<QPainterWindowPixmap*>(pixmap));
     }
 
     if (!opaque) {
@@ -316,7 +399,8 @@ void SceneQPainter::Window::performPaint(int mask, QRegion region, WindowPaintDa
         tempPainter.fillRect(QRect(QPoint(0, 0), toplevel->visibleRect().size()), translucent);
         tempPainter.end();
         painter = scenePainter;
-        painter->drawImage(toplevel->visibleRect().topLeft() - toplevel->frameGeometry().topLeft(), tempImage);
+        m_scene->drawImage(painter, QRect(toplevel->visibleRect().topLeft() - toplevel->frameGeometry().topLeft(), tempImage.size()),
+                           tempImage, tempImage.rect());
     }
 
     painter->restore();
@@ -341,7 +425,7 @@ void SceneQPainter::Window::renderShadow(QPainter* painter)
         QRectF source(topLeft.textureX(), topLeft.textureY(),
                       bottomRight.textureX() - topLeft.textureX(),
                       bottomRight.textureY() - topLeft.textureY());
-        painter->drawImage(target, shadowTexture, source);
+        m_scene->drawImage(painter, target, shadowTexture, source);
     }
 }
 
@@ -375,10 +459,14 @@ void SceneQPainter::Window::renderWindowDecorations(QPainter *painter)
         return;
     }
 
-    painter->drawImage(dtr, renderer->image(SceneQPainterDecorationRenderer::DecorationPart::Top));
-    painter->drawImage(dlr, renderer->image(SceneQPainterDecorationRenderer::DecorationPart::Left));
-    painter->drawImage(drr, renderer->image(SceneQPainterDecorationRenderer::DecorationPart::Right));
-    painter->drawImage(dbr, renderer->image(SceneQPainterDecorationRenderer::DecorationPart::Bottom));
+    const auto drawPart = [this, painter, renderer] (const QRect &rect, SceneQPainterDecorationRenderer::DecorationPart part) {
+        const QImage image = renderer->image(part);
+        m_scene->drawImage(painter, rect, image, image.rect());
+    };
+    drawPart(dtr, SceneQPainterDecorationRenderer::DecorationPart::Top);
+    drawPart(dlr, SceneQPainterDecorationRenderer::DecorationPart::Left);
+    drawPart(drr, SceneQPainterDecorationRenderer::DecorationPart::Right);
+    drawPart(dbr, SceneQPainterDecorationRenderer::DecorationPart::Bottom);
 }
 
 WindowPixmap *SceneQPainter::Window::createWindowPixmap()
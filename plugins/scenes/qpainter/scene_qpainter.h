@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "scene.h"
 #include <platformsupport/scenes/qpainter/backend.h>
 #include "shadow.h"
+#include "tile_renderer.h"
 
 #include "decorations/decorationrenderer.h"
 
@@ -37,6 +38,8 @@ public:
     bool usesOverlayWindow() const override;
     OverlayWindow* overlayWindow() const override;
     qint64 paint(QRegion damage, QList<Toplevel *> windows) override;
+    qint64 paintOutput(int screenId, QRegion damage, QList<Toplevel *> windows) override;
+    bool perOutputScheduling() const override;
     void paintGenericScreen(int mask, ScreenPaintData data) override;
     CompositingType compositingType() const override;
     bool initFailed() const override;
@@ -56,6 +59,12 @@ public:
         return m_backend.data();
     }
 
+    /**
+     * Draws @p image with @p painter. If @p painter is the scene painter and the frame is
+     * rendered by several threads, the call is recorded and only executed on the next flush.
+     */
+    void drawImage(QPainter *painter, const QRectF &target, const QImage &image, const QRectF &source);
+
     static SceneQPainter *createScene(QObject *parent);
 
 protected:
@@ -66,8 +75,10 @@ protected:
 
 private:
     explicit SceneQPainter(QPainterBackend *backend, QObject *parent = nullptr);
+    QRegion paintScreenOutput(int screenId, int *mask, const QRegion &damage);
     QScopedPointer<QPainterBackend> m_backend;
     QScopedPointer<QPainter> m_painter;
+    QScopedPointer<QPainterTileRenderer> m_tileRenderer;
     class Window;
 };
 
@@ -186,12 +197,6 @@ OverlayWindow* SceneQPainter::overlayWindow() const
     return m_backend->overlayWindow();
 }
 
-inline
-QPainter* SceneQPainter::scenePainter() const
-{
-    return m_painter.data();
-}
-
 inline
 const QImage &QPainterWindowPixmap::image()
 {
@@ -0,0 +1,174 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "tile_renderer.h"
+
+#include <QAtomicInt>
+#include <QtConcurrentRun>
+
+namespace KWin
+{
+
+QPainterTileRenderer::QPainterTileRenderer(int threadCount)
+    : m_threadCount(qMax(1, threadCount))
+{
+    // the calling thread renders tiles as well
+    m_pool.setMaxThreadCount(qMax(1, m_threadCount - 1));
+    // don't create new threads for every frame
+    m_pool.setExpiryTimeout(-1);
+}
+
+QPainterTileRenderer::~QPainterTileRenderer()
+{
+    m_pool.waitForDone();
+}
+
+void QPainterTileRenderer::begin(QImage *target, QPainter *painter)
+{
+    m_target = target;
+    m_painter = painter;
+    // the painter is already active, so the image is detached and this is the memory it paints on
+    m_bits = target->bits();
+}
+
+void QPainterTileRenderer::end()
+{
+    flush();
+    m_target = nullptr;
+    m_painter = nullptr;
+    m_bits = nullptr;
+}
+
+void QPainterTileRenderer::drawImage(const QRectF &target, const QImage &image, const QRectF &source)
+{
+    Command command;
+    command.type = Command::Type::Image;
+    command.target = target;
+    command.source = source;
+    command.image = image;
+    record(std::move(command));
+}
+
+void QPainterTileRenderer::drawRect(const QRect &rect, const QColor &color)
+{
+    Command command;
+    command.type = Command::Type::Rect;
+    // the pen draws one pixel right of and below the rect
+    command.target = QRectF(rect.adjusted(0, 0, 1, 1));
+    command.rect = rect;
+    command.color = color;
+    record(std::move(command));
+}
+
+void QPainterTileRenderer::record(Command &&command)
+{
+    const QRect device = m_target->rect();
+    command.transform = m_painter->combinedTransform();
+    if (m_painter->hasClipping()) {
+        command.clip = command.transform.map(m_painter->clipRegion()) & device;
+    } else {
+        command.clip = device;
+    }
+    command.bounds = command.transform.mapRect(command.target).toAlignedRect().adjusted(-1, -1, 1, 1)
+                   & command.clip.boundingRect();
+    if (command.bounds.isEmpty()) {
+        return;
+    }
+    command.opacity = m_painter->opacity();
+    command.hints = m_painter->renderHints();
+    command.compositionMode = m_painter->compositionMode();
+    m_damage += command.bounds;
+    m_commands.append(std::move(command));
+}
+
+void QPainterTileRenderer::flush()
+{
+    if (m_commands.isEmpty()) {
+        return;
+    }
+    const QRect bounds = m_damage.boundingRect();
+    const QRect device = m_target->rect();
+    QVector<QRect> tiles;
+    for (int y = bounds.top() - bounds.top() % s_tileSize; y <= bounds.bottom(); y += s_tileSize) {
+        for (int x = bounds.left() - bounds.left() % s_tileSize; x <= bounds.right(); x += s_tileSize) {
+            const QRect tile = QRect(x, y, s_tileSize, s_tileSize) & device;
+            if (m_damage.intersects(tile)) {
+                tiles << tile;
+            }
+        }
+    }
+
+    QAtomicInt next(0);
+    const auto work = [this, &tiles, &next] {
+        int i;
+        while ((i = next.fetchAndAddRelaxed(1)) < tiles.count()) {
+            renderTile(tiles.at(i));
+        }
+    };
+    QVector<QFuture<void>> workers;
+    const int workerCount = qMin(m_threadCount - 1, tiles.count() - 1);
+    for (int i = 0; i < workerCount; ++i) {
+        workers << QtConcurrent::run(&m_pool, work);
+    }
+    work();
+    for (QFuture<void> &worker : workers) {
+        worker.waitForFinished();
+    }
+
+    m_commands.clear();
+    m_damage = QRegion();
+}
+
+void QPainterTileRenderer::renderTile(const QRect &tile)
+{
+    // a view on the memory of the tile, tiles never share any pixels
+    const int bytesPerPixel = m_target->depth() / 8;
+    QImage view(m_bits + tile.y() * m_target->bytesPerLine() + tile.x() * bytesPerPixel,
+                tile.width(), tile.height(), m_target->bytesPerLine(), m_target->format());
+    QPainter painter(&view);
+    const QTransform offset = QTransform::fromTranslate(-tile.x(), -tile.y());
+    for (const Command &command : qAsConst(m_commands)) {
+        if (!command.bounds.intersects(tile)) {
+            continue;
+        }
+        const QRegion clip = command.clip & tile;
+        if (clip.isEmpty()) {
+            continue;
+        }
+        painter.resetTransform();
+        painter.setClipRegion(clip.translated(-tile.topLeft()));
+        painter.setTransform(command.transform * offset);
+        painter.setOpacity(command.opacity);
+        painter.setRenderHints(painter.renderHints(), false);
+        painter.setRenderHints(command.hints);
+        painter.setCompositionMode(command.compositionMode);
+        switch (command.type) {
+        case Command::Type::Image:
+            painter.drawImage(command.target, command.image, command.source);
+            break;
+        case Command::Type::Rect:
+            painter.setPen(QPen());
+            painter.setBrush(command.color);
+            painter.drawRect(command.rect);
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,118 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_SCENE_QPAINTER_TILE_RENDERER_H
+#define KWIN_SCENE_QPAINTER_TILE_RENDERER_H
+
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRegion>
+#include <QThreadPool>
+#include <QTransform>
+#include <QVector>
+
+namespace KWin
+{
+
+/**
+ * @brief Rasterises the windows of a frame on several threads.
+ *
+ * While the scene is painting, the draw calls for window contents, decorations, shadows
+ * and the background are recorded together with the transformation and clip of the scene
+ * painter instead of being executed. The recorded images are implicitly shared copies, so
+ * the commands keep a frozen snapshot of the window pixmaps.
+ *
+ * On flush() the target image is split into tiles. Each tile gets its own QPainter on the
+ * memory of the tile and replays the commands intersecting it. The tiles are distributed
+ * between the worker threads and the calling thread, flush() returns once all of them are
+ * done.
+ *
+ * Anything painting with the scene painter directly, e.g. effects drawing on top of the
+ * windows, has to flush the recorded commands first to keep the painting order.
+ */
+class QPainterTileRenderer
+{
+public:
+    explicit QPainterTileRenderer(int threadCount);
+    ~QPainterTileRenderer();
+
+    int threadCount() const {
+        return m_threadCount;
+    }
+    bool isRecording() const {
+        return m_target != nullptr;
+    }
+
+    /**
+     * Starts recording the draw calls for @p target, which @p painter is active on.
+     */
+    void begin(QImage *target, QPainter *painter);
+    /**
+     * Renders the remaining commands and stops recording.
+     */
+    void end();
+    /**
+     * Renders all recorded commands into the target and waits for the tiles to finish.
+     */
+    void flush();
+
+    void drawImage(const QRectF &target, const QImage &image, const QRectF &source);
+    void drawRect(const QRect &rect, const QColor &color);
+
+    static const int s_tileSize = 256;
+
+private:
+    struct Command {
+        enum class Type {
+            Image,
+            Rect
+        };
+        Type type;
+        QTransform transform;
+        /**
+         * The clip in device coordinates, the complete target if the painter doesn't clip.
+         */
+        QRegion clip;
+        QRect bounds;
+        qreal opacity;
+        QPainter::RenderHints hints;
+        QPainter::CompositionMode compositionMode;
+        QRectF target;
+        QRectF source;
+        QImage image;
+        QRect rect;
+        QColor color;
+    };
+
+    void record(Command &&command);
+    void renderTile(const QRect &tile);
+
+    QThreadPool m_pool;
+    int m_threadCount;
+    QImage *m_target = nullptr;
+    QPainter *m_painter = nullptr;
+    uchar *m_bits = nullptr;
+    QRegion m_damage;
+    QVector<Command> m_commands;
+};
+
+}
+
+#endif
@@ -270,8 +270,8 @@ void PointerInputRedirection::processMotion(const QPointF &pos, const QSizeF &de
     event.setModifiersRelevantForGlobalShortcuts(input()->modifiersRelevantForGlobalShortcuts());
 
     update();
-    input()->processSpies(std::bind(&InputEventSpy::pointerEvent, std::placeholders::_1, &event));
-    input()->processFilters(std::bind(&InputEventFilter::pointerEvent, std::placeholders::_1, &event, 0));
+    input()->processSpies(InputEventType::PointerMotion, std::bind(&InputEventSpy::pointerEvent, std::placeholders::_1, &event));
+    input()->processFilters(InputEventType::PointerMotion, std::bind(&InputEventFilter::pointerEvent, std::placeholders::_1, &event, 0));
 }
 
 void PointerInputRedirection::processButton(uint32_t button, InputRedirection::PointerButtonState state, uint32_t time, LibInput::Device *device)
@@ -297,13 +297,13 @@ void PointerInputRedirection::processButton(uint32_t button, InputRedirection::P
     event.setModifiersRelevantForGlobalShortcuts(input()->modifiersRelevantForGlobalShortcuts());
     event.setNativeButton(button);
 
-    input()->processSpies(std::bind(&InputEventSpy::pointerEvent, std::placeholders::_1, &event));
+    input()->processSpies(InputEventType::PointerButton, std::bind(&InputEventSpy::pointerEvent, std::placeholders::_1, &event));
 
     if (!inited()) {
         return;
     }
 
-    input()->processFilters(std::bind(&InputEventFilter::pointerEvent, std::placeholders::_1, &event, button));
+    input()->processFilters(InputEventType::PointerButton, std::bind(&InputEventFilter::pointerEvent, std::placeholders::_1, &event, button));
 
     if (state == InputRedirection::PointerButtonReleased) {
         update();
@@ -322,12 +322,12 @@ void PointerInputRedirection::processAxis(InputRedirection::PointerAxis axis, qr
                            m_qtButtons, input()->keyboardModifiers(), source, time, device);
     wheelEvent.setModifiersRelevantForGlobalShortcuts(input()->modifiersRelevantForGlobalShortcuts());
 
-    input()->processSpies(std::bind(&InputEventSpy::wheelEvent, std::placeholders::_1, &wheelEvent));
+    input()->processSpies(InputEventType::PointerAxis, std::bind(&InputEventSpy::wheelEvent, std::placeholders::_1, &wheelEvent));
 
     if (!inited()) {
         return;
     }
-    input()->processFilters(std::bind(&InputEventFilter::wheelEvent, std::placeholders::_1, &wheelEvent));
+    input()->processFilters(InputEventType::PointerAxis, std::bind(&InputEventFilter::wheelEvent, std::placeholders::_1, &wheelEvent));
 }
 
 void PointerInputRedirection::processSwipeGestureBegin(int fingerCount, quint32 time, KWin::LibInput::Device *device)
@@ -337,8 +337,8 @@ void PointerInputRedirection::processSwipeGestureBegin(int fingerCount, quint32
         return;
     }
 
-    input()->processSpies(std::bind(&InputEventSpy::swipeGestureBegin, std::placeholders::_1, fingerCount, time));
-    input()->processFilters(std::bind(&InputEventFilter::swipeGestureBegin, std::placeholders::_1, fingerCount, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::swipeGestureBegin, std::placeholders::_1, fingerCount, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::swipeGestureBegin, std::placeholders::_1, fingerCount, time));
 }
 
 void PointerInputRedirection::processSwipeGestureUpdate(const QSizeF &delta, quint32 time, KWin::LibInput::Device *device)
@@ -349,8 +349,8 @@ void PointerInputRedirection::processSwipeGestureUpdate(const QSizeF &delta, qui
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::swipeGestureUpdate, std::placeholders::_1, delta, time));
-    input()->processFilters(std::bind(&InputEventFilter::swipeGestureUpdate, std::placeholders::_1, delta, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::swipeGestureUpdate, std::placeholders::_1, delta, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::swipeGestureUpdate, std::placeholders::_1, delta, time));
 }
 
 void PointerInputRedirection::processSwipeGestureEnd(quint32 time, KWin::LibInput::Device *device)
@@ -361,8 +361,8 @@ void PointerInputRedirection::processSwipeGestureEnd(quint32 time, KWin::LibInpu
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::swipeGestureEnd, std::placeholders::_1, time));
-    input()->processFilters(std::bind(&InputEventFilter::swipeGestureEnd, std::placeholders::_1, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::swipeGestureEnd, std::placeholders::_1, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::swipeGestureEnd, std::placeholders::_1, time));
 }
 
 void PointerInputRedirection::processSwipeGestureCancelled(quint32 time, KWin::LibInput::Device *device)
@@ -373,8 +373,8 @@ void PointerInputRedirection::processSwipeGestureCancelled(quint32 time, KWin::L
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::swipeGestureCancelled, std::placeholders::_1, time));
-    input()->processFilters(std::bind(&InputEventFilter::swipeGestureCancelled, std::placeholders::_1, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::swipeGestureCancelled, std::placeholders::_1, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::swipeGestureCancelled, std::placeholders::_1, time));
 }
 
 void PointerInputRedirection::processPinchGestureBegin(int fingerCount, quint32 time, KWin::LibInput::Device *device)
@@ -385,8 +385,8 @@ void PointerInputRedirection::processPinchGestureBegin(int fingerCount, quint32
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::pinchGestureBegin, std::placeholders::_1, fingerCount, time));
-    input()->processFilters(std::bind(&InputEventFilter::pinchGestureBegin, std::placeholders::_1, fingerCount, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::pinchGestureBegin, std::placeholders::_1, fingerCount, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::pinchGestureBegin, std::placeholders::_1, fingerCount, time));
 }
 
 void PointerInputRedirection::processPinchGestureUpdate(qreal scale, qreal angleDelta, const QSizeF &delta, quint32 time, KWin::LibInput::Device *device)
@@ -397,8 +397,8 @@ void PointerInputRedirection::processPinchGestureUpdate(qreal scale, qreal angle
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::pinchGestureUpdate, std::placeholders::_1, scale, angleDelta, delta, time));
-    input()->processFilters(std::bind(&InputEventFilter::pinchGestureUpdate, std::placeholders::_1, scale, angleDelta, delta, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::pinchGestureUpdate, std::placeholders::_1, scale, angleDelta, delta, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::pinchGestureUpdate, std::placeholders::_1, scale, angleDelta, delta, time));
 }
 
 void PointerInputRedirection::processPinchGestureEnd(quint32 time, KWin::LibInput::Device *device)
@@ -409,8 +409,8 @@ void PointerInputRedirection::processPinchGestureEnd(quint32 time, KWin::LibInpu
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::pinchGestureEnd, std::placeholders::_1, time));
-    input()->processFilters(std::bind(&InputEventFilter::pinchGestureEnd, std::placeholders::_1, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::pinchGestureEnd, std::placeholders::_1, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::pinchGestureEnd, std::placeholders::_1, time));
 }
 
 void PointerInputRedirection::processPinchGestureCancelled(quint32 time, KWin::LibInput::Device *device)
@@ -421,8 +421,8 @@ void PointerInputRedirection::processPinchGestureCancelled(quint32 time, KWin::L
     }
     update();
 
-    input()->processSpies(std::bind(&InputEventSpy::pinchGestureCancelled, std::placeholders::_1, time));
-    input()->processFilters(std::bind(&InputEventFilter::pinchGestureCancelled, std::placeholders::_1, time));
+    input()->processSpies(InputEventType::Gesture, std::bind(&InputEventSpy::pinchGestureCancelled, std::placeholders::_1, time));
+    input()->processFilters(InputEventType::Gesture, std::bind(&InputEventFilter::pinchGestureCancelled, std::placeholders::_1, time));
 }
 
 bool PointerInputRedirection::areButtonsPressed() const
@@ -30,6 +30,7 @@ namespace KWin
 
 PopupInputFilter::PopupInputFilter()
     : QObject()
+    , InputEventFilter(InputEventType::PointerButton)
 {
     connect(waylandServer(), &WaylandServer::shellClientAdded, this, &PopupInputFilter::handleClientAdded);
 }
@@ -22,13 +22,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <kconfig.h>
 #include <KXMessages>
-#include <QRegExp>
 #include <QTemporaryFile>
 #include <QFile>
 #include <QFileInfo>
 #include <QDebug>
 #include <QDir>
 
+#include <algorithm>
+
 #ifndef KCMRULES
 #include "x11client.h"
 #include "client_machine.h"
@@ -386,13 +387,97 @@ bool Rules::matchType(NET::WindowType match_type) const
     return true;
 }
 
+static bool isHexDigit(QChar c)
+{
+    return (c >= QLatin1Char('0') && c <= QLatin1Char('9'))
+        || (c >= QLatin1Char('a') && c <= QLatin1Char('f'))
+        || (c >= QLatin1Char('A') && c <= QLatin1Char('F'));
+}
+
+static bool isOctalDigit(QChar c)
+{
+    return c >= QLatin1Char('0') && c <= QLatin1Char('7');
+}
+
+// The rules used to be matched with QRegExp. Its syntax is kept for the existing rules by
+// rewriting the constructs PCRE reads differently: \xhhhh takes up to four hex digits and
+// \0ooo up to three octal digits, and $ only matches at the very end of the subject, not
+// before a trailing newline. Constructs QRegExp rejected, like lazy quantifiers or
+// lookbehinds, are passed through; such rules never matched before.
+static QString convertQRegExpPattern(const QString &pattern)
+{
+    QString converted;
+    converted.reserve(pattern.size());
+    bool inCharacterClass = false;
+    for (int i = 0; i < pattern.size(); ++i) {
+        const QChar c = pattern.at(i);
+        if (c == QLatin1Char('\\') && i + 1 < pattern.size()) {
+            const QChar escaped = pattern.at(i + 1);
+            int digits = 0;
+            if (escaped == QLatin1Char('x')) {
+                while (digits < 4 && i + 2 + digits < pattern.size() && isHexDigit(pattern.at(i + 2 + digits))) {
+                    digits++;
+                }
+                if (digits) {
+                    converted += QLatin1String("\\x{");
+                    converted += pattern.midRef(i + 2, digits);
+                    converted += QLatin1Char('}');
+                    i += 1 + digits;
+                    continue;
+                }
+            } else if (escaped == QLatin1Char('0')) {
+                while (digits < 3 && i + 2 + digits < pattern.size() && isOctalDigit(pattern.at(i + 2 + digits))) {
+                    digits++;
+                }
+                converted += QLatin1String("\\o{0");
+                converted += pattern.midRef(i + 2, digits);
+                converted += QLatin1Char('}');
+                i += 1 + digits;
+                continue;
+            }
+            converted += c;
+            converted += escaped;
+            i++;
+            continue;
+        }
+        if (inCharacterClass) {
+            // a ] right after the opening [ or [^ is a literal
+            if (c == QLatin1Char(']') && pattern.at(i - 1) != QLatin1Char('[')
+                    && !(pattern.at(i - 1) == QLatin1Char('^') && pattern.at(i - 2) == QLatin1Char('['))) {
+                inCharacterClass = false;
+            }
+            converted += c;
+        } else if (c == QLatin1Char('[')) {
+            inCharacterClass = true;
+            converted += c;
+        } else if (c == QLatin1Char('$')) {
+            converted += QLatin1String("\\z");
+        } else {
+            converted += c;
+        }
+    }
+    return converted;
+}
+
+bool Rules::matchRegExp(RegExpPattern &compiled, const QString &pattern, const QString &subject)
+{
+    // only compiled again if the pattern changed, e.g. in the rules dialog
+    if (compiled.pattern != pattern) {
+        compiled.pattern = pattern;
+        // \w, \d, \s and \b cover all of Unicode in QRegExp
+        compiled.regExp = QRegularExpression(convertQRegExpPattern(pattern), QRegularExpression::UseUnicodePropertiesOption);
+        compiled.regExp.optimize();
+    }
+    // an invalid pattern doesn't match anything, as with QRegExp
+    return compiled.regExp.isValid() && compiled.regExp.match(subject).hasMatch();
+}
+
 bool Rules::matchWMClass(const QByteArray& match_class, const QByteArray& match_name) const
 {
     if (wmclassmatch != UnimportantMatch) {
-        // TODO optimize?
         QByteArray cwmclass = wmclasscomplete
                               ? match_name + ' ' + match_class : match_class;
-        if (wmclassmatch == RegExpMatch && QRegExp(QString::fromUtf8(wmclass)).indexIn(QString::fromUtf8(cwmclass)) == -1)
+        if (wmclassmatch == RegExpMatch && !matchRegExp(wmclassregexp, QString::fromUtf8(wmclass), QString::fromUtf8(cwmclass)))
             return false;
         if (wmclassmatch == ExactMatch && wmclass != cwmclass)
             return false;
@@ -405,7 +490,7 @@ bool Rules::matchWMClass(const QByteArray& match_class, const QByteArray& match_
 bool Rules::matchRole(const QByteArray& match_role) const
 {
     if (windowrolematch != UnimportantMatch) {
-        if (windowrolematch == RegExpMatch && QRegExp(QString::fromUtf8(windowrole)).indexIn(QString::fromUtf8(match_role)) == -1)
+        if (windowrolematch == RegExpMatch && !matchRegExp(windowroleregexp, QString::fromUtf8(windowrole), QString::fromUtf8(match_role)))
             return false;
         if (windowrolematch == ExactMatch && windowrole != match_role)
             return false;
@@ -418,7 +503,7 @@ bool Rules::matchRole(const QByteArray& match_role) const
 bool Rules::matchTitle(const QString& match_title) const
 {
     if (titlematch != UnimportantMatch) {
-        if (titlematch == RegExpMatch && QRegExp(title).indexIn(match_title) == -1)
+        if (titlematch == RegExpMatch && !matchRegExp(titleregexp, title, match_title))
             return false;
         if (titlematch == ExactMatch && title != match_title)
             return false;
@@ -436,7 +521,7 @@ bool Rules::matchClientMachine(const QByteArray& match_machine, bool local) cons
                 && matchClientMachine("localhost", true))
             return true;
         if (clientmachinematch == RegExpMatch
-                && QRegExp(QString::fromUtf8(clientmachine)).indexIn(QString::fromUtf8(match_machine)) == -1)
+                && !matchRegExp(clientmachineregexp, QString::fromUtf8(clientmachine), QString::fromUtf8(match_machine)))
             return false;
         if (clientmachinematch == ExactMatch
                 && clientmachine != match_machine)
@@ -682,6 +767,14 @@ bool Rules::isTemporary() const
     return temporary_state > 0;
 }
 
+QByteArray Rules::exactWMClass() const
+{
+    if (wmclassmatch != ExactMatch) {
+        return QByteArray();
+    }
+    return wmclass;
+}
+
 bool Rules::discardTemporary(bool force)
 {
     if (temporary_state == 0)   // not temporary
@@ -1010,29 +1103,82 @@ void RuleBook::deleteAll()
 {
     qDeleteAll(m_rules);
     m_rules.clear();
+    m_wmClassIndexDirty = true;
+}
+
+void RuleBook::updateWMClassIndex()
+{
+    m_wmClassIndex.clear();
+    m_unindexedRules.clear();
+    for (int i = 0; i < m_rules.count(); ++i) {
+        const QByteArray wmClass = m_rules.at(i)->exactWMClass();
+        if (wmClass.isEmpty()) {
+            m_unindexedRules.append(i);
+        } else {
+            m_wmClassIndex[wmClass].append(i);
+        }
+    }
+    m_wmClassIndexDirty = false;
 }
 
 WindowRules RuleBook::find(const AbstractClient* c, bool ignore_temporary)
 {
+    if (m_wmClassIndexDirty) {
+        updateWMClassIndex();
+    }
+    // Rules requiring another window class are skipped without evaluating them. A rule
+    // can match either the class or the complete class including the name of the window.
+    static const QVector<int> s_noRules;
+    auto indexedRules = [this](const QByteArray &wmClass) -> const QVector<int>& {
+        const auto it = m_wmClassIndex.constFind(wmClass);
+        return it != m_wmClassIndex.constEnd() ? *it : s_noRules;
+    };
+    const QVector<int> *candidates[] = {
+        &m_unindexedRules,
+        &indexedRules(c->resourceClass()),
+        &indexedRules(c->resourceName() + ' ' + c->resourceClass())
+    };
+    // the lists are sorted, walking them side by side keeps the rule book order
+    QVector<int>::const_iterator positions[] = {
+        candidates[0]->constBegin(),
+        candidates[1]->constBegin(),
+        candidates[2]->constBegin()
+    };
+
     QVector< Rules* > ret;
-    for (QList< Rules* >::Iterator it = m_rules.begin();
-            it != m_rules.end();
-       ) {
-        if (ignore_temporary && (*it)->isTemporary()) {
-            ++it;
+    QVector<int> used;
+    while (true) {
+        int index = m_rules.count();
+        for (int i = 0; i < 3; ++i) {
+            if (positions[i] != candidates[i]->constEnd()) {
+                index = std::min(index, *positions[i]);
+            }
+        }
+        if (index == m_rules.count()) {
+            break;
+        }
+        for (int i = 0; i < 3; ++i) {
+            if (positions[i] != candidates[i]->constEnd() && *positions[i] == index) {
+                ++positions[i];
+            }
+        }
+        Rules* rule = m_rules.at(index);
+        if (ignore_temporary && rule->isTemporary()) {
             continue;
         }
-        if ((*it)->match(c)) {
-            Rules* rule = *it;
+        if (rule->match(c)) {
             qCDebug(KWIN_CORE) << "Rule found:" << rule << ":" << c;
             if (rule->isTemporary())
-                it = m_rules.erase(it);
-            else
-                ++it;
+                used.append(index);
             ret.append(rule);
-            continue;
         }
-        ++it;
+    }
+    // temporary rules are only applied once
+    for (auto it = used.crbegin(); it != used.crend(); ++it) {
+        m_rules.removeAt(*it);
+    }
+    if (!used.isEmpty()) {
+        m_wmClassIndexDirty = true;
     }
     return WindowRules(ret);
 }
@@ -1077,6 +1223,7 @@ void RuleBook::load()
         Rules* rule = new Rules(cg);
         m_rules.append(rule);
     }
+    m_wmClassIndexDirty = true;
 }
 
 void RuleBook::save()
@@ -1115,6 +1262,7 @@ void RuleBook::temporaryRulesMessage(const QString& message)
             was_temporary = true;
     Rules* rule = new Rules(message, true);
     m_rules.prepend(rule);   // highest priority first
+    m_wmClassIndexDirty = true;
     if (!was_temporary)
         QTimer::singleShot(60000, this, SLOT(cleanupTemporaryRules()));
 }
@@ -1127,6 +1275,7 @@ void RuleBook::cleanupTemporaryRules()
        ) {
         if ((*it)->discardTemporary(false)) { // deletes (*it)
             it = m_rules.erase(it);
+            m_wmClassIndexDirty = true;
         } else {
             if ((*it)->isTemporary())
                 has_temporary = true;
@@ -1151,6 +1300,7 @@ void RuleBook::discardUsed(AbstractClient* c, bool withdrawn)
                 c->removeRule(*it);
                 Rules* r = *it;
                 it = m_rules.erase(it);
+                m_wmClassIndexDirty = true;
                 delete r;
                 continue;
             }
@@ -23,7 +23,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <netwm_def.h>
+#include <QHash>
 #include <QRect>
+#include <QRegularExpression>
 #include <QVector>
 #include <kconfiggroup.h>
 
@@ -137,6 +139,11 @@ public:
     bool match(const AbstractClient* c) const;
     bool update(AbstractClient*, int selection);
     bool isTemporary() const;
+    /**
+     * The window class a window must have exactly for this rule to match,
+     * or an empty array if the rule can match any window class.
+     */
+    QByteArray exactWMClass() const;
     bool discardTemporary(bool force);   // removes if temporary and forced or too old
     bool applyPlacement(Placement::Policy& placement) const;
     bool applyGeometry(QRect& rect, bool init) const;
@@ -191,6 +198,12 @@ private:
         UnusedForceRule = Unused,
         ForceRuleDummy = 256   // so that it's at least short int
     };
+    // a pattern together with its compiled expression, compiled on the first match
+    struct RegExpPattern {
+        QString pattern;
+        QRegularExpression regExp;
+    };
+    static bool matchRegExp(RegExpPattern &compiled, const QString &pattern, const QString &subject);
     void readFromCfg(const KConfigGroup& cfg);
     static SetRule readSetRule(const KConfigGroup&, const QString& key);
     static ForceRule readForceRule(const KConfigGroup&, const QString& key);
@@ -214,6 +227,11 @@ private:
     QByteArray clientmachine;
     StringMatch clientmachinematch;
     NET::WindowTypes types; // types for matching
+    // so that matching doesn't need to parse the patterns
+    mutable RegExpPattern wmclassregexp;
+    mutable RegExpPattern windowroleregexp;
+    mutable RegExpPattern titleregexp;
+    mutable RegExpPattern clientmachineregexp;
     Placement::Policy placement;
     ForceRule placementrule;
     QPoint position;
@@ -315,9 +333,15 @@ private Q_SLOTS:
 private:
     void deleteAll();
     void initWithX11();
+    void updateWMClassIndex();
     QTimer *m_updateTimer;
     bool m_updatesDisabled;
     QList<Rules*> m_rules;
+    // positions in m_rules of the rules requiring an exact window class, and of all others,
+    // each list in ascending order
+    QHash<QByteArray, QVector<int>> m_wmClassIndex;
+    QVector<int> m_unindexedRules;
+    bool m_wmClassIndexDirty = true;
     QScopedPointer<KXMessages> m_temporaryRulesMessages;
     KSharedConfig::Ptr m_config;
 
@@ -300,6 +300,12 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
         if (!window->isPaintingEnabled()) {
             continue;
         }
+        if (m_scanoutWindows.contains(toplevel)) {
+            // shown by a plane on top of the composited image, only occludes the windows below
+            data.paint = QRegion();
+            data.clip = toplevel->bufferGeometry();
+            data.mask = (data.mask & ~PAINT_WINDOW_TRANSLUCENT) | PAINT_WINDOW_OPAQUE;
+        }
         dirtyArea |= data.paint;
         // Schedule the window for painting
         phase2data.append({ window, data.paint, data.clip, data.mask, data.quads });
@@ -360,6 +366,9 @@ void Scene::paintSimpleScreen(int orig_mask, QRegion region)
     // Now walk the list bottom to top and draw the windows.
     for (int i = 0; i < phase2data.count(); ++i) {
         Phase2Data *data = &phase2data[i];
+        if (m_scanoutWindows.contains(data->window->window())) {
+            continue;
+        }
 
         // add all regions which have been drawn so far
         paintedArea |= data->region;
@@ -634,6 +643,52 @@ bool Scene::hasSwapEvent() const
     return false;
 }
 
+qint64 Scene::textureUploadBytes() const
+{
+    return 0;
+}
+
+qint64 Scene::streamedTextureUploadBytes() const
+{
+    return 0;
+}
+
+qreal Scene::decorationAtlasOccupancy() const
+{
+    return 0;
+}
+
+int Scene::decorationTextureBinds() const
+{
+    return 0;
+}
+
+int Scene::scaleCacheHits() const
+{
+    return 0;
+}
+
+qint64 Scene::scaleFilteredPixels() const
+{
+    return 0;
+}
+
+int Scene::scaleCacheEvictions() const
+{
+    return 0;
+}
+
+qint64 Scene::paintOutput(int screenId, QRegion damage, QList<Toplevel *> windows)
+{
+    Q_UNUSED(screenId)
+    return paint(damage, windows);
+}
+
+bool Scene::perOutputScheduling() const
+{
+    return false;
+}
+
 bool Scene::makeOpenGLContextCurrent()
 {
     return false;
@@ -892,19 +947,9 @@ WindowQuadList Scene::Window::makeDecorationQuads(const QRect *rects, const QReg
 {
     WindowQuadList list;
 
-    const QPoint offsets[4] = {
-        QPoint(-rects[0].x() + rects[1].height() + rects[3].height() + 2, -rects[0].y()),                    // Left
-        QPoint(-rects[1].x(), -rects[1].y()),                                                                // Top
-        QPoint(-rects[2].x() + rects[1].height() + rects[3].height() + rects[0].width() + 3, -rects[2].y()), // Right
-        QPoint(-rects[3].x(), -rects[3].y() + rects[1].height() + 1)                                         // Bottom
-    };
-
-    const Qt::Orientation orientations[4] = {
-        Qt::Vertical,   // Left
-        Qt::Horizontal, // Top
-        Qt::Vertical,   // Right
-        Qt::Horizontal, // Bottom
-    };
+    QPoint offsets[4];
+    Qt::Orientation orientations[4];
+    decorationTextureOffsets(rects, textureScale, offsets, orientations);
 
     for (int i = 0; i < 4; i++) {
         const QRegion intersectedRegion = (region & rects[i]);
@@ -912,31 +957,34 @@ WindowQuadList Scene::Window::makeDecorationQuads(const QRect *rects, const QReg
             if (!r.isValid())
                 continue;
 
-            const bool swap = orientations[i] == Qt::Vertical;
-
             const int x0 = r.x();
             const int y0 = r.y();
             const int x1 = r.x() + r.width();
             const int y1 = r.y() + r.height();
 
-            const int u0 = (x0 + offsets[i].x()) * textureScale;
-            const int v0 = (y0 + offsets[i].y()) * textureScale;
-            const int u1 = (x1 + offsets[i].x()) * textureScale;
-            const int v1 = (y1 + offsets[i].y()) * textureScale;
+            const bool swap = orientations[i] == Qt::Vertical;
+
+            // u runs along the x axis of the window, v along its y axis
+            const int u0 = (x0 - rects[i].x()) * textureScale;
+            const int v0 = (y0 - rects[i].y()) * textureScale;
+            const int u1 = (x1 - rects[i].x()) * textureScale;
+            const int v1 = (y1 - rects[i].y()) * textureScale;
+            const int s = offsets[i].x();
+            const int t = offsets[i].y();
 
             WindowQuad quad(WindowQuadDecoration);
             quad.setUVAxisSwapped(swap);
 
             if (swap) {
-                quad[0] = WindowVertex(x0, y0, v0, u0); // Top-left
-                quad[1] = WindowVertex(x1, y0, v0, u1); // Top-right
-                quad[2] = WindowVertex(x1, y1, v1, u1); // Bottom-right
-                quad[3] = WindowVertex(x0, y1, v1, u0); // Bottom-left
+                quad[0] = WindowVertex(x0, y0, s + v0, t + u0); // Top-left
+                quad[1] = WindowVertex(x1, y0, s + v0, t + u1); // Top-right
+                quad[2] = WindowVertex(x1, y1, s + v1, t + u1); // Bottom-right
+                quad[3] = WindowVertex(x0, y1, s + v1, t + u0); // Bottom-left
             } else {
-                quad[0] = WindowVertex(x0, y0, u0, v0); // Top-left
-                quad[1] = WindowVertex(x1, y0, u1, v0); // Top-right
-                quad[2] = WindowVertex(x1, y1, u1, v1); // Bottom-right
-                quad[3] = WindowVertex(x0, y1, u0, v1); // Bottom-left
+                quad[0] = WindowVertex(x0, y0, s + u0, t + v0); // Top-left
+                quad[1] = WindowVertex(x1, y0, s + u1, t + v0); // Top-right
+                quad[2] = WindowVertex(x1, y1, s + u1, t + v1); // Bottom-right
+                quad[3] = WindowVertex(x0, y1, s + u0, t + v1); // Bottom-left
             }
 
             list.append(quad);
@@ -946,6 +994,14 @@ WindowQuadList Scene::Window::makeDecorationQuads(const QRect *rects, const QReg
     return list;
 }
 
+void Scene::Window::decorationTextureOffsets(const QRect *rects, qreal textureScale, QPoint *offsets, Qt::Orientation *orientations) const
+{
+    for (int i = 0; i < 4; i++) {
+        offsets[i] = rects[i].topLeft() * textureScale;
+        orientations[i] = Qt::Horizontal;
+    }
+}
+
 WindowQuadList Scene::Window::makeContentsQuads() const
 {
     const QRegion contentsRegion = clientShape();
@@ -78,6 +78,55 @@ public:
     // ie. "what of this frame is lost to painting"
     virtual qint64 paint(QRegion damage, QList<Toplevel *> windows) = 0;
 
+    /**
+     * Repaints only the screen with @p screenId, used if perOutputScheduling is supported.
+     * Default implementation repaints all screens.
+     * @param screenId The id of the screen as used in Screens
+     */
+    virtual qint64 paintOutput(int screenId, QRegion damage, QList<Toplevel *> windows);
+    /**
+     * Whether the outputs can be repainted independently of each other, each at
+     * its own refresh rate. Default implementation returns @c false.
+     */
+    virtual bool perOutputScheduling() const;
+    /**
+     * The number of bytes of pixel data uploaded into window textures since the scene got
+     * created. Comparing the values of two frames gives the upload bandwidth of a frame.
+     * Default implementation returns @c 0.
+     */
+    virtual qint64 textureUploadBytes() const;
+    /**
+     * The part of textureUploadBytes which got streamed through pixel buffers instead of
+     * being uploaded from client memory. Default implementation returns @c 0.
+     */
+    virtual qint64 streamedTextureUploadBytes() const;
+    /**
+     * The fraction of the texture shared by the window decorations which is in use, between
+     * @c 0 and @c 1. Default implementation returns @c 0.
+     */
+    virtual qreal decorationAtlasOccupancy() const;
+    /**
+     * The number of times a decoration texture got bound while painting the last frame.
+     * Default implementation returns @c 0.
+     */
+    virtual int decorationTextureBinds() const;
+    /**
+     * The number of times a smoothly scaled window got painted from the cache without
+     * filtering it again. Default implementation returns @c 0.
+     */
+    virtual int scaleCacheHits() const;
+    /**
+     * The number of scaled pixels the smooth scaling filter produced. Refiltering the
+     * damaged part of a cached window only adds the pixels it touched.
+     * Default implementation returns @c 0.
+     */
+    virtual qint64 scaleFilteredPixels() const;
+    /**
+     * The number of scaled windows dropped from the cache to stay within
+     * Options::glScaleCacheSize. Default implementation returns @c 0.
+     */
+    virtual int scaleCacheEvictions() const;
+
     /**
      * Adds the Toplevel to the Scene.
      *
@@ -238,6 +287,18 @@ protected:
 
     virtual void paintEffectQuickView(EffectQuickView *w) = 0;
 
+    // the windows in their stacking order, bottom most first
+    const QVector<Window *> &stackingOrder() const {
+        return stacking_order;
+    }
+    /**
+     * The @p windows are shown on hardware planes for the next paintScreen. They still
+     * occlude the windows below them, but are not painted.
+     */
+    void setScanoutWindows(const QVector<Toplevel *> &windows) {
+        m_scanoutWindows = windows;
+    }
+
     // compute time since the last repaint
     void updateTimeDiff();
     // saved data for 2nd pass of optimized screen painting
@@ -267,6 +328,7 @@ private:
     QHash< Toplevel*, Window* > m_windows;
     // windows in their stacking order
     QVector< Window* > stacking_order;
+    QVector<Toplevel *> m_scanoutWindows;
 };
 
 /**
@@ -347,6 +409,15 @@ public:
     void invalidateQuadsCache();
 protected:
     WindowQuadList makeDecorationQuads(const QRect *rects, const QRegion &region, qreal textureScale = 1.0) const;
+    /**
+     * Returns where the decoration parts laid out in @p rects (left, top, right and bottom)
+     * are stored in the decoration texture, in texture pixels. Parts with a Qt::Vertical
+     * orientation are stored transposed, their texture axes are swapped.
+     *
+     * Default implementation assumes a texture holding the complete decoration as it is
+     * laid out around the window.
+     */
+    virtual void decorationTextureOffsets(const QRect *rects, qreal textureScale, QPoint *offsets, Qt::Orientation *orientations) const;
     WindowQuadList makeContentsQuads() const;
     /**
      * @brief Returns the WindowPixmap for this Window.
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "scriptedeffect.h"
 #include "meta.h"
+#include "scriptenginepool.h"
 #include "scriptingutils.h"
 #include "workspace_wrapper.h"
 #include "../screens.h"
@@ -31,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <KPluginMetaData>
 // Qt
 #include <QFile>
+#include <QPointer>
 #include <QtScript/QScriptEngine>
 #include <QtScript/QScriptValueIterator>
 #include <QStandardPaths>
@@ -583,15 +585,59 @@ bool ScriptedEffect::supported()
     return effects->animationsSupported();
 }
 
+/**
+ * Installs the bindings shared by all scripted effects into a new engine of the pool.
+ */
+static void installEffectBindings(QScriptEngine *engine)
+{
+    QScriptValue globalObject = engine->globalObject();
+    QScriptValue effectsObject = engine->newQObject(effects, QScriptEngine::QtOwnership, QScriptEngine::ExcludeDeleteLater);
+    globalObject.setProperty(QStringLiteral("effects"), effectsObject, QScriptValue::Undeletable);
+    globalObject.setProperty(QStringLiteral("Effect"), engine->newQMetaObject(&ScriptedEffect::staticMetaObject));
+#ifndef KWIN_UNIT_TEST
+    globalObject.setProperty(QStringLiteral("KWin"), engine->newQMetaObject(&QtScriptWorkspaceWrapper::staticMetaObject));
+#endif
+    globalObject.setProperty(QStringLiteral("Globals"), engine->newQMetaObject(&KWin::staticMetaObject));
+
+    globalObject.setProperty(QStringLiteral("QEasingCurve"), engine->newQMetaObject(&QEasingCurve::staticMetaObject));
+    MetaScripting::registration(engine);
+    qScriptRegisterMetaType<KEffectWindowRef>(engine, effectWindowToScriptValue, effectWindowFromScriptValue);
+    qScriptRegisterMetaType<KWin::FPx2>(engine, fpx2ToScriptValue, fpx2FromScriptValue);
+    qScriptRegisterSequenceMetaType<QList< KWin::EffectWindow* > >(engine);
+    // add our animationTime
+    globalObject.setProperty(QStringLiteral("animationTime"), engine->newFunction(kwinEffectScriptAnimationTime));
+    // add displayWidth and displayHeight
+    globalObject.setProperty(QStringLiteral("displayWidth"), engine->newFunction(kwinEffectDisplayWidth));
+    globalObject.setProperty(QStringLiteral("displayHeight"), engine->newFunction(kwinEffectDisplayHeight));
+}
+
+ScriptEnginePool *ScriptedEffect::enginePool()
+{
+    // the pool goes away together with the effects handler it exposes to the scripts
+    static QPointer<ScriptEnginePool> s_pool;
+    if (!s_pool) {
+        Q_ASSERT(effects);
+        s_pool = new ScriptEnginePool(s_maxEngines, installEffectBindings, effects);
+    }
+    return s_pool;
+}
+
 ScriptedEffect::ScriptedEffect()
     : AnimationEffect()
-    , m_engine(new QScriptEngine(this))
+    , m_enginePool(enginePool())
     , m_scriptFile(QString())
     , m_config(nullptr)
     , m_chainPosition(0)
 {
     Q_ASSERT(effects);
-    connect(m_engine, SIGNAL(signalHandlerException(QScriptValue)), SLOT(signalHandlerException(QScriptValue)));
+    m_scope = m_enginePool->acquire(this);
+    connect(m_enginePool, &ScriptEnginePool::signalHandlerException, this,
+        [this] (const QString &fileName, const QScriptValue &exception) {
+            if (fileName == m_scriptFile) {
+                signalHandlerException(exception);
+            }
+        }
+    );
     connect(effects, &EffectsHandler::activeFullScreenEffectChanged, this, [this]() {
         Effect* fullScreenEffect = effects->activeFullScreenEffect();
         if (fullScreenEffect == m_activeFullScreenEffect) {
@@ -606,6 +652,9 @@ ScriptedEffect::ScriptedEffect()
 
 ScriptedEffect::~ScriptedEffect()
 {
+    if (m_enginePool) {
+        m_enginePool->release(this);
+    }
 }
 
 bool ScriptedEffect::init(const QString &effectName, const QString &pathToScript)
@@ -627,69 +676,50 @@ bool ScriptedEffect::init(const QString &effectName, const QString &pathToScript
         m_config->load();
     }
 
-    QScriptValue effectsObject = m_engine->newQObject(effects, QScriptEngine::QtOwnership, QScriptEngine::ExcludeDeleteLater);
-    m_engine->globalObject().setProperty(QStringLiteral("effects"), effectsObject, QScriptValue::Undeletable);
-    m_engine->globalObject().setProperty(QStringLiteral("Effect"), m_engine->newQMetaObject(&ScriptedEffect::staticMetaObject));
-#ifndef KWIN_UNIT_TEST
-    m_engine->globalObject().setProperty(QStringLiteral("KWin"), m_engine->newQMetaObject(&QtScriptWorkspaceWrapper::staticMetaObject));
-#endif
-    m_engine->globalObject().setProperty(QStringLiteral("Globals"), m_engine->newQMetaObject(&KWin::staticMetaObject));
-
-    m_engine->globalObject().setProperty(QStringLiteral("QEasingCurve"), m_engine->newQMetaObject(&QEasingCurve::staticMetaObject));
-    m_engine->globalObject().setProperty(QStringLiteral("effect"), m_engine->newQObject(this, QScriptEngine::QtOwnership, QScriptEngine::ExcludeDeleteLater), QScriptValue::Undeletable);
-    MetaScripting::registration(m_engine);
-    qScriptRegisterMetaType<KEffectWindowRef>(m_engine, effectWindowToScriptValue, effectWindowFromScriptValue);
-    qScriptRegisterMetaType<KWin::FPx2>(m_engine, fpx2ToScriptValue, fpx2FromScriptValue);
-    qScriptRegisterSequenceMetaType<QList< KWin::EffectWindow* > >(m_engine);
+    // the bindings shared by all effects are already in the engine, only the ones
+    // specific to this effect are added to its scope
+    QScriptEngine *engine = m_scope.engine();
+    m_scope.setProperty(QStringLiteral("effect"), engine->newQObject(this, QScriptEngine::QtOwnership, QScriptEngine::ExcludeDeleteLater), QScriptValue::Undeletable);
     // add our print
-    QScriptValue printFunc = m_engine->newFunction(kwinEffectScriptPrint);
-    printFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("print"), printFunc);
-    // add our animationTime
-    QScriptValue animationTimeFunc = m_engine->newFunction(kwinEffectScriptAnimationTime);
-    animationTimeFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("animationTime"), animationTimeFunc);
-    // add displayWidth and displayHeight
-    QScriptValue displayWidthFunc = m_engine->newFunction(kwinEffectDisplayWidth);
-    m_engine->globalObject().setProperty(QStringLiteral("displayWidth"), displayWidthFunc);
-    QScriptValue displayHeightFunc = m_engine->newFunction(kwinEffectDisplayHeight);
-    m_engine->globalObject().setProperty(QStringLiteral("displayHeight"), displayHeightFunc);
+    QScriptValue printFunc = engine->newFunction(kwinEffectScriptPrint);
+    printFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("print"), printFunc);
     // add global Shortcut
-    registerGlobalShortcutFunction(this, m_engine, kwinScriptGlobalShortcut);
-    registerScreenEdgeFunction(this, m_engine, kwinScriptScreenEdge);
-    registerTouchScreenEdgeFunction(this, m_engine, kwinRegisterTouchScreenEdge);
-    unregisterTouchScreenEdgeFunction(this, m_engine, kwinUnregisterTouchScreenEdge);
+    registerGlobalShortcutFunction(this, m_scope, kwinScriptGlobalShortcut);
+    registerScreenEdgeFunction(this, m_scope, kwinScriptScreenEdge);
+    registerTouchScreenEdgeFunction(this, m_scope, kwinRegisterTouchScreenEdge);
+    unregisterTouchScreenEdgeFunction(this, m_scope, kwinUnregisterTouchScreenEdge);
     // add the animate method
-    QScriptValue animateFunc = m_engine->newFunction(kwinEffectAnimate);
-    animateFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("animate"), animateFunc);
+    QScriptValue animateFunc = engine->newFunction(kwinEffectAnimate);
+    animateFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("animate"), animateFunc);
 
     // and the set variant
-    QScriptValue setFunc = m_engine->newFunction(kwinEffectSet);
-    setFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("set"), setFunc);
+    QScriptValue setFunc = engine->newFunction(kwinEffectSet);
+    setFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("set"), setFunc);
 
     // retarget
-    QScriptValue retargetFunc = m_engine->newFunction(kwinEffectRetarget);
-    retargetFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("retarget"), retargetFunc);
+    QScriptValue retargetFunc = engine->newFunction(kwinEffectRetarget);
+    retargetFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("retarget"), retargetFunc);
 
     // redirect
-    QScriptValue redirectFunc = m_engine->newFunction(kwinEffectRedirect);
-    redirectFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("redirect"), redirectFunc);
+    QScriptValue redirectFunc = engine->newFunction(kwinEffectRedirect);
+    redirectFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("redirect"), redirectFunc);
 
     // complete
-    QScriptValue completeFunc = m_engine->newFunction(kwinEffectComplete);
-    completeFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("complete"), completeFunc);
+    QScriptValue completeFunc = engine->newFunction(kwinEffectComplete);
+    completeFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("complete"), completeFunc);
 
     // cancel...
-    QScriptValue cancelFunc = m_engine->newFunction(kwinEffectCancel);
-    cancelFunc.setData(m_engine->newQObject(this));
-    m_engine->globalObject().setProperty(QStringLiteral("cancel"), cancelFunc);
+    QScriptValue cancelFunc = engine->newFunction(kwinEffectCancel);
+    cancelFunc.setData(engine->newQObject(this));
+    m_scope.setProperty(QStringLiteral("cancel"), cancelFunc);
 
-    QScriptValue ret = m_engine->evaluate(QString::fromUtf8(scriptFile.readAll()));
+    QScriptValue ret = m_enginePool->evaluate(this, QString::fromUtf8(scriptFile.readAll()), m_scriptFile);
 
     if (ret.isError()) {
         signalHandlerException(ret);
@@ -713,7 +743,7 @@ bool ScriptedEffect::isActiveFullScreenEffect() const
 void ScriptedEffect::signalHandlerException(const QScriptValue &value)
 {
     if (value.isError()) {
-        qCDebug(KWIN_SCRIPTING) << "KWin Effect script encountered an error at [Line " << m_engine->uncaughtExceptionLineNumber() << "]";
+        qCDebug(KWIN_SCRIPTING) << "KWin Effect script encountered an error at [Line " << engine()->uncaughtExceptionLineNumber() << "]";
         qCDebug(KWIN_SCRIPTING) << "Message: " << value.toString();
 
         QScriptValueIterator iter(value);
@@ -867,7 +897,12 @@ bool ScriptedEffect::unregisterTouchScreenCallback(int edge)
 
 QScriptEngine *ScriptedEffect::engine() const
 {
-    return m_engine;
+    return m_scope.engine();
+}
+
+QScriptValue ScriptedEffect::scope() const
+{
+    return m_scope;
 }
 
 } // namespace
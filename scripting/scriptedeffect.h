@@ -23,13 +23,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <kwinanimationeffect.h>
 
+#include <QPointer>
+#include <QtScript/QScriptValue>
+
 class KConfigLoader;
 class KPluginMetaData;
 class QScriptEngine;
-class QScriptValue;
 
 namespace KWin
 {
+class ScriptEnginePool;
+
 class KWIN_EXPORT ScriptedEffect : public KWin::AnimationEffect
 {
     Q_OBJECT
@@ -68,6 +72,13 @@ public:
     int requestedEffectChainPosition() const override {
         return m_chainPosition;
     }
+    PaintHooks paintHooks() const override {
+        // scripts can only animate, which is done by AnimationEffect
+        return PrePaintScreenHook | PostPaintScreenHook | PrePaintWindowHook | PaintWindowHook;
+    }
+    bool isActiveForWindow(EffectWindow *w) const override {
+        return isAnimating(w);
+    }
     QString activeConfig() const;
     void setActiveConfig(const QString &name);
     static ScriptedEffect *create(const QString &effectName, const QString &pathToScript, int chainPosition);
@@ -124,6 +135,12 @@ public:
     bool registerTouchScreenCallback(int edge, QScriptValue callback);
     bool unregisterTouchScreenCallback(int edge);
 
+    /**
+     * The pool of engines the scripted effects run on.
+     */
+    static ScriptEnginePool *enginePool();
+    static const int s_maxEngines = 2;
+
 public Q_SLOTS:
     //curve should be of type QEasingCurve::type or ScriptedEffect::EasingCurve
     quint64 animate(KWin::EffectWindow *w, Attribute a, int ms, KWin::FPx2 to, KWin::FPx2 from = KWin::FPx2(), uint metaData = 0, int curve = QEasingCurve::Linear, int delay = 0, bool fullScreen = false, bool keepAlive = true);
@@ -145,6 +162,12 @@ Q_SIGNALS:
 protected:
     ScriptedEffect();
     QScriptEngine *engine() const;
+    /**
+     * The object the script of the effect is evaluated in. The engine is shared with
+     * other effects, so functions for this effect have to go here instead of into the
+     * global object.
+     */
+    QScriptValue scope() const;
     bool init(const QString &effectName, const QString &pathToScript);
     void animationEnded(KWin::EffectWindow *w, Attribute a, uint meta) override;
 
@@ -152,7 +175,8 @@ private Q_SLOTS:
     void signalHandlerException(const QScriptValue &value);
     void globalShortcutTriggered();
 private:
-    QScriptEngine *m_engine;
+    QPointer<ScriptEnginePool> m_enginePool;
+    QScriptValue m_scope;
     QString m_effectName;
     QString m_scriptFile;
     QHash<QAction*, QScriptValue> m_shortcutCallbacks;
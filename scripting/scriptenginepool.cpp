@@ -0,0 +1,309 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "scriptenginepool.h"
+#include "scripting_logging.h"
+
+#include <QFile>
+#include <QtScript/QScriptContext>
+#include <QtScript/QScriptEngine>
+#include <QtScript/QScriptClass>
+#include <QtScript/QScriptString>
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace KWin
+{
+
+/**
+ * Class of the global object of the engines. Writes done by the code of a script, like
+ * assignments to undeclared variables, go into the scope of the script. Writes from C++
+ * outside of any script, i.e. the shared bindings, go into the global object itself.
+ */
+class ScriptEnginePool::GlobalObject : public QScriptClass
+{
+public:
+    GlobalObject(ScriptEnginePool *pool, QScriptEngine *engine)
+        : QScriptClass(engine)
+        , m_pool(pool)
+    {
+    }
+
+    QueryFlags queryProperty(const QScriptValue &object, const QScriptString &name, QueryFlags flags, uint *id) override {
+        Q_UNUSED(object)
+        Q_UNUSED(name)
+        Q_UNUSED(id)
+        if (!(flags & HandlesWriteAccess)) {
+            return 0;
+        }
+        const Script *script = m_pool->findScript(engine()->currentContext());
+        if (!script) {
+            return 0;
+        }
+        m_target = script->scope;
+        return HandlesWriteAccess;
+    }
+    void setProperty(QScriptValue &object, const QScriptString &name, uint id, const QScriptValue &value) override {
+        Q_UNUSED(object)
+        Q_UNUSED(id)
+        m_target.setProperty(name, value);
+        m_target = QScriptValue();
+    }
+
+private:
+    ScriptEnginePool *m_pool;
+    QScriptValue m_target;
+};
+
+static qint64 residentMemory()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.count() < 2) {
+        return 0;
+    }
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * The file the @p exception was thrown in, taken from the backtrace if the error
+ * object doesn't know it.
+ */
+static QString exceptionFileName(QScriptEngine *engine, const QScriptValue &exception)
+{
+    const QScriptValue fileName = exception.property(QStringLiteral("fileName"));
+    if (fileName.isString() && !fileName.toString().isEmpty()) {
+        return fileName.toString();
+    }
+    // the entries look like "function(arguments) at file:line"
+    const QStringList backtrace = engine->uncaughtExceptionBacktrace();
+    for (const QString &frame : backtrace) {
+        const int at = frame.lastIndexOf(QLatin1String(" at "));
+        const int colon = frame.lastIndexOf(QLatin1Char(':'));
+        if (at != -1 && colon > at) {
+            return frame.mid(at + 4, colon - at - 4);
+        }
+    }
+    return QString();
+}
+
+ScriptEnginePool::ScriptEnginePool(int maxEngines, std::function<void (QScriptEngine *)> setup, QObject *parent)
+    : QObject(parent)
+    , m_maxEngines(maxEngines)
+    , m_setup(setup)
+{
+}
+
+ScriptEnginePool::~ScriptEnginePool()
+{
+    // the engines unload their programs while getting destroyed
+    m_scripts.clear();
+    QVector<QScriptEngine *> engines;
+    for (const Engine &engine : qAsConst(m_engines)) {
+        engines << engine.engine;
+    }
+    m_engines.clear();
+    qDeleteAll(engines);
+}
+
+int ScriptEnginePool::createEngine()
+{
+    QScriptEngine *engine = new QScriptEngine(this);
+    // the built-in objects are looked up through the prototype
+    QScriptValue global = engine->newObject(new GlobalObject(this, engine));
+    global.setPrototype(engine->globalObject());
+    engine->setGlobalObject(global);
+    connect(engine, &QScriptEngine::signalHandlerException, this,
+        [this, engine] (const QScriptValue &exception) {
+            emit signalHandlerException(exceptionFileName(engine, exception), exception);
+        }
+    );
+
+    // connect is provided by the prototype of all functions, wrap it to know which
+    // script a connection belongs to
+    QScriptValue functionPrototype = engine->globalObject().property(QStringLiteral("Function")).property(QStringLiteral("prototype"));
+    QScriptValue connect = engine->newFunction(connectFunction);
+    connect.setData(functionPrototype.property(QStringLiteral("connect")));
+    functionPrototype.setProperty(QStringLiteral("connect"), connect);
+
+    m_setup(engine);
+    m_engines << Engine{engine, functionPrototype.property(QStringLiteral("disconnect")), 0};
+    return m_engines.count() - 1;
+}
+
+QScriptValue ScriptEnginePool::acquire(QObject *script)
+{
+    Q_ASSERT(!findScript(script));
+    Script entry;
+    entry.object = script;
+    entry.residentAtAcquire = residentMemory();
+    entry.loadTimer.start();
+    entry.loadTime = -1;
+    entry.memory = 0;
+
+    // spread the scripts over the engines, a new engine is only created if all are in use
+    auto it = std::min_element(m_engines.constBegin(), m_engines.constEnd(),
+        [] (const Engine &a, const Engine &b) {
+            return a.scripts < b.scripts;
+        }
+    );
+    if (it == m_engines.constEnd() || (it->scripts > 0 && m_engines.count() < m_maxEngines)) {
+        entry.engine = createEngine();
+    } else {
+        entry.engine = it - m_engines.constBegin();
+    }
+    Engine &engine = m_engines[entry.engine];
+    engine.scripts++;
+    entry.scope = engine.engine->newObject();
+    m_scripts << entry;
+    return entry.scope;
+}
+
+QScriptValue ScriptEnginePool::evaluate(QObject *script, const QString &program, const QString &fileName)
+{
+    Script *entry = findScript(script);
+    Q_ASSERT(entry);
+    entry->fileName = fileName;
+    QScriptEngine *engine = m_engines.at(entry->engine).engine;
+
+    // declarations of the program go into the activation object of the pushed context,
+    // which is the scope of the script, rather than into the global object
+    QScriptContext *context = engine->pushContext();
+    context->setActivationObject(entry->scope);
+    context->setThisObject(entry->scope);
+    const QScriptValue result = engine->evaluate(program, entry->fileName);
+    engine->popContext();
+
+    entry = findScript(script);
+    if (entry) {
+        entry->loadTime = entry->loadTimer.nsecsElapsed();
+        entry->memory = qMax<qint64>(0, residentMemory() - entry->residentAtAcquire);
+        emit statisticsChanged();
+    }
+    return result;
+}
+
+void ScriptEnginePool::release(QObject *script)
+{
+    auto it = std::find_if(m_scripts.begin(), m_scripts.end(),
+        [script] (const Script &entry) {
+            return entry.object == script;
+        }
+    );
+    if (it == m_scripts.end()) {
+        return;
+    }
+    const Script entry = *it;
+    m_scripts.erase(it);
+
+    Engine &engine = m_engines[entry.engine];
+    engine.scripts--;
+    for (const auto &connection : entry.connections) {
+        // fails for connections the script broke itself, which is fine
+        engine.disconnect.call(connection.first, connection.second);
+    }
+    engine.engine->clearExceptions();
+    emit statisticsChanged();
+}
+
+QScriptValue ScriptEnginePool::scope(QObject *script) const
+{
+    for (const Script &entry : m_scripts) {
+        if (entry.object == script) {
+            return entry.scope;
+        }
+    }
+    return QScriptValue();
+}
+
+bool ScriptEnginePool::hasConnections(QObject *script) const
+{
+    for (const Script &entry : m_scripts) {
+        if (entry.object == script) {
+            return !entry.connections.isEmpty();
+        }
+    }
+    return false;
+}
+
+QVector<ScriptEnginePool::Statistics> ScriptEnginePool::statistics() const
+{
+    QVector<Statistics> statistics;
+    statistics.reserve(m_scripts.count());
+    for (const Script &entry : m_scripts) {
+        statistics << Statistics{entry.fileName, entry.engine, entry.loadTime, entry.memory};
+    }
+    return statistics;
+}
+
+ScriptEnginePool::Script *ScriptEnginePool::findScript(QObject *object)
+{
+    for (Script &entry : m_scripts) {
+        if (entry.object == object) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+ScriptEnginePool::Script *ScriptEnginePool::findScript(QScriptContext *context)
+{
+    // all code of a script has the scope of the script in its scope chain
+    for (QScriptContext *c = context; c; c = c->parentContext()) {
+        const QScriptValueList scopeChain = c->scopeChain();
+        for (const QScriptValue &scope : scopeChain) {
+            for (Script &entry : m_scripts) {
+                if (entry.scope.strictlyEquals(scope)) {
+                    return &entry;
+                }
+            }
+        }
+    }
+    return nullptr;
+}
+
+QScriptValue ScriptEnginePool::connectFunction(QScriptContext *context, QScriptEngine *engine)
+{
+    QScriptValue connect = context->callee().data();
+    const QScriptValue signal = context->thisObject();
+    QScriptValueList arguments;
+    for (int i = 0; i < context->argumentCount(); ++i) {
+        arguments << context->argument(i);
+    }
+    const QScriptValue result = connect.call(signal, arguments);
+    if (engine->hasUncaughtException()) {
+        return result;
+    }
+    ScriptEnginePool *pool = qobject_cast<ScriptEnginePool *>(engine->parent());
+    if (!pool) {
+        return result;
+    }
+    if (Script *entry = pool->findScript(context->parentContext())) {
+        entry->connections << qMakePair(signal, arguments);
+    } else {
+        qCDebug(KWIN_SCRIPTING) << "Signal connected outside of a script scope";
+    }
+    return result;
+}
+
+}
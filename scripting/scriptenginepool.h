@@ -0,0 +1,153 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+
+#ifndef KWIN_SCRIPTENGINEPOOL_H
+#define KWIN_SCRIPTENGINEPOOL_H
+
+#include <kwinglobals.h>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPair>
+#include <QVector>
+#include <QtScript/QScriptValue>
+
+#include <functional>
+
+class QScriptContext;
+class QScriptEngine;
+
+namespace KWin
+{
+
+/**
+ * @brief A small pool of QScriptEngines shared by many scripts.
+ *
+ * Creating a QScriptEngine and installing the KWin API into it is expensive, both in
+ * memory and in time. Instead of giving each script its own engine the scripts are put
+ * on a few shared engines. The bindings which are the same for all scripts are installed
+ * once when an engine gets created, each script only adds its own few functions.
+ *
+ * Each script is evaluated in its own scope object: the variables and functions it
+ * declares don't end up in the global object of the engine, so scripts sharing an engine
+ * cannot see each other. Assignments to undeclared variables, which would create or
+ * overwrite properties of the global object, are redirected into the scope of the
+ * assigning script as well. The signal connections made by a script are tracked and get
+ * broken once the script is released, as if its engine would have been destroyed.
+ *
+ * The time it took to load a script and how much the resident memory of the process
+ * grew meanwhile is recorded, see statistics().
+ */
+class KWIN_EXPORT ScriptEnginePool : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @p setup installs the bindings shared by all scripts into a new engine.
+     */
+    ScriptEnginePool(int maxEngines, std::function<void (QScriptEngine *)> setup, QObject *parent = nullptr);
+    ~ScriptEnginePool() override;
+
+    /**
+     * Picks an engine for @p script and creates the scope the script is going to be
+     * evaluated in. The script specific bindings should be installed into the returned
+     * scope before calling evaluate.
+     */
+    QScriptValue acquire(QObject *script);
+    /**
+     * Evaluates @p program loaded from @p fileName in the scope of @p script.
+     */
+    QScriptValue evaluate(QObject *script, const QString &program, const QString &fileName);
+    /**
+     * Breaks the signal connections made by @p script and drops its scope.
+     */
+    void release(QObject *script);
+
+    /**
+     * The scope of @p script, invalid if @p script didn't acquire one.
+     */
+    QScriptValue scope(QObject *script) const;
+    /**
+     * Whether @p script connected a function to a signal, i.e. can still get invoked.
+     */
+    bool hasConnections(QObject *script) const;
+
+    int engineCount() const {
+        return m_engines.count();
+    }
+
+    struct Statistics {
+        QString fileName;
+        /**
+         * The index of the engine the script runs on.
+         */
+        int engine;
+        /**
+         * Time in nanoseconds from acquiring the scope until the script was evaluated.
+         */
+        qint64 loadTime;
+        /**
+         * Growth of the resident memory in bytes while the script got loaded.
+         */
+        qint64 memory;
+    };
+    QVector<Statistics> statistics() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted when a signal handler of the script loaded from @p fileName threw @p exception.
+     */
+    void signalHandlerException(const QString &fileName, const QScriptValue &exception);
+    void statisticsChanged();
+
+private:
+    struct Engine {
+        QScriptEngine *engine;
+        QScriptValue disconnect;
+        int scripts;
+    };
+    struct Script {
+        QObject *object;
+        int engine;
+        QString fileName;
+        QScriptValue scope;
+        QVector<QPair<QScriptValue, QScriptValueList>> connections;
+        QElapsedTimer loadTimer;
+        qint64 residentAtAcquire;
+        qint64 loadTime;
+        qint64 memory;
+    };
+    class GlobalObject;
+    friend class GlobalObject;
+
+    int createEngine();
+    Script *findScript(QObject *object);
+    Script *findScript(QScriptContext *context);
+    static QScriptValue connectFunction(QScriptContext *context, QScriptEngine *engine);
+
+    int m_maxEngines;
+    std::function<void (QScriptEngine *)> m_setup;
+    QVector<Engine> m_engines;
+    QVector<Script> m_scripts;
+};
+
+}
+
+#endif
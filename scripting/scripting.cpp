@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // own
 #include "dbuscall.h"
 #include "meta.h"
+#include "scriptenginepool.h"
 #include "scriptingutils.h"
 #include "workspace_wrapper.h"
 #include "screenedgeitem.h"
@@ -253,6 +254,12 @@ void KWin::AbstractScript::stop()
     deleteLater();
 }
 
+bool KWin::AbstractScript::hasCallbacks() const
+{
+    return !m_shortcutCallbacks.isEmpty() || !m_screenEdgeCallbacks.isEmpty() ||
+           !m_callbacks.isEmpty() || !m_userActionsMenuCallbacks.isEmpty();
+}
+
 void KWin::AbstractScript::printMessage(const QString &message)
 {
     qCDebug(KWIN_SCRIPTING) << fileName() << ":" << message;
@@ -276,47 +283,60 @@ bool KWin::AbstractScript::borderActivated(KWin::ElectricBorder edge)
     return true;
 }
 
-void KWin::Script::installScriptFunctions(QScriptEngine* engine)
+void KWin::Script::installScriptFunctions()
 {
+    QScriptEngine *engine = m_scope.engine();
     // add our print
     QScriptValue printFunc = engine->newFunction(kwinScriptPrint);
     printFunc.setData(engine->newQObject(this));
-    engine->globalObject().setProperty(QStringLiteral("print"), printFunc);
+    m_scope.setProperty(QStringLiteral("print"), printFunc);
     // add read config
     QScriptValue configFunc = engine->newFunction(kwinScriptReadConfig);
     configFunc.setData(engine->newQObject(this));
-    engine->globalObject().setProperty(QStringLiteral("readConfig"), configFunc);
+    m_scope.setProperty(QStringLiteral("readConfig"), configFunc);
     QScriptValue dbusCallFunc = engine->newFunction(kwinCallDBus);
     dbusCallFunc.setData(engine->newQObject(this));
-    engine->globalObject().setProperty(QStringLiteral("callDBus"), dbusCallFunc);
+    m_scope.setProperty(QStringLiteral("callDBus"), dbusCallFunc);
     // add global Shortcut
-    registerGlobalShortcutFunction(this, engine, kwinScriptGlobalShortcut);
+    registerGlobalShortcutFunction(this, m_scope, kwinScriptGlobalShortcut);
     // add screen edge
-    registerScreenEdgeFunction(this, engine, kwinRegisterScreenEdge);
-    unregisterScreenEdgeFunction(this, engine, kwinUnregisterScreenEdge);
-    registerTouchScreenEdgeFunction(this, engine, kwinRegisterTouchScreenEdge);
-    unregisterTouchScreenEdgeFunction(this, engine, kwinUnregisterTouchScreenEdge);
+    registerScreenEdgeFunction(this, m_scope, kwinRegisterScreenEdge);
+    unregisterScreenEdgeFunction(this, m_scope, kwinUnregisterScreenEdge);
+    registerTouchScreenEdgeFunction(this, m_scope, kwinRegisterTouchScreenEdge);
+    unregisterTouchScreenEdgeFunction(this, m_scope, kwinUnregisterTouchScreenEdge);
 
     // add user actions menu register function
-    registerUserActionsMenuFunction(this, engine, kwinRegisterUserActionsMenu);
+    registerUserActionsMenuFunction(this, m_scope, kwinRegisterUserActionsMenu);
+}
+
+/**
+ * Installs the bindings shared by all scripts into a new engine of the pool.
+ */
+static void installSharedScriptFunctions(QScriptEngine *engine)
+{
+    QScriptValue globalObject = engine->globalObject();
+    QScriptValue optionsValue = engine->newQObject(KWin::options, QScriptEngine::QtOwnership,
+                            QScriptEngine::ExcludeSuperClassContents | QScriptEngine::ExcludeDeleteLater);
+    globalObject.setProperty(QStringLiteral("options"), optionsValue, QScriptValue::Undeletable);
+    globalObject.setProperty(QStringLiteral("QTimer"), constructTimerClass(engine));
+    KWin::MetaScripting::supplyConfig(engine);
     // add assertions
     QScriptValue assertTrueFunc = engine->newFunction(kwinAssertTrue);
-    engine->globalObject().setProperty(QStringLiteral("assertTrue"), assertTrueFunc);
-    engine->globalObject().setProperty(QStringLiteral("assert"), assertTrueFunc);
+    globalObject.setProperty(QStringLiteral("assertTrue"), assertTrueFunc);
+    globalObject.setProperty(QStringLiteral("assert"), assertTrueFunc);
     QScriptValue assertFalseFunc = engine->newFunction(kwinAssertFalse);
-    engine->globalObject().setProperty(QStringLiteral("assertFalse"), assertFalseFunc);
+    globalObject.setProperty(QStringLiteral("assertFalse"), assertFalseFunc);
     QScriptValue assertEqualsFunc = engine->newFunction(kwinAssertEquals);
-    engine->globalObject().setProperty(QStringLiteral("assertEquals"), assertEqualsFunc);
+    globalObject.setProperty(QStringLiteral("assertEquals"), assertEqualsFunc);
     QScriptValue assertNullFunc = engine->newFunction(kwinAssertNull);
-    engine->globalObject().setProperty(QStringLiteral("assertNull"), assertNullFunc);
-    engine->globalObject().setProperty(QStringLiteral("assertEquals"), assertEqualsFunc);
+    globalObject.setProperty(QStringLiteral("assertNull"), assertNullFunc);
     QScriptValue assertNotNullFunc = engine->newFunction(kwinAssertNotNull);
-    engine->globalObject().setProperty(QStringLiteral("assertNotNull"), assertNotNullFunc);
+    globalObject.setProperty(QStringLiteral("assertNotNull"), assertNotNullFunc);
     // global properties
-    engine->globalObject().setProperty(QStringLiteral("KWin"), engine->newQMetaObject(&QtScriptWorkspaceWrapper::staticMetaObject));
-    QScriptValue workspace = engine->newQObject(Scripting::self()->workspaceWrapper(), QScriptEngine::QtOwnership,
+    globalObject.setProperty(QStringLiteral("KWin"), engine->newQMetaObject(&KWin::QtScriptWorkspaceWrapper::staticMetaObject));
+    QScriptValue workspace = engine->newQObject(KWin::Scripting::self()->workspaceWrapper(), QScriptEngine::QtOwnership,
                                                 QScriptEngine::ExcludeDeleteLater);
-    engine->globalObject().setProperty(QStringLiteral("workspace"), workspace, QScriptValue::Undeletable);
+    globalObject.setProperty(QStringLiteral("workspace"), workspace, QScriptValue::Undeletable);
     // install meta functions
     KWin::MetaScripting::registration(engine);
 }
@@ -448,16 +468,25 @@ void KWin::AbstractScript::actionDestroyed(QObject *object)
 
 KWin::Script::Script(int id, QString scriptName, QString pluginName, QObject* parent)
     : AbstractScript(id, scriptName, pluginName, parent)
-    , m_engine(new QScriptEngine(this))
     , m_starting(false)
-    , m_agent(new ScriptUnloaderAgent(this))
 {
     QDBusConnection::sessionBus().registerObject(QLatin1Char('/') + QString::number(scriptId()), this, QDBusConnection::ExportScriptableContents | QDBusConnection::ExportScriptableInvokables);
+    ScriptEnginePool *pool = Scripting::self()->enginePool();
+    connect(pool, &ScriptEnginePool::signalHandlerException, this,
+        [this] (const QString &fileName, const QScriptValue &exception) {
+            if (fileName == this->fileName()) {
+                sigException(exception);
+            }
+        }
+    );
 }
 
 KWin::Script::~Script()
 {
     QDBusConnection::sessionBus().unregisterObject(QLatin1Char('/') + QString::number(scriptId()));
+    if (Scripting::self()) {
+        Scripting::self()->enginePool()->release(this);
+    }
 }
 
 void KWin::Script::run()
@@ -508,19 +537,18 @@ void KWin::Script::slotScriptLoadedFromFile()
         return;
     }
 
-    QScriptValue optionsValue = m_engine->newQObject(options, QScriptEngine::QtOwnership,
-                            QScriptEngine::ExcludeSuperClassContents | QScriptEngine::ExcludeDeleteLater);
-    m_engine->globalObject().setProperty(QStringLiteral("options"), optionsValue, QScriptValue::Undeletable);
-    m_engine->globalObject().setProperty(QStringLiteral("QTimer"), constructTimerClass(m_engine));
-    QObject::connect(m_engine, SIGNAL(signalHandlerException(QScriptValue)), this, SLOT(sigException(QScriptValue)));
-    KWin::MetaScripting::supplyConfig(m_engine);
-    installScriptFunctions(m_engine);
+    ScriptEnginePool *pool = Scripting::self()->enginePool();
+    m_scope = pool->acquire(this);
+    installScriptFunctions();
 
-    QScriptValue ret = m_engine->evaluate(QString::fromUtf8(watcher->result()));
+    QScriptValue ret = pool->evaluate(this, QString::fromUtf8(watcher->result()), fileName());
 
     if (ret.isError()) {
         sigException(ret);
         deleteLater();
+    } else if (!pool->hasConnections(this) && !hasCallbacks() && m_touchScreenEdgeCallbacks.isEmpty()) {
+        // nothing of the script can be invoked anymore
+        stop();
     }
 
     if (m_invocationContext.type() == QDBusMessage::MethodCallMessage) {
@@ -538,7 +566,7 @@ void KWin::Script::sigException(const QScriptValue& exception)
 {
     QScriptValue ret = exception;
     if (ret.isError()) {
-        qCDebug(KWIN_SCRIPTING) << "defaultscript encountered an error at [Line " << m_engine->uncaughtExceptionLineNumber() << "]";
+        qCDebug(KWIN_SCRIPTING) << "defaultscript encountered an error at [Line " << engine()->uncaughtExceptionLineNumber() << "]";
         qCDebug(KWIN_SCRIPTING) << "Message: " << ret.toString();
         qCDebug(KWIN_SCRIPTING) << "-----------------";
 
@@ -580,19 +608,6 @@ bool KWin::Script::unregisterTouchScreenCallback(int edge)
     return true;
 }
 
-KWin::ScriptUnloaderAgent::ScriptUnloaderAgent(KWin::Script *script)
-    : QScriptEngineAgent(script->engine())
-    , m_script(script)
-{
-    script->engine()->setAgent(this);
-}
-
-void KWin::ScriptUnloaderAgent::scriptUnload(qint64 id)
-{
-    Q_UNUSED(id)
-    m_script->stop();
-}
-
 KWin::DeclarativeScript::DeclarativeScript(int id, QString scriptName, QString pluginName, QObject* parent)
     : AbstractScript(id, scriptName, pluginName, parent)
     , m_context(new QQmlContext(Scripting::self()->declarativeScriptSharedContext(), this))
@@ -692,6 +707,7 @@ KWin::Scripting::Scripting(QObject *parent)
     , m_qmlEngine(new QQmlEngine(this))
     , m_declarativeScriptSharedContext(new QQmlContext(m_qmlEngine, this))
     , m_workspaceWrapper(new QtScriptWorkspaceWrapper(this))
+    , m_enginePool(new ScriptEnginePool(s_maxEngines, installSharedScriptFunctions, this))
 {
     init();
     QDBusConnection::sessionBus().registerObject(QStringLiteral("/Scripting"), this, QDBusConnection::ExportScriptableContents | QDBusConnection::ExportScriptableInvokables);
@@ -27,7 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QFile>
 #include <QHash>
 #include <QStringList>
-#include <QtScript/QScriptEngineAgent>
+#include <QtScript/QScriptValue>
 #include <QJSValue>
 
 #include <QDBusContext>
@@ -42,7 +42,6 @@ class QGraphicsScene;
 class QMenu;
 class QMutex;
 class QScriptEngine;
-class QScriptValue;
 class QQuickWindow;
 class KConfigGroup;
 
@@ -52,8 +51,8 @@ typedef QList< QPair<bool, QPair<QString, QString > > > LoadScriptList;
 namespace KWin
 {
 class AbstractClient;
-class ScriptUnloaderAgent;
 class QtScriptWorkspaceWrapper;
+class ScriptEnginePool;
 class X11Client;
 
 class KWIN_EXPORT AbstractScript : public QObject
@@ -169,6 +168,11 @@ protected:
     int scriptId() const {
         return m_scriptId;
     }
+    /**
+     * Whether the script registered a function to be invoked later on, like a shortcut
+     * or a screen edge.
+     */
+    bool hasCallbacks() const;
 
 private:
     /**
@@ -225,8 +229,12 @@ public:
 
     Script(int id, QString scriptName, QString pluginName, QObject *parent = nullptr);
     ~Script() override;
+    /**
+     * The engine the script runs on, shared with other scripts. @c null until the
+     * script is running.
+     */
     QScriptEngine *engine() {
-        return m_engine;
+        return m_scope.engine();
     }
 
     bool registerTouchScreenCallback(int edge, QScriptValue callback);
@@ -250,29 +258,18 @@ private Q_SLOTS:
     void slotScriptLoadedFromFile();
 
 private:
-    void installScriptFunctions(QScriptEngine *engine);
+    void installScriptFunctions();
     /**
      * Read the script from file into a byte array.
      * If file cannot be read an empty byte array is returned.
      */
     QByteArray loadScriptFromFile(const QString &fileName);
-    QScriptEngine *m_engine;
+    QScriptValue m_scope;
     QDBusMessage m_invocationContext;
     bool m_starting;
-    QScopedPointer<ScriptUnloaderAgent> m_agent;
     QHash<int, QAction*> m_touchScreenEdgeCallbacks;
 };
 
-class ScriptUnloaderAgent : public QScriptEngineAgent
-{
-public:
-    explicit ScriptUnloaderAgent(Script *script);
-    void scriptUnload(qint64 id) override;
-
-private:
-    Script *m_script;
-};
-
 class DeclarativeScript : public AbstractScript
 {
     Q_OBJECT
@@ -370,6 +367,13 @@ public:
     QQmlContext *declarativeScriptSharedContext() const;
     QQmlContext *declarativeScriptSharedContext();
     QtScriptWorkspaceWrapper *workspaceWrapper() const;
+    /**
+     * The pool of engines the JavaScript based scripts run on.
+     */
+    ScriptEnginePool *enginePool() const {
+        return m_enginePool;
+    }
+    static const int s_maxEngines = 2;
 
     AbstractScript *findScript(const QString &pluginName) const;
 
@@ -390,6 +394,7 @@ private:
     QQmlEngine *m_qmlEngine;
     QQmlContext *m_declarativeScriptSharedContext;
     QtScriptWorkspaceWrapper *m_workspaceWrapper;
+    ScriptEnginePool *m_enginePool;
 };
 
 inline
@@ -322,46 +322,52 @@ QScriptValue scriptingAssert(QScriptContext *context, QScriptEngine *engine, int
     return engine->newVariant(true);
 }
 
-inline void registerGlobalShortcutFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void registerGlobalShortcutFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue shortcutFunc = engine->newFunction(function);
     shortcutFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("registerShortcut"), shortcutFunc);
+    scope.setProperty(QStringLiteral("registerShortcut"), shortcutFunc);
 }
 
-inline void registerScreenEdgeFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void registerScreenEdgeFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue shortcutFunc = engine->newFunction(function);
     shortcutFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("registerScreenEdge"), shortcutFunc);
+    scope.setProperty(QStringLiteral("registerScreenEdge"), shortcutFunc);
 }
 
-inline void unregisterScreenEdgeFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void unregisterScreenEdgeFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue shortcutFunc = engine->newFunction(function);
     shortcutFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("unregisterScreenEdge"), shortcutFunc);
+    scope.setProperty(QStringLiteral("unregisterScreenEdge"), shortcutFunc);
 }
 
-inline void registerTouchScreenEdgeFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void registerTouchScreenEdgeFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue touchScreenFunc = engine->newFunction(function);
     touchScreenFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("registerTouchScreenEdge"), touchScreenFunc);
+    scope.setProperty(QStringLiteral("registerTouchScreenEdge"), touchScreenFunc);
 }
 
-inline void unregisterTouchScreenEdgeFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void unregisterTouchScreenEdgeFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue touchScreenFunc = engine->newFunction(function);
     touchScreenFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("unregisterTouchScreenEdge"), touchScreenFunc);
+    scope.setProperty(QStringLiteral("unregisterTouchScreenEdge"), touchScreenFunc);
 }
 
-inline void registerUserActionsMenuFunction(QObject *parent, QScriptEngine *engine, QScriptEngine::FunctionSignature function)
+inline void registerUserActionsMenuFunction(QObject *parent, QScriptValue &scope, QScriptEngine::FunctionSignature function)
 {
+    QScriptEngine *engine = scope.engine();
     QScriptValue shortcutFunc = engine->newFunction(function);
     shortcutFunc.setData(engine->newQObject(parent));
-    engine->globalObject().setProperty(QStringLiteral("registerUserActionsMenu"), shortcutFunc);
+    scope.setProperty(QStringLiteral("registerUserActionsMenu"), shortcutFunc);
 }
 
 } // namespace KWin
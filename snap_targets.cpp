@@ -0,0 +1,100 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#include "snap_targets.h"
+#include "abstract_client.h"
+#include "workspace.h"
+
+#include <algorithm>
+
+namespace KWin
+{
+
+SnapTargets::SnapTargets(AbstractClient *movingClient, QObject *parent)
+    : QObject(parent)
+    , m_movingClient(movingClient)
+{
+    update();
+}
+
+SnapTargets::~SnapTargets() = default;
+
+void SnapTargets::update()
+{
+    // the windows might be gone already
+    for (const QMetaObject::Connection &connection : m_connections) {
+        disconnect(connection);
+    }
+    m_connections.clear();
+    m_clients = workspace()->allClientList();
+    m_horizontalEdges.clear();
+    m_verticalEdges.clear();
+    m_horizontalEdges.reserve(m_clients.count() * 2);
+    m_verticalEdges.reserve(m_clients.count() * 2);
+    for (int i = 0; i < m_clients.count(); ++i) {
+        AbstractClient *client = m_clients.at(i);
+        if (client == m_movingClient || client->isDesktop() || client->isSplash()) {
+            continue;
+        }
+        const QRect geometry = client->frameGeometry();
+        m_horizontalEdges.push_back({geometry.x(), i});
+        m_horizontalEdges.push_back({geometry.x() + geometry.width(), i});
+        m_verticalEdges.push_back({geometry.y(), i});
+        m_verticalEdges.push_back({geometry.y() + geometry.height(), i});
+        m_connections.push_back(connect(client, &AbstractClient::geometryShapeChanged, this, [this] { m_dirty = true; }));
+    }
+    std::sort(m_horizontalEdges.begin(), m_horizontalEdges.end());
+    std::sort(m_verticalEdges.begin(), m_verticalEdges.end());
+    m_dirty = false;
+}
+
+void SnapTargets::collectNear(const std::vector<Edge> &edges, int position, int distance, std::vector<int> &indexes) const
+{
+    auto it = std::lower_bound(edges.cbegin(), edges.cend(), Edge{position - distance + 1, 0});
+    for (; it != edges.cend() && it->position < position + distance; ++it) {
+        indexes.push_back(it->index);
+    }
+}
+
+QVector<AbstractClient *> SnapTargets::candidates(const QRect &geometry, int distance)
+{
+    // Any modification of the window list detaches it from our copy.
+    if (m_dirty || !m_clients.isSharedWith(workspace()->allClientList())) {
+        update();
+    }
+    std::vector<int> indexes;
+    if (distance > 0) {
+        const int right = geometry.x() + geometry.width();
+        const int bottom = geometry.y() + geometry.height();
+        collectNear(m_horizontalEdges, geometry.x(), distance, indexes);
+        collectNear(m_horizontalEdges, right, distance, indexes);
+        collectNear(m_verticalEdges, geometry.y(), distance, indexes);
+        collectNear(m_verticalEdges, bottom, distance, indexes);
+        std::sort(indexes.begin(), indexes.end());
+        indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+    }
+    QVector<AbstractClient *> clients;
+    clients.reserve(indexes.size());
+    for (int index : indexes) {
+        clients << m_clients.at(index);
+    }
+    return clients;
+}
+
+}
@@ -0,0 +1,87 @@
+/********************************************************************
+ KWin - the KDE window manager
+ This file is part of the KDE project.
+
+Copyright (C) 2019 KWin developers
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************/
+#ifndef KWIN_SNAP_TARGETS_H
+#define KWIN_SNAP_TARGETS_H
+
+#include <kwinglobals.h>
+
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QVector>
+
+#include <vector>
+
+namespace KWin
+{
+
+class AbstractClient;
+
+/**
+ * @brief The edges of the other windows a window can snap to while it is being moved.
+ *
+ * The left and right edges of all windows are kept sorted by their position, and so are
+ * the top and bottom edges. Finding the windows close to the moved window thus only needs
+ * a few binary searches instead of looking at every window on each pointer motion.
+ *
+ * The edges are collected once the move starts. They are only sorted again if another
+ * window got added, removed or changed its geometry while the window is being moved.
+ */
+class KWIN_EXPORT SnapTargets : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SnapTargets(AbstractClient *movingClient, QObject *parent = nullptr);
+    ~SnapTargets() override;
+
+    AbstractClient *movingClient() const {
+        return m_movingClient;
+    }
+
+    /**
+     * Returns the windows with an edge closer than @p distance to an edge of @p geometry,
+     * in the order of Workspace::allClientList(). Windows which are not interesting for
+     * snapping, e.g. because they are minimized, still need to be filtered out.
+     */
+    QVector<AbstractClient *> candidates(const QRect &geometry, int distance);
+
+private:
+    struct Edge {
+        int position;
+        int index;
+        bool operator<(const Edge &other) const {
+            return position < other.position;
+        }
+    };
+
+    void update();
+    void collectNear(const std::vector<Edge> &edges, int position, int distance, std::vector<int> &indexes) const;
+
+    AbstractClient *m_movingClient;
+    QList<AbstractClient *> m_clients;
+    std::vector<Edge> m_horizontalEdges;
+    std::vector<Edge> m_verticalEdges;
+    std::vector<QMetaObject::Connection> m_connections;
+    bool m_dirty = true;
+};
+
+}
+
+#endif
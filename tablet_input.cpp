@@ -90,8 +90,8 @@ void TabletInputRedirection::tabletToolEvent(KWin::InputRedirection::TabletEvent
                     0, // z
                     Qt::NoModifier, serialId, button, button);
 
-    input()->processSpies(std::bind(&InputEventSpy::tabletToolEvent, std::placeholders::_1, &ev));
-    input()->processFilters(
+    input()->processSpies(InputEventType::Tablet, std::bind(&InputEventSpy::tabletToolEvent, std::placeholders::_1, &ev));
+    input()->processFilters(InputEventType::Tablet,
         std::bind(&InputEventFilter::tabletToolEvent, std::placeholders::_1, &ev));
 
     m_tipDown = tipDown;
@@ -105,9 +105,9 @@ void KWin::TabletInputRedirection::tabletToolButtonEvent(uint button, bool isPre
     else
         m_toolPressedButtons.remove(button);
 
-    input()->processSpies(std::bind(&InputEventSpy::tabletToolButtonEvent,
+    input()->processSpies(InputEventType::Tablet, std::bind(&InputEventSpy::tabletToolButtonEvent,
                                     std::placeholders::_1, m_toolPressedButtons));
-    input()->processFilters(std::bind( &InputEventFilter::tabletToolButtonEvent,
+    input()->processFilters(InputEventType::Tablet, std::bind( &InputEventFilter::tabletToolButtonEvent,
                                       std::placeholders::_1, m_toolPressedButtons));
 }
 
@@ -119,25 +119,25 @@ void KWin::TabletInputRedirection::tabletPadButtonEvent(uint button, bool isPres
         m_padPressedButtons.remove(button);
     }
 
-    input()->processSpies(std::bind( &InputEventSpy::tabletPadButtonEvent,
+    input()->processSpies(InputEventType::Tablet, std::bind( &InputEventSpy::tabletPadButtonEvent,
                                      std::placeholders::_1, m_padPressedButtons));
-    input()->processFilters(std::bind( &InputEventFilter::tabletPadButtonEvent,
+    input()->processFilters(InputEventType::Tablet, std::bind( &InputEventFilter::tabletPadButtonEvent,
                                        std::placeholders::_1, m_padPressedButtons));
 }
 
 void KWin::TabletInputRedirection::tabletPadStripEvent(int number, int position, bool isFinger)
 {
-    input()->processSpies(std::bind( &InputEventSpy::tabletPadStripEvent,
+    input()->processSpies(InputEventType::Tablet, std::bind( &InputEventSpy::tabletPadStripEvent,
                                      std::placeholders::_1, number, position, isFinger));
-    input()->processFilters(std::bind( &InputEventFilter::tabletPadStripEvent,
+    input()->processFilters(InputEventType::Tablet, std::bind( &InputEventFilter::tabletPadStripEvent,
                                        std::placeholders::_1, number, position, isFinger));
 }
 
 void KWin::TabletInputRedirection::tabletPadRingEvent(int number, int position, bool isFinger)
 {
-    input()->processSpies(std::bind( &InputEventSpy::tabletPadRingEvent,
+    input()->processSpies(InputEventType::Tablet, std::bind( &InputEventSpy::tabletPadRingEvent,
                                      std::placeholders::_1, number, position, isFinger));
-    input()->processFilters(std::bind( &InputEventFilter::tabletPadRingEvent,
+    input()->processFilters(InputEventType::Tablet, std::bind( &InputEventFilter::tabletPadRingEvent,
                                        std::placeholders::_1, number, position, isFinger));
 }
 
@@ -39,6 +39,7 @@ class TabletModeSwitchEventSpy : public QObject, public InputEventSpy
 public:
     explicit TabletModeSwitchEventSpy(TabletModeManager *parent)
         : QObject(parent)
+        , InputEventSpy(InputEventType::Switch)
         , m_parent(parent)
     {
     }
@@ -139,9 +139,9 @@ QRect Toplevel::visibleRect() const
     return rect;
 }
 
-Xcb::Property Toplevel::fetchWmClientLeader() const
+Xcb::Property Toplevel::fetchWmClientLeader(xcb_window_t window)
 {
-    return Xcb::Property(false, window(), atoms->wm_client_leader, XCB_ATOM_WINDOW, 0, 10000);
+    return Xcb::Property(false, window, atoms->wm_client_leader, XCB_ATOM_WINDOW, 0, 10000);
 }
 
 void Toplevel::readWmClientLeader(Xcb::Property &prop)
@@ -151,7 +151,7 @@ void Toplevel::readWmClientLeader(Xcb::Property &prop)
 
 void Toplevel::getWmClientLeader()
 {
-    auto prop = fetchWmClientLeader();
+    auto prop = fetchWmClientLeader(window());
     readWmClientLeader(prop);
 }
 
@@ -675,9 +675,9 @@ xcb_window_t Toplevel::frameId() const
     return m_client;
 }
 
-Xcb::Property Toplevel::fetchSkipCloseAnimation() const
+Xcb::Property Toplevel::fetchSkipCloseAnimation(xcb_window_t window)
 {
-    return Xcb::Property(false, window(), atoms->kde_skip_close_animation, XCB_ATOM_CARDINAL, 0, 1);
+    return Xcb::Property(false, window, atoms->kde_skip_close_animation, XCB_ATOM_CARDINAL, 0, 1);
 }
 
 void Toplevel::readSkipCloseAnimation(Xcb::Property &property)
@@ -687,7 +687,7 @@ void Toplevel::readSkipCloseAnimation(Xcb::Property &property)
 
 void Toplevel::getSkipCloseAnimation()
 {
-    Xcb::Property property = fetchSkipCloseAnimation();
+    Xcb::Property property = fetchSkipCloseAnimation(window());
     readSkipCloseAnimation(property);
 }
 
@@ -670,7 +670,7 @@ protected:
     void discardWindowPixmap();
     void addDamageFull();
     virtual void addDamage(const QRegion &damage);
-    Xcb::Property fetchWmClientLeader() const;
+    static Xcb::Property fetchWmClientLeader(xcb_window_t window);
     void readWmClientLeader(Xcb::Property &p);
     void getWmClientLeader();
     void getWmClientMachine();
@@ -687,7 +687,7 @@ protected:
 
     void getResourceClass();
     void setResourceClass(const QByteArray &name, const QByteArray &className = QByteArray());
-    Xcb::Property fetchSkipCloseAnimation() const;
+    static Xcb::Property fetchSkipCloseAnimation(xcb_window_t window);
     void readSkipCloseAnimation(Xcb::Property &prop);
     void getSkipCloseAnimation();
     virtual void debug(QDebug& stream) const = 0;
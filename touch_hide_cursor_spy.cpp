@@ -24,6 +24,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 namespace KWin
 {
 
+TouchHideCursorSpy::TouchHideCursorSpy()
+    : InputEventSpy(InputEventType::Touch)
+{
+}
+
 void TouchHideCursorSpy::pointerEvent(MouseEvent *event)
 {
     Q_UNUSED(event)
@@ -50,6 +55,7 @@ void TouchHideCursorSpy::showCursor()
         return;
     }
     m_cursorHidden = false;
+    setInterests(InputEventType::Touch);
     kwinApp()->platform()->showCursor();
 }
 
@@ -59,6 +65,8 @@ void TouchHideCursorSpy::hideCursor()
         return;
     }
     m_cursorHidden = true;
+    setInterests(InputEventType::Touch | InputEventType::PointerMotion |
+                 InputEventType::PointerButton | InputEventType::PointerAxis);
     kwinApp()->platform()->hideCursor();
 }
 
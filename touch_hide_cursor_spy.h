@@ -23,9 +23,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 namespace KWin
 {
 
+/**
+ * Hides the cursor on touch down and shows it again on the next pointer event. Only touch
+ * events are of interest while the cursor is shown.
+ */
 class TouchHideCursorSpy : public InputEventSpy
 {
 public:
+    TouchHideCursorSpy();
+
     void pointerEvent(KWin::MouseEvent *event) override;
     void wheelEvent(KWin::WheelEvent *event) override;
     void touchDown(qint32 id, const QPointF &pos, quint32 time) override;
@@ -179,8 +179,8 @@ void TouchInputRedirection::processDown(qint32 id, const QPointF &pos, quint32 t
     if (m_touches == 1) {
         update();
     }
-    input()->processSpies(std::bind(&InputEventSpy::touchDown, std::placeholders::_1, id, pos, time));
-    input()->processFilters(std::bind(&InputEventFilter::touchDown, std::placeholders::_1, id, pos, time));
+    input()->processSpies(InputEventType::Touch, std::bind(&InputEventSpy::touchDown, std::placeholders::_1, id, pos, time));
+    input()->processFilters(InputEventType::Touch, std::bind(&InputEventFilter::touchDown, std::placeholders::_1, id, pos, time));
     m_windowUpdatedInCycle = false;
 }
 
@@ -191,8 +191,8 @@ void TouchInputRedirection::processUp(qint32 id, quint32 time, LibInput::Device
         return;
     }
     m_windowUpdatedInCycle = false;
-    input()->processSpies(std::bind(&InputEventSpy::touchUp, std::placeholders::_1, id, time));
-    input()->processFilters(std::bind(&InputEventFilter::touchUp, std::placeholders::_1, id, time));
+    input()->processSpies(InputEventType::Touch, std::bind(&InputEventSpy::touchUp, std::placeholders::_1, id, time));
+    input()->processFilters(InputEventType::Touch, std::bind(&InputEventFilter::touchUp, std::placeholders::_1, id, time));
     m_windowUpdatedInCycle = false;
     m_touches--;
     if (m_touches == 0) {
@@ -208,8 +208,8 @@ void TouchInputRedirection::processMotion(qint32 id, const QPointF &pos, quint32
     }
     m_lastPosition = pos;
     m_windowUpdatedInCycle = false;
-    input()->processSpies(std::bind(&InputEventSpy::touchMotion, std::placeholders::_1, id, pos, time));
-    input()->processFilters(std::bind(&InputEventFilter::touchMotion, std::placeholders::_1, id, pos, time));
+    input()->processSpies(InputEventType::Touch, std::bind(&InputEventSpy::touchMotion, std::placeholders::_1, id, pos, time));
+    input()->processFilters(InputEventType::Touch, std::bind(&InputEventFilter::touchMotion, std::placeholders::_1, id, pos, time));
     m_windowUpdatedInCycle = false;
 }
 
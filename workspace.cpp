@@ -50,6 +50,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "screens.h"
 #include "platform.h"
 #include "scripting/scripting.h"
+#include "snap_targets.h"
 #ifdef KWIN_BUILD_TABBOX
 #include "tabbox.h"
 #endif
@@ -315,6 +316,7 @@ void Workspace::init()
                     m_allClients.append(c);
                     if (!unconstrained_stacking_order.contains(c))
                         unconstrained_stacking_order.append(c);   // Raise if it hasn't got any stacking position yet
+                    invalidateRestackHint();
                     if (!stacking_order.contains(c))    // It'll be updated later, and updateToolWindows() requires
                         stacking_order.append(c);      // c to be in stacking_order
                 }
@@ -455,40 +457,7 @@ void Workspace::initWithX11()
         // Begin updates blocker block
         StackingUpdatesBlocker blocker(this);
 
-        Xcb::Tree tree(rootWindow());
-        xcb_window_t *wins = xcb_query_tree_children(tree.data());
-
-        QVector<Xcb::WindowAttributes> windowAttributes(tree->children_len);
-        QVector<Xcb::WindowGeometry> windowGeometries(tree->children_len);
-
-        // Request the attributes and geometries of all toplevel windows
-        for (int i = 0; i < tree->children_len; i++) {
-            windowAttributes[i] = Xcb::WindowAttributes(wins[i]);
-            windowGeometries[i] = Xcb::WindowGeometry(wins[i]);
-        }
-
-        // Get the replies
-        for (int i = 0; i < tree->children_len; i++) {
-            Xcb::WindowAttributes attr(windowAttributes.at(i));
-
-            if (attr.isNull()) {
-                continue;
-            }
-
-            if (attr->override_redirect) {
-                if (attr->map_state == XCB_MAP_STATE_VIEWABLE &&
-                    attr->_class != XCB_WINDOW_CLASS_INPUT_ONLY)
-                    // ### This will request the attributes again
-                    createUnmanaged(wins[i]);
-            } else if (attr->map_state != XCB_MAP_STATE_UNMAPPED) {
-                if (Application::wasCrash()) {
-                    fixPositionAfterCrash(wins[i], windowGeometries.at(i).data());
-                }
-
-                // ### This will request the attributes again
-                createClient(wins[i], true);
-            }
-        }
+        manageExistingX11Windows();
 
         // Propagate clients, will really happen at the end of the updates blocker block
         updateStackingOrder(true);
@@ -530,6 +499,57 @@ void Workspace::initWithX11()
         activateClient(new_active_client);
 }
 
+void Workspace::manageExistingX11Windows()
+{
+    StackingUpdatesBlocker blocker(this);
+
+    Xcb::Tree tree(rootWindow());
+    xcb_window_t *wins = xcb_query_tree_children(tree.data());
+
+    QVector<Xcb::WindowAttributes> windowAttributes(tree->children_len);
+    QVector<Xcb::WindowGeometry> windowGeometries(tree->children_len);
+
+    // Request the attributes and geometries of all toplevel windows
+    for (int i = 0; i < tree->children_len; i++) {
+        windowAttributes[i] = Xcb::WindowAttributes(wins[i]);
+        windowGeometries[i] = Xcb::WindowGeometry(wins[i]);
+    }
+
+    // Get the replies. All the other requests needed to manage the windows are sent
+    // before waiting for the first reply, so adopting them doesn't cost several round
+    // trips per window.
+    QVector<X11ManageRequests *> manageRequests;
+    for (int i = 0; i < tree->children_len; i++) {
+        Xcb::WindowAttributes attr(windowAttributes.at(i));
+
+        if (attr.isNull()) {
+            continue;
+        }
+        if (findUnmanaged(wins[i]) || findClient(Predicate::WindowMatch, wins[i]) ||
+                findClient(Predicate::FrameIdMatch, wins[i])) {
+            continue;
+        }
+
+        if (attr->override_redirect) {
+            if (attr->map_state == XCB_MAP_STATE_VIEWABLE &&
+                attr->_class != XCB_WINDOW_CLASS_INPUT_ONLY)
+                // ### This will request the attributes again
+                createUnmanaged(wins[i]);
+        } else if (attr->map_state != XCB_MAP_STATE_UNMAPPED) {
+            if (Application::wasCrash() && fixPositionAfterCrash(wins[i], windowGeometries.at(i).data())) {
+                // The reply is outdated, the geometry requested now is sent after the move
+                windowGeometries[i] = Xcb::WindowGeometry(wins[i]);
+            }
+
+            manageRequests << new X11ManageRequests(attr, windowGeometries.at(i));
+        }
+    }
+    for (X11ManageRequests *requests : qAsConst(manageRequests)) {
+        createClient(*requests, true);
+    }
+    qDeleteAll(manageRequests);
+}
+
 Workspace::~Workspace()
 {
     blockStackingUpdates(true);
@@ -605,6 +625,12 @@ void Workspace::setupClientConnections(AbstractClient *c)
 }
 
 X11Client *Workspace::createClient(xcb_window_t w, bool is_mapped)
+{
+    X11ManageRequests requests(w);
+    return createClient(requests, is_mapped);
+}
+
+X11Client *Workspace::createClient(X11ManageRequests &requests, bool is_mapped)
 {
     StackingUpdatesBlocker blocker(this);
     X11Client *c = new X11Client();
@@ -613,7 +639,7 @@ X11Client *Workspace::createClient(xcb_window_t w, bool is_mapped)
         connect(c, &X11Client::blockingCompositingChanged, compositor, &X11Compositor::updateClientCompositeBlocking);
     }
     connect(c, SIGNAL(clientFullScreenSet(KWin::X11Client *,bool,bool)), ScreenEdges::self(), SIGNAL(checkBlocking()));
-    if (!c->manage(w, is_mapped)) {
+    if (!c->manage(requests, is_mapped)) {
         X11Client::deleteClient(c);
         return nullptr;
     }
@@ -661,6 +687,7 @@ void Workspace::addClient(X11Client *c)
         unconstrained_stacking_order.append(c);   // Raise if it hasn't got any stacking position yet
     if (!stacking_order.contains(c))    // It'll be updated later, and updateToolWindows() requires
         stacking_order.append(c);      // c to be in stacking_order
+    invalidateRestackHint();
     markXStackingOrderAsDirty();
     updateClientArea(); // This cannot be in manage(), because the client got added only now
     updateClientLayer(c);
@@ -753,6 +780,7 @@ void Workspace::addDeleted(Deleted* c, Toplevel *orig)
     } else {
         stacking_order.append(c);
     }
+    invalidateRestackHint();
     markXStackingOrderAsDirty();
     connect(c, &Deleted::needsRepaint, m_compositor, &Compositor::scheduleRepaint);
 }
@@ -764,6 +792,7 @@ void Workspace::removeDeleted(Deleted* c)
     deleted.removeAll(c);
     unconstrained_stacking_order.removeAll(c);
     stacking_order.removeAll(c);
+    invalidateRestackHint();
     markXStackingOrderAsDirty();
     if (!c->wasClient()) {
         return;
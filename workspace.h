@@ -58,11 +58,14 @@ class Group;
 class InternalClient;
 class KillWindow;
 class ShortcutDialog;
+class SnapTargets;
 class Toplevel;
 class Unmanaged;
 class UserActionsMenu;
 class X11Client;
 class X11EventFilter;
+struct X11ManageRequests;
+class XdgShellClient;
 enum class Predicate;
 
 class KWIN_EXPORT Workspace : public QObject
@@ -385,9 +388,21 @@ public:
     void unregisterEventFilter(X11EventFilter *filter);
 
     void markXStackingOrderAsDirty();
+    /**
+     * Makes the next updateStackingOrder() rebuild the stacking order from scratch. Has to be
+     * called whenever something the constrained stacking order depends on changes, e.g. the
+     * layer or the transients of a window, unless the stacking order is rebuilt anyway.
+     */
+    void invalidateRestackHint();
 
     void quickTileWindow(QuickTileMode mode);
 
+    /**
+     * Manages the mapped toplevel X11 windows which are not known yet, e.g. the windows which
+     * exist already when KWin starts. Called from initWithX11().
+     */
+    void manageExistingX11Windows();
+
     enum Direction {
         DirectionNorth,
         DirectionEast,
@@ -548,6 +563,9 @@ private:
 
     void propagateClients(bool propagate_new_clients);   // Called only from updateStackingOrder
     QList<Toplevel *> constrainedStackingOrder();
+    void addRestackHint(AbstractClient *c, bool raise);
+    bool applyRestackHint(QList<Toplevel *> &stacking, QRegion &repaints);
+    bool restackRepaints(const QList<Toplevel *> &oldOrder, const QList<Toplevel *> &newOrder, QRegion &repaints) const;
     void raiseClientWithinApplication(AbstractClient* c);
     void lowerClientWithinApplication(AbstractClient* c);
     bool allowFullClientRaising(const AbstractClient* c, xcb_timestamp_t timestamp);
@@ -555,11 +573,12 @@ private:
     bool keepDeletedTransientAbove(const Toplevel *mainWindow, const Deleted *transient) const;
     void blockStackingUpdates(bool block);
     void updateToolWindows(bool also_hide);
-    void fixPositionAfterCrash(xcb_window_t w, const xcb_get_geometry_reply_t *geom);
+    bool fixPositionAfterCrash(xcb_window_t w, const xcb_get_geometry_reply_t *geom);
     void saveOldScreenSizes();
 
     /// This is the right way to create a new client
     X11Client *createClient(xcb_window_t w, bool is_mapped);
+    X11Client *createClient(X11ManageRequests &requests, bool is_mapped);
     void setupClientConnections(AbstractClient *client);
     void addClient(X11Client *c);
     Unmanaged* createUnmanaged(xcb_window_t w);
@@ -569,6 +588,23 @@ private:
 
     void closeActivePopup();
     void updateClientArea(bool force);
+
+    /**
+     * How a window with a strut restricts the areas available to the other windows
+     * on the desktops it is on.
+     */
+    struct StrutContribution {
+        const AbstractClient *client;
+        int desktop; // NET::OnAllDesktops if the window is on all desktops
+        bool restrictsWorkArea;
+        QRect workArea;
+        QVector<QRect> screenAreas; // the area left on each screen
+        bool ignoreEmptyScreenAreas; // screen areas removing the screen completely are ignored
+        StrutRects strutRects;
+        bool operator==(const StrutContribution &other) const;
+    };
+    StrutContribution strutContribution(X11Client *c, const QRect &desktopArea, const QVector<QRect> &screens) const;
+    StrutContribution strutContribution(XdgShellClient *c, const QRect &desktopArea, const QVector<QRect> &screens) const;
     void resetClientAreas(uint desktopCount);
     void updateClientVisibilityOnDesktopChange(uint newDesktop);
     void activateClientOnNewDesktop(uint desktop);
@@ -607,6 +643,17 @@ private:
     QList<Toplevel *> stacking_order; // Topmost last
     QVector<xcb_window_t> manual_overlays; //Topmost last
     bool force_restacking;
+    /**
+     * The raise or lower of a single window since the last update of the stacking order.
+     * As long as nothing else changed in between, it is applied to the current stacking
+     * order instead of rebuilding the whole order.
+     */
+    struct RestackHint {
+        AbstractClient *client = nullptr;
+        bool raise = false;
+        bool valid = true;
+    };
+    RestackHint m_restackHint;
     QList<Toplevel *> x_stacking; // From XQueryTree()
     std::unique_ptr<Xcb::Tree> m_xStackingQueryTree;
     bool m_xStackingDirty = false;
@@ -656,6 +703,9 @@ private:
     QVector< QVector<QRect> > screenarea; // Array of workareas per xinerama screen for all virtual desktops
     QVector< QRect > oldscreensizes; // array of previous sizes of xinerama screens
     QSize olddisplaysize; // previous sizes od displayWidth()/displayHeight()
+    // contributions of the windows with struts and the screens they were computed for
+    QVector<StrutContribution> m_strutContributions;
+    QVector<QRect> m_strutScreens;
 
     int set_active_client_recursion;
     int block_stacking_updates; // When > 0, stacking updates are temporarily disabled
@@ -668,6 +718,7 @@ private:
     QList<X11EventFilter *> m_eventFilters;
     QList<X11EventFilter *> m_genericEventFilters;
     QScopedPointer<X11EventFilter> m_movingClientFilter;
+    QScopedPointer<SnapTargets> m_snapTargets;
 
     SessionManager *m_sessionManager;
 private:
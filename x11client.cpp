@@ -327,13 +327,49 @@ void X11Client::destroyClient()
  * reparenting, initial geometry, initial state, placement, etc.
  * Returns false if KWin is not going to manage this window.
  */
-bool X11Client::manage(xcb_window_t w, bool isMapped)
+X11ManageRequests::X11ManageRequests(xcb_window_t window)
+    : X11ManageRequests(Xcb::WindowAttributes(window), Xcb::WindowGeometry(window))
+{
+}
+
+/**
+ * The properties are read long before embedClient() selects the events of the client, a change
+ * in between would get lost. Selecting the property changes before sending the requests makes
+ * the server report such a change, it is handled once the client got managed.
+ */
+static xcb_window_t selectPropertyChanges(xcb_window_t window)
+{
+    Xcb::selectInput(window, XCB_EVENT_MASK_PROPERTY_CHANGE);
+    return window;
+}
+
+X11ManageRequests::X11ManageRequests(const Xcb::WindowAttributes &attributes, const Xcb::WindowGeometry &geometry)
+    : window(selectPropertyChanges(attributes.window()))
+    , attributes(attributes)
+    , geometry(geometry)
+    , wmClientLeader(X11Client::fetchWmClientLeader(window))
+    , skipCloseAnimation(X11Client::fetchSkipCloseAnimation(window))
+    , showOnScreenEdge(X11Client::fetchShowOnScreenEdge(window))
+    , colorScheme(X11Client::fetchColorScheme(window))
+    , firstInTabBox(X11Client::fetchFirstInTabBox(window))
+    , transient(X11Client::fetchTransient(window))
+    , activities(X11Client::fetchActivities(window))
+    , applicationMenuServiceName(X11Client::fetchApplicationMenuServiceName(window))
+    , applicationMenuObjectPath(X11Client::fetchApplicationMenuObjectPath(window))
+    , motifHints(atoms->motif_wm_hints)
+{
+    geometryHints.init(window);
+    motifHints.init(window);
+}
+
+bool X11Client::manage(X11ManageRequests &requests, bool isMapped)
 {
     StackingUpdatesBlocker stacking_blocker(workspace());
 
-    Xcb::WindowAttributes attr(w);
-    Xcb::WindowGeometry windowGeometry(w);
-    if (attr.isNull() || windowGeometry.isNull()) {
+    const xcb_window_t w = requests.window;
+    Xcb::WindowAttributes &attr = requests.attributes;
+    Xcb::WindowGeometry &windowGeometry = requests.geometry;
+    if (!w || attr.isNull() || windowGeometry.isNull()) {
         return false;
     }
 
@@ -378,18 +414,18 @@ bool X11Client::manage(xcb_window_t w, bool isMapped)
         NET::WM2DesktopFileName |
         NET::WM2GTKFrameExtents;
 
-    auto wmClientLeaderCookie = fetchWmClientLeader();
-    auto skipCloseAnimationCookie = fetchSkipCloseAnimation();
-    auto showOnScreenEdgeCookie = fetchShowOnScreenEdge();
-    auto colorSchemeCookie = fetchColorScheme();
-    auto firstInTabBoxCookie = fetchFirstInTabBox();
-    auto transientCookie = fetchTransient();
-    auto activitiesCookie = fetchActivities();
-    auto applicationMenuServiceNameCookie = fetchApplicationMenuServiceName();
-    auto applicationMenuObjectPathCookie = fetchApplicationMenuObjectPath();
-
-    m_geometryHints.init(window());
-    m_motif.init(window());
+    auto &wmClientLeaderCookie = requests.wmClientLeader;
+    auto &skipCloseAnimationCookie = requests.skipCloseAnimation;
+    auto &showOnScreenEdgeCookie = requests.showOnScreenEdge;
+    auto &colorSchemeCookie = requests.colorScheme;
+    auto &firstInTabBoxCookie = requests.firstInTabBox;
+    auto &transientCookie = requests.transient;
+    auto &activitiesCookie = requests.activities;
+    auto &applicationMenuServiceNameCookie = requests.applicationMenuServiceName;
+    auto &applicationMenuObjectPathCookie = requests.applicationMenuObjectPath;
+
+    m_geometryHints = requests.geometryHints;
+    m_motif = requests.motifHints;
     info = new WinInfo(this, m_client, rootWindow(), properties, properties2);
 
     if (isDesktop() && bit_depth == 32) {
@@ -2476,11 +2512,12 @@ void X11Client::debug(QDebug& stream) const
     print<QDebug>(stream);
 }
 
-Xcb::StringProperty X11Client::fetchActivities() const
+Xcb::StringProperty X11Client::fetchActivities(xcb_window_t window)
 {
 #ifdef KWIN_BUILD_ACTIVITIES
-    return Xcb::StringProperty(window(), atoms->activities);
+    return Xcb::StringProperty(window, atoms->activities);
 #else
+    Q_UNUSED(window)
     return Xcb::StringProperty();
 #endif
 }
@@ -2543,7 +2580,7 @@ void X11Client::readActivities(Xcb::StringProperty &property)
 void X11Client::checkActivities()
 {
 #ifdef KWIN_BUILD_ACTIVITIES
-    Xcb::StringProperty property = fetchActivities();
+    Xcb::StringProperty property = fetchActivities(window());
     readActivities(property);
 #endif
 }
@@ -2559,9 +2596,9 @@ QRect X11Client::decorationRect() const
     return QRect(0, 0, width(), height());
 }
 
-Xcb::Property X11Client::fetchFirstInTabBox() const
+Xcb::Property X11Client::fetchFirstInTabBox(xcb_window_t window)
 {
-    return Xcb::Property(false, m_client, atoms->kde_first_in_window_list,
+    return Xcb::Property(false, window, atoms->kde_first_in_window_list,
                          atoms->kde_first_in_window_list, 0, 1);
 }
 
@@ -2573,13 +2610,13 @@ void X11Client::readFirstInTabBox(Xcb::Property &property)
 void X11Client::updateFirstInTabBox()
 {
     // TODO: move into KWindowInfo
-    Xcb::Property property = fetchFirstInTabBox();
+    Xcb::Property property = fetchFirstInTabBox(window());
     readFirstInTabBox(property);
 }
 
-Xcb::StringProperty X11Client::fetchColorScheme() const
+Xcb::StringProperty X11Client::fetchColorScheme(xcb_window_t window)
 {
-    return Xcb::StringProperty(m_client, atoms->kde_color_sheme);
+    return Xcb::StringProperty(window, atoms->kde_color_sheme);
 }
 
 void X11Client::readColorScheme(Xcb::StringProperty &property)
@@ -2589,7 +2626,7 @@ void X11Client::readColorScheme(Xcb::StringProperty &property)
 
 void X11Client::updateColorScheme()
 {
-    Xcb::StringProperty property = fetchColorScheme();
+    Xcb::StringProperty property = fetchColorScheme(window());
     readColorScheme(property);
 }
 
@@ -2705,9 +2742,9 @@ QSize X11Client::clientSizeToFrameSize(const QSize &size) const
     return QSize(width, height);
 }
 
-Xcb::Property X11Client::fetchShowOnScreenEdge() const
+Xcb::Property X11Client::fetchShowOnScreenEdge(xcb_window_t window)
 {
-    return Xcb::Property(false, window(), atoms->kde_screen_edge_show, XCB_ATOM_CARDINAL, 0, 1);
+    return Xcb::Property(false, window, atoms->kde_screen_edge_show, XCB_ATOM_CARDINAL, 0, 1);
 }
 
 void X11Client::readShowOnScreenEdge(Xcb::Property &property)
@@ -2778,7 +2815,7 @@ void X11Client::readShowOnScreenEdge(Xcb::Property &property)
 
 void X11Client::updateShowOnScreenEdge()
 {
-    Xcb::Property property = fetchShowOnScreenEdge();
+    Xcb::Property property = fetchShowOnScreenEdge(window());
     readShowOnScreenEdge(property);
 }
 
@@ -2817,9 +2854,9 @@ QSize X11Client::resizeIncrements() const
     return m_geometryHints.resizeIncrements();
 }
 
-Xcb::StringProperty X11Client::fetchApplicationMenuServiceName() const
+Xcb::StringProperty X11Client::fetchApplicationMenuServiceName(xcb_window_t window)
 {
-    return Xcb::StringProperty(m_client, atoms->kde_net_wm_appmenu_service_name);
+    return Xcb::StringProperty(window, atoms->kde_net_wm_appmenu_service_name);
 }
 
 void X11Client::readApplicationMenuServiceName(Xcb::StringProperty &property)
@@ -2829,13 +2866,13 @@ void X11Client::readApplicationMenuServiceName(Xcb::StringProperty &property)
 
 void X11Client::checkApplicationMenuServiceName()
 {
-    Xcb::StringProperty property = fetchApplicationMenuServiceName();
+    Xcb::StringProperty property = fetchApplicationMenuServiceName(window());
     readApplicationMenuServiceName(property);
 }
 
-Xcb::StringProperty X11Client::fetchApplicationMenuObjectPath() const
+Xcb::StringProperty X11Client::fetchApplicationMenuObjectPath(xcb_window_t window)
 {
-    return Xcb::StringProperty(m_client, atoms->kde_net_wm_appmenu_object_path);
+    return Xcb::StringProperty(window, atoms->kde_net_wm_appmenu_object_path);
 }
 
 void X11Client::readApplicationMenuObjectPath(Xcb::StringProperty &property)
@@ -2845,7 +2882,7 @@ void X11Client::readApplicationMenuObjectPath(Xcb::StringProperty &property)
 
 void X11Client::checkApplicationMenuObjectPath()
 {
-    Xcb::StringProperty property = fetchApplicationMenuObjectPath();
+    Xcb::StringProperty property = fetchApplicationMenuObjectPath(window());
     readApplicationMenuObjectPath(property);
 }
 
@@ -3032,9 +3069,9 @@ bool X11Client::sameAppWindowRoleMatch(const X11Client *c1, const X11Client *c2,
  - every window in the group : group()->members()
 */
 
-Xcb::TransientFor X11Client::fetchTransient() const
+Xcb::TransientFor X11Client::fetchTransient(xcb_window_t window)
 {
-    return Xcb::TransientFor(window());
+    return Xcb::TransientFor(window);
 }
 
 void X11Client::readTransientProperty(Xcb::TransientFor &transientFor)
@@ -3052,7 +3089,7 @@ void X11Client::readTransientProperty(Xcb::TransientFor &transientFor)
 
 void X11Client::readTransient()
 {
-    Xcb::TransientFor transientFor = fetchTransient();
+    Xcb::TransientFor transientFor = fetchTransient(window());
     readTransientProperty(transientFor);
 }
 
@@ -57,6 +57,37 @@ enum class Predicate {
     InputIdMatch
 };
 
+/**
+ * @brief The replies X11Client::manage() has to wait for before it can set up a client.
+ *
+ * Creating it only sends the requests. This allows to send the requests for all the windows
+ * which are going to be managed before waiting for the first reply, e.g. when adopting the
+ * windows which already exist on startup, instead of doing several round trips per window.
+ */
+struct KWIN_EXPORT X11ManageRequests
+{
+    explicit X11ManageRequests(xcb_window_t window);
+    /**
+     * Takes over the already sent requests for the attributes and geometry of the window.
+     */
+    X11ManageRequests(const Xcb::WindowAttributes &attributes, const Xcb::WindowGeometry &geometry);
+
+    xcb_window_t window;
+    Xcb::WindowAttributes attributes;
+    Xcb::WindowGeometry geometry;
+    Xcb::Property wmClientLeader;
+    Xcb::Property skipCloseAnimation;
+    Xcb::Property showOnScreenEdge;
+    Xcb::StringProperty colorScheme;
+    Xcb::Property firstInTabBox;
+    Xcb::TransientFor transient;
+    Xcb::StringProperty activities;
+    Xcb::StringProperty applicationMenuServiceName;
+    Xcb::StringProperty applicationMenuObjectPath;
+    Xcb::GeometryHints geometryHints;
+    Xcb::MotifHints motifHints;
+};
+
 class KWIN_EXPORT X11Client : public AbstractClient
 {
     Q_OBJECT
@@ -122,7 +153,7 @@ public:
     bool windowEvent(xcb_generic_event_t *e);
     NET::WindowType windowType(bool direct = false, int supported_types = 0) const override;
 
-    bool manage(xcb_window_t w, bool isMapped);
+    bool manage(X11ManageRequests &requests, bool isMapped);
     void releaseWindow(bool on_shutdown = false);
     void destroyClient();
 
@@ -280,10 +311,10 @@ public:
 
     void layoutDecorationRects(QRect &left, QRect &top, QRect &right, QRect &bottom) const override;
 
-    Xcb::Property fetchFirstInTabBox() const;
+    static Xcb::Property fetchFirstInTabBox(xcb_window_t window);
     void readFirstInTabBox(Xcb::Property &property);
     void updateFirstInTabBox();
-    Xcb::StringProperty fetchColorScheme() const;
+    static Xcb::StringProperty fetchColorScheme(xcb_window_t window);
     void readColorScheme(Xcb::StringProperty &property);
     void updateColorScheme() override;
 
@@ -302,11 +333,11 @@ public:
      */
     void showOnScreenEdge() override;
 
-    Xcb::StringProperty fetchApplicationMenuServiceName() const;
+    static Xcb::StringProperty fetchApplicationMenuServiceName(xcb_window_t window);
     void readApplicationMenuServiceName(Xcb::StringProperty &property);
     void checkApplicationMenuServiceName();
 
-    Xcb::StringProperty fetchApplicationMenuObjectPath() const;
+    static Xcb::StringProperty fetchApplicationMenuObjectPath(xcb_window_t window);
     void readApplicationMenuObjectPath(Xcb::StringProperty &property);
     void checkApplicationMenuObjectPath();
 
@@ -464,7 +495,7 @@ private:
 
     void updateInputWindow();
 
-    Xcb::Property fetchShowOnScreenEdge() const;
+    static Xcb::Property fetchShowOnScreenEdge(xcb_window_t window);
     void readShowOnScreenEdge(Xcb::Property &property);
     /**
      * Reads the property and creates/destroys the screen edge if required
@@ -492,7 +523,7 @@ private:
     };
     MappingState mapping_state;
 
-    Xcb::TransientFor fetchTransient() const;
+    static Xcb::TransientFor fetchTransient(xcb_window_t window);
     void readTransientProperty(Xcb::TransientFor &transientFor);
     void readTransient();
     xcb_window_t verifyTransientFor(xcb_window_t transient_for, bool set);
@@ -538,10 +569,11 @@ private:
     static bool check_active_modal; ///< \see X11Client::checkActiveModal()
     int sm_stacking_order;
     friend struct ResetupRulesProcedure;
+    friend struct X11ManageRequests;
 
     friend bool performTransiencyCheck();
 
-    Xcb::StringProperty fetchActivities() const;
+    static Xcb::StringProperty fetchActivities(xcb_window_t window);
     void readActivities(Xcb::StringProperty &property);
     void checkActivities();
     bool activitiesDefined; //whether the x property was actually set
@@ -40,6 +40,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <xcb/xfixes.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <xwayland_logging.h>
@@ -49,8 +51,17 @@ namespace KWin
 namespace Xwl
 {
 
-// in Bytes: equals 64KB
-static const uint32_t s_incrChunkSize = 63 * 1024;
+// in Bytes: the first chunk, a transfer of less data does not need to be incremental
+static const int s_minIncrChunkSize = 63 * 1024;
+// in Bytes: upper bound of the data buffered per transfer
+static const int s_maxIncrChunkSize = 4 * 1024 * 1024;
+
+static int maxIncrChunkSize()
+{
+    // a chunk has to fit into a single ChangeProperty request, which has a 24 byte header
+    const qint64 maxRequest = qint64(xcb_get_maximum_request_length(kwinApp()->x11Connection())) * 4 - 24;
+    return qBound<qint64>(s_minIncrChunkSize, maxRequest, s_maxIncrChunkSize);
+}
 
 Transfer::Transfer(xcb_atom_t selection, qint32 fd, xcb_timestamp_t timestamp, QObject *parent)
     : QObject(parent)
@@ -58,6 +69,11 @@ Transfer::Transfer(xcb_atom_t selection, qint32 fd, xcb_timestamp_t timestamp, Q
     , m_fd(fd)
     , m_timestamp(timestamp)
 {
+    // the data is streamed, a slow peer must not block the compositor
+    const int flags = fcntl(m_fd, F_GETFL);
+    if (flags == -1 || fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        qCWarning(KWIN_XWL) << "Failed to make the transfer fd non-blocking:" << m_fd;
+    }
 }
 
 void Transfer::createSocketNotifier(QSocketNotifier::Type type)
@@ -100,7 +116,10 @@ TransferWltoX::TransferWltoX(xcb_atom_t selection, xcb_selection_request_event_t
                              qint32 fd, QObject *parent)
     : Transfer(selection, fd, 0, parent)
     , m_request(request)
+    , m_chunkSize(s_minIncrChunkSize)
+    , m_maxChunkSize(maxIncrChunkSize())
 {
+    m_buffer.resize(m_chunkSize);
 }
 
 TransferWltoX::~TransferWltoX()
@@ -120,31 +139,29 @@ void TransferWltoX::startTransferFromSource()
     );
 }
 
-int TransferWltoX::flushSourceData()
+void TransferWltoX::flushSourceData()
 {
     xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
+    // the data gets copied into the output buffer of the connection,
+    // thus the buffer can be refilled right away
     xcb_change_property(xcbConn,
                         XCB_PROP_MODE_REPLACE,
                         m_request->requestor,
                         m_request->property,
                         m_request->target,
                         8,
-                        m_chunks.first().first.size(),
-                        m_chunks.first().first.data());
+                        m_bufferSize,
+                        m_buffer.constData());
     xcb_flush(xcbConn);
 
     m_propertyIsSet = true;
+    m_bufferSize = 0;
     resetTimeout();
-
-    const auto rm = m_chunks.takeFirst();
-    return rm.first.size();
 }
 
 void TransferWltoX::startIncr()
 {
-    Q_ASSERT(m_chunks.size() == 1);
-
     xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
     uint32_t mask[] = { XCB_EVENT_MASK_PROPERTY_CHANGE };
@@ -153,7 +170,7 @@ void TransferWltoX::startIncr()
                                   XCB_CW_EVENT_MASK, mask);
 
     // spec says to make the available space larger
-    const uint32_t chunkSpace = 1024 + s_incrChunkSize;
+    const uint32_t chunkSpace = 1024 + m_chunkSize;
     xcb_change_property(xcbConn,
                         XCB_PROP_MODE_REPLACE,
                         m_request->requestor,
@@ -165,69 +182,90 @@ void TransferWltoX::startIncr()
     setIncr(true);
     // first data will be flushed after the property has been deleted
     // again by the requestor
-    m_flushPropertyOnDelete = true;
     m_propertyIsSet = true;
     Q_EMIT selectionNotify(m_request, true);
 }
 
-void TransferWltoX::readWlSource()
+void TransferWltoX::finishIncr()
 {
-    if (m_chunks.size() == 0 ||
-            m_chunks.last().second == s_incrChunkSize) {
-        // append new chunk
-        auto next = QPair<QByteArray, int>();
-        next.first.resize(s_incrChunkSize);
-        next.second = 0;
-        m_chunks.append(next);
-    }
-
-    const auto oldLen = m_chunks.last().second;
-    const auto avail = s_incrChunkSize - m_chunks.last().second;
-    Q_ASSERT(avail > 0);
-
-    ssize_t readLen = read(fd(), m_chunks.last().first.data() + oldLen, avail);
-    if (readLen == -1) {
-        qCWarning(KWIN_XWL) << "Error reading in Wl data.";
+    xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
-        // TODO: cleanup X side?
-        endTransfer();
-        return;
-    }
-    m_chunks.last().second = oldLen + readLen;
+    uint32_t mask[] = {0};
+    xcb_change_window_attributes (xcbConn,
+                                  m_request->requestor,
+                                  XCB_CW_EVENT_MASK, mask);
 
-    if (readLen == 0) {
-        // at the fd end - complete transfer now
-        m_chunks.last().first.resize(m_chunks.last().second);
+    // a zero-length property marks the end of the incremental transfer
+    xcb_change_property(xcbConn,
+                        XCB_PROP_MODE_REPLACE,
+                        m_request->requestor,
+                        m_request->property,
+                        m_request->target,
+                        8, 0, nullptr);
+    xcb_flush(xcbConn);
+    endTransfer();
+}
 
-        if (incr()) {
-            // incremental transfer is to be completed now
-            m_flushPropertyOnDelete = true;
-            if (!m_propertyIsSet) {
-                // flush if target's property is not set at the moment
-                flushSourceData();
+void TransferWltoX::readWlSource()
+{
+    // drain the source until the chunk is full instead of reading once per wakeup
+    while (m_bufferSize < m_chunkSize) {
+        const ssize_t readLen = read(fd(), m_buffer.data() + m_bufferSize, m_chunkSize - m_bufferSize);
+        if (readLen == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
             }
+            qCWarning(KWIN_XWL) << "Error reading in Wl data.";
+
+            // TODO: cleanup X side?
+            endTransfer();
+            return;
+        }
+        if (readLen == 0) {
+            // at the fd end
+            m_sourceFinished = true;
             clearSocketNotifier();
-        } else {
+            break;
+        }
+        m_bufferSize += readLen;
+    }
+    resetTimeout();
+
+    if (!incr()) {
+        if (m_sourceFinished) {
             // non incremental transfer is to be completed now,
             // data can be transferred to X client via a single property set
             flushSourceData();
             Q_EMIT selectionNotify(m_request, true);
             endTransfer();
+        } else if (m_bufferSize == m_chunkSize) {
+            // first chunk full, but not yet at fd end -> go incremental
+            startIncr();
+            socketNotifier()->setEnabled(false);
         }
-    } else if (m_chunks.last().second == s_incrChunkSize) {
-        // first chunk full, but not yet at fd end -> go incremental
-        if (incr()) {
-            m_flushPropertyOnDelete = true;
-            if (!m_propertyIsSet) {
-                // flush if target's property is not set at the moment
-                flushSourceData();
-            }
+        return;
+    }
+
+    if (m_bufferSize < m_chunkSize && !m_sourceFinished) {
+        // wait for more data
+        return;
+    }
+    if (!m_propertyIsSet) {
+        // flush if target's property is not set at the moment
+        if (m_bufferSize > 0) {
+            flushSourceData();
         } else {
-            // starting incremental transfer
-            startIncr();
+            finishIncr();
+            return;
         }
     }
-    resetTimeout();
+    if (socketNotifier()) {
+        // only read ahead another chunk
+        socketNotifier()->setEnabled(m_bufferSize < m_chunkSize);
+    }
 }
 
 bool TransferWltoX::handlePropertyNotify(xcb_property_notify_event_t *event)
@@ -250,29 +288,25 @@ void TransferWltoX::handlePropertyDelete()
     }
     m_propertyIsSet = false;
 
-    if (m_flushPropertyOnDelete) {
-        if (!socketNotifier() && m_chunks.isEmpty()) {
-            // transfer complete
-            xcb_connection_t *xcbConn = kwinApp()->x11Connection();
-
-            uint32_t mask[] = {0};
-            xcb_change_window_attributes (xcbConn,
-                                          m_request->requestor,
-                                          XCB_CW_EVENT_MASK, mask);
-
-            xcb_change_property(xcbConn,
-                                XCB_PROP_MODE_REPLACE,
-                                m_request->requestor,
-                                m_request->property,
-                                m_request->target,
-                                8, 0, nullptr);
-            xcb_flush(xcbConn);
-            m_flushPropertyOnDelete = false;
-            endTransfer();
-        } else {
+    if (m_bufferSize == m_chunkSize) {
+        // the source keeps up with the requestor, so larger chunks save round trips
+        flushSourceData();
+        if (m_chunkSize < m_maxChunkSize) {
+            m_chunkSize = qMin(m_chunkSize * 2, m_maxChunkSize);
+            m_buffer.resize(m_chunkSize);
+        }
+    } else if (m_sourceFinished) {
+        if (m_bufferSize > 0) {
             flushSourceData();
+        } else {
+            // transfer complete
+            finishIncr();
+            return;
         }
     }
+    if (socketNotifier()) {
+        socketNotifier()->setEnabled(true);
+    }
 }
 
 TransferXtoWl::TransferXtoWl(xcb_atom_t selection, xcb_atom_t target, qint32 fd,
@@ -321,7 +355,12 @@ bool TransferXtoWl::handlePropertyNotify(xcb_property_notify_event_t *event)
     if (event->window == m_window) {
         if (event->state == XCB_PROPERTY_NEW_VALUE &&
                 event->atom == atoms->wl_selection) {
-            getIncrChunk();
+            if (m_receiver && !m_receiver->isEmpty()) {
+                // fetched once the current chunk is written
+                m_incrChunkPending = true;
+            } else {
+                getIncrChunk();
+            }
         }
         return true;
     }
@@ -403,10 +442,13 @@ void TransferXtoWl::getIncrChunk()
         // receive mechanism has not yet been setup
         return;
     }
+    m_incrChunkPending = false;
     xcb_connection_t *xcbConn = kwinApp()->x11Connection();
 
+    // deleting the property right away lets the source prepare the next chunk
+    // while this one is written
     auto cookie = xcb_get_property(xcbConn,
-                                   0,
+                                   1,
                                    m_window,
                                    atoms->wl_selection,
                                    XCB_GET_PROPERTY_TYPE_ANY,
@@ -441,6 +483,7 @@ DataReceiver::~DataReceiver()
 
 void DataReceiver::transferFromProperty(xcb_get_property_reply_t *reply)
 {
+    free(m_propertyReply);
     m_propertyStart = 0;
     m_propertyReply = reply;
 
@@ -460,6 +503,11 @@ QByteArray DataReceiver::data() const
                                    m_data.size() - m_propertyStart);
 }
 
+bool DataReceiver::isEmpty() const
+{
+    return m_propertyStart == m_data.size();
+}
+
 void DataReceiver::partRead(int length)
 {
     m_propertyStart += length;
@@ -553,41 +601,45 @@ void MozUrlReceiver::setData(const char *value, int length)
 
 void TransferXtoWl::dataSourceWrite()
 {
-    QByteArray property = m_receiver->data();
-
-    ssize_t len = write(fd(), property.constData(), property.size());
-    if (len == -1) {
-        qCWarning(KWIN_XWL) << "X11 to Wayland write error on fd:" << fd();
-        endTransfer();
-        return;
+    while (!m_receiver->isEmpty()) {
+        const QByteArray property = m_receiver->data();
+        const ssize_t len = write(fd(), property.constData(), property.size());
+        if (len == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // the pipe is full, continue once the receiver read from it
+                if (!socketNotifier()) {
+                    createSocketNotifier(QSocketNotifier::Write);
+                    connect(socketNotifier(), &QSocketNotifier::activated, this,
+                        [this](int socket) {
+                            Q_UNUSED(socket);
+                            dataSourceWrite();
+                        }
+                    );
+                }
+                resetTimeout();
+                return;
+            }
+            qCWarning(KWIN_XWL) << "X11 to Wayland write error on fd:" << fd();
+            endTransfer();
+            return;
+        }
+        m_receiver->partRead(len);
     }
+    resetTimeout();
 
-    m_receiver->partRead(len);
-    if (len == property.size()) {
-        // property completely transferred
-        if (incr()) {
-            clearSocketNotifier();
-            xcb_connection_t *xcbConn = kwinApp()->x11Connection();
-            xcb_delete_property(xcbConn,
-                                m_window,
-                                atoms->wl_selection);
-            xcb_flush(xcbConn);
-        } else {
-            // transfer complete
-            endTransfer();
+    // property completely transferred
+    if (incr()) {
+        clearSocketNotifier();
+        if (m_incrChunkPending) {
+            getIncrChunk();
         }
     } else {
-        if (!socketNotifier()) {
-            createSocketNotifier(QSocketNotifier::Write);
-            connect(socketNotifier(), &QSocketNotifier::activated, this,
-                [this](int socket) {
-                    Q_UNUSED(socket);
-                    dataSourceWrite();
-                }
-            );
-        }
+        // transfer complete
+        endTransfer();
     }
-    resetTimeout();
 }
 
 } // namespace Xwl
@@ -132,18 +132,27 @@ Q_SIGNALS:
 private:
     void startIncr();
     void readWlSource();
-    int flushSourceData();
+    void flushSourceData();
+    void finishIncr();
     void handlePropertyDelete();
 
     xcb_selection_request_event_t *m_request = nullptr;
 
-    /* contains all received data portioned in chunks
-     * TODO: explain second QPair component
+    /* The data read from the Wayland source which has not yet been handed to the
+     * requestor. Only a single chunk is buffered: reading from the source pauses
+     * while the buffer is full and the requestor did not consume the last chunk.
+     * The buffer keeps its capacity, only m_bufferSize bytes of it are valid.
      */
-    QVector<QPair<QByteArray, int> > m_chunks;
+    QByteArray m_buffer;
+    int m_bufferSize = 0;
+    /* Size of the next incremental chunk. Starts small and grows up to
+     * m_maxChunkSize as long as the source keeps filling the chunks.
+     */
+    int m_chunkSize;
+    int m_maxChunkSize;
 
     bool m_propertyIsSet = false;
-    bool m_flushPropertyOnDelete = false;
+    bool m_sourceFinished = false;
 
     Q_DISABLE_COPY(TransferWltoX)
 };
@@ -163,6 +172,7 @@ public:
     QByteArray data() const;
 
     void partRead(int length);
+    bool isEmpty() const;
 
 protected:
     void setDataInternal(QByteArray data) {
@@ -220,6 +230,10 @@ private:
 
     xcb_window_t m_window;
     DataReceiver *m_receiver = nullptr;
+    /* The source provided the next incremental chunk while
+     * the previous one is still being written
+     */
+    bool m_incrChunkPending = false;
 
     Q_DISABLE_COPY(TransferXtoWl)
 };